@@ -0,0 +1,152 @@
+#ifndef ADAPTIVE_STREAM_CONTROLLER_H
+#define ADAPTIVE_STREAM_CONTROLLER_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+
+/**
+ * @brief Adjusts JPEG quality and frame size to match what the link can carry
+ *
+ * Stream sender tasks report how long each frame took to send and how many
+ * frames they had to skip. Every evaluation window the controller compares
+ * those figures with the target frame rate and latency and moves one step
+ * along a ladder of operating points: JPEG quality is reduced first, then
+ * frame size. Stepping down happens after a single bad window; stepping
+ * back up needs several consecutive good windows so the stream does not
+ * oscillate on a marginal link.
+ *
+ * The top of the ladder is the configured frame size and quality (see
+ * CameraControl); lower rungs step down through the standard sizes below
+ * it. With adaptation disabled the stream stays on the top rung.
+ */
+class AdaptiveStreamController {
+public:
+    static constexpr uint32_t TARGET_FPS = 15;
+    static constexpr uint32_t TARGET_LATENCY_MS = 250;
+    static constexpr framesize_t DEFAULT_FRAME_SIZE = FRAMESIZE_VGA;
+    static constexpr int DEFAULT_QUALITY = 12;
+    static constexpr framesize_t MAX_FRAME_SIZE = FRAMESIZE_UXGA;   // Largest the OV2640 delivers
+
+    /**
+     * @brief Put the sensor on the current operating point and register
+     * the controller with the capture pipeline
+     *
+     * The camera may have been initialised at a larger frame size than the
+     * stream uses (see TimeLapse).
+     */
+    static void begin();
+
+    /**
+     * @brief Record one frame sent to a client
+     *
+     * @param sendTimeUs Time taken to write the frame to the socket
+     * @param latencyUs Time between capture and the start of sending
+     * @param framesSkipped Frames the client skipped before this one
+     */
+    static void recordFrameSent(uint32_t sendTimeUs, uint32_t latencyUs, uint32_t framesSkipped);
+
+    /**
+     * @brief Get the current position on the operating-point ladder (0 = best)
+     */
+    static uint8_t getLevel();
+
+    /**
+     * @brief Get the JPEG quality currently applied (lower is better)
+     */
+    static int getQuality();
+
+    /**
+     * @brief Get the frame size currently applied
+     */
+    static framesize_t getFrameSize();
+
+    /**
+     * @brief Get the name of the frame size currently applied
+     */
+    static const char *getFrameSizeName();
+
+    /**
+     * @brief Set the top of the ladder and whether to adapt at all
+     *
+     * Returns to the top rung and programs the sensor if it is running, so
+     * call this between frames or before the camera is initialised.
+     *
+     * @param frameSize Frame size of the top rung
+     * @param quality JPEG quality of the top rung
+     * @param adaptive false to hold the top rung whatever the link does
+     */
+    static void configure(framesize_t frameSize, int quality, bool adaptive);
+
+    /**
+     * @brief Get the configured frame size (the top of the ladder)
+     */
+    static framesize_t getBaseFrameSize();
+
+    /**
+     * @brief Get the configured JPEG quality (the top of the ladder)
+     */
+    static int getBaseQuality();
+
+    /**
+     * @brief Check whether the operating point follows the link
+     */
+    static bool isAdaptive();
+
+    /**
+     * @brief Get the name of a frame size, such as "VGA"
+     *
+     * @return "UNKNOWN" for sizes above MAX_FRAME_SIZE
+     */
+    static const char *getFrameSizeName(framesize_t frameSize);
+
+    /**
+     * @brief Look up a frame size by name (case-insensitive)
+     *
+     * @return FRAMESIZE_INVALID if the name is unknown or above MAX_FRAME_SIZE
+     */
+    static framesize_t parseFrameSize(const char *name);
+
+private:
+    static constexpr uint32_t WINDOW_MS = 2000;
+    static constexpr uint8_t UPGRADE_WINDOWS = 3;
+    static constexpr uint8_t QUALITY_STEPS = 4;
+    static constexpr int QUALITY_STEP = 6;
+    static constexpr int WORST_QUALITY = 63;
+    static constexpr uint8_t FRAME_SIZE_STEPS = 3;
+    static constexpr uint8_t MAX_LEVEL = QUALITY_STEPS * FRAME_SIZE_STEPS - 1;
+    static constexpr uint8_t LADDER_SIZE_COUNT = 7;
+
+    static const framesize_t LADDER_SIZES[LADDER_SIZE_COUNT];
+    static const char *const FRAME_SIZE_NAMES[MAX_FRAME_SIZE + 1];
+
+    static framesize_t baseFrameSize;
+    static int baseQuality;
+    static bool adaptive;
+    static uint8_t level;
+    static framesize_t appliedFrameSize;
+    static int appliedQuality;
+    static uint8_t goodWindows;
+    static uint32_t windowStartMs;
+    static uint32_t framesSent;
+    static uint32_t framesSkipped;
+    static uint64_t totalSendTimeUs;
+    static uint64_t totalLatencyUs;
+    static portMUX_TYPE statsMux;
+
+    /**
+     * @brief Evaluate the current window and apply any change; runs between frames
+     */
+    static void update();
+
+    /**
+     * @brief Program the sensor for the current level
+     */
+    static void applyLevel();
+
+    /**
+     * @brief Get the frame size a number of rungs below the top of the ladder
+     */
+    static framesize_t frameSizeAt(uint8_t steps);
+};
+
+#endif // ADAPTIVE_STREAM_CONTROLLER_H
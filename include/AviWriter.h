@@ -0,0 +1,76 @@
+#ifndef AVI_WRITER_H
+#define AVI_WRITER_H
+
+#include <Arduino.h>
+#include "StreamSessionManager.h"
+
+/**
+ * @brief Dimensions and sizes of a motion JPEG clip, known before writing
+ */
+struct AviClipInfo {
+    uint16_t width;
+    uint16_t height;
+    uint32_t frameCount;
+    uint32_t usPerFrame;
+    uint32_t maxFrameBytes;
+    uint32_t chunkBytes;   // Sum of getChunkSize() over every frame
+};
+
+/**
+ * @brief Writes an MJPEG AVI file straight to a socket
+ *
+ * Every size in the RIFF headers is worked out from AviClipInfo up front,
+ * so the file is streamed in one pass with a Content-Length and nothing is
+ * buffered: the headers, then each JPEG as a "00dc" chunk sent in place,
+ * then the idx1 index that players use for seeking.
+ */
+class AviWriter {
+public:
+    /**
+     * @brief Space a frame of @p length bytes takes in the movi list
+     */
+    static uint32_t getChunkSize(size_t length);
+
+    /**
+     * @brief Total size of the AVI file
+     */
+    static uint32_t getFileSize(const AviClipInfo &clip);
+
+    /**
+     * @brief Write the RIFF, hdrl and movi list headers
+     *
+     * @return true if the headers were sent
+     */
+    static bool writeHeader(StreamSession *session, const AviClipInfo &clip);
+
+    /**
+     * @brief Write one JPEG as a movi chunk
+     *
+     * @return true if the whole chunk was sent
+     */
+    static bool writeFrame(StreamSession *session, const uint8_t *jpeg, size_t length);
+
+    /**
+     * @brief Start the idx1 index after the last frame
+     */
+    static bool writeIndexHeader(StreamSession *session, uint32_t frameCount);
+
+    /**
+     * @brief Format one 16-byte index entry
+     *
+     * @param entry Receives the entry
+     * @param offset Offset of the frame's chunk from the movi list type
+     * @param length JPEG size in bytes
+     */
+    static void formatIndexEntry(uint8_t *entry, uint32_t offset, size_t length);
+
+    /**
+     * @brief Offset of the first chunk from the movi list type
+     */
+    static uint32_t getFirstChunkOffset();
+
+private:
+    static constexpr uint32_t HEADER_SIZE = 224;
+};
+
+#endif // AVI_WRITER_H
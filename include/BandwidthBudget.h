@@ -0,0 +1,86 @@
+#ifndef BANDWIDTH_BUDGET_H
+#define BANDWIDTH_BUDGET_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Priority class of a stream client when sharing the bandwidth budget
+ */
+enum class StreamPriority : uint8_t {
+    PRIMARY,     // "high"
+    STANDARD,    // "normal"
+    BACKGROUND   // "low"
+};
+
+/**
+ * @brief Device-wide token bucket shared by all stream clients
+ *
+ * Every stream sender draws tokens for each frame before writing it. The
+ * bucket refills at the configured rate and holds up to one second of
+ * budget. Lower priority clients may only draw while the bucket is above
+ * a reserve, so under contention high priority clients get their frames
+ * first and the uplink keeps room for MQTT and control traffic.
+ */
+class BandwidthBudget {
+public:
+    /**
+     * @brief Set the budget for all stream traffic
+     *
+     * @param kbps Budget in kilobits per second, 0 for unlimited
+     */
+    static void setLimitKbps(uint32_t kbps);
+
+    /**
+     * @brief Get the configured budget in kilobits per second (0 = unlimited)
+     */
+    static uint32_t getLimitKbps();
+
+    /**
+     * @brief Wait until a frame may be sent and charge it to the budget
+     *
+     * @param bytes Size of the frame about to be sent
+     * @param priority Priority class of the client
+     * @return Time spent waiting in milliseconds
+     */
+    static uint32_t acquire(size_t bytes, StreamPriority priority);
+
+    /**
+     * @brief Get the measured stream throughput in kilobits per second
+     */
+    static uint32_t getUsedKbps();
+
+    /**
+     * @brief Get the total time clients have spent waiting for budget
+     */
+    static uint32_t getThrottledMs();
+
+    /**
+     * @brief Parse a priority class name ("high", "normal" or "low")
+     */
+    static StreamPriority parsePriority(const char *name);
+
+    /**
+     * @brief Get the name of a priority class, as parsePriority() accepts it
+     */
+    static const char *getPriorityName(StreamPriority priority);
+
+private:
+    static constexpr uint32_t MAX_WAIT_STEP_MS = 100;
+    static constexpr uint32_t USAGE_WINDOW_MS = 5000;
+
+    static uint32_t limitBytesPerSecond;
+    static int64_t tokens;
+    static int64_t lastRefillUs;
+    static uint32_t windowStartMs;
+    static uint32_t windowBytes;
+    static uint32_t usedKbps;
+    static uint32_t throttledMs;
+    static portMUX_TYPE budgetMux;
+
+    /**
+     * @brief Top up the bucket for the time elapsed; caller holds budgetMux
+     */
+    static void refill(int64_t nowUs);
+};
+
+#endif // BANDWIDTH_BUDGET_H
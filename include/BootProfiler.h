@@ -0,0 +1,77 @@
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @brief Times the phases of start-up and the time to the first frame
+ *
+ * Phases are measured from esp_timer start (shortly after reset) and may
+ * overlap, as Wi-Fi association runs alongside camera bring-up. The first
+ * frame is grabbed at the end of camera initialisation, so the camera
+ * phase includes it and the time to first frame is in the first full
+ * heartbeat. The phases are printed at the end of setup().
+ */
+class BootProfiler {
+public:
+    static constexpr uint8_t MAX_PHASES = 8;
+
+    /**
+     * @brief Start timing a phase
+     *
+     * @param name Phase name; must stay valid
+     * @return Phase handle for endPhase(), or -1 if the table is full
+     */
+    static int8_t beginPhase(const char *name);
+
+    /**
+     * @brief Finish timing a phase
+     */
+    static void endPhase(int8_t phase);
+
+    /**
+     * @brief Record that a frame was captured; only the first one counts
+     *
+     * Called once the camera has initialised, and from the capture task on
+     * every frame in case that grab timed out.
+     */
+    static void recordFrameCaptured();
+
+    /**
+     * @brief Get the time from start-up to the first frame
+     *
+     * @return Milliseconds, or -1 if no frame has been captured yet
+     */
+    static int32_t getTimeToFirstFrameMs();
+
+    /**
+     * @brief Print the phases and time to first frame to Serial
+     */
+    static void report();
+
+    /**
+     * @brief Write the boot figures as JSON members for the heartbeat
+     *
+     * Writes ',"ttff_ms":N,"boot_ms":{"camera":N,...}' with the duration
+     * of each finished phase, without allocating.
+     *
+     * @return Characters written; output that does not fit is cut short at
+     *         size - 1, so the result can always be added to an offset
+     */
+    static int formatSummary(char *buffer, size_t size);
+
+private:
+    struct Phase {
+        const char *name;
+        uint32_t startMs;
+        uint32_t endMs;
+        bool finished;
+    };
+
+    static Phase phases[MAX_PHASES];
+    static uint8_t phaseCount;
+    static std::atomic<int32_t> firstFrameMs;
+};
+
+#endif // BOOT_PROFILER_H
@@ -0,0 +1,90 @@
+#ifndef CAMERA_BUFFER_STRATEGY_H
+#define CAMERA_BUFFER_STRATEGY_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+
+/**
+ * @brief Framebuffer layouts the camera driver can be initialised with
+ *
+ * Ordered from most to least capable so a failed initialisation can step
+ * down to the next entry.
+ */
+enum class CameraBufferMode {
+    PSRAM_TRIPLE_LATEST,
+    PSRAM_DOUBLE_LATEST,
+    DRAM_SINGLE
+};
+
+/**
+ * @brief Chooses how the camera driver allocates and fills framebuffers
+ *
+ * Boards with PSRAM get several PSRAM framebuffers in CAMERA_GRAB_LATEST
+ * mode, so the frame handed to a client is the newest one rather than one
+ * captured before the previous send finished. Boards without PSRAM keep a
+ * single DRAM framebuffer. Also tracks how old frames are when sending starts.
+ */
+class CameraBufferStrategy {
+public:
+    /**
+     * @brief Pick the best strategy for this board
+     */
+    static void select();
+
+    /**
+     * @brief Apply the current strategy to a camera configuration
+     *
+     * @param config Camera configuration to update
+     */
+    static void apply(camera_config_t &config);
+
+    /**
+     * @brief Step down to the next less demanding strategy
+     *
+     * @return true if there was a fallback left to try
+     */
+    static bool fallBack();
+
+    /**
+     * @brief Number of framebuffers the capture pipeline may hold at once
+     *
+     * In grab-latest mode one framebuffer is always left to the driver so it
+     * can keep capturing while the others are being sent.
+     */
+    static uint8_t getPipelineFrameCount();
+
+    /**
+     * @brief Get the current strategy
+     */
+    static CameraBufferMode getMode();
+
+    /**
+     * @brief Get a short description of the current strategy
+     */
+    static const char *getName();
+
+    /**
+     * @brief Record the time between capture and the start of sending
+     *
+     * @param captureTimeUs Capture time of the frame being sent
+     */
+    static void recordSendStart(int64_t captureTimeUs);
+
+    /**
+     * @brief Get the smoothed capture-to-send latency
+     */
+    static uint32_t getAverageLatencyMs();
+
+    /**
+     * @brief Get the worst capture-to-send latency since boot
+     */
+    static uint32_t getMaxLatencyMs();
+
+private:
+    static CameraBufferMode mode;
+    static uint32_t averageLatencyUs;
+    static uint32_t maxLatencyUs;
+    static portMUX_TYPE latencyMux;
+};
+
+#endif // CAMERA_BUFFER_STRATEGY_H
@@ -0,0 +1,167 @@
+#ifndef CAMERA_CONTROL_H
+#define CAMERA_CONTROL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+
+/**
+ * @brief A set of camera control values, keyed by position in the control table
+ *
+ * Only controls whose bit is set in @p mask carry a value. The same layout
+ * is used for a batch of changes and for the settings kept in NVS.
+ */
+struct CameraSettings {
+    static constexpr uint8_t CONTROL_COUNT = 28;
+
+    uint32_t mask;
+    int16_t values[CONTROL_COUNT];
+};
+
+/**
+ * @brief Runtime camera controls shared by /control and the MQTT "control" action
+ *
+ * Controls are named after their sensor_t setters (brightness, contrast,
+ * hmirror, aec_value, ...), plus framesize, quality and adaptive, which
+ * set the top of the AdaptiveStreamController ladder, roi_x, roi_y,
+ * roi_w and roi_h, which crop the stream (see RegionOfInterest), and
+ * standby_timeout_s, which parks the sensor (see CameraPower). A batch of changes
+ * is validated as a whole and staged; the capture task applies everything
+ * staged in one go between two frames, so open streams carry on and never
+ * see half a batch.
+ *
+ * Every change is also saved in the "webcam" preferences namespace and
+ * restored at the next boot. The framebuffers are sized for the frame size
+ * the camera was initialised with, so a larger one only takes full effect
+ * after a restart; until then the stream runs at the initial size.
+ */
+class CameraControl {
+public:
+    /**
+     * @brief Load the saved settings and configure the stream ladder
+     *
+     * Call before the camera is initialised, so it starts at the saved
+     * frame size and quality.
+     */
+    static void loadSettings();
+
+    /**
+     * @brief Apply the saved sensor controls and register with the capture pipeline
+     *
+     * Call once the camera is initialised, before capture starts.
+     *
+     * @param cameraFrameSize Frame size the camera was initialised with,
+     *        which the framebuffers are sized for
+     */
+    static void begin(framesize_t cameraFrameSize);
+
+    /**
+     * @brief Add one control to a batch of changes
+     *
+     * @param changes Batch to add to
+     * @param name Control name
+     * @param value Number, "true"/"false", or a frame size name such as "SVGA"
+     * @return false if the name is unknown or the value out of range
+     */
+    static bool parse(CameraSettings &changes, const char *name, const char *value);
+
+    /**
+     * @brief Stage a batch of changes for the next frame and save it
+     *
+     * @return false if the settings could not be saved
+     */
+    static bool apply(const CameraSettings &changes);
+
+    /**
+     * @brief Get the largest frame size the framebuffers hold
+     */
+    static framesize_t getMaxFrameSize();
+
+    /**
+     * @brief Check whether a saved frame size needs a restart to take full effect
+     */
+    static bool isRestartRequired();
+
+    /**
+     * @brief Add the control values, including staged ones, to a JSON document
+     */
+    static void addStatus(JsonDocument &doc);
+
+    /**
+     * @brief Handle a "control" command from the MQTT command channel
+     *
+     * {"action":"control","framesize":"SVGA","brightness":1} applies every
+     * control named in the command, or none if any of them is invalid.
+     */
+    static void handleCommand(JsonDocument &command);
+
+    /**
+     * @brief Get the number of controls
+     */
+    static uint8_t getControlCount();
+
+    /**
+     * @brief Get the name of a control
+     */
+    static const char *getControlName(uint8_t index);
+
+private:
+    struct Control {
+        const char *name;
+        int16_t minimum;
+        int16_t maximum;
+        int (*sensor_t::*setter)(sensor_t *sensor, int value);   // nullptr for stream settings
+        int (*read)(const camera_status_t &status);
+    };
+
+    static constexpr uint8_t FRAMESIZE = 0;
+    static constexpr uint8_t QUALITY = 1;
+    static constexpr uint8_t ADAPTIVE = 2;
+    static constexpr uint32_t STREAM_MASK = (1u << FRAMESIZE) | (1u << QUALITY) | (1u << ADAPTIVE);
+    static constexpr uint8_t ROI_X = 23;
+    static constexpr uint8_t ROI_Y = 24;
+    static constexpr uint8_t ROI_WIDTH = 25;
+    static constexpr uint8_t ROI_HEIGHT = 26;
+    static constexpr uint32_t ROI_MASK = (1u << ROI_X) | (1u << ROI_Y) | (1u << ROI_WIDTH) | (1u << ROI_HEIGHT);
+    static constexpr uint8_t STANDBY_TIMEOUT = 27;
+
+    static const Control CONTROLS[CameraSettings::CONTROL_COUNT];
+
+    static CameraSettings saved;
+    static CameraSettings pending;
+    static framesize_t initFrameSize;
+    static uint32_t savedGeneration;   // Bumped each time saved changes
+    static portMUX_TYPE settingsMux;    // Guards pending, saved and savedGeneration
+
+    /**
+     * @brief Apply the staged changes; runs between frames
+     */
+    static void applyPending();
+
+    /**
+     * @brief Pass the region of interest in a set of values to RegionOfInterest
+     *
+     * Fields the set does not hold keep their values from @p current.
+     */
+    static void configureRegion(const CameraSettings &settings, const CameraSettings &current);
+
+    /**
+     * @brief Program the sensor with the sensor controls in a set of values
+     */
+    static void applySensorControls(const CameraSettings &settings);
+
+    /**
+     * @brief Merge one set of values into another
+     */
+    static void merge(CameraSettings &target, const CameraSettings &changes);
+
+    /**
+     * @brief Find a control by name
+     *
+     * @return Its index, or -1 if there is none
+     */
+    static int findControl(const char *name);
+};
+
+#endif // CAMERA_CONTROL_H
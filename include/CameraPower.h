@@ -0,0 +1,174 @@
+#ifndef CAMERA_POWER_H
+#define CAMERA_POWER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_camera.h>
+
+/**
+ * @brief Power state of the camera sensor
+ */
+enum class CameraPowerState : uint8_t {
+    ACTIVE,      // Capturing for a viewer, a still or motion detection
+    IDLE,        // Powered, with nothing to capture for; counting down to standby
+    STANDBY,     // Parked
+    WAKING       // Powered up again, waiting for the first usable frame
+};
+
+/**
+ * @brief Parks the sensor while nothing needs frames, and times how fast it comes back
+ *
+ * The capture task reports whether anything is waiting for frames: a
+ * /stream, /ws or RTSP viewer, a /capture or MQTT snapshot, a still, or
+ * motion detection. After the standby timeout with none of them, the
+ * sensor is parked. Boards that wire the sensor's PWDN pin have it driven
+ * high, which halts the sensor clock while keeping its registers; others
+ * set the sensor's own standby bit over SCCB. Either way the driver stops
+ * filling framebuffers, so DMA and JPEG traffic stop too. XCLK belongs to
+ * the camera driver and keeps running.
+ *
+ * The next consumer wakes the sensor. Frames captured before it was
+ * parked, and the first one after it powers up, are thrown away; the time
+ * from the wake to the first frame handed on is the wake latency, reported
+ * in the heartbeat, /control and /metrics so the timeout can be weighed
+ * against responsiveness.
+ */
+class CameraPower {
+public:
+    static constexpr uint16_t DEFAULT_STANDBY_TIMEOUT_S = 30;
+    static constexpr uint16_t MAX_STANDBY_TIMEOUT_S = 3600;
+    static constexpr uint32_t NEVER = UINT32_MAX;
+
+    /**
+     * @brief Take over the sensor's power-down line once the camera is initialised
+     *
+     * @param pwdnPin PWDN GPIO, or -1 if the board ties it low
+     */
+    static void begin(int pwdnPin);
+
+    /**
+     * @brief Set the time without consumers before the sensor is parked
+     *
+     * Takes effect from the next time the camera goes idle.
+     *
+     * @param seconds Timeout; 0 keeps the sensor powered
+     */
+    static void setStandbyTimeout(uint16_t seconds);
+
+    /**
+     * @brief Get the standby timeout in seconds
+     */
+    static uint16_t getStandbyTimeout();
+
+    /**
+     * @brief Note that something needs frames, waking the sensor if it is parked
+     *
+     * Capture task only.
+     */
+    static void resume();
+
+    /**
+     * @brief Note that nothing needs frames, parking the sensor once the timeout has run out
+     *
+     * Capture task only.
+     *
+     * @return Milliseconds left before standby, or NEVER if the sensor is
+     *         parked or will stay powered
+     */
+    static uint32_t idle();
+
+    /**
+     * @brief Check whether a captured frame can be handed on
+     *
+     * Capture task only. The first frame accepted after a wake ends the
+     * wake latency measurement.
+     *
+     * @return false if the frame predates the wake and must be returned to the driver
+     */
+    static bool acceptFrame(const camera_fb_t *fb);
+
+    /**
+     * @brief Check whether the sensor is parked
+     */
+    static bool isParked();
+
+    /**
+     * @brief Get the current power state
+     */
+    static CameraPowerState getState();
+
+    /**
+     * @brief Get the name of the current power state
+     */
+    static const char *getStateName();
+
+    /**
+     * @brief Get the name of a power state: "active", "idle", "standby" or "waking"
+     */
+    static const char *getStateName(CameraPowerState state);
+
+    /**
+     * @brief Get the number of times the sensor has woken from standby
+     */
+    static uint32_t getWakeCount();
+
+    /**
+     * @brief Get the wake-to-first-frame latency of the last wake
+     */
+    static uint32_t getLastWakeMs();
+
+    /**
+     * @brief Get the longest wake-to-first-frame latency since boot
+     */
+    static uint32_t getMaxWakeMs();
+
+    /**
+     * @brief Get the total time the sensor has been parked, the current standby included
+     */
+    static uint32_t getStandbySeconds();
+
+    /**
+     * @brief Add the power state, standby time and wake latencies to a JSON document
+     */
+    static void addStatus(JsonDocument &doc);
+
+private:
+    static constexpr uint32_t PWDN_SETTLE_MS = 10;        // As the driver allows after power-up
+    static constexpr uint8_t WAKE_DISCARD_FRAMES = 1;     // Torn or badly exposed after power-up
+
+    static int pwdnPin;
+    static volatile CameraPowerState state;
+    static uint16_t standbyTimeoutS;
+    static uint32_t idleTimeoutMs;       // Latched when the camera went idle
+    static uint32_t idleSinceMs;
+    static bool unsupportedWarned;
+    static int64_t wakeStartUs;
+    static uint8_t framesToDiscard;
+    static uint32_t wakeCount;
+    static uint32_t lastWakeMs;
+    static uint32_t maxWakeMs;
+    static uint64_t standbyTotalMs;
+    static uint32_t standbySinceMs;
+    static portMUX_TYPE statsMux;
+
+    /**
+     * @brief Power the sensor down
+     *
+     * @return true if it is now parked
+     */
+    static bool park();
+
+    /**
+     * @brief Power the sensor up again
+     */
+    static void wake();
+
+    /**
+     * @brief Set or clear the sensor's standby bit over SCCB
+     *
+     * @return true if the sensor has one
+     */
+    static bool setSensorStandby(bool standby);
+};
+
+#endif // CAMERA_POWER_H
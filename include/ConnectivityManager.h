@@ -0,0 +1,102 @@
+#ifndef CONNECTIVITY_MANAGER_H
+#define CONNECTIVITY_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "TaskScheduler.h"
+
+/**
+ * @brief Link state of the Wi-Fi or MQTT reconnection state machine
+ */
+enum class LinkState : uint8_t {
+    CONNECTED,
+    WAITING,      // Down; the next attempt starts at the retry time
+    CONNECTING    // Association started; waiting for an address or the deadline
+};
+
+/**
+ * @brief Keeps Wi-Fi and MQTT connected without blocking anything else
+ *
+ * Runs as a TaskScheduler job. Wi-Fi driver events wake it at once; a
+ * periodic service run polls the MQTT clients and checks deadlines. A lost
+ * link is retried with exponential backoff. Wi-Fi association is started
+ * and then watched rather than waited for, and each MQTT attempt is a
+ * single short connect, so a reconnect storm only ever occupies the
+ * network task - never the capture or stream tasks on the other core.
+ *
+ * The state is mirrored in the TaskScheduler event group as
+ * WIFI_UP and MQTT_UP. MqttCommandChannel's connection is retried with a
+ * backoff of its own, and only while MQTT_UP is set: with the broker
+ * down, the main connection's attempts already find that out.
+ */
+class ConnectivityManager {
+public:
+    static constexpr uint32_t SERVICE_INTERVAL_MS = 50;
+
+    /**
+     * @brief Take over the connections set up during boot
+     *
+     * Call before TaskScheduler::begin().
+     *
+     * @param onMqttConnected Job posted each time MQTT reconnects; may be nullptr
+     */
+    static void begin(TaskScheduler::Job onMqttConnected);
+
+    /**
+     * @brief Check deadlines, start attempts and poll the MQTT clients
+     *
+     * Runs on the scheduler task every SERVICE_INTERVAL_MS.
+     */
+    static void service();
+
+    /**
+     * @brief Get the number of times Wi-Fi has been re-established
+     */
+    static uint32_t getWiFiReconnects();
+
+    /**
+     * @brief Get the number of times MQTT has been re-established
+     */
+    static uint32_t getMqttReconnects();
+
+private:
+    static constexpr uint32_t MIN_BACKOFF_MS = 1000;
+    static constexpr uint32_t MAX_BACKOFF_MS = 32000;
+    static constexpr int MQTT_ATTEMPT_TIMEOUT_S = 1;
+
+    static LinkState wifiState;
+    static LinkState mqttState;
+    static uint32_t wifiRetryAtMs;
+    static uint32_t wifiDeadlineMs;
+    static uint32_t wifiBackoffMs;
+    static uint32_t wifiLostAtMs;
+    static uint32_t mqttRetryAtMs;
+    static uint32_t mqttBackoffMs;
+    static uint32_t commandRetryAtMs;
+    static uint32_t commandBackoffMs;
+    static uint32_t wifiReconnects;
+    static uint32_t mqttReconnects;
+    static TaskScheduler::Job mqttConnectedJob;
+
+    /**
+     * @brief Wi-Fi driver event handler; runs on the Arduino event task
+     */
+    static void onWiFiEvent(arduino_event_id_t event);
+
+    /**
+     * @brief Advance the Wi-Fi state machine
+     */
+    static void updateWiFi(uint32_t nowMs);
+
+    /**
+     * @brief Advance the MQTT state machine; needs Wi-Fi
+     */
+    static void updateMqtt(uint32_t nowMs);
+
+    /**
+     * @brief Poll the command channel, reconnecting it while MQTT is up
+     */
+    static void updateCommandChannel(uint32_t nowMs);
+};
+
+#endif // CONNECTIVITY_MANAGER_H
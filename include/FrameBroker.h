@@ -0,0 +1,239 @@
+#ifndef FRAME_BROKER_H
+#define FRAME_BROKER_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+/**
+ * @brief A captured frame shared between all subscribers
+ *
+ * Wraps a driver framebuffer with a reference count. The framebuffer is
+ * handed back to the camera driver when the last reference is released.
+ */
+struct SharedFrame {
+    camera_fb_t *fb;
+    uint32_t sequence;
+    uint32_t refCount;
+    int64_t captureTimeUs;
+};
+
+/**
+ * @brief Captures each frame once and fans it out to every subscriber
+ *
+ * A single capture task owns the camera and publishes each frame into a
+ * reference-counted "latest frame" slot. Subscribers (one per /stream
+ * client) always pick up the newest frame they have not yet seen, so a
+ * slow client skips frames instead of holding back the others.
+ *
+ * Subscribers and stills keep the sensor awake; once there have been none
+ * for the standby timeout, the capture task parks it (see CameraPower) and
+ * wakes it for the next one. Passive subscribers take frames while the
+ * sensor is awake but do not keep it so.
+ */
+class FrameBroker {
+public:
+    static constexpr uint8_t MAX_SUBSCRIBERS = 8;
+    static constexpr uint8_t MAX_FRAMES = 3;
+
+    /**
+     * @brief Start the capture task
+     *
+     * @param framebufferCount Number of framebuffers the camera driver was initialised with
+     * @return true if the capture task was started
+     */
+    static bool begin(uint8_t framebufferCount);
+
+    /**
+     * @brief Register a new frame consumer
+     *
+     * @param keepAwake false for a passive subscriber, which leaves the
+     *        sensor to go into standby while nothing else needs frames
+     * @return Subscriber id, or -1 if all subscriber slots are in use
+     */
+    static int subscribe(bool keepAwake = true);
+
+    /**
+     * @brief Remove a frame consumer
+     *
+     * @param subscriberId Id returned by subscribe()
+     */
+    static void unsubscribe(int subscriberId);
+
+    /**
+     * @brief Wait for the newest frame this subscriber has not yet seen
+     *
+     * Frames published while the subscriber was busy are skipped.
+     * The returned frame must be handed back with release().
+     *
+     * @param subscriberId Id returned by subscribe()
+     * @param timeout Maximum time to wait for a frame
+     * @return The acquired frame, or nullptr on timeout
+     */
+    static SharedFrame *waitForFrame(int subscriberId, TickType_t timeout);
+
+    /**
+     * @brief Acquire the most recently captured frame without waiting
+     *
+     * @param maxAgeMs Ignore the cached frame if it is older than this
+     * @return The acquired frame, or nullptr if no recent frame is cached
+     */
+    static SharedFrame *acquireLatest(uint32_t maxAgeMs);
+
+    /**
+     * @brief Wait for a frame newer than a given sequence number
+     *
+     * Returns the cached frame straight away if it is already newer,
+     * otherwise subscribes just long enough for the next capture.
+     *
+     * @param afterSequence Sequence number the caller already has
+     * @param timeout Maximum time to wait for a frame
+     * @return The acquired frame, or nullptr on timeout
+     */
+    static SharedFrame *waitForFrameAfter(uint32_t afterSequence, TickType_t timeout);
+
+    /**
+     * @brief Release a frame acquired from the broker
+     */
+    static void release(SharedFrame *frame);
+
+    /**
+     * @brief Get the number of frames captured since boot
+     */
+    static uint32_t getCapturedFrameCount();
+
+    /**
+     * @brief Get the number of frames a subscriber has skipped
+     */
+    static uint32_t getDroppedFrameCount(int subscriberId);
+
+    /**
+     * @brief Get the number of active subscribers
+     */
+    static uint8_t getSubscriberCount();
+
+    /**
+     * @brief Get a random value chosen at boot that distinguishes
+     * sequence numbers from different boots
+     */
+    static uint32_t getEpoch();
+
+    /**
+     * @brief Register a function the capture task calls between frames
+     *
+     * Sensor settings changed from a between-frames callback never affect
+     * a frame that is part-way through capture.
+     *
+     * @return true if the callback was registered
+     */
+    static bool addBetweenFramesCallback(void (*callback)());
+
+    /**
+     * @brief Capture one frame at a different frame size and quality
+     *
+     * Between two frames the capture task switches the sensor over. It keeps
+     * the first frame that comes back at @p frameSize rather than publishing
+     * it, then switches straight back to the streaming settings. Frames
+     * already in the pipeline at the old size are still published. The
+     * stream therefore only misses the still itself and any frames the
+     * sensor drops while changing mode. Between-frames callbacks wait until
+     * the switch is over.
+     *
+     * One still is taken at a time. @p frameSize must fit the framebuffers.
+     *
+     * @return The still, to be handed back with release(), or nullptr on timeout
+     */
+    static SharedFrame *captureStill(framesize_t frameSize, int quality, TickType_t timeout);
+
+    /**
+     * @brief Get the gap the last still left between two published frames
+     */
+    static uint32_t getLastStillGapMs();
+
+private:
+    struct Subscriber {
+        bool active;
+        bool keepsAwake;
+        uint32_t lastSequence;
+        uint32_t droppedFrames;
+        SemaphoreHandle_t frameReady;
+    };
+
+    static constexpr uint32_t CAPTURE_TASK_STACK = 4096;
+    static constexpr uint32_t CAPTURE_RETRY_DELAY_MS = 100;
+    static constexpr uint8_t MAX_CALLBACKS = 4;
+    static constexpr uint8_t STILL_MAX_FRAMES = 8;   // Give up if the new size has not arrived by then
+
+    struct StillRequest {
+        bool pending;                  // Requested and not yet delivered or abandoned
+        bool switched;                 // Sensor is on the still settings; capture task only
+        framesize_t frameSize;
+        int quality;
+        framesize_t streamFrameSize;   // Settings to return to
+        int streamQuality;
+        uint8_t framesWaited;
+        SharedFrame *frame;
+    };
+
+    static SharedFrame frames[MAX_FRAMES];
+    static Subscriber subscribers[MAX_SUBSCRIBERS];
+    static SharedFrame *latest;
+    static uint8_t framebufferCount;
+    static uint8_t outstandingFrames;
+    static uint8_t subscriberCount;
+    static uint8_t awakeSubscriberCount;     // Subscribers that keep the sensor out of standby
+    static uint32_t sequence;
+    static uint32_t epoch;
+    static SemaphoreHandle_t lock;
+    static SemaphoreHandle_t frameReleased;
+    static TaskHandle_t captureTask;
+    static void (*betweenFramesCallbacks[MAX_CALLBACKS])();
+    static uint8_t callbackCount;
+    static StillRequest still;
+    static SemaphoreHandle_t stillLock;
+    static SemaphoreHandle_t stillReady;
+    static int64_t lastPublishUs;
+    static int64_t stillGapStartUs;
+    static uint32_t lastStillGapMs;
+
+    /**
+     * @brief Capture loop run by the capture task
+     */
+    static void captureLoop(void *parameter);
+
+    /**
+     * @brief Block until the driver has a framebuffer free for the next capture
+     */
+    static void waitForFreeFramebuffer();
+
+    /**
+     * @brief Publish a captured framebuffer as the latest frame
+     */
+    static void publish(camera_fb_t *fb);
+
+    /**
+     * @brief Switch the sensor over for a requested still, or back after an abandoned one
+     */
+    static void beginStill();
+
+    /**
+     * @brief Hand a frame at the still size to the requester
+     *
+     * @return true if the frame was taken and must not be published
+     */
+    static bool takeStill(camera_fb_t *fb);
+
+    /**
+     * @brief Put the streaming settings back after a still
+     */
+    static void endStill();
+
+    /**
+     * @brief Drop one reference to a frame; the caller must hold the lock
+     */
+    static void releaseLocked(SharedFrame *frame);
+};
+
+#endif // FRAME_BROKER_H
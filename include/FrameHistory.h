@@ -0,0 +1,170 @@
+#ifndef FRAME_HISTORY_H
+#define FRAME_HISTORY_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "AviWriter.h"
+#include "JpegArena.h"
+
+/**
+ * @brief State of the event clip held in the history
+ */
+enum class ClipState : uint8_t {
+    IDLE,        // No clip; the history is recycled freely
+    RECORDING,   // Triggered; still recording the post-event window
+    READY        // Window complete and protected until released or expired
+};
+
+/**
+ * @brief Keeps the last few seconds of JPEG frames in a PSRAM arena
+ *
+ * A low-priority task copies captured frames, at up to RECORD_FPS, into a
+ * JpegArena allocated once at start-up, overwriting the oldest, so
+ * recording never allocates.
+ *
+ * trigger() freezes a window around the current moment: frames from the
+ * last @p preSeconds, plus the next @p postSeconds as they arrive. Frames
+ * in the window are never overwritten until the clip is released, so it
+ * can be exported as an AVI while recording carries on in the rest of the
+ * arena. Boards without PSRAM have no history.
+ *
+ * Recording does not keep the sensor out of standby (see CameraPower), so
+ * there is no history from while it is parked. A clip keeps the sensor
+ * awake until its post-event window is complete.
+ */
+class FrameHistory {
+public:
+    static constexpr uint32_t RECORD_FPS = 10;
+    static constexpr uint32_t DEFAULT_PRE_SECONDS = 5;
+    static constexpr uint32_t DEFAULT_POST_SECONDS = 5;
+
+    /**
+     * @brief Allocate the arena and start the recording task
+     *
+     * @return true if recording was started
+     */
+    static bool begin();
+
+    /**
+     * @brief Check whether the history is recording
+     */
+    static bool isAvailable();
+
+    /**
+     * @brief Freeze a clip around the current moment
+     *
+     * @param preSeconds Seconds of history before now to include
+     * @param postSeconds Seconds after now to keep recording into the clip
+     * @return false if there is no history or a clip is already held
+     */
+    static bool trigger(uint32_t preSeconds, uint32_t postSeconds);
+
+    /**
+     * @brief Drop the held clip so its frames can be recycled
+     */
+    static void releaseClip();
+
+    /**
+     * @brief Handle a "clip" command from the MQTT command channel
+     *
+     * {"action":"clip","pre":5,"post":5} triggers a clip, and
+     * {"action":"clip","release":true} drops the held one.
+     */
+    static void handleCommand(JsonDocument &command);
+
+    /**
+     * @brief Get the state of the clip
+     */
+    static ClipState getClipState();
+
+    /**
+     * @brief Start exporting the held clip
+     *
+     * The clip stays protected until the matching endExport(), even if it
+     * expires or is released meanwhile.
+     *
+     * @param info Receives the dimensions and sizes of the clip
+     * @return false if no complete clip is held
+     */
+    static bool beginExport(AviClipInfo &info);
+
+    /**
+     * @brief Get a frame of the clip being exported
+     *
+     * @param index Frame number within the clip
+     * @param data Receives a pointer to the JPEG in the arena
+     * @param length Receives the JPEG size
+     * @return true if the frame exists
+     */
+    static bool getClipFrame(uint32_t index, const uint8_t **data, size_t *length);
+
+    /**
+     * @brief Finish an export started with beginExport()
+     */
+    static void endExport();
+
+    /**
+     * @brief Add the history and clip status to a JSON document
+     *
+     * Includes how many seconds of history fit at the current frame size
+     * and quality.
+     */
+    static void addStatus(JsonDocument &doc);
+
+private:
+    static constexpr uint32_t TASK_STACK = 3072;
+    static constexpr uint32_t FRAME_WAIT_TIMEOUT_MS = 1000;
+    static constexpr uint32_t MAX_RECORDS = 1024;
+    static constexpr size_t ARENA_MAX_BYTES = 2 * 1024 * 1024;
+    static constexpr size_t ARENA_MIN_BYTES = 256 * 1024;
+    static constexpr size_t PSRAM_RESERVE_BYTES = 1024 * 1024;
+    static constexpr uint32_t MAX_PRE_SECONDS = 60;
+    static constexpr uint32_t MAX_POST_SECONDS = 60;
+    static constexpr uint32_t CLIP_HOLD_MS = 120000;
+
+    static JpegArena arena;
+    static uint32_t averageFrameBytes;
+    static uint32_t framesRecorded;
+    static uint32_t framesRejected;
+
+    static ClipState clipState;
+    static uint32_t clipFirstRecord;
+    static uint32_t clipLastRecord;
+    static int64_t clipEndUs;
+    static uint32_t clipReadyMs;
+    static bool clipTruncated;
+    static uint8_t exportCount;
+
+    static SemaphoreHandle_t lock;
+    static TaskHandle_t recordTask;
+
+    /**
+     * @brief Recording loop run by the recording task
+     */
+    static void recordLoop(void *parameter);
+
+    /**
+     * @brief Copy one frame into the arena, evicting the oldest records
+     *
+     * @return true if the frame was stored
+     */
+    static bool store(const uint8_t *jpeg, size_t length, uint16_t width, uint16_t height,
+                      uint32_t sequence, int64_t captureTimeUs);
+
+    /**
+     * @brief Eviction policy: the oldest record may go unless it belongs to the held clip
+     *
+     * Called by the arena, under the lock.
+     */
+    static bool canEvict(uint32_t serial);
+
+    /**
+     * @brief Complete or expire the clip as time passes; caller holds the lock
+     */
+    static void updateClipLocked(int64_t nowUs);
+};
+
+#endif // FRAME_HISTORY_H
@@ -2,8 +2,8 @@
 #define HEARTBEAT_MQTT_PUBLISHER_H
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
 #include <WiFi.h>
+#include "CameraPower.h"
 #include "MqttHandler.h"
 #include "ConfigurationManager.h"
 #include "version.h"
@@ -11,14 +11,112 @@
 /**
  * @brief Publishes heartbeat messages to MQTT
  * 
- * Heartbeat includes device information, WiFi status, uptime, and system metrics
+ * Heartbeat includes device information, WiFi status, uptime, and system metrics.
+ *
+ * Messages are formatted into static buffers so a heartbeat does not touch
+ * the heap. The identity fields (id, name, version, boot count and so on)
+ * are encoded once, the network fields again only when the IP address
+ * changes, and only uptime, heap and RSSI on every beat. The segments are
+ * written straight to the broker through MqttCommandChannel. MqttHandler
+ * is only used while that connection is down; its publish() takes a
+ * String, so the segments are joined into one reserved in begin().
+ *
+ * The camera's power state (see CameraPower) is in every full heartbeat,
+ * and in a delta one when it has changed since the last report; the
+ * latency of waking from standby is in heartbeat/stream.
+ *
+ * The first full heartbeat also carries the time to first frame and the
+ * duration of each boot phase from BootProfiler; if no frame had been
+ * captured yet, they are repeated in the first heartbeat after one is.
+ *
+ * Between full heartbeats (at start-up, every FULL_HEARTBEAT_INTERVAL_MS
+ * and whenever the IP address changes) a delta heartbeat carries the id
+ * and uptime plus free_heap and rssi only if they moved by more than
+ * HEAP_DELTA_BYTES or RSSI_DELTA_DB. heartbeat/stream is suppressed between
+ * full heartbeats while the camera is idle and no client is connected.
  */
 class HeartbeatMqttPublisher {
 public:
+    static constexpr uint32_t FULL_HEARTBEAT_INTERVAL_MS = 15 * 60 * 1000;
+    static constexpr uint32_t HEAP_DELTA_BYTES = 4096;
+    static constexpr int RSSI_DELTA_DB = 5;
+
+    /**
+     * @brief Encode the identity fields once the configuration is loaded
+     */
+    static void begin();
+
     /**
      * @brief Publish a heartbeat message
+     *
+     * @return true if the heartbeat was handed to a connected client
+     */
+    static bool publishHeartbeat();
+
+    /**
+     * @brief Get the number of full and delta heartbeats published
+     */
+    static uint32_t getPublishCount();
+
+private:
+    static constexpr size_t IDENTITY_BUFFER_SIZE = 320;
+    static constexpr size_t NETWORK_BUFFER_SIZE = 96;
+    static constexpr size_t DYNAMIC_BUFFER_SIZE = 288;
+    static constexpr size_t STREAM_BUFFER_SIZE = 480;
+
+    static char identity[IDENTITY_BUFFER_SIZE];   // '{"id":...' up to the network fields
+    static char idMember[64];                     // '{"id":"<uuid>"' opening a delta
+    static char network[NETWORK_BUFFER_SIZE];
+    static char dynamic[DYNAMIC_BUFFER_SIZE];
+    static char streamStatus[STREAM_BUFFER_SIZE];
+    static size_t identityLength;
+    static size_t idMemberLength;
+    static size_t networkLength;
+    static uint8_t lastIp[4];
+    static uint32_t lastFreeHeap;
+    static int lastRssi;
+    static uint32_t lastFullMs;
+    static uint32_t lastFramesCaptured;
+    static uint32_t publishCount;
+    static bool publishedFull;
+    static bool bootReported;      // Boot figures sent along with the time to first frame
+    static CameraPowerState lastCameraState;
+    static String fallbackPayload;   // Reused by publishSegments() for MqttHandler
+
+    /**
+     * @brief Re-encode the network fields if the IP address changed
+     *
+     * @return true if the address changed
+     */
+    static bool updateNetwork();
+
+    /**
+     * @brief Publish capture and stream pipeline figures on heartbeat/stream
+     *
+     * Kept separate from the heartbeat so each message fits the 512-byte
+     * MQTT buffer set in setup().
+     */
+    static bool publishStreamStatus();
+
+    /**
+     * @brief Publish a message made of several segments without joining them
+     */
+    static bool publishSegments(const char *topic, const char *const *segments, const size_t *lengths,
+                                uint8_t count);
+
+    /**
+     * @brief Append a JSON string value, escaping quotes and backslashes
+     *
+     * @return New length of the buffer contents
+     */
+    static size_t appendJsonString(char *buffer, size_t size, size_t length, const char *value);
+
+    /**
+     * @brief Append printf-style output, clamping at the end of the buffer
+     *
+     * @return New length of the buffer contents, at most size - 1
      */
-    static void publishHeartbeat();
+    static size_t appendFormat(char *buffer, size_t size, size_t length, const char *format, ...);
 };
 
 #endif // HEARTBEAT_MQTT_PUBLISHER_H
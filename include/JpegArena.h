@@ -0,0 +1,133 @@
+#ifndef JPEG_ARENA_H
+#define JPEG_ARENA_H
+
+#include <Arduino.h>
+
+/**
+ * @brief One JPEG held in a JpegArena
+ */
+struct JpegRecord {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t sequence;
+    uint16_t width;
+    uint16_t height;
+    int64_t captureTimeUs;
+};
+
+/**
+ * @brief Ring of variable-length JPEG records in one PSRAM allocation
+ *
+ * JPEGs are stored back to back and the oldest are overwritten as the
+ * write position wraps, so storing never allocates. A fixed ring of record
+ * descriptors indexes the arena. Records are numbered by serial: the live
+ * ones run from getOldest() up to, but not including, getNext().
+ *
+ * The owner decides which records may go through an eviction policy, asked
+ * each time the oldest record is in the way. The arena has no lock of its
+ * own; the owner serialises every call.
+ */
+class JpegArena {
+public:
+    /**
+     * @brief Eviction policy
+     *
+     * @param serial Serial number of the oldest record
+     * @return true if the record may be overwritten
+     */
+    typedef bool (*EvictionPolicy)(uint32_t serial);
+
+    /**
+     * @param maxRecords Size of the descriptor ring
+     * @param canEvict Policy asked before the oldest record is dropped
+     */
+    JpegArena(uint32_t maxRecords, EvictionPolicy canEvict);
+
+    /**
+     * @brief Work out how big an arena PSRAM can spare
+     *
+     * @param maxBytes Largest arena wanted
+     * @param minBytes Smallest arena worth having
+     * @param reserveBytes PSRAM to leave free for everything else
+     * @return The arena size, or 0 if less than @p minBytes is spare
+     */
+    static size_t getAvailableSize(size_t maxBytes, size_t minBytes, size_t reserveBytes);
+
+    /**
+     * @brief Allocate the arena and its descriptors in PSRAM
+     *
+     * @return false if either allocation failed
+     */
+    bool allocate(size_t size);
+
+    /**
+     * @brief Check whether the arena has been allocated
+     */
+    bool isAllocated() const;
+
+    /**
+     * @brief Get the arena size in bytes
+     */
+    size_t getSize() const;
+
+    /**
+     * @brief Make room for a JPEG, evicting the oldest records the policy lets go
+     *
+     * The space is the caller's until the matching commit(). It is in no
+     * record, so it can be filled without holding the owner's lock as long
+     * as nothing else reserves or clears meanwhile.
+     *
+     * @param length JPEG size in bytes
+     * @return Pointer to the space, or nullptr if the JPEG does not fit
+     */
+    uint8_t *reserve(size_t length);
+
+    /**
+     * @brief Add the JPEG copied into the space from the last reserve() as the newest record
+     */
+    void commit(size_t length, uint16_t width, uint16_t height, uint32_t sequence, int64_t captureTimeUs);
+
+    /**
+     * @brief Drop every record
+     */
+    void clear();
+
+    /**
+     * @brief Get the serial number of the oldest record
+     */
+    uint32_t getOldest() const;
+
+    /**
+     * @brief Get the serial number the next record will have
+     */
+    uint32_t getNext() const;
+
+    /**
+     * @brief Get the record with a given serial number
+     */
+    const JpegRecord &at(uint32_t serial) const;
+
+    /**
+     * @brief Get the JPEG data of a record
+     */
+    const uint8_t *getData(const JpegRecord &record) const;
+
+private:
+    const uint32_t maxRecords;
+    const EvictionPolicy canEvict;
+
+    uint8_t *data;
+    size_t size;
+    JpegRecord *records;
+    uint32_t oldest;
+    uint32_t next;
+    uint32_t writeOffset;
+    uint32_t reservedOffset;
+
+    /**
+     * @brief Drop the oldest record if the policy allows it
+     */
+    bool evictOldest();
+};
+
+#endif // JPEG_ARENA_H
@@ -0,0 +1,123 @@
+#ifndef JPEG_DC_DECODER_H
+#define JPEG_DC_DECODER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Reduced-size planes decoded by JpegDcDecoder::decodeScaled()
+ *
+ * One plane per component in SOF order (Y, Cb, Cr for a colour JPEG), each
+ * at its own sampling: with 4:2:2 the chroma planes are half as wide as
+ * the luma plane. Planes point into the caller's output buffer.
+ */
+struct JpegScaledImage {
+    uint8_t componentCount;
+    uint16_t width;               // Full image size from the SOF
+    uint16_t height;
+    uint8_t *planes[3];
+    uint16_t planeWidths[3];      // Whole blocks, so may be a little wider than the image
+    uint16_t planeHeights[3];
+};
+
+/**
+ * @brief Extracts 1/8- and 1/4-scale images from a baseline JPEG
+ *
+ * The DC coefficient of every 8x8 block is the block's mean brightness,
+ * so the DC terms alone form a thumbnail at 1/8 scale. The decoder walks
+ * the entropy-coded data, keeps the DC terms and skips the AC
+ * coefficients without dequantising them, so there is no IDCT or colour
+ * conversion work. For 1/4 scale it also keeps the first horizontal,
+ * vertical and diagonal AC terms, which are enough to split each block
+ * into the means of its four quadrants. Baseline Huffman JPEGs with any
+ * sampling factors and restart intervals are supported, which covers
+ * everything the camera sensor produces.
+ */
+class JpegDcDecoder {
+public:
+    /**
+     * @brief Decode the luma DC map of a JPEG
+     *
+     * @param jpeg JPEG data
+     * @param length Length of the JPEG data
+     * @param output Receives one byte per 8x8 luma block, row by row
+     * @param capacity Size of @p output in bytes
+     * @param blocksWide Receives the width of the map in blocks
+     * @param blocksHigh Receives the height of the map in blocks
+     * @return true on success, false for unsupported or corrupt data or a map larger than @p capacity
+     */
+    bool decodeLumaDc(const uint8_t *jpeg, size_t length, uint8_t *output, size_t capacity,
+                      uint16_t &blocksWide, uint16_t &blocksHigh);
+
+    /**
+     * @brief Decode every component of a JPEG at 1/8 or 1/4 scale
+     *
+     * @param jpeg JPEG data
+     * @param length Length of the JPEG data
+     * @param divisor 8 for one pixel per block, 4 for two by two
+     * @param output Receives the planes one after another
+     * @param capacity Size of @p output in bytes
+     * @param image Receives the plane sizes and pointers into @p output
+     * @return true on success, false for unsupported or corrupt data or planes larger than @p capacity
+     */
+    bool decodeScaled(const uint8_t *jpeg, size_t length, uint8_t divisor, uint8_t *output, size_t capacity,
+                      JpegScaledImage &image);
+
+private:
+    static constexpr uint8_t MAX_COMPONENTS = 3;
+    static constexpr uint8_t LOOKAHEAD_BITS = 9;
+    static constexpr uint8_t LOW_FREQUENCIES = 5;   // Zigzag positions kept for 1/4 scale
+
+    /**
+     * @brief Called with each decoded block of the scan
+     *
+     * @param coefficients Dequantised coefficients in zigzag order; only the
+     *                     first lowFrequencies passed to decodeScan() are filled in
+     */
+    typedef void (*BlockHandler)(void *context, uint8_t component, uint32_t blockX, uint32_t blockY,
+                                 const int *coefficients);
+
+    struct HuffmanTable {
+        bool defined;
+        // Fast path: (code length << 8) | symbol for every 9-bit prefix, 0 if longer
+        uint16_t lookahead[1 << LOOKAHEAD_BITS];
+        int32_t maxCode[18];
+        int32_t valueOffset[17];
+        uint8_t values[256];
+    };
+
+    struct Component {
+        uint8_t id;
+        uint8_t horizontal;
+        uint8_t vertical;
+        uint8_t quantTable;
+        uint8_t dcTable;
+        uint8_t acTable;
+        int predictor;
+    };
+
+    HuffmanTable dcTables[2];
+    HuffmanTable acTables[2];
+    uint16_t quantLow[4][LOW_FREQUENCIES];
+    Component components[MAX_COMPONENTS];
+    uint8_t componentCount;
+    uint16_t width;
+    uint16_t height;
+    uint16_t restartInterval;
+
+    const uint8_t *position;
+    const uint8_t *end;
+    uint32_t bitBuffer;
+    int bitCount;
+
+    bool buildTable(HuffmanTable &table, const uint8_t *counts, const uint8_t *symbols, int symbolCount);
+    bool parseHeaders(const uint8_t *jpeg, size_t length, const uint8_t **scan, uint8_t *scanOrder, uint8_t &scanCount);
+    void fillBits();
+    uint32_t getBits(int count);
+    int decodeSymbol(const HuffmanTable &table);
+    bool skipToRestart();
+    void getBlockCount(uint8_t component, uint16_t &blocksWide, uint16_t &blocksHigh) const;
+    bool decodeScan(const uint8_t *scan, const uint8_t *limit, const uint8_t *scanOrder, uint8_t scanCount,
+                    uint8_t lowFrequencies, BlockHandler handler, void *context);
+};
+
+#endif // JPEG_DC_DECODER_H
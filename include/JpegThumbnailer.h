@@ -0,0 +1,99 @@
+#ifndef JPEG_THUMBNAILER_H
+#define JPEG_THUMBNAILER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "FrameBroker.h"
+
+class JpegDcDecoder;
+
+/**
+ * @brief Makes 1/8- and 1/4-scale JPEG thumbnails of captured frames
+ *
+ * Serves /stream?scale= for dashboards that show many cameras as small
+ * tiles. The frame is never fully decoded: JpegDcDecoder reads the block
+ * DC terms (plus the first AC terms at 1/4) straight from the entropy-coded
+ * data, and only the thumbnail, 80x60 or 160x120 at VGA, is encoded again
+ * with fmt2jpg(). Thumbnails come from the same captured framebuffer as
+ * the full stream.
+ *
+ * Each frame is transcoded at most once per scale; every client at that
+ * scale gets a copy of the cached result.
+ */
+class JpegThumbnailer {
+public:
+    static constexpr uint8_t THUMBNAIL_QUALITY = 60;      // fmt2jpg() quality, 1-100
+
+    /**
+     * @brief Create the cache lock and decoder
+     *
+     * Buffers are allocated on first use.
+     *
+     * @return true if thumbnails are available
+     */
+    static bool begin();
+
+    /**
+     * @brief Parse a scale parameter: "1/8" or "8", "1/4" or "4"
+     *
+     * @param text Parameter value
+     * @param divisor Receives 8 or 4
+     * @return true if the scale is supported
+     */
+    static bool parseScale(const char *text, uint8_t &divisor);
+
+    /**
+     * @brief Get the thumbnail of a frame, transcoding it if nobody has yet
+     *
+     * @param frame Frame held by the caller
+     * @param divisor 8 or 4
+     * @param buffer Caller's buffer, grown with realloc() as needed and freed by the caller
+     * @param capacity Size of @p buffer, updated when it grows
+     * @param length Receives the length of the thumbnail
+     * @return true if the thumbnail was copied into @p buffer
+     */
+    static bool copyThumbnail(const SharedFrame *frame, uint8_t divisor, uint8_t *&buffer, size_t &capacity,
+                              size_t &length);
+
+    /**
+     * @brief Get the time the last transcode took
+     */
+    static uint32_t getLastTranscodeUs();
+
+private:
+    /**
+     * @brief Most recent thumbnail at one scale
+     */
+    struct CacheEntry {
+        bool valid;
+        uint32_t sequence;
+        uint8_t *jpeg;           // From fmt2jpg()
+        size_t length;
+    };
+
+    static SemaphoreHandle_t lock;
+    static JpegDcDecoder *decoder;
+    static CacheEntry cache[2];  // 1/8 then 1/4
+    static uint8_t *planes;      // Scratch for the decoded planes
+    static size_t planesCapacity;
+    static uint8_t *yuyv;        // Scratch for the packed thumbnail
+    static size_t yuyvCapacity;
+    static uint32_t lastTranscodeUs;
+
+    /**
+     * @brief Decode a frame at reduced scale and encode the result as a JPEG
+     *
+     * Called with the lock held.
+     *
+     * @return true if @p entry now holds the frame's thumbnail
+     */
+    static bool transcode(const camera_fb_t *fb, uint8_t divisor, CacheEntry &entry);
+
+    /**
+     * @brief Grow a scratch buffer, preferring PSRAM
+     */
+    static bool reserve(uint8_t *&buffer, size_t &capacity, size_t size);
+};
+
+#endif // JPEG_THUMBNAILER_H
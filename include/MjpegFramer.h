@@ -0,0 +1,74 @@
+#ifndef MJPEG_FRAMER_H
+#define MJPEG_FRAMER_H
+
+#include <Arduino.h>
+#include "StreamSessionManager.h"
+
+/**
+ * @brief Writes multipart/x-mixed-replace MJPEG framing straight to a socket
+ *
+ * Each frame goes out as one scatter-gather write of the boundary and part
+ * headers, the JPEG data straight from the framebuffer, and the trailing
+ * CRLF. The body is not chunk-encoded: the connection is closed at the end
+ * of the stream, so no chunk size lines are needed.
+ *
+ * For latency measurement each part carries X-Frame-Seq, X-Timestamp (the
+ * frame's capture time) and X-Send-Timestamp (when the part was handed to
+ * the socket), and the response carries X-Server-Time so a client can map
+ * the camera clock to its own. All times are seconds.microseconds on the
+ * esp_timer clock, which counts from boot.
+ */
+class MjpegFramer {
+public:
+    /**
+     * @brief Write the HTTP response status line and headers
+     *
+     * X-Server-Time is taken just before the write, so a client that notes
+     * when it sent the request and when the headers arrived knows the camera
+     * clock to within half that round trip.
+     *
+     * @return true if the headers were sent
+     */
+    static bool writeResponseHeader(StreamSession *session);
+
+    /**
+     * @brief Write one JPEG as a multipart part
+     *
+     * @param session Session to write to
+     * @param sequence Frame sequence number
+     * @param captureTimeUs Capture time of the frame
+     * @param jpeg JPEG data, sent in place without copying
+     * @param length JPEG size in bytes
+     * @return true if the whole part was sent
+     */
+    static bool writeFrame(StreamSession *session, uint32_t sequence, int64_t captureTimeUs,
+                           const uint8_t *jpeg, size_t length);
+
+    /**
+     * @brief Get the number of frames written since boot
+     */
+    static uint32_t getFramesWritten();
+
+    /**
+     * @brief Get the number of socket writes made for frames since boot
+     */
+    static uint32_t getSocketWrites();
+
+    /**
+     * @brief Get the framing bytes written since boot
+     *
+     * Counts everything on the wire except the JPEG data itself.
+     */
+    static uint64_t getOverheadBytes();
+
+private:
+    static constexpr size_t PART_HEADER_SIZE = 192;
+    static constexpr size_t RESPONSE_HEADER_SIZE = 224;
+
+    static uint32_t framesWritten;
+    static uint32_t socketWrites;
+    static uint64_t overheadBytes;
+    static portMUX_TYPE statsMux;
+};
+
+#endif // MJPEG_FRAMER_H
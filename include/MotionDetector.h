@@ -0,0 +1,209 @@
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+class JpegDcDecoder;
+
+/**
+ * @brief Rectangular detection zone, in percent of the frame
+ */
+struct MotionZone {
+    bool enabled;
+    uint8_t x;
+    uint8_t y;
+    uint8_t width;
+    uint8_t height;
+    uint8_t triggerPercent;   // Share of the zone's blocks that must change
+};
+
+/**
+ * @brief Detects motion from the DC terms of captured JPEGs
+ *
+ * A low-priority task subscribes to the frame broker like a stream client
+ * and decodes only the luma DC coefficients of each frame, giving a 1/8
+ * scale brightness map (80x60 blocks at VGA). Each block is compared with
+ * a slowly learnt background after removing any global brightness change,
+ * and a zone is active when enough of its blocks differ by more than the
+ * threshold. Motion starts after consecutive active frames and stops after
+ * a quiet period; start and stop events are queued and a job is posted to
+ * the network task to publish them on the "motion" MQTT topic.
+ *
+ * The detector takes the newest frame each time it is ready, so if it ever
+ * falls behind it skips frames rather than holding back the stream.
+ */
+class MotionDetector {
+public:
+    static constexpr uint8_t MAX_ZONES = 4;
+
+    /**
+     * @brief Start the detection task
+     *
+     * @return true if the task was started
+     */
+    static bool begin();
+
+    /**
+     * @brief Enable or disable detection
+     *
+     * While disabled the task unsubscribes, so the camera can idle when
+     * nobody is streaming. Detection starts disabled; the setting is saved
+     * and restored by begin() after a reboot.
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief Check whether detection is enabled
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Set the brightness change (0-255) at which a block counts as changed
+     */
+    static void setThreshold(uint8_t threshold);
+
+    /**
+     * @brief Get the block change threshold
+     */
+    static uint8_t getThreshold();
+
+    /**
+     * @brief Replace a detection zone
+     *
+     * @param index Zone number, 0 to MAX_ZONES - 1
+     * @param zone New zone settings
+     * @return true if the index and rectangle were valid
+     */
+    static bool setZone(uint8_t index, const MotionZone &zone);
+
+    /**
+     * @brief Get a detection zone
+     */
+    static MotionZone getZone(uint8_t index);
+
+    /**
+     * @brief Check whether motion is currently in progress
+     */
+    static bool isMotionActive();
+
+    /**
+     * @brief Analyse one JPEG frame
+     *
+     * Called by the detection task for every frame it picks up, and by the
+     * host benchmark directly.
+     *
+     * @param jpeg JPEG data
+     * @param length Length of the JPEG data
+     * @param sequence Frame sequence number, reported in events
+     * @param nowMs Capture time of the frame in milliseconds
+     * @return true if the frame was decoded and analysed
+     */
+    static bool processFrame(const uint8_t *jpeg, size_t length, uint32_t sequence, uint32_t nowMs);
+
+    /**
+     * @brief Publish queued start and stop events on the "motion" topic
+     *
+     * Runs on the network task, which owns the MQTT connection. Events stay
+     * queued while MQTT is down.
+     */
+    static void publishPendingEvents();
+
+    /**
+     * @brief Add settings, zones and statistics to a status document
+     */
+    static void addStatus(JsonDocument &doc);
+
+private:
+    struct MotionEvent {
+        bool start;
+        uint8_t zones;            // Bit per zone active when the event was raised
+        uint8_t changedPercent;   // Peak changed share over the enabled zones
+        uint32_t sequence;
+        uint32_t durationMs;
+    };
+
+    static constexpr uint32_t TASK_STACK = 4096;
+    static constexpr uint32_t FRAME_WAIT_TIMEOUT_MS = 5000;
+    static constexpr uint32_t NO_PSRAM_INTERVAL_MS = 200;
+    static constexpr size_t MAX_JPEG_COPY = 256 * 1024;
+    static constexpr uint32_t MAX_BLOCKS_PSRAM = 200 * 150;   // UXGA
+    static constexpr uint32_t MAX_BLOCKS_INTERNAL = 80 * 60;  // VGA
+    static constexpr uint8_t DEFAULT_THRESHOLD = 12;
+    static constexpr uint8_t LEARN_SHIFT = 6;
+    static constexpr uint8_t CHANGED_LEARN_SHIFT = 8;
+    static constexpr uint8_t WARMUP_FRAMES = 8;
+    static constexpr uint8_t START_FRAMES = 2;
+    static constexpr uint32_t STOP_QUIET_MS = 3000;
+    static constexpr uint8_t EVENT_QUEUE_SIZE = 4;
+
+    static volatile bool enabled;
+    static uint8_t threshold;
+    static MotionZone zones[MAX_ZONES];
+    static portMUX_TYPE settingsMux;
+
+    static JpegDcDecoder *decoder;
+    static uint8_t *lumaMap;
+    static uint16_t *background;
+    static uint8_t *changedMask;
+    static uint32_t blockCapacity;
+    static uint16_t mapWidth;
+    static uint16_t mapHeight;
+    static uint8_t warmupFrames;
+    static uint8_t activeFrames;
+    static bool motionActive;
+    static uint32_t motionStartMs;
+    static uint32_t lastActiveMs;
+    static uint8_t peakChangedPercent;
+    static uint8_t motionZones;
+
+    static MotionEvent events[EVENT_QUEUE_SIZE];
+    static uint8_t eventHead;
+    static uint8_t eventCount;
+    static uint32_t eventsDropped;
+    static portMUX_TYPE eventMux;
+
+    static uint32_t framesAnalysed;
+    static uint32_t decodeFailures;
+    static uint32_t framesSkipped;
+    static uint32_t averageAnalysisUs;
+    static uint32_t maxAnalysisUs;
+    static uint8_t lastChangedPercent;
+    static TaskHandle_t detectTask;
+
+    /**
+     * @brief Detection loop run by the detection task
+     */
+    static void detectLoop(void *parameter);
+
+    /**
+     * @brief Allocate the map, background and mask buffers on first use
+     */
+    static bool allocateBuffers();
+
+    /**
+     * @brief Compare the luma map with the background and update it
+     *
+     * @return Number of changed blocks
+     */
+    static uint32_t compareWithBackground(uint32_t blockCount, uint8_t blockThreshold);
+
+    /**
+     * @brief Count the changed blocks inside a zone as a percentage
+     */
+    static uint8_t zoneChangedPercent(const MotionZone &zone);
+
+    /**
+     * @brief Advance the start and stop state for one analysed frame
+     */
+    static void updateState(uint8_t activeZones, uint8_t changedPercent, uint32_t sequence, uint32_t nowMs);
+
+    /**
+     * @brief Queue an event for publishing, dropping the oldest if full
+     */
+    static void queueEvent(const MotionEvent &event);
+};
+
+#endif // MOTION_DETECTOR_H
@@ -0,0 +1,112 @@
+#ifndef MQTT_COMMAND_CHANNEL_H
+#define MQTT_COMMAND_CHANNEL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+
+/**
+ * @brief Handler for one command action; runs on the network task
+ */
+typedef void (*MqttCommandHandler)(JsonDocument &command);
+
+/**
+ * @brief Second MQTT connection for device commands and large payloads
+ *
+ * MqttHandler owns the main connection but neither exposes incoming
+ * messages nor streaming publishes, so this keeps a connection of its own
+ * (client id "<name>-cmd") that subscribes to configure/<uuid>. Each
+ * message is parsed as JSON and passed to the handler registered for its
+ * "action" field; unknown actions are ignored, as they may be meant for
+ * MqttHandler. The client's buffer stays at COMMAND_BUFFER_SIZE: commands
+ * are small, and large payloads are streamed through getClient() with
+ * beginPublish()/write()/endPublish(), which bypasses the buffer.
+ *
+ * ConnectivityManager decides when to connect: it calls connect() only
+ * while the main MQTT connection is up, with the same backoff, and each
+ * attempt gives up after ATTEMPT_TIMEOUT_S rather than PubSubClient's and
+ * WiFiClient's default timeouts, as it runs on the network task.
+ *
+ * Handlers run inside loop() while the client's buffer still holds the
+ * message, so they must not publish; they record what to do and post a
+ * TaskScheduler job to act on it afterwards.
+ */
+class MqttCommandChannel {
+public:
+    static constexpr uint8_t MAX_HANDLERS = 6;
+
+    /**
+     * @brief Configure the client from the device configuration
+     *
+     * The first connection attempt is made by loop().
+     */
+    static void begin();
+
+    /**
+     * @brief Register the handler for an action
+     *
+     * @param action Value of the "action" field; must stay valid
+     * @return false if the handler table is full
+     */
+    static bool addHandler(const char *action, MqttCommandHandler handler);
+
+    /**
+     * @brief Dispatch incoming commands and keep the connection alive
+     *
+     * Called by ConnectivityManager on the network task while Wi-Fi is up.
+     * Does nothing while disconnected; see connect().
+     */
+    static void loop();
+
+    /**
+     * @brief Make one connection attempt and subscribe to the command topic
+     *
+     * Blocks for at most about ATTEMPT_TIMEOUT_S per step. Retries are up to
+     * the caller.
+     *
+     * @return true if connected and subscribed
+     */
+    static bool connect();
+
+    /**
+     * @brief Check whether the command connection is up
+     */
+    static bool isConnected();
+
+    /**
+     * @brief Get the client, for streaming publishes from the network task
+     */
+    static PubSubClient &getClient();
+
+    /**
+     * @brief Get the device UUID used in topics
+     */
+    static const char *getDeviceId();
+
+private:
+    struct Handler {
+        const char *action;
+        MqttCommandHandler handler;
+    };
+
+    static constexpr uint16_t COMMAND_BUFFER_SIZE = 512;
+    static constexpr uint16_t ATTEMPT_TIMEOUT_S = 1;
+
+    static WiFiClient wifiClient;
+    static PubSubClient client;
+    static Handler handlers[MAX_HANDLERS];
+    static uint8_t handlerCount;
+    static char server[64];          // PubSubClient keeps the pointer
+    static char deviceId[40];
+    static char commandTopic[64];
+    static bool configured;
+    static bool failureReported;   // Log one failure per outage
+
+    /**
+     * @brief PubSubClient message callback
+     */
+    static void onMessage(char *topic, uint8_t *payload, unsigned int length);
+};
+
+#endif // MQTT_COMMAND_CHANNEL_H
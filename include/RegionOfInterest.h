@@ -0,0 +1,142 @@
+#ifndef REGION_OF_INTEREST_H
+#define REGION_OF_INTEREST_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_camera.h>
+
+/**
+ * @brief Measured cost of streaming one region
+ */
+struct RegionStats {
+    uint16_t x;                  // Region in field pixels
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t outputWidth;        // Encoded size, most recently
+    uint16_t outputHeight;
+    uint32_t frames;
+    uint32_t bytesPerFrame;
+    float fps;                   // Capture rate while the region was in use
+    bool current;
+};
+
+/**
+ * @brief Crops the stream to a region of the sensor with the OV2640's DSP window
+ *
+ * A camera watching a doorway or a gauge need not capture, encode and send
+ * the whole field. The region is given in pixels of the full 1600x1200
+ * sensor field through the roi_x, roi_y, roi_w and roi_h camera controls
+ * (see CameraControl), and programmed with set_res_raw() between two
+ * frames. Only the region is encoded: it is scaled down to fit the current
+ * stream frame size, but never up, so a region smaller than the frame size
+ * comes out at full sensor resolution - a digital zoom that costs fewer
+ * bytes, not more. The sensor runs in the fastest of its CIF, SVGA and UXGA
+ * modes that still has a pixel for every output pixel.
+ *
+ * set_framesize() resets the window, so the adaptive ladder and stills call
+ * apply() again after changing the frame size.
+ *
+ * Bytes per frame and frame rate are measured for each of the last few
+ * regions, the full field included, so the saving can be compared.
+ */
+class RegionOfInterest {
+public:
+    static constexpr uint16_t FIELD_WIDTH = 1600;     // OV2640 UXGA
+    static constexpr uint16_t FIELD_HEIGHT = 1200;
+    static constexpr uint16_t MIN_SIZE = 64;
+    static constexpr uint8_t MAX_STATS = 4;
+
+    /**
+     * @brief Set the region; applied by the next apply()
+     *
+     * The region is moved and shrunk to fit the field, and rounded to
+     * multiples of 4 pixels.
+     *
+     * @param width Region width; 0 for the full field
+     * @param height Region height; 0 for the full field
+     */
+    static void configure(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
+    /**
+     * @brief Program the sensor window for the region and the current frame size
+     *
+     * Call on the capture task between frames, and after every set_framesize()
+     * on the stream.
+     */
+    static void apply();
+
+    /**
+     * @brief Check whether the stream is cropped to a region
+     */
+    static bool isActive();
+
+    /**
+     * @brief Count a captured stream frame towards the current region's statistics
+     */
+    static void recordFrame(const camera_fb_t *fb);
+
+    /**
+     * @brief Add the region, its output size and per-region statistics to a JSON document
+     */
+    static void addStatus(JsonDocument &doc);
+
+    /**
+     * @brief Get the statistics of the regions used most recently
+     *
+     * @param stats Receives up to MAX_STATS entries
+     * @return Number of entries written
+     */
+    static uint8_t getStats(RegionStats *stats);
+
+private:
+    static constexpr uint32_t MAX_FRAME_GAP_US = 1000000;   // Longer gaps are idle time, not frame intervals
+
+    // OV2640 sensor modes as set_res_raw() takes them in startX
+    enum SensorMode : uint8_t {
+        MODE_UXGA = 0,
+        MODE_SVGA = 1,
+        MODE_CIF = 2
+    };
+
+    struct Region {
+        uint16_t x;
+        uint16_t y;
+        uint16_t width;
+        uint16_t height;
+    };
+
+    struct Stats {
+        Region region;
+        uint16_t outputWidth;
+        uint16_t outputHeight;
+        uint32_t frames;
+        uint64_t bytes;
+        uint32_t intervals;
+        uint64_t intervalUs;
+        int64_t lastCaptureUs;           // 0 until a frame of this run of the region
+        uint32_t lastUsedMs;
+    };
+
+    static Region requested;
+    static Region applied;
+    static bool windowed;                // The sensor window is cropped
+    static bool warned;
+    static uint16_t outputWidth;
+    static uint16_t outputHeight;
+    static Stats stats[MAX_STATS];
+    static Stats *current;
+    static portMUX_TYPE statsMux;
+
+    /**
+     * @brief Pick the statistics entry for a region, reusing the oldest if it is new
+     */
+    static Stats *selectStats(const Region &region);
+
+    /**
+     * @brief Check whether a region covers the whole field
+     */
+    static bool isFullField(const Region &region);
+};
+
+#endif // REGION_OF_INTEREST_H
@@ -0,0 +1,72 @@
+#ifndef RTP_JPEG_H
+#define RTP_JPEG_H
+
+#include <Arduino.h>
+
+/**
+ * @brief What RTP/JPEG needs to know about one JPEG from the sensor
+ *
+ * Filled in by RtpJpeg::parse(). The scan points into the framebuffer, so
+ * the frame must be held until every packet has gone out.
+ */
+struct RtpJpegFrame {
+    uint8_t type;                 // RFC 2435 type: 0 for 4:2:2, 1 for 4:2:0, +64 with restart markers
+    uint8_t width;                // In units of 8 pixels
+    uint8_t height;
+    uint16_t restartInterval;
+    uint8_t quantTables[128];     // Luma then chroma, 8-bit, zigzag order as in the DQT
+    const uint8_t *scan;          // Entropy-coded data, without the EOI marker
+    size_t scanLength;
+};
+
+/**
+ * @brief One RTP packet: headers in a buffer, payload straight from the frame
+ */
+struct RtpJpegPacket {
+    uint8_t header[12 + 8 + 4 + 4 + 128];
+    size_t headerLength;
+    const uint8_t *payload;
+    size_t payloadLength;
+    bool last;                    // Carries the RTP marker bit
+};
+
+/**
+ * @brief Packetises baseline JPEGs as RTP/JPEG (RFC 2435)
+ *
+ * RTP/JPEG leaves out the JPEG headers and sends only the scan, with a small
+ * header per packet from which the receiver rebuilds them. That only works
+ * for the standard Huffman tables of ITU T.81 Annex K, which the OV2640 and
+ * OV3660 always use. The quantisation tables are sent in the first packet
+ * of every frame (Q = 255), so quality changes at run time need no
+ * renegotiation.
+ */
+class RtpJpeg {
+public:
+    static constexpr uint8_t PAYLOAD_TYPE = 26;
+    static constexpr uint32_t CLOCK_RATE = 90000;
+    static constexpr size_t MAX_PAYLOAD_SIZE = 1400;   // Keeps packets within a 1500-byte MTU
+
+    /**
+     * @brief Find the scan and the parameters RTP/JPEG needs in a JPEG
+     *
+     * @return false if the JPEG cannot be carried: not baseline YCbCr with
+     *         4:2:2 or 4:2:0 sampling, too large, or truncated
+     */
+    static bool parse(const uint8_t *jpeg, size_t length, RtpJpegFrame &frame);
+
+    /**
+     * @brief Build the next packet of a frame
+     *
+     * @param frame Frame returned by parse()
+     * @param offset Scan offset of the packet; advanced past its payload
+     * @param sequence RTP sequence number
+     * @param timestamp RTP timestamp, the same for every packet of a frame
+     * @param ssrc RTP synchronisation source
+     * @param packet Receives the packet
+     * @return false once the whole scan has been packetised
+     */
+    static bool nextPacket(const RtpJpegFrame &frame, size_t &offset, uint16_t sequence,
+                           uint32_t timestamp, uint32_t ssrc, RtpJpegPacket &packet);
+};
+
+#endif // RTP_JPEG_H
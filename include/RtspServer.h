@@ -0,0 +1,237 @@
+#ifndef RTSP_SERVER_H
+#define RTSP_SERVER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+#include "BandwidthBudget.h"
+
+// Both can be overridden from build_flags in platformio.ini; the native
+// build listens on 8554 so it needs no privileges
+#ifndef RTSP_PORT
+#define RTSP_PORT 554
+#endif
+#ifndef RTSP_MULTICAST_ENABLED
+#define RTSP_MULTICAST_ENABLED 1
+#endif
+
+/**
+ * @brief How a client asked for RTP to be delivered
+ */
+enum class RtspTransport : uint8_t {
+    NONE,        // No SETUP yet
+    UDP,         // Unicast to the client's RTP/RTCP ports
+    TCP,         // Interleaved on the RTSP connection
+    MULTICAST    // One shared transmission to a group
+};
+
+/**
+ * @brief RTSP server streaming the camera as RTP/JPEG (RFC 2326, RFC 2435)
+ *
+ * Runs next to WebCamServer for NVRs and players that speak RTSP, e.g.
+ * rtsp://<ip>/ in VLC or ffmpeg. Frames come from FrameBroker like /stream
+ * and are sent without transcoding: RtpJpeg splits each JPEG's scan into
+ * packets.
+ *
+ * A server task answers OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN and
+ * GET_PARAMETER on every connection. Each unicast client that plays gets a
+ * sender task of its own, sending RTP over UDP or, when UDP is blocked,
+ * interleaved on the RTSP connection (RTP/AVP/TCP). Multicast clients all
+ * share one sender to the group 239.255.x.y, where x.y are the last two
+ * octets of the camera's address, on port 5004: however many viewers join,
+ * the camera sends each frame once. Every sender reports every 5 seconds
+ * in an RTCP sender report so clients can map RTP time to wall-clock time.
+ *
+ * Each sender holds a StreamSessionManager stream slot, as a "normal"
+ * /stream viewer does; PLAY is answered 503 with Retry-After when none
+ * is free.
+ *
+ * Sessions time out after 60 seconds without a request, an RTCP receiver
+ * report or interleaved data from the client, and end when the RTSP
+ * connection closes.
+ */
+class RtspServer {
+public:
+    static constexpr uint8_t MAX_CLIENTS = 4;
+    static constexpr uint16_t SERVER_RTP_PORT = 6970;          // RTCP on the next port
+    static constexpr uint16_t MULTICAST_PORT = 5004;
+    static constexpr uint8_t MULTICAST_TTL = 1;
+    static constexpr uint32_t SESSION_TIMEOUT_SECONDS = 60;
+
+    /**
+     * @brief Open the listening and RTP/RTCP sockets and start the server task
+     *
+     * Call once Wi-Fi is up.
+     *
+     * @return true if the server was started
+     */
+    static bool begin();
+
+    /**
+     * @brief Get the URL to give an RTSP client
+     */
+    static String getUrl();
+
+private:
+    static constexpr size_t REQUEST_BUFFER_SIZE = 1024;
+    static constexpr size_t RESPONSE_BUFFER_SIZE = 768;
+    static constexpr uint32_t SERVER_TASK_STACK = 6144;
+    static constexpr uint32_t SENDER_TASK_STACK = 4096;
+    static constexpr uint32_t SELECT_TIMEOUT_MS = 1000;
+    static constexpr uint32_t FRAME_WAIT_TIMEOUT_MS = 1000;
+    static constexpr uint32_t SENDER_STOP_WAIT_MS = 3000;
+    static constexpr uint32_t REPORT_INTERVAL_MS = 5000;
+    static constexpr uint32_t SEND_TIMEOUT_MS = 5000;
+    static constexpr uint8_t SEND_RETRY_LIMIT = 20;
+    static constexpr StreamPriority STREAM_PRIORITY = StreamPriority::STANDARD;
+
+    /**
+     * @brief RTP state of one transmission, and the sender task behind it
+     */
+    struct Stream {
+        RtspTransport transport;
+        int fd;                            // TCP: RTSP connection the packets are interleaved on
+        SemaphoreHandle_t writeLock;       // TCP: shared with RTSP responses
+        uint8_t channel;                   // TCP: RTP channel, RTCP on the next one
+        struct sockaddr_in rtpAddress;     // UDP and multicast
+        struct sockaddr_in rtcpAddress;
+        int subscriber;
+        uint32_t ssrc;
+        uint16_t sequence;
+        uint32_t timestampOffset;          // Random start for RTP time
+        uint32_t packetCount;
+        uint32_t octetCount;
+        uint32_t lastReportMs;
+        volatile bool stopRequested;
+        volatile bool running;             // Cleared by the sender as it exits
+    };
+
+    struct Client {
+        bool active;
+        bool closing;                      // Connection gone; slot freed once the sender has stopped
+        int fd;
+        uint32_t sessionId;                // 0 until SETUP
+        bool playing;
+        uint32_t lastActivityMs;
+        Stream stream;                     // Unicast only; multicast clients use multicastStream
+        size_t received;
+        char request[REQUEST_BUFFER_SIZE + 1];
+    };
+
+    static Client clients[MAX_CLIENTS];
+    static Stream multicastStream;
+    static int listenSocket;
+    static int rtpSocket;
+    static int rtcpSocket;
+    static TaskHandle_t serverTask;
+
+    /**
+     * @brief Accept connections and answer requests; run by the server task
+     */
+    static void serverLoop(void *parameter);
+
+    /**
+     * @brief Accept a new RTSP connection, or turn it away if every slot is taken
+     */
+    static void acceptClient();
+
+    /**
+     * @brief Read from a connection and handle every complete request in it
+     *
+     * @return false if the connection has closed
+     */
+    static bool receive(Client &client);
+
+    /**
+     * @brief Answer one request
+     *
+     * @param request Request line and headers, NUL-terminated
+     */
+    static void handleRequest(Client &client, char *request);
+
+    /**
+     * @brief Handle SETUP: choose the transport and create the session
+     *
+     * @return RTSP status code
+     */
+    static int setup(Client &client, const char *transport, char *reply, size_t replySize);
+
+    /**
+     * @brief Handle PLAY: start the client's sender, or join the multicast one
+     *
+     * @return RTSP status code
+     */
+    static int play(Client &client, const char *url, char *reply, size_t replySize);
+
+    /**
+     * @brief Stop sending to a client; for multicast, stop the shared sender once nobody is left
+     */
+    static void stopPlaying(Client &client);
+
+    /**
+     * @brief Stop playing and mark the client for closing
+     */
+    static void closeClient(Client &client);
+
+    /**
+     * @brief Start a sender task for a stream
+     */
+    static bool startSender(Stream &stream, const char *name);
+
+    /**
+     * @brief Ask a sender to stop and wait until it has
+     *
+     * @return true if the sender has stopped
+     */
+    static bool stopSender(Stream &stream);
+
+    /**
+     * @brief Give a stream a fresh SSRC, sequence number and RTP time offset
+     */
+    static void resetStream(Stream &stream);
+
+    /**
+     * @brief Send frames from FrameBroker until asked to stop; run by each sender task
+     */
+    static void streamSender(void *parameter);
+
+    /**
+     * @brief Packetise and send one frame
+     *
+     * @return false if the stream cannot carry on (TCP connection gone)
+     */
+    static bool sendFrame(Stream &stream, const uint8_t *jpeg, size_t length, uint32_t timestamp);
+
+    /**
+     * @brief Send an RTCP sender report with a CNAME if one is due
+     */
+    static void sendReport(Stream &stream);
+
+    /**
+     * @brief Send one RTP or RTCP packet of a stream
+     *
+     * @param rtcp true to send on the RTCP port or channel
+     * @return true if the packet was sent
+     */
+    static bool sendPacket(Stream &stream, bool rtcp, const uint8_t *header, size_t headerLength,
+                           const uint8_t *payload, size_t payloadLength);
+
+    /**
+     * @brief Write a whole buffer to an RTSP connection under its write lock
+     */
+    static bool sendLocked(int fd, SemaphoreHandle_t writeLock, const char *data, size_t length);
+
+    /**
+     * @brief Note an RTCP receiver report as activity on the session it belongs to
+     */
+    static void receiveReport();
+
+    /**
+     * @brief Multicast group for this camera, from its current address
+     */
+    static struct in_addr getMulticastGroup();
+};
+
+#endif // RTSP_SERVER_H
@@ -0,0 +1,83 @@
+#ifndef SNAPSHOT_MQTT_PUBLISHER_H
+#define SNAPSHOT_MQTT_PUBLISHER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PubSubClient.h>
+#include "FrameBroker.h"
+#include "MqttCommandChannel.h"
+
+/**
+ * @brief Publishes camera snapshots to MQTT on request
+ *
+ * A "snapshot" command on configure/<uuid> asks for the next frame to be
+ * published, either as a single message (mode "stream") or as a series of
+ * sequenced chunks (mode "chunks") for brokers that cap the message size.
+ * The JPEG is written from the framebuffer straight to the socket with
+ * beginPublish()/write()/endPublish(), so no copy of it is ever made and
+ * heap use does not depend on the image size; the 512-byte MQTT buffers
+ * are never involved.
+ *
+ * Topics:
+ *   snapshot/<uuid>/info   JSON description, published first
+ *   snapshot/<uuid>        the JPEG (mode "stream")
+ *   snapshot/<uuid>/chunk  CHUNK_HEADER_SIZE-byte header + data (mode "chunks")
+ */
+class SnapshotMqttPublisher {
+public:
+    static constexpr size_t CHUNK_HEADER_SIZE = 12;
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1024;
+    static constexpr size_t MIN_CHUNK_SIZE = 64;
+    static constexpr size_t MAX_CHUNK_SIZE = 16384;
+
+    /**
+     * @brief Register the "snapshot" command
+     */
+    static void begin();
+
+    /**
+     * @brief Capture and publish a snapshot now
+     *
+     * @param chunked Publish as sequenced chunks instead of one message
+     * @param chunkSize JPEG bytes per chunk, clamped to MIN/MAX_CHUNK_SIZE
+     * @return true if every message was written to the broker
+     */
+    static bool publishSnapshot(bool chunked, size_t chunkSize);
+
+private:
+    static constexpr uint32_t FRAME_MAX_AGE_MS = 1000;
+    static constexpr uint32_t FRAME_WAIT_TIMEOUT_MS = 2000;
+
+    static bool pending;
+    static bool pendingChunked;
+    static size_t pendingChunkSize;
+
+    /**
+     * @brief Publish the requested snapshot; posted to the network task by the command handler
+     */
+    static void publishPending();
+
+    /**
+     * @brief Record a snapshot request from the command channel
+     */
+    static void handleCommand(JsonDocument &command);
+
+    /**
+     * @brief Publish the info message describing the snapshot
+     */
+    static bool publishInfo(PubSubClient &client, const SharedFrame *frame, bool chunked, uint32_t chunkCount);
+
+    /**
+     * @brief Publish the JPEG as sequenced chunks
+     */
+    static bool publishChunks(PubSubClient &client, const SharedFrame *frame, size_t chunkSize, uint32_t chunkCount);
+
+    /**
+     * @brief Write a payload through the client without buffering it
+     *
+     * @return true if every byte was written
+     */
+    static bool writeAll(PubSubClient &client, const uint8_t *data, size_t length);
+};
+
+#endif // SNAPSHOT_MQTT_PUBLISHER_H
@@ -0,0 +1,169 @@
+#ifndef STREAM_METRICS_H
+#define STREAM_METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_http_server.h>
+#include "FrameBroker.h"
+
+/**
+ * @brief Fixed-bucket latency histogram
+ *
+ * Bucket and observation counts are relaxed atomics. The sum is kept in
+ * microseconds, so sub-millisecond observations still add up; at 64 bits
+ * it needs a short critical section, as the ESP32 has no 64-bit atomics.
+ */
+class LatencyHistogram {
+public:
+    static constexpr uint8_t BUCKET_COUNT = 11;
+
+    /**
+     * @brief Upper bounds of the buckets in milliseconds
+     */
+    static const uint32_t BUCKET_BOUNDS_MS[BUCKET_COUNT];
+
+    /**
+     * @brief Record one observation
+     *
+     * @param durationUs Observed duration in microseconds
+     */
+    void record(uint32_t durationUs);
+
+    /**
+     * @brief Get the number of observations
+     */
+    uint32_t getCount() const;
+
+    /**
+     * @brief Get the mean observation in milliseconds
+     */
+    uint32_t getAverageMs() const;
+
+    /**
+     * @brief Get the cumulative count of observations up to a bucket bound
+     */
+    uint32_t getCumulativeCount(uint8_t bucket) const;
+
+    /**
+     * @brief Get the sum of all observations in microseconds
+     */
+    uint64_t getSumUs() const;
+
+private:
+    std::atomic<uint32_t> buckets[BUCKET_COUNT + 1];
+    std::atomic<uint32_t> count;
+    uint64_t sumUs;
+
+    static portMUX_TYPE sumMux;
+};
+
+/**
+ * @brief Counters and histograms for the capture and stream pipeline
+ *
+ * 32-bit counters are relaxed atomics. The 64-bit byte count and histogram
+ * sums are updated in a critical section a few instructions long, since
+ * the ESP32 has no 64-bit atomics; recording a sample never waits on a
+ * mutex or on another task's progress.
+ * Served as Prometheus text on /metrics and summarised in the heartbeat.
+ */
+class StreamMetrics {
+public:
+    /**
+     * @brief Record a frame captured by the capture task
+     *
+     * @param fbGetUs Time spent in esp_camera_fb_get()
+     */
+    static void recordFrameCaptured(uint32_t fbGetUs);
+
+    /**
+     * @brief Record a failed capture
+     */
+    static void recordCaptureFailure();
+
+    /**
+     * @brief Record a frame sent to a stream client
+     *
+     * @param client Client slot (frame broker subscriber id)
+     * @param bytes JPEG size in bytes
+     * @param sendUs Time taken to write the frame
+     */
+    static void recordFrameSent(int client, size_t bytes, uint32_t sendUs);
+
+    /**
+     * @brief Record frames a stream client skipped
+     */
+    static void recordFramesDropped(int client, uint32_t frames);
+
+    /**
+     * @brief Record a WebSocket client acknowledging a frame
+     *
+     * @param ackUs Time from sending the frame to the acknowledgement
+     */
+    static void recordFrameAcknowledged(uint32_t ackUs);
+
+    /**
+     * @brief Record the camera waking from standby
+     *
+     * @param wakeUs Time from powering the sensor up to its first usable frame
+     */
+    static void recordCameraWake(uint32_t wakeUs);
+
+    /**
+     * @brief Record a stream client connecting
+     */
+    static void recordClientConnected();
+
+    /**
+     * @brief Record a stream client disconnecting
+     */
+    static void recordClientDisconnected();
+
+    /**
+     * @brief Write all metrics as Prometheus text exposition format
+     */
+    static esp_err_t sendPrometheus(httpd_req_t *req);
+
+    /**
+     * @brief Write a summary of the metrics as JSON members for the heartbeat
+     *
+     * Writes '"frames_captured":N,...' with no braces, without allocating.
+     *
+     * @return Characters written, as snprintf()
+     */
+    static int formatSummary(char *buffer, size_t size);
+
+    /**
+     * @brief Get the number of frames captured since boot
+     */
+    static uint32_t getFramesCaptured();
+
+    /**
+     * @brief Get the JPEG bytes sent to stream clients since boot
+     */
+    static uint64_t getBytesSent();
+
+    /**
+     * @brief Get the number of connected stream clients
+     */
+    static uint32_t getActiveClients();
+
+    /**
+     * @brief Get the mean time the camera took to wake from standby
+     */
+    static uint32_t getAverageWakeMs();
+
+private:
+    static std::atomic<uint32_t> framesCaptured;
+    static std::atomic<uint32_t> captureFailures;
+    static std::atomic<uint32_t> framesSent[FrameBroker::MAX_SUBSCRIBERS];
+    static std::atomic<uint32_t> framesDropped[FrameBroker::MAX_SUBSCRIBERS];
+    static uint64_t bytesSent;
+    static std::atomic<uint32_t> activeClients;
+    static LatencyHistogram fbGetLatency;
+    static LatencyHistogram sendLatency;
+    static LatencyHistogram ackLatency;
+    static LatencyHistogram wakeLatency;
+    static portMUX_TYPE bytesMux;
+};
+
+#endif // STREAM_METRICS_H
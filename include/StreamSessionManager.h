@@ -0,0 +1,241 @@
+#ifndef STREAM_SESSION_MANAGER_H
+#define STREAM_SESSION_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/uio.h>
+#include "BandwidthBudget.h"
+
+// Stream slots shared by /stream, /ws and RTSP viewers, and how many of them only
+// "high" priority viewers may take; both can be changed at run time
+#ifndef STREAM_SLOTS
+#define STREAM_SLOTS 4
+#endif
+#ifndef STREAM_HIGH_PRIORITY_SLOTS
+#define STREAM_HIGH_PRIORITY_SLOTS 1
+#endif
+
+/**
+ * @brief A client connection handed off from the HTTP server to its own task
+ */
+struct StreamSession {
+    bool active;
+    bool socketClosed;
+    httpd_handle_t server;
+    int fd;
+    int subscriber;
+    uint32_t afterSequence;
+    uint32_t timeoutMs;
+    bool longPoll;
+    bool etagMatched;           // Long-poll If-None-Match names the frame at afterSequence
+    uint32_t maxFps;
+    StreamPriority priority;
+    uint8_t scale;              // Thumbnail divisor (4 or 8), 1 for full frames
+    uint8_t ackWindow;          // Unacknowledged frames allowed in flight (WebSocket)
+    uint32_t ackedSequence;     // Highest frame sequence the client has acknowledged
+    bool acked;                 // ackedSequence holds a value
+    TaskHandle_t task;          // Sender task, notified when an acknowledgement arrives
+    bool stream;                // Holds a stream slot
+    volatile uint32_t sendingSinceMs;  // Start of the write in progress, 0 between writes
+    bool timedOut;              // A write hit the socket send timeout
+    bool reclaimed;             // Stalled, and its slot given to a new viewer
+};
+
+/**
+ * @brief Moves long-lived responses off the HTTP server task
+ *
+ * esp_http_server runs every handler on a single task, so a handler that
+ * never returns (an MJPEG stream) or waits a long time (a long-polled
+ * snapshot) would stall every other request. A handler instead claims the
+ * client socket here and returns; a dedicated sender task then writes the
+ * response directly to the socket. While a session owns a socket the server
+ * is not allowed to close it, so the descriptor cannot be reused under the
+ * sender task's feet.
+ */
+class StreamSessionManager {
+public:
+    static constexpr uint8_t MAX_SESSIONS = 8;
+    static constexpr uint32_t STALL_RECLAIM_MS = 3000;     // Blocked in one write this long counts as stalled
+    static constexpr uint32_t RETRY_AFTER_SECONDS = 5;     // Retry-After sent with a 503 when slots are full
+    static constexpr uint32_t RECLAIM_WAIT_MS = 500;       // Time a reclaimed sender gets to hand its slot back
+
+    /**
+     * @brief Decide whether a new viewer may have a stream slot
+     *
+     * "high" viewers may use every slot; the others leave the high priority
+     * slots free. When the viewer's slots are all taken, the stream that has
+     * been stuck in a single write the longest, if for at least
+     * STALL_RECLAIM_MS, is shut down and its slot handed over once its
+     * sender has finished. Otherwise the viewer is counted as rejected.
+     *
+     * Call from the server task, then open() the session with @p stream set.
+     *
+     * @return true if the viewer may open a stream session
+     */
+    static bool admit(StreamPriority priority);
+
+    /**
+     * @brief Take a stream slot for a stream sent outside a session
+     *
+     * As admit(), for senders that do not run on an HTTP socket, such as
+     * RTSP. A stalled stream is never reclaimed for them: its socket may
+     * only be shut down from the server task. Give the slot back with
+     * releaseSlot() when the stream ends.
+     *
+     * @return true if the slot was taken
+     */
+    static bool claimSlot(StreamPriority priority);
+
+    /**
+     * @brief Give back a slot taken by claimSlot()
+     */
+    static void releaseSlot(StreamPriority priority);
+
+    /**
+     * @brief Claim the socket behind a request
+     *
+     * @param req Request whose socket is being taken over
+     * @param subscriber Frame broker subscriber id to store with the session
+     * @param stream true if the session takes a stream slot granted by admit()
+     * @return The new session, or nullptr if all session slots are in use
+     */
+    static StreamSession *open(httpd_req_t *req, int subscriber, bool stream = false);
+
+    /**
+     * @brief Start the sender task for a session
+     *
+     * On failure the session is released and the socket left with the server.
+     *
+     * @param session Session returned by open()
+     * @param sender Task function; receives the session as its parameter
+     * @param name Task name
+     * @param stackSize Task stack size in bytes
+     * @return true if the task was started
+     */
+    static bool start(StreamSession *session, TaskFunction_t sender, const char *name, uint32_t stackSize);
+
+    /**
+     * @brief Release a session from its sender task
+     *
+     * @param session Session to release
+     * @param keepAlive Hand the socket back to the server for further requests
+     *                  rather than closing the connection
+     */
+    static void finish(StreamSession *session, bool keepAlive);
+
+    /**
+     * @brief Write a whole buffer to the session's socket
+     *
+     * @return true if every byte was sent
+     */
+    static bool sendAll(StreamSession *session, const void *data, size_t length);
+
+    /**
+     * @brief Write several buffers to the session's socket as one send
+     *
+     * The buffers go out in a single writev() call where the socket accepts
+     * them all at once; a partial write is resumed from where it stopped.
+     * The iovec array is modified as the write progresses.
+     *
+     * @param vector Buffers to send
+     * @param count Number of buffers
+     * @param writes Incremented by the number of socket writes issued
+     * @return true if every byte was sent
+     */
+    static bool sendVector(StreamSession *session, struct iovec *vector, int count, uint32_t *writes);
+
+    /**
+     * @brief Record a client acknowledgement for the session owning a socket
+     *
+     * Called from the server task; wakes the session's sender task.
+     *
+     * @param sequence Highest frame sequence the client has received
+     * @return false if no session owns the socket
+     */
+    static bool acknowledge(httpd_handle_t server, int fd, uint32_t sequence);
+
+    /**
+     * @brief Get the highest frame sequence acknowledged for a session
+     *
+     * @param sequence Receives the sequence
+     * @return false if nothing has been acknowledged yet
+     */
+    static bool getAcknowledged(StreamSession *session, uint32_t *sequence);
+
+    /**
+     * @brief Check whether the server has already dropped the connection
+     */
+    static bool isClosed(StreamSession *session);
+
+    /**
+     * @brief Socket close hook for httpd_config_t::close_fn
+     *
+     * Defers closing sockets still owned by a session to its sender task.
+     */
+    static void onSocketClose(httpd_handle_t server, int fd);
+
+    /**
+     * @brief Get the number of sessions with a running sender task
+     */
+    static uint8_t getActiveCount();
+
+    /**
+     * @brief Set the number of stream slots
+     *
+     * Sessions already streaming keep their slots.
+     *
+     * @param slots Stream slots, 1 to MAX_SESSIONS
+     * @param highPrioritySlots Slots only "high" viewers may take, fewer than @p slots
+     * @return false if either value is out of range
+     */
+    static bool setStreamSlots(uint8_t slots, uint8_t highPrioritySlots);
+
+    /**
+     * @brief Get the number of stream slots
+     */
+    static uint8_t getStreamSlots();
+
+    /**
+     * @brief Get the number of slots kept for "high" viewers
+     */
+    static uint8_t getHighPrioritySlots();
+
+    /**
+     * @brief Get the number of streams of a priority class holding a slot
+     */
+    static uint8_t getActiveStreamCount(StreamPriority priority);
+
+    /**
+     * @brief Get the number of viewers of a priority class turned away since boot
+     */
+    static uint32_t getRejectedCount(StreamPriority priority);
+
+    /**
+     * @brief Get the number of streams ended by the socket send timeout
+     */
+    static uint32_t getTimedOutCount();
+
+    /**
+     * @brief Get the number of stalled streams shut down to make room for a new viewer
+     */
+    static uint32_t getReclaimedCount();
+
+private:
+    static StreamSession sessions[MAX_SESSIONS];
+    static portMUX_TYPE sessionMux;
+    static uint8_t streamSlots;
+    static uint8_t highPrioritySlots;
+    static uint8_t claimedSlots[3];        // Taken by claimSlot(), by StreamPriority
+    static uint32_t rejectedCounts[3];     // By StreamPriority
+    static uint32_t timedOutCount;
+    static uint32_t reclaimedCount;
+
+    /**
+     * @brief Note a failed write; a timeout marks the session as timed out
+     */
+    static void recordSendError(StreamSession *session);
+};
+
+#endif // STREAM_SESSION_MANAGER_H
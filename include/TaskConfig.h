@@ -0,0 +1,76 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+/**
+ * @brief Core and priority for each task role
+ *
+ * Every value can be overridden from build_flags in platformio.ini,
+ * e.g. -DSTREAM_TASK_CORE=0. Wi-Fi and lwIP run on core 0.
+ */
+
+// Camera capture task (FrameBroker)
+#ifndef CAPTURE_TASK_CORE
+#define CAPTURE_TASK_CORE 1
+#endif
+#ifndef CAPTURE_TASK_PRIORITY
+#define CAPTURE_TASK_PRIORITY 6
+#endif
+
+// HTTP server task serving the index page, snapshots and control requests
+#ifndef HTTPD_TASK_CORE
+#define HTTPD_TASK_CORE 0
+#endif
+#ifndef HTTPD_TASK_PRIORITY
+#define HTTPD_TASK_PRIORITY 5
+#endif
+
+// Per-client sender tasks for /stream and long-polled /capture
+#ifndef STREAM_TASK_CORE
+#define STREAM_TASK_CORE 1
+#endif
+#ifndef STREAM_TASK_PRIORITY
+#define STREAM_TASK_PRIORITY 4
+#endif
+
+// Motion detection, below the HTTP server so it only uses spare time on core 0
+#ifndef MOTION_TASK_CORE
+#define MOTION_TASK_CORE 0
+#endif
+#ifndef MOTION_TASK_PRIORITY
+#define MOTION_TASK_PRIORITY 2
+#endif
+
+// Network task (TaskScheduler): Wi-Fi/MQTT reconnection, MQTT traffic and
+// heartbeats, next to the Wi-Fi driver and away from capture and streaming
+#ifndef NETWORK_TASK_CORE
+#define NETWORK_TASK_CORE 0
+#endif
+#ifndef NETWORK_TASK_PRIORITY
+#define NETWORK_TASK_PRIORITY 4
+#endif
+
+// Frame history recording into PSRAM; short copies, ahead of motion analysis
+#ifndef HISTORY_TASK_CORE
+#define HISTORY_TASK_CORE 0
+#endif
+#ifndef HISTORY_TASK_PRIORITY
+#define HISTORY_TASK_PRIORITY 3
+#endif
+
+// Time-lapse stills; waits on the capture task and copies a frame now and then
+#ifndef TIMELAPSE_TASK_CORE
+#define TIMELAPSE_TASK_CORE 0
+#endif
+#ifndef TIMELAPSE_TASK_PRIORITY
+#define TIMELAPSE_TASK_PRIORITY 1
+#endif
+
+// RTSP server task answering requests; RTSP senders run like /stream senders
+#ifndef RTSP_TASK_CORE
+#define RTSP_TASK_CORE 0
+#endif
+#ifndef RTSP_TASK_PRIORITY
+#define RTSP_TASK_PRIORITY 3
+#endif
+
+#endif // TASK_CONFIG_H
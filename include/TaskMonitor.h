@@ -0,0 +1,70 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * @brief CPU and stack use of one task
+ */
+struct TaskUsage {
+    char name[16];
+    int8_t core;               // -1 if the task may run on either core
+    uint8_t priority;
+    uint8_t cpuPercent;        // Of one core, over the last sample interval
+    uint32_t stackFreeBytes;   // Least free stack since the task started
+};
+
+/**
+ * @brief Samples per-task CPU time and stack headroom
+ *
+ * sample() runs periodically on the scheduler task and keeps the figures
+ * from the last interval for /metrics. A task whose free stack falls
+ * below LOW_STACK_BYTES is logged once. Needs the FreeRTOS trace facility
+ * (and run-time stats for the CPU figures); without it nothing is sampled.
+ *
+ * MAX_TASKS leaves room for every stream and RTSP session task on top of
+ * the system ones. With more tasks than that FreeRTOS fills in nothing, so
+ * the sample is skipped and counted rather than leaving /metrics to serve
+ * the last figures as if they were current.
+ */
+class TaskMonitor {
+public:
+    static constexpr uint32_t SAMPLE_INTERVAL_MS = 10000;
+    static constexpr uint8_t MAX_TASKS = 40;
+
+    /**
+     * @brief Take a sample; runs every SAMPLE_INTERVAL_MS
+     */
+    static void sample();
+
+    /**
+     * @brief Copy the figures from the last sample
+     *
+     * @param usage Receives up to @p maxCount entries
+     * @return Number of entries written
+     */
+    static uint8_t getUsage(TaskUsage *usage, uint8_t maxCount);
+
+    /**
+     * @brief Get the number of samples skipped for want of room
+     */
+    static uint32_t getSkippedSamples();
+
+private:
+    static constexpr uint32_t LOW_STACK_BYTES = 512;
+
+    static TaskUsage usage[MAX_TASKS];
+    static uint8_t usageCount;
+    static UBaseType_t taskNumbers[MAX_TASKS];
+    static uint32_t runTimes[MAX_TASKS];
+    static bool lowStackReported[MAX_TASKS];
+    static uint8_t trackedCount;
+    static uint32_t lastTotalRunTime;
+    static std::atomic<uint32_t> skippedSamples;
+    static portMUX_TYPE usageMux;
+};
+
+#endif // TASK_MONITOR_H
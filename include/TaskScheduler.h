@@ -0,0 +1,116 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+/**
+ * @brief Runs network work on one task, woken by events instead of polling
+ *
+ * Jobs are plain functions. Any task can post() one onto a queue, which
+ * wakes the scheduler task through an event group bit; periodic jobs run
+ * when their interval is up, and in between the task sleeps until the
+ * next deadline or the next posted job. Jobs run one at a time, so
+ * everything run here can share the MQTT connections without locking.
+ *
+ * The same event group carries the connectivity bits set by
+ * ConnectivityManager, so other tasks can check or wait for them.
+ */
+class TaskScheduler {
+public:
+    typedef void (*Job)();
+
+    static constexpr EventBits_t WIFI_UP = 1 << 1;
+    static constexpr EventBits_t MQTT_UP = 1 << 2;
+
+    /**
+     * @brief Create the event group and job queue
+     *
+     * Called by begin(), and by anything that sets events or posts jobs
+     * before the task starts, such as ConnectivityManager::begin(); until
+     * then setEvents() and post() are lost. Safe to call more than once.
+     *
+     * @return true if both exist
+     */
+    static bool init();
+
+    /**
+     * @brief Start the scheduler task on NETWORK_TASK_CORE
+     *
+     * @return true if the task was started
+     */
+    static bool begin();
+
+    /**
+     * @brief Run a job on the scheduler task as soon as possible
+     *
+     * Safe to call from any task, including the scheduler task itself.
+     *
+     * @return false if the queue is full and the job was dropped
+     */
+    static bool post(Job job);
+
+    /**
+     * @brief Run a job every @p intervalMs
+     *
+     * Call before begin().
+     *
+     * @return false if the table is full
+     */
+    static bool addPeriodic(Job job, uint32_t intervalMs);
+
+    /**
+     * @brief Set connectivity bits in the event group
+     */
+    static void setEvents(EventBits_t bits);
+
+    /**
+     * @brief Clear connectivity bits in the event group
+     */
+    static void clearEvents(EventBits_t bits);
+
+    /**
+     * @brief Get the connectivity bits currently set
+     */
+    static EventBits_t getEvents();
+
+    /**
+     * @brief Get the number of jobs dropped because the queue was full
+     */
+    static uint32_t getDroppedJobs();
+
+private:
+    struct PeriodicJob {
+        Job job;
+        uint32_t intervalMs;
+        uint32_t lastRunMs;
+    };
+
+    static constexpr EventBits_t JOB_POSTED = 1 << 0;
+    static constexpr uint8_t QUEUE_LENGTH = 16;
+    static constexpr uint8_t MAX_PERIODIC_JOBS = 8;
+    static constexpr uint32_t TASK_STACK = 8192;   // Takes over from the 8 KB Arduino loop task
+
+    static EventGroupHandle_t events;
+    static QueueHandle_t jobs;
+    static PeriodicJob periodicJobs[MAX_PERIODIC_JOBS];
+    static uint8_t periodicJobCount;
+    static std::atomic<uint32_t> droppedJobs;
+    static TaskHandle_t task;
+
+    /**
+     * @brief Scheduler loop run by the scheduler task
+     */
+    static void run(void *parameter);
+
+    /**
+     * @brief Get the time until the next periodic job is due
+     */
+    static TickType_t ticksUntilNextJob(uint32_t nowMs);
+};
+
+#endif // TASK_SCHEDULER_H
@@ -0,0 +1,199 @@
+#ifndef TIME_LAPSE_H
+#define TIME_LAPSE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "AviWriter.h"
+#include "JpegArena.h"
+
+/**
+ * @brief Time-lapse schedule, as kept in NVS
+ */
+struct TimeLapseSettings {
+    uint32_t intervalSeconds;   // 0 when time-lapse is stopped
+    uint8_t frameSize;          // framesize_t
+    uint8_t quality;
+};
+
+/**
+ * @brief Takes a high-resolution still on a schedule and keeps a timeline
+ *
+ * Every interval a low-priority task asks FrameBroker::captureStill() for
+ * one frame at the time-lapse frame size and quality. The capture task
+ * switches the sensor for that frame only, so the live stream carries on
+ * at its own settings and loses about one frame per still. Stills are
+ * copied into a JpegArena in PSRAM. Once it is full the oldest are
+ * overwritten, so the timeline always holds the most recent stills. The whole timeline downloads as one MJPEG AVI.
+ *
+ * The framebuffers must be big enough for the stills, so while time-lapse
+ * is running the camera is initialised at its frame size. A larger frame
+ * size chosen at run time takes effect after a restart; until then stills
+ * are taken at the largest size the framebuffers hold. Needs PSRAM.
+ */
+class TimeLapse {
+public:
+    static constexpr uint32_t MIN_INTERVAL_SECONDS = 5;
+    static constexpr uint32_t MAX_INTERVAL_SECONDS = 86400;
+    static constexpr uint32_t DEFAULT_INTERVAL_SECONDS = 60;
+    static constexpr framesize_t DEFAULT_FRAME_SIZE = FRAMESIZE_XGA;
+    static constexpr int DEFAULT_QUALITY = 10;
+    static constexpr uint32_t DEFAULT_PLAYBACK_FPS = 10;
+    static constexpr uint32_t MAX_PLAYBACK_FPS = 30;
+
+    /**
+     * @brief Load the saved schedule
+     *
+     * Call before the camera is initialised.
+     */
+    static void loadSettings();
+
+    /**
+     * @brief Get the frame size to initialise the camera with
+     *
+     * @param streamFrameSize Frame size the stream starts at
+     * @return The larger of the stream and time-lapse frame sizes while
+     *         time-lapse is running, otherwise @p streamFrameSize
+     */
+    static framesize_t getCameraFrameSize(framesize_t streamFrameSize);
+
+    /**
+     * @brief Start the time-lapse task, resuming a saved schedule
+     *
+     * Call once capture has started.
+     *
+     * @return true if the task was started
+     */
+    static bool begin();
+
+    /**
+     * @brief Start taking stills, the first straight away, and save the schedule
+     *
+     * @return false if there is no PSRAM for the timeline or the schedule could not be saved
+     */
+    static bool start(uint32_t intervalSeconds, framesize_t frameSize, int quality);
+
+    /**
+     * @brief Stop taking stills; the timeline is kept
+     */
+    static bool stop();
+
+    /**
+     * @brief Drop every still in the timeline
+     *
+     * @return false if the timeline is being downloaded
+     */
+    static bool clear();
+
+    /**
+     * @brief Get the saved schedule
+     */
+    static TimeLapseSettings getSettings();
+
+    /**
+     * @brief Handle a "timelapse" command from the MQTT command channel
+     *
+     * {"action":"timelapse","interval":60,"framesize":"UXGA","quality":10}
+     * starts (missing fields keep their saved values),
+     * {"action":"timelapse","stop":true} stops and
+     * {"action":"timelapse","clear":true} empties the timeline.
+     */
+    static void handleCommand(JsonDocument &command);
+
+    /**
+     * @brief Start exporting the timeline
+     *
+     * No still is overwritten until the matching endExport(); stills that
+     * would need the space are skipped meanwhile.
+     *
+     * @param info Receives the dimensions and sizes of the timeline
+     * @param fps Playback frame rate
+     * @return false if the timeline is empty
+     */
+    static bool beginExport(AviClipInfo &info, uint32_t fps);
+
+    /**
+     * @brief Get a still of the timeline being exported
+     *
+     * @param index Still number within the timeline
+     * @param data Receives a pointer to the JPEG in the arena
+     * @param length Receives the JPEG size
+     * @return true if the still exists
+     */
+    static bool getFrame(uint32_t index, const uint8_t **data, size_t *length);
+
+    /**
+     * @brief Finish an export started with beginExport()
+     */
+    static void endExport();
+
+    /**
+     * @brief Add the schedule, timeline and switch cost to a JSON document
+     */
+    static void addStatus(JsonDocument &doc);
+
+private:
+    static constexpr uint32_t TASK_STACK = 3072;
+    static constexpr uint32_t STILL_TIMEOUT_MS = 3000;
+    static constexpr uint32_t MAX_RECORDS = 512;
+    static constexpr size_t ARENA_MAX_BYTES = 1536 * 1024;
+    static constexpr size_t ARENA_MIN_BYTES = 128 * 1024;
+    static constexpr size_t PSRAM_RESERVE_BYTES = 512 * 1024;
+
+    static TimeLapseSettings settings;
+    static JpegArena arena;
+    static uint8_t exportCount;
+    static uint32_t stillsTaken;
+    static uint32_t stillsFailed;
+    static uint32_t stillsSkipped;
+    static uint32_t lastStillMs;
+    static uint32_t lastSwitchMs;
+
+    static SemaphoreHandle_t lock;
+    static TaskHandle_t task;
+
+    /**
+     * @brief Schedule loop run by the time-lapse task
+     */
+    static void shootLoop(void *parameter);
+
+    /**
+     * @brief Take one still and add it to the timeline
+     */
+    static void shoot();
+
+    /**
+     * @brief Allocate the timeline arena if that has not been done yet
+     */
+    static bool allocateArena();
+
+    /**
+     * @brief Copy one still into the arena, overwriting the oldest
+     *
+     * @return true if the still was stored
+     */
+    static bool store(const uint8_t *jpeg, size_t length, uint16_t width, uint16_t height,
+                      uint32_t sequence, int64_t captureTimeUs);
+
+    /**
+     * @brief Eviction policy: no still goes while the timeline is being exported
+     *
+     * Called by the arena, under the lock.
+     */
+    static bool canEvict(uint32_t serial);
+
+    /**
+     * @brief Save the schedule and wake the task to act on it
+     */
+    static bool applySettings(const TimeLapseSettings &newSettings);
+
+    /**
+     * @brief Frame size stills are taken at: the chosen one, within what the framebuffers hold
+     */
+    static framesize_t getCaptureFrameSize();
+};
+
+#endif // TIME_LAPSE_H
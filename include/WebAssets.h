@@ -0,0 +1,73 @@
+// Generated by tools/embed_web_assets.py from web/; do not edit.
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minified, gzipped web UI. Only WebCamServer.cpp includes this, so each
+// array exists once in flash.
+
+// index.html: 3133 bytes, 891 gzipped
+constexpr size_t WEB_INDEX_HTML_GZ_LENGTH = 891;
+constexpr char WEB_INDEX_HTML_ETAG[] = "\"bfc035b04535b938\"";
+constexpr uint8_t WEB_INDEX_HTML_GZ[WEB_INDEX_HTML_GZ_LENGTH] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0x7d, 0x55, 0x6d, 0x6f, 0xdb, 0x36,
+    0x10, 0xfe, 0xee, 0x5f, 0xc1, 0xb9, 0x18, 0xa4, 0x60, 0xd6, 0x5b, 0x9c, 0x05, 0x81, 0x24, 0x67,
+    0x48, 0xdb, 0x0c, 0x18, 0xd0, 0x2e, 0xc1, 0x92, 0x6c, 0x18, 0x86, 0x7d, 0xa0, 0xc5, 0x93, 0xc5,
+    0x86, 0x22, 0x35, 0x92, 0xb2, 0x6c, 0x18, 0xfe, 0xef, 0x3b, 0x4a, 0xb2, 0x6b, 0xaf, 0x6b, 0x21,
+    0x58, 0xe2, 0xcb, 0x73, 0xcf, 0xdd, 0x3d, 0x77, 0xa4, 0xf3, 0xef, 0xde, 0x3f, 0xbc, 0x7b, 0xfe,
+    0xf3, 0xf1, 0x9e, 0x54, 0xb6, 0x16, 0xb7, 0xf9, 0xf8, 0x06, 0xca, 0x6e, 0xf3, 0x1a, 0x2c, 0x25,
+    0x45, 0x45, 0xb5, 0x01, 0xbb, 0x98, 0xbe, 0x3c, 0xff, 0x1c, 0xdc, 0x4c, 0xc7, 0x55, 0x49, 0x6b,
+    0x58, 0x4c, 0xd7, 0x1c, 0xba, 0x46, 0x69, 0x3b, 0x25, 0x85, 0x92, 0x16, 0x24, 0xa2, 0x3a, 0xce,
+    0x6c, 0xb5, 0x60, 0xb0, 0xe6, 0x05, 0x04, 0xfd, 0x64, 0x46, 0xb8, 0xe4, 0x96, 0x53, 0x11, 0x98,
+    0x82, 0x0a, 0x58, 0x24, 0x61, 0x8c, 0x2c, 0x96, 0x5b, 0x01, 0xb7, 0xf7, 0x4f, 0x8f, 0xf3, 0xcb,
+    0xe0, 0xdd, 0xdd, 0x47, 0xf2, 0x64, 0x35, 0xd0, 0x3a, 0x8f, 0x86, 0xf5, 0xdc, 0xd8, 0x2d, 0x7e,
+    0x96, 0x8a, 0x6d, 0x77, 0x25, 0x52, 0x07, 0x25, 0xad, 0xb9, 0xd8, 0xa6, 0x77, 0x1a, 0x79, 0x66,
+    0x86, 0x4a, 0x13, 0x18, 0xd0, 0xbc, 0xcc, 0x6a, 0xaa, 0x57, 0x5c, 0xa6, 0x71, 0xd6, 0x50, 0xc6,
+    0xb8, 0x5c, 0xa5, 0x97, 0x71, 0xb3, 0xc9, 0x96, 0xb4, 0x78, 0x5d, 0x69, 0xd5, 0x4a, 0x16, 0x14,
+    0x4a, 0x28, 0x9d, 0xbe, 0x29, 0x63, 0xf7, 0x64, 0x8c, 0x9b, 0x46, 0xd0, 0x6d, 0x5a, 0x0a, 0xd8,
+    0x64, 0xee, 0x15, 0x30, 0xae, 0xa1, 0xb0, 0x5c, 0xc9, 0x14, 0x91, 0x6d, 0x2d, 0x33, 0x2a, 0xf8,
+    0x4a, 0x06, 0xdc, 0x42, 0x6d, 0xd2, 0x02, 0x53, 0x02, 0xbd, 0xaf, 0x92, 0xdd, 0x48, 0x33, 0x9f,
+    0xcf, 0xf7, 0x6f, 0x4c, 0x1f, 0xea, 0xae, 0xa6, 0x9b, 0x21, 0xc1, 0x34, 0x89, 0xe3, 0xef, 0xb3,
+    0xa5, 0xd2, 0x0c, 0x74, 0x3a, 0x6f, 0x36, 0xc4, 0x28, 0xc1, 0x19, 0x71, 0xe0, 0x71, 0x35, 0xd0,
+    0x94, 0xf1, 0xd6, 0xa4, 0x37, 0x2e, 0x36, 0xb5, 0x09, 0x4c, 0x45, 0x99, 0xea, 0xd2, 0x98, 0x5c,
+    0x21, 0xfa, 0x1a, 0x7f, 0x7a, 0xb5, 0xa4, 0x7e, 0x3c, 0xeb, 0x9f, 0x30, 0xb9, 0xd8, 0x87, 0x4e,
+    0x4f, 0xca, 0x25, 0xe8, 0xdd, 0x17, 0xb9, 0x74, 0x15, 0x06, 0xf7, 0x9f, 0x7c, 0xbf, 0xed, 0xe5,
+    0x12, 0x3d, 0x5c, 0xfd, 0x8f, 0x97, 0x3c, 0x1a, 0x64, 0xce, 0xa3, 0xa1, 0xde, 0x4e, 0xee, 0xdb,
+    0x9c, 0xf1, 0x35, 0x29, 0x04, 0x35, 0x66, 0x31, 0x3d, 0x46, 0x81, 0x05, 0xab, 0x92, 0x93, 0x6a,
+    0x7d, 0xe0, 0x6b, 0x38, 0x96, 0x0c, 0x77, 0x72, 0x5e, 0xaf, 0x08, 0x67, 0x8b, 0xe9, 0xa0, 0xcd,
+    0x94, 0x50, 0x81, 0xbd, 0xd0, 0xa3, 0xc6, 0x15, 0x74, 0x82, 0xc4, 0x58, 0xd8, 0x42, 0xf3, 0xc6,
+    0xde, 0xae, 0xa9, 0x26, 0xce, 0x66, 0x41, 0x98, 0x2a, 0xda, 0x1a, 0x75, 0x0e, 0x57, 0x60, 0xef,
+    0x05, 0xb8, 0xe1, 0xdb, 0xed, 0x2f, 0xcc, 0xf7, 0x06, 0x43, 0xef, 0x22, 0x9b, 0x38, 0xb0, 0xa9,
+    0x54, 0x27, 0x11, 0x2e, 0x5b, 0x21, 0xb2, 0x49, 0xd9, 0xca, 0xbe, 0x68, 0xc4, 0x55, 0xf3, 0xe3,
+    0xa7, 0x06, 0x56, 0xfe, 0x05, 0xd9, 0x4d, 0x90, 0x31, 0x34, 0xba, 0x40, 0x98, 0x17, 0x8d, 0xe6,
+    0xd9, 0x64, 0x7f, 0x8e, 0xfe, 0x03, 0x96, 0x4f, 0xaa, 0x78, 0x05, 0xdb, 0x5b, 0xf4, 0xd4, 0x45,
+    0x85, 0x6e, 0xd1, 0x48, 0xa8, 0x82, 0x3a, 0x5c, 0xd8, 0x68, 0x65, 0x15, 0xaa, 0x4d, 0x16, 0x0b,
+    0xa4, 0xaa, 0xac, 0x6d, 0x4c, 0xea, 0x91, 0x9f, 0x88, 0xd7, 0x19, 0x93, 0x46, 0x91, 0x47, 0x52,
+    0x37, 0x74, 0xa3, 0x21, 0xb8, 0xce, 0xb8, 0xc8, 0xa0, 0x23, 0x9f, 0xc9, 0x47, 0xd2, 0x1f, 0x3e,
+    0x93, 0x56, 0xca, 0x58, 0x9c, 0x7b, 0x51, 0x67, 0x0e, 0x49, 0x61, 0xeb, 0x01, 0x6a, 0xc4, 0xd0,
+    0xba, 0xa4, 0xc2, 0x40, 0x36, 0xe9, 0x4c, 0xb8, 0xe4, 0x92, 0xea, 0xed, 0xf3, 0xb6, 0x71, 0x21,
+    0x79, 0x54, 0x6b, 0xba, 0x5d, 0xb6, 0x65, 0x09, 0xda, 0xeb, 0xb7, 0x95, 0xac, 0xc1, 0x18, 0xba,
+    0x72, 0xbb, 0xc7, 0xc4, 0x7c, 0x58, 0xa3, 0x6e, 0x87, 0x84, 0x5c, 0x35, 0x41, 0x8f, 0x21, 0xbd,
+    0xa7, 0x96, 0xfe, 0x8e, 0xe7, 0x74, 0x80, 0x84, 0x0c, 0xa7, 0x33, 0x12, 0xcf, 0x48, 0x72, 0x7d,
+    0x50, 0x16, 0xfe, 0x69, 0x41, 0x16, 0x8e, 0x6f, 0x30, 0x74, 0x95, 0x78, 0xe1, 0xd2, 0xce, 0x2f,
+    0xb1, 0x59, 0x88, 0xd5, 0x2d, 0x8c, 0x48, 0xa7, 0xf3, 0xc8, 0xea, 0xf6, 0x6f, 0xee, 0x5c, 0x6c,
+    0x67, 0xbc, 0xc9, 0xf5, 0xec, 0x4b, 0x92, 0xab, 0x91, 0x64, 0x64, 0x69, 0x35, 0xea, 0x4a, 0x5e,
+    0x7e, 0xfb, 0x10, 0x16, 0x58, 0x21, 0x0b, 0x0f, 0xcb, 0x4f, 0x78, 0x02, 0x71, 0xee, 0x3b, 0xe2,
+    0xb7, 0x42, 0x2d, 0xfd, 0xbf, 0x9c, 0xa7, 0xbf, 0x67, 0x64, 0x67, 0x51, 0x05, 0xd4, 0x9a, 0xd7,
+    0x98, 0x6f, 0xe4, 0x16, 0xbd, 0xbd, 0xa3, 0x39, 0xd1, 0xcd, 0x31, 0x67, 0x7d, 0xe1, 0x95, 0x14,
+    0x8a, 0xba, 0xa5, 0x61, 0x02, 0x5a, 0x2b, 0x7d, 0xa6, 0x51, 0xdf, 0x21, 0x25, 0xf1, 0x51, 0x44,
+    0x74, 0xcc, 0xb6, 0x4f, 0x16, 0xbd, 0xf7, 0x25, 0x3e, 0x96, 0x2d, 0x7c, 0x78, 0xbc, 0xff, 0xd5,
+    0xe1, 0x10, 0x63, 0x40, 0x32, 0x1f, 0x7b, 0x1c, 0x4f, 0x99, 0x7f, 0xd0, 0xc8, 0x39, 0xdf, 0x4f,
+    0xf6, 0x59, 0xcf, 0xd3, 0xb7, 0xa4, 0x03, 0xbb, 0x5c, 0x34, 0xac, 0xd5, 0xeb, 0x49, 0x2e, 0xc3,
+    0xa6, 0x43, 0x1f, 0x3a, 0x17, 0xf3, 0xce, 0x4e, 0x3a, 0xb4, 0x9f, 0xee, 0xc7, 0x92, 0x16, 0x42,
+    0x99, 0xaf, 0x14, 0xd4, 0x79, 0x1a, 0x24, 0x2e, 0x14, 0x1b, 0xc2, 0x4d, 0xe2, 0x64, 0xee, 0xb6,
+    0xf0, 0x5a, 0x7e, 0xe6, 0x35, 0xa8, 0xd6, 0xfa, 0x67, 0x9d, 0x3d, 0x23, 0x3f, 0xc6, 0x71, 0xec,
+    0x9c, 0x13, 0xc0, 0xae, 0x22, 0x8e, 0xe2, 0x20, 0xd9, 0xb7, 0xed, 0x92, 0x33, 0xbb, 0xdd, 0xe4,
+    0xe4, 0x78, 0x8d, 0x89, 0xef, 0x07, 0x09, 0xb9, 0xc4, 0xab, 0x25, 0x3c, 0x5a, 0x5e, 0x8c, 0xd8,
+    0x93, 0xc3, 0xf5, 0x55, 0x16, 0xbc, 0x75, 0x86, 0x3b, 0x20, 0x8f, 0x86, 0x0b, 0x27, 0xea, 0xff,
+    0x73, 0xfe, 0x05, 0x51, 0x37, 0x1a, 0xc3, 0x89, 0x06, 0x00, 0x00,
+};
+
+#endif // WEB_ASSETS_H
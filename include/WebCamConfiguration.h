@@ -2,8 +2,12 @@
 #define WEB_CAM_CONFIG_H
 
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <nvs_flash.h>
 #include <Preferences.h>
+#include "CameraControl.h"
+#include "TimeLapse.h"
 
 /**
  * @brief Configuration settings for the web camera
@@ -18,7 +22,9 @@ struct WebCamConfigurationSettings {
  * @brief Manages web camera configuration storage
  * 
  * This class handles storing and retrieving configuration values
- * such as WiFi credentials using the ESP32's NVS (Non-Volatile Storage)
+ * such as WiFi credentials using the ESP32's NVS (Non-Volatile Storage).
+ * Every load and save goes through one Preferences object under one
+ * mutex, so they are safe to call from any task.
  */
 class WebCamConfiguration {
 private:
@@ -27,10 +33,26 @@ private:
     static constexpr const char *EXPECTED_CONFIRMATION = "CONFIRM";
     static constexpr const char *WIFI_SSID_KEY = "wifi_ssid";
     static constexpr const char *WIFI_PASS_KEY = "wifi_pass";
+    static constexpr const char *CAMERA_SETTINGS_KEY = "camera";
+    static constexpr const char *TIMELAPSE_SETTINGS_KEY = "timelapse";
+    static constexpr const char *MOTION_ENABLED_KEY = "motion_on";
     static constexpr const int BOOT_BUTTON_PIN = 0;  // GPIO 0 for ESP32-CAM boot button
     
     static WebCamConfigurationSettings config;
     static Preferences preferences;
+    static SemaphoreHandle_t lock;
+    
+    /**
+     * @brief Take the mutex around the Preferences object, creating it on first use
+     *
+     * The first call comes from setup(), before any other task uses NVS.
+     */
+    static void lockPreferences();
+    
+    /**
+     * @brief Give back the mutex taken by lockPreferences()
+     */
+    static void unlockPreferences();
     
     /**
      * @brief Get input from Serial
@@ -77,6 +99,48 @@ public:
      */
     static bool saveConfiguration(WebCamConfigurationSettings newConfig);
     
+    /**
+     * @brief Load the saved camera controls from NVS
+     * @param settings Receives the saved controls
+     * @return true if settings saved with the current control table were found
+     */
+    static bool loadCameraSettings(CameraSettings &settings);
+    
+    /**
+     * @brief Save the camera controls to NVS
+     * @param settings Controls to save
+     * @return true if save successful
+     */
+    static bool saveCameraSettings(const CameraSettings &settings);
+    
+    /**
+     * @brief Load the saved time-lapse schedule from NVS
+     * @param settings Receives the saved schedule
+     * @return true if a schedule was found
+     */
+    static bool loadTimeLapseSettings(TimeLapseSettings &settings);
+    
+    /**
+     * @brief Save the time-lapse schedule to NVS
+     * @param settings Schedule to save
+     * @return true if save successful
+     */
+    static bool saveTimeLapseSettings(const TimeLapseSettings &settings);
+    
+    /**
+     * @brief Load whether motion detection was left enabled
+     * @param enabled Receives the saved setting
+     * @return true if a setting was found
+     */
+    static bool loadMotionEnabled(bool &enabled);
+    
+    /**
+     * @brief Save whether motion detection is enabled
+     * @param enabled Setting to save
+     * @return true if save successful
+     */
+    static bool saveMotionEnabled(bool enabled);
+    
     /**
      * @brief Main setup method
      */
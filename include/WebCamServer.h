@@ -5,6 +5,9 @@
 #include <WiFi.h>
 #include <esp_camera.h>
 #include <esp_http_server.h>
+#include "AviWriter.h"
+#include "FrameBroker.h"
+#include "StreamSessionManager.h"
 
 /**
  * @brief Manages the ESP32-CAM web server and streaming functionality
@@ -61,6 +64,23 @@ public:
     String getStreamUrl();
 
 private:
+    static constexpr uint32_t FRAME_WAIT_TIMEOUT_MS = 5000;
+    static constexpr uint32_t CAPTURE_POLL_TIMEOUT_MS = 10000;
+    static constexpr uint32_t CAPTURE_MAX_AGE_MS = 1000;
+    static constexpr uint32_t STREAM_TASK_STACK = 4096;
+    static constexpr uint32_t SNAPSHOT_TASK_STACK = 3072;
+    static constexpr uint32_t CLIP_TASK_STACK = 4096;
+    static constexpr uint32_t CLIP_INDEX_BATCH = 32;
+    static constexpr uint16_t MAX_URI_HANDLERS = 12;
+    static constexpr uint16_t MAX_OPEN_SOCKETS = 7;       // lwIP allows CONFIG_LWIP_MAX_SOCKETS - 3
+    static constexpr uint8_t CONTROL_SOCKETS = 2;         // Never given to streams, so the page and controls still load
+    static constexpr uint16_t SOCKET_TIMEOUT_SECONDS = 5; // Send and receive timeout; ends streams to dead clients
+    static constexpr uint8_t WS_DEFAULT_ACK_WINDOW = 2;
+    static constexpr uint8_t WS_MAX_ACK_WINDOW = 8;
+    static constexpr uint32_t WS_ACK_TIMEOUT_MS = 10000;
+    static constexpr uint32_t WS_ACK_POLL_MS = 100;
+    static constexpr size_t WS_MAX_ACK_LENGTH = 16;
+    
     httpd_handle_t streamHttpd;
     bool serverRunning;
     
@@ -71,9 +91,137 @@ private:
     
     /**
      * @brief HTTP handler for the stream endpoint
+     * 
+     * Hands the connection to a per-client sender task and returns at once,
+     * or answers 503 with Retry-After when every stream slot is taken.
      */
     static esp_err_t streamHandler(httpd_req_t *req);
     
+    /**
+     * @brief Sender task writing the MJPEG stream to one client
+     */
+    static void streamSender(void *parameter);
+    
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    /**
+     * @brief WebSocket handler for the acknowledged stream endpoint
+     * 
+     * Called once when esp_http_server has completed the handshake, which
+     * hands the connection to a sender task, and then for every message
+     * from the client, each of which acknowledges a frame.
+     * /ws?window=N allows N unacknowledged frames in flight (1-8, default 2);
+     * fps and priority work as for /stream. Without a free stream slot the
+     * connection is closed with status 1013.
+     */
+    static esp_err_t webSocketHandler(httpd_req_t *req);
+    
+    /**
+     * @brief Sender task writing frames to one WebSocket client within its acknowledgement window
+     */
+    static void webSocketSender(void *parameter);
+#endif
+    
+    /**
+     * @brief HTTP handler for the cached snapshot endpoint
+     * 
+     * Serves the most recently captured frame from memory. With
+     * ?after=<seq> the request waits until a newer frame exists.
+     */
+    static esp_err_t captureHandler(httpd_req_t *req);
+    
+    /**
+     * @brief Sender task answering a /capture request that has to wait for a frame
+     */
+    static void snapshotSender(void *parameter);
+    
+    /**
+     * @brief Format the ETag and X-Frame-Seq header values for a frame sequence number
+     */
+    static void formatFrameTags(uint32_t sequence, char *etag, size_t etagSize, char *seq, size_t seqSize);
+    
+    /**
+     * @brief HTTP handler reporting and setting the stream bandwidth budget
+     * 
+     * /bandwidth?kbps=N sets the budget (0 = unlimited).
+     */
+    static esp_err_t bandwidthHandler(httpd_req_t *req);
+    
+    /**
+     * @brief HTTP handler reporting and setting the stream slots
+     * 
+     * /streams?slots=N&high=M sets the number of stream slots and how many
+     * of them only "high" priority viewers may take; without arguments it
+     * reports the slots, the streams holding them and the rejected and
+     * reaped counts.
+     */
+    static esp_err_t streamsHandler(httpd_req_t *req);
+    
+    /**
+     * @brief Answer 503 with Retry-After when there is no room for a viewer
+     */
+    static esp_err_t sendUnavailable(httpd_req_t *req, const char *message);
+    
+    /**
+     * @brief HTTP handler reporting and setting the camera controls
+     * 
+     * /control?framesize=SVGA&quality=10&brightness=1 applies all the
+     * named controls together between two frames; see CameraControl.
+     */
+    static esp_err_t controlHandler(httpd_req_t *req);
+    
+    /**
+     * @brief HTTP handler reporting and configuring motion detection
+     * 
+     * /motion?enabled=0|1&threshold=N sets detection globally;
+     * /motion?zone=I&x=&y=&w=&h=&trigger=&zone_enabled= edits one zone.
+     */
+    static esp_err_t motionHandler(httpd_req_t *req);
+    
+    /**
+     * @brief HTTP handler for event clips from the frame history
+     * 
+     * /clip downloads the held clip as an MJPEG AVI;
+     * /clip?action=trigger&pre=S&post=S freezes a new clip;
+     * /clip?action=status and /clip?action=release report and drop it.
+     */
+    static esp_err_t clipHandler(httpd_req_t *req);
+    
+    /**
+     * @brief Sender task writing the held clip to one client as an AVI file
+     */
+    static void clipSender(void *parameter);
+    
+    /**
+     * @brief HTTP handler for the time-lapse timeline
+     * 
+     * /timelapse downloads the timeline as an MJPEG AVI (&fps=N sets the
+     * playback rate); /timelapse?action=start&interval=S&framesize=UXGA&quality=Q
+     * starts taking stills; /timelapse?action=status, stop and clear
+     * report, stop and empty it.
+     */
+    static esp_err_t timeLapseHandler(httpd_req_t *req);
+    
+    /**
+     * @brief Sender task writing the time-lapse timeline to one client as an AVI file
+     */
+    static void timeLapseSender(void *parameter);
+    
+    /**
+     * @brief Write a complete AVI response, headers to index
+     * 
+     * @param getFrame Reads frame @p index of the clip being exported
+     * @param filename Suggested download name
+     * @return true if the whole file was sent
+     */
+    static bool sendAvi(StreamSession *session, const AviClipInfo &clip,
+                        bool (*getFrame)(uint32_t index, const uint8_t **data, size_t *length),
+                        const char *filename);
+    
+    /**
+     * @brief HTTP handler serving pipeline metrics in Prometheus text format
+     */
+    static esp_err_t metricsHandler(httpd_req_t *req);
+    
     /**
      * @brief HTTP handler for the index page
      */
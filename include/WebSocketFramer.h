@@ -0,0 +1,55 @@
+#ifndef WEB_SOCKET_FRAMER_H
+#define WEB_SOCKET_FRAMER_H
+
+#include <Arduino.h>
+#include "StreamSessionManager.h"
+
+/**
+ * @brief Writes JPEG frames as binary WebSocket messages straight to a socket
+ *
+ * Each message is one unfragmented, unmasked binary frame holding a
+ * 16-byte frame header followed by the JPEG:
+ *
+ *   offset 0   uint32  frame sequence
+ *   offset 4   uint32  JPEG size in bytes
+ *   offset 8   uint64  capture time, microseconds since boot
+ *
+ * all little-endian. The WebSocket header, frame header and JPEG data
+ * straight from the framebuffer go out as one scatter-gather write, as
+ * MjpegFramer does for multipart parts. The handshake itself is done by
+ * esp_http_server.
+ */
+class WebSocketFramer {
+public:
+    static constexpr size_t FRAME_HEADER_SIZE = 16;
+
+    /**
+     * @brief Write one JPEG as a binary message
+     *
+     * @param session Session to write to
+     * @param sequence Frame sequence the client acknowledges
+     * @param captureTimeUs Capture time of the frame
+     * @param jpeg JPEG data, sent in place without copying
+     * @param length JPEG size in bytes
+     * @return true if the whole message was sent
+     */
+    static bool writeFrame(StreamSession *session, uint32_t sequence, int64_t captureTimeUs,
+                           const uint8_t *jpeg, size_t length);
+
+    /**
+     * @brief Parse an acknowledgement message from the client
+     *
+     * A text message holds the sequence in decimal; a 4-byte binary message
+     * holds it little-endian.
+     *
+     * @param text true for a text message
+     * @param sequence Receives the acknowledged sequence
+     * @return true if the message is a valid acknowledgement
+     */
+    static bool parseAck(const uint8_t *payload, size_t length, bool text, uint32_t *sequence);
+
+private:
+    static constexpr size_t MAX_MESSAGE_HEADER_SIZE = 10;
+};
+
+#endif // WEB_SOCKET_FRAMER_H
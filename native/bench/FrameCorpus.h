@@ -0,0 +1,78 @@
+#ifndef NATIVE_FRAME_CORPUS_H
+#define NATIVE_FRAME_CORPUS_H
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "SyntheticJpeg.h"
+
+// Frame corpus and timing helpers shared by the host benchmarks. Frames
+// come from WEBCAM_FRAMES_DIR (as recorded with tools/stream_load_test.py
+// --record) or, if that is unset or empty, from synthetic VGA frames with
+// a square moving across them.
+
+namespace FrameCorpus {
+
+const uint16_t SYNTHETIC_WIDTH = 640;
+const uint16_t SYNTHETIC_HEIGHT = 480;
+const int SYNTHETIC_QUALITY = 12;
+const uint32_t SYNTHETIC_FRAMES = 120;
+
+inline uint32_t envNumber(const char *name, uint32_t defaultValue) {
+    const char *value = getenv(name);
+    return value != nullptr && atoi(value) > 0 ? (uint32_t)atoi(value) : defaultValue;
+}
+
+inline std::vector<std::vector<uint8_t> > load() {
+    std::vector<std::vector<uint8_t> > frames;
+    const char *directory = getenv("WEBCAM_FRAMES_DIR");
+    if (directory != nullptr) {
+        std::vector<std::string> names;
+        if (DIR *dir = opendir(directory)) {
+            while (struct dirent *entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                if (name.size() > 4 && (name.substr(name.size() - 4) == ".jpg" || name.substr(name.size() - 4) == ".JPG")) {
+                    names.push_back(name);
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(names.begin(), names.end());
+        for (const std::string &name : names) {
+            FILE *file = fopen((std::string(directory) + "/" + name).c_str(), "rb");
+            if (file == nullptr) {
+                continue;
+            }
+            std::vector<uint8_t> jpeg;
+            uint8_t chunk[4096];
+            size_t count;
+            while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+                jpeg.insert(jpeg.end(), chunk, chunk + count);
+            }
+            fclose(file);
+            frames.push_back(jpeg);
+        }
+        printf("Corpus: %u frames from %s\n", (unsigned)frames.size(), directory);
+    }
+
+    if (frames.empty()) {
+        frames.resize(SYNTHETIC_FRAMES);
+        for (uint32_t i = 0; i < SYNTHETIC_FRAMES; i++) {
+            SyntheticJpeg::encode(SYNTHETIC_WIDTH, SYNTHETIC_HEIGHT, SYNTHETIC_QUALITY, i, frames[i]);
+        }
+        printf("Corpus: %u synthetic %ux%u frames\n", SYNTHETIC_FRAMES, SYNTHETIC_WIDTH, SYNTHETIC_HEIGHT);
+    }
+    return frames;
+}
+
+inline uint32_t percentile(std::vector<uint32_t> samples, uint32_t percent) {
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) * percent / 100];
+}
+
+} // namespace FrameCorpus
+
+#endif // NATIVE_FRAME_CORPUS_H
@@ -0,0 +1,244 @@
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <esp_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "AdaptiveStreamController.h"
+#include "FrameBroker.h"
+#include "MjpegFramer.h"
+#include "StreamSessionManager.h"
+
+// Streams the fake camera's test pattern through MjpegFramer to a socket
+// whose reader is throttled, and checks that AdaptiveStreamController
+// follows the link: with the reader slowed down it raises JPEG quality
+// (numerically) first and only then steps the frame size down; once the
+// throttle is lifted it climbs back to the top rung, waiting several good
+// windows before each step up.
+//
+//   pio run -e native_adaptive_check -t exec
+//
+// Environment:
+//   ADAPTIVE_CHECK_KBPS  throttled read rate in kbit/s (default 400)
+
+namespace {
+
+const uint32_t SETTLE_MS = 4000;            // Unthrottled run before the throttle
+const uint32_t STEP_DOWN_LIMIT_MS = 30000;  // Time allowed to reach the first smaller frame size
+const uint32_t RECOVERY_LIMIT_MS = 60000;   // Time allowed to climb back to the top rung
+const uint32_t MIN_UPGRADE_GAP_MS = 4000;   // Less than this between steps up is no hysteresis
+const uint32_t LIFT_WINDOW_MS = 2000;       // Controller window still holding throttled frames
+const size_t SOCKET_BUFFER = 16384;         // Roughly what lwIP lets a stream socket queue
+
+std::atomic<uint32_t> readBytesPerSecond(0);   // 0 reads as fast as possible
+std::atomic<bool> running(true);
+
+// The viewer: drains the socket, no faster than readBytesPerSecond
+void runReader(int fd) {
+    static uint8_t buffer[2048];
+    int64_t windowStartUs = esp_timer_get_time();
+    uint64_t windowBytes = 0;
+    uint32_t windowRate = 0;
+    while (running) {
+        uint32_t rate = readBytesPerSecond;
+        if (rate != windowRate) {
+            windowRate = rate;
+            windowStartUs = esp_timer_get_time();
+            windowBytes = 0;
+        }
+        if (rate > 0) {
+            int64_t dueUs = windowStartUs + (int64_t)(windowBytes * 1000000 / rate);
+            int64_t waitUs = dueUs - esp_timer_get_time();
+            if (waitUs > 0) {
+                usleep(waitUs);
+            }
+        }
+        size_t chunk = rate > 0 ? std::min<size_t>(sizeof(buffer), rate / 50 + 1) : sizeof(buffer);
+        ssize_t count = recv(fd, buffer, chunk, 0);
+        if (count <= 0) {
+            break;
+        }
+        windowBytes += count;
+    }
+}
+
+struct OperatingPoint {
+    uint8_t level;
+    framesize_t frameSize;
+    int quality;
+};
+
+OperatingPoint current() {
+    return {AdaptiveStreamController::getLevel(), AdaptiveStreamController::getFrameSize(),
+            AdaptiveStreamController::getQuality()};
+}
+
+} // namespace
+
+int main() {
+    const char *kbpsValue = getenv("ADAPTIVE_CHECK_KBPS");
+    uint32_t kbps = kbpsValue != nullptr && atoi(kbpsValue) > 0 ? atoi(kbpsValue) : 400;
+
+    camera_config_t config = {};
+    config.pixel_format = PIXFORMAT_JPEG;
+    config.frame_size = AdaptiveStreamController::getFrameSize();
+    config.jpeg_quality = AdaptiveStreamController::getQuality();
+    config.fb_count = 2;
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    config.grab_mode = CAMERA_GRAB_LATEST;
+    if (esp_camera_init(&config) != ESP_OK || !FrameBroker::begin(config.fb_count)) {
+        printf("FAIL: camera did not start\n");
+        return 1;
+    }
+    AdaptiveStreamController::begin();
+    const framesize_t baseFrameSize = AdaptiveStreamController::getBaseFrameSize();
+    const int baseQuality = AdaptiveStreamController::getBaseQuality();
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        printf("FAIL: cannot open the socket pair\n");
+        return 1;
+    }
+    int bufferSize = SOCKET_BUFFER;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    std::thread reader(runReader, fds[1]);
+
+    StreamSession session = {};
+    session.active = true;
+    session.fd = fds[0];
+    session.subscriber = FrameBroker::subscribe();
+
+    enum Phase { SETTLE, THROTTLED, RECOVERY };
+    Phase phase = SETTLE;
+    uint32_t phaseStartMs = millis();
+    uint32_t lastUpgradeMs = 0;
+    uint32_t skippedTotal = 0;
+    uint32_t frames = 0;
+    OperatingPoint previous = current();
+    const char *failure = nullptr;
+
+    printf("Top rung %s q%d, throttled to %u kbit/s\n",
+           AdaptiveStreamController::getFrameSizeName(baseFrameSize), baseQuality, kbps);
+
+    while (failure == nullptr) {
+        // The stream sender's loop, as in WebCamServer::streamSender
+        SharedFrame *frame = FrameBroker::waitForFrame(session.subscriber, pdMS_TO_TICKS(5000));
+        if (frame == nullptr) {
+            failure = "no frame from the camera";
+            break;
+        }
+        int64_t sendStart = esp_timer_get_time();
+        bool ok = MjpegFramer::writeFrame(&session, frame->sequence, frame->captureTimeUs,
+                                          frame->fb->buf, frame->fb->len);
+        int64_t sendEnd = esp_timer_get_time();
+        uint32_t skipped = FrameBroker::getDroppedFrameCount(session.subscriber);
+        AdaptiveStreamController::recordFrameSent((uint32_t)(sendEnd - sendStart),
+                                                  (uint32_t)(sendStart - frame->captureTimeUs),
+                                                  skipped - skippedTotal);
+        skippedTotal = skipped;
+        FrameBroker::release(frame);
+        frames++;
+        if (!ok) {
+            failure = "socket write failed";
+            break;
+        }
+
+        uint32_t now = millis();
+        uint32_t elapsed = now - phaseStartMs;
+        OperatingPoint point = current();
+        if (point.level != previous.level) {
+            printf("%8.1fs %-9s level %2u: %s q%d\n", now / 1000.0,
+                   phase == SETTLE ? "settle" : (phase == THROTTLED ? "throttled" : "recovery"),
+                   point.level, AdaptiveStreamController::getFrameSizeName(point.frameSize), point.quality);
+        }
+
+        switch (phase) {
+            case SETTLE:
+                if (point.level != 0) {
+                    failure = "stepped down on an unthrottled link";
+                } else if (elapsed >= SETTLE_MS) {
+                    readBytesPerSecond = kbps * 1000 / 8;
+                    phase = THROTTLED;
+                    phaseStartMs = now;
+                }
+                break;
+
+            case THROTTLED:
+                if (point.level < previous.level) {
+                    failure = "stepped up while throttled";
+                } else if (point.level > previous.level + 1) {
+                    failure = "skipped a rung";
+                } else if (point.frameSize == baseFrameSize) {
+                    // Quality rungs: the frame size holds while quality worsens
+                    if (point.level > previous.level && point.quality <= previous.quality) {
+                        failure = "stepped down without raising the quality value";
+                    }
+                } else if (point.frameSize > baseFrameSize) {
+                    failure = "frame size grew";
+                } else if (previous.frameSize == baseFrameSize) {
+                    // First frame size rung: every quality rung must have come first
+                    if (previous.quality <= baseQuality) {
+                        failure = "frame size stepped down before quality";
+                    } else if (point.quality != baseQuality) {
+                        failure = "a smaller frame size did not restart at the top quality";
+                    } else {
+                        readBytesPerSecond = 0;
+                        phase = RECOVERY;
+                        phaseStartMs = now;
+                        lastUpgradeMs = now;
+                    }
+                }
+                if (failure == nullptr && phase == THROTTLED && elapsed >= STEP_DOWN_LIMIT_MS) {
+                    failure = "frame size never stepped down while throttled";
+                }
+                break;
+
+            case RECOVERY:
+                // The window open when the throttle lifted, and the backlog
+                // in the socket buffer, may still cost one more rung
+                if (point.level > previous.level && elapsed >= LIFT_WINDOW_MS) {
+                    failure = "stepped down after the throttle was lifted";
+                } else if (point.level < previous.level) {
+                    if (previous.level - point.level > 1) {
+                        failure = "skipped a rung on the way up";
+                    } else if (now - lastUpgradeMs < MIN_UPGRADE_GAP_MS) {
+                        failure = "stepped up without waiting for several good windows";
+                    }
+                    lastUpgradeMs = now;
+                }
+                if (failure == nullptr && point.level == 0) {
+                    if (point.frameSize != baseFrameSize || point.quality != baseQuality) {
+                        failure = "level 0 is not the top rung";
+                    } else {
+                        printf("Recovered to the top rung in %.1f s\n", elapsed / 1000.0);
+                        running = false;
+                    }
+                } else if (failure == nullptr && elapsed >= RECOVERY_LIMIT_MS) {
+                    failure = "did not climb back to the top rung";
+                }
+                break;
+        }
+        previous = point;
+        if (!running) {
+            break;
+        }
+    }
+
+    running = false;
+    shutdown(fds[0], SHUT_RDWR);
+    close(fds[0]);
+    reader.join();
+    close(fds[1]);
+
+    printf("Frames sent: %u, skipped: %u\n", frames, skippedTotal);
+    if (failure != nullptr) {
+        printf("FAIL: %s\n", failure);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
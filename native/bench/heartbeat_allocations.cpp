@@ -0,0 +1,219 @@
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "ConfigurationManager.h"
+#include "HeartbeatMqttPublisher.h"
+#include "MqttCommandChannel.h"
+#include "MqttHandler.h"
+
+// Counts heap allocations made while publishing heartbeats, and fails if a
+// heartbeat makes any. The command channel connects to a minimal broker run
+// on a loopback socket in this process, so publishing goes through the real
+// client path; allocations made by the broker thread are not counted. The
+// command channel is then disconnected and the same number of heartbeats is
+// published through the MqttHandler fallback.
+//
+//   pio run -e native_alloc_check -t exec
+//
+// Environment:
+//   HEARTBEAT_CHECK_BEATS  heartbeats to publish on each path after the first
+//                          (default 20)
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+namespace {
+
+std::atomic<uint32_t> allocations(0);
+thread_local bool counting = false;
+
+void countAllocation() {
+    if (counting) {
+        allocations++;
+    }
+}
+
+std::atomic<uint32_t> heartbeatsReceived(0);
+std::atomic<uint32_t> statusReceived(0);
+
+bool readFully(int fd, uint8_t *buffer, size_t length) {
+    while (length > 0) {
+        ssize_t count = recv(fd, buffer, length, 0);
+        if (count <= 0) {
+            return false;
+        }
+        buffer += count;
+        length -= count;
+    }
+    return true;
+}
+
+// Accepts one client, acknowledges CONNECT and SUBSCRIBE, and counts the
+// heartbeat publishes it receives
+void runBroker(int listener) {
+    int fd = accept(listener, nullptr, nullptr);
+    static uint8_t body[4096];
+    for (;;) {
+        uint8_t header;
+        uint8_t digit;
+        size_t length = 0;
+        size_t multiplier = 1;
+        if (!readFully(fd, &header, 1)) {
+            break;
+        }
+        do {
+            if (!readFully(fd, &digit, 1)) {
+                close(fd);
+                return;
+            }
+            length += (digit & 0x7f) * multiplier;
+            multiplier *= 128;
+        } while (digit & 0x80);
+        if (length > sizeof(body) || !readFully(fd, body, length)) {
+            break;
+        }
+
+        uint8_t type = header >> 4;
+        if (type == 1) {
+            const uint8_t connack[] = {0x20, 2, 0, 0};
+            send(fd, connack, sizeof(connack), 0);
+        } else if (type == 8) {
+            const uint8_t suback[] = {0x90, 3, body[0], body[1], 0};
+            send(fd, suback, sizeof(suback), 0);
+        } else if (type == 3 && length >= 2) {
+            size_t topicLength = (body[0] << 8) | body[1];
+            if (topicLength == 9 && memcmp(body + 2, "heartbeat", 9) == 0) {
+                heartbeatsReceived++;
+            } else if (topicLength == 16 && memcmp(body + 2, "heartbeat/stream", 16) == 0) {
+                statusReceived++;
+            }
+        } else if (type == 12) {
+            const uint8_t pingresp[] = {0xd0, 0};
+            send(fd, pingresp, sizeof(pingresp), 0);
+        }
+    }
+    close(fd);
+}
+
+struct Result {
+    uint32_t total;
+    uint32_t worst;
+};
+
+// Publishes beats + 1 heartbeats, counting allocations in each
+bool publishBeats(uint32_t beats, bool commandChannel, Result &result) {
+    result = {};
+    for (uint32_t beat = 0; beat <= beats; beat++) {
+        allocations = 0;
+        counting = true;
+        bool published = HeartbeatMqttPublisher::publishHeartbeat();
+        counting = false;
+        if (!published) {
+            printf("FAIL: heartbeat %u not published\n", beat);
+            return false;
+        }
+        uint32_t count = allocations;
+        result.total += count;
+        result.worst = count > result.worst ? count : result.worst;
+        if (commandChannel) {
+            MqttCommandChannel::loop();
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+extern "C" void *malloc(size_t size) {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+int main() {
+    const char *beatsValue = getenv("HEARTBEAT_CHECK_BEATS");
+    uint32_t beats = beatsValue != nullptr && atoi(beatsValue) > 0 ? atoi(beatsValue) : 20;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, (struct sockaddr *)&address, &addressLength) != 0) {
+        printf("FAIL: cannot open the loopback broker\n");
+        return 1;
+    }
+    std::thread broker(runBroker, listener);
+    broker.detach();
+
+    char port[8];
+    snprintf(port, sizeof(port), "%u", ntohs(address.sin_port));
+    setenv("WEBCAM_MQTT_SERVER", "127.0.0.1", 1);
+    setenv("WEBCAM_MQTT_PORT", port, 1);
+    ConfigurationManager::setup();
+    HeartbeatMqttPublisher::begin();
+    MqttCommandChannel::begin();
+    for (int attempt = 0; attempt < 50 && !MqttCommandChannel::connect(); attempt++) {
+        delay(20);
+    }
+    if (!MqttCommandChannel::isConnected()) {
+        printf("FAIL: command channel did not connect\n");
+        return 1;
+    }
+
+    // The first heartbeat is a full one, the rest are deltas
+    Result channel;
+    if (!publishBeats(beats, true, channel)) {
+        return 1;
+    }
+    for (int wait = 0; wait < 50 && heartbeatsReceived < beats + 1; wait++) {
+        delay(10);
+    }
+    uint32_t channelPublished = HeartbeatMqttPublisher::getPublishCount();
+
+    // With the command channel down, heartbeats go through MqttHandler
+    MqttCommandChannel::getClient().disconnect();
+    if (MqttCommandChannel::isConnected() || !MqttHandler::connect(1)) {
+        printf("FAIL: cannot switch to the MqttHandler connection\n");
+        return 1;
+    }
+    uint32_t handlerStart = MqttHandler::getPublishCount();
+    Result fallback;
+    if (!publishBeats(beats, false, fallback)) {
+        return 1;
+    }
+    uint32_t handlerHeartbeats = MqttHandler::getPublishCount() - handlerStart;
+
+    printf("Command channel: %u heartbeats published, %u received, %u stream status\n",
+           channelPublished, heartbeatsReceived.load(), statusReceived.load());
+    printf("Command channel allocations: %u in total, at most %u in one heartbeat\n",
+           channel.total, channel.worst);
+    printf("MqttHandler: %u messages published\n", handlerHeartbeats);
+    printf("MqttHandler allocations: %u in total, at most %u in one heartbeat\n",
+           fallback.total, fallback.worst);
+
+    if (channel.total > 0 || fallback.total > 0 || heartbeatsReceived < beats + 1 ||
+        handlerHeartbeats < beats + 1) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
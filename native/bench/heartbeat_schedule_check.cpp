@@ -0,0 +1,116 @@
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include "ConfigurationManager.h"
+#include "ConnectivityManager.h"
+#include "FrameCorpus.h"
+#include "HeartbeatMqttPublisher.h"
+#include "MqttCommandChannel.h"
+#include "MqttHandler.h"
+#include "TaskScheduler.h"
+
+// Starts the network task the way setup() does - MQTT connected during
+// boot, ConnectivityManager taking over before TaskScheduler::begin() -
+// and times the heartbeats the periodic job publishes. The job skips a
+// beat while MQTT_UP is clear, so connectivity bits lost before the
+// scheduler existed show up as missing heartbeats.
+//
+// The command channel's broker accepts the connection but never answers,
+// so every reconnect attempt runs into its timeout on the network task; a
+// gap between heartbeats much longer than the interval means an attempt
+// held the task for longer than it should.
+//
+//   pio run -e native_heartbeat_check -t exec
+//
+// Environment:
+//   HEARTBEAT_CHECK_INTERVAL_MS  heartbeat interval (default 1000)
+//   HEARTBEAT_CHECK_BEATS        periodic heartbeats expected (default 5)
+
+using FrameCorpus::envNumber;
+
+namespace {
+
+// A command channel attempt plus scheduling slack
+const uint32_t STALL_ALLOWANCE_MS = 1500;
+
+std::atomic<uint32_t> lastBeatMs(0);
+std::atomic<uint32_t> longestGapMs(0);
+
+// As publishHeartbeatJob() in main.cpp, timing each beat
+void publishHeartbeatJob() {
+    if (TaskScheduler::getEvents() & TaskScheduler::MQTT_UP) {
+        HeartbeatMqttPublisher::publishHeartbeat();
+        uint32_t now = millis();
+        uint32_t gap = now - lastBeatMs;
+        if (gap > longestGapMs) {
+            longestGapMs = gap;
+        }
+        lastBeatMs = now;
+    }
+}
+
+} // namespace
+
+int main() {
+    uint32_t intervalMs = envNumber("HEARTBEAT_CHECK_INTERVAL_MS", 1000);
+    uint32_t beats = envNumber("HEARTBEAT_CHECK_BEATS", 5);
+
+    // Listens, so connects succeed, but never accepts or answers
+    int silentBroker = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (bind(silentBroker, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(silentBroker, 8) != 0 ||
+        getsockname(silentBroker, (struct sockaddr *)&address, &addressLength) != 0) {
+        printf("FAIL: cannot open the loopback broker\n");
+        return 1;
+    }
+    char port[8];
+    snprintf(port, sizeof(port), "%u", ntohs(address.sin_port));
+    setenv("WEBCAM_MQTT_SERVER", "127.0.0.1", 1);
+    setenv("WEBCAM_MQTT_PORT", port, 1);
+
+    ConfigurationManager::setup();
+    HeartbeatMqttPublisher::begin();
+    if (!MqttHandler::connect(1)) {
+        printf("FAIL: MQTT did not connect\n");
+        return 1;
+    }
+    HeartbeatMqttPublisher::publishHeartbeat();
+    uint32_t bootHeartbeats = HeartbeatMqttPublisher::getPublishCount();
+    MqttCommandChannel::begin();
+
+    ConnectivityManager::begin(nullptr);
+    TaskScheduler::addPeriodic(publishHeartbeatJob, intervalMs);
+    lastBeatMs = millis();
+    if (!TaskScheduler::begin()) {
+        printf("FAIL: network task did not start\n");
+        return 1;
+    }
+
+    uint32_t limitMs = beats * (intervalMs + STALL_ALLOWANCE_MS);
+    uint32_t start = millis();
+    while (HeartbeatMqttPublisher::getPublishCount() - bootHeartbeats < beats && millis() - start < limitMs) {
+        delay(10);
+    }
+    uint32_t periodic = HeartbeatMqttPublisher::getPublishCount() - bootHeartbeats;
+    printf("Periodic heartbeats: %u of %u in %.1f s, longest gap %u ms\n", periodic, beats,
+           (millis() - start) / 1000.0, longestGapMs.load());
+
+    if (periodic < beats) {
+        printf("FAIL: %s\n", (TaskScheduler::getEvents() & TaskScheduler::MQTT_UP) ? "heartbeats missed"
+                                                                                : "MQTT_UP never set");
+        return 1;
+    }
+    if (longestGapMs > intervalMs + STALL_ALLOWANCE_MS) {
+        printf("FAIL: the network task was held up between heartbeats\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
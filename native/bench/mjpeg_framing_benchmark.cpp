@@ -0,0 +1,164 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "FrameCorpus.h"
+#include "MjpegFramer.h"
+#include "StreamSessionManager.h"
+
+// Compares the cost on the wire of the MJPEG stream's framing: the stream
+// loop as it was before MjpegFramer, three httpd_resp_send_chunk calls per
+// frame (part header, JPEG, boundary), against MjpegFramer's single
+// scatter-gather write. Both write the frame corpus described in
+// FrameCorpus.h to a socket pair; send() and writev() are intercepted to
+// count the socket writes each path makes (Linux only), and the reader
+// counts the bytes that arrive.
+//
+//   pio run -e native_mjpeg_bench -t exec
+//
+// Environment:
+//   WEBCAM_FRAMES_DIR        JPEG corpus to replay
+//   MJPEG_BENCH_PASSES       times to run over the corpus (default 20)
+
+using FrameCorpus::envNumber;
+
+namespace {
+
+std::atomic<uint32_t> socketWrites(0);
+thread_local bool counting = false;
+std::atomic<uint64_t> bytesReceived(0);
+
+void runReader(int fd) {
+    static uint8_t buffer[65536];
+    for (;;) {
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) {
+            break;
+        }
+        bytesReceived += count;
+    }
+}
+
+// esp_http_server's httpd_resp_send_chunk: the chunk size line, the data
+// and the closing CRLF each go out as a separate send
+bool sendChunk(int fd, const void *data, size_t length) {
+    char size[16];
+    int sizeLength = snprintf(size, sizeof(size), "%x\r\n", (unsigned)length);
+    return send(fd, size, sizeLength, 0) == sizeLength &&
+           send(fd, data, length, 0) == (ssize_t)length &&
+           send(fd, "\r\n", 2, 0) == 2;
+}
+
+// One frame as the stream loop wrote it before MjpegFramer, with the part
+// headers MjpegFramer writes today so that only the framing differs
+bool writeLegacyFrame(int fd, uint32_t sequence, const std::vector<uint8_t> &jpeg) {
+    // The boundary was sent with length 13 from an 11-byte literal; the
+    // two bytes after it went out too
+    static const char boundary[13] = "\r\n--frame\r\n";
+    char part[192];
+    int64_t nowUs = esp_timer_get_time();
+    size_t partLength = snprintf(part, sizeof(part),
+        "Content-Type: image/jpeg\r\n"
+        "Content-Length: %u\r\n"
+        "X-Frame-Seq: %u\r\n"
+        "X-Timestamp: %u.%06u\r\n"
+        "X-Send-Timestamp: %u.%06u\r\n"
+        "\r\n",
+        (unsigned)jpeg.size(), sequence, (unsigned)(nowUs / 1000000), (unsigned)(nowUs % 1000000),
+        (unsigned)(nowUs / 1000000), (unsigned)(nowUs % 1000000));
+    return sendChunk(fd, part, partLength) &&
+           sendChunk(fd, jpeg.data(), jpeg.size()) &&
+           sendChunk(fd, boundary, sizeof(boundary));
+}
+
+struct Result {
+    uint32_t frames;
+    uint32_t writes;
+    uint64_t bytes;
+    uint64_t jpegBytes;
+    int64_t elapsedUs;
+};
+
+Result run(const std::vector<std::vector<uint8_t> > &frames, uint32_t passes, bool legacy) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    bytesReceived = 0;
+    std::thread reader(runReader, fds[1]);
+
+    StreamSession session = {};
+    session.active = true;
+    session.fd = fds[0];
+
+    Result result = {};
+    socketWrites = 0;
+    counting = true;
+    int64_t start = esp_timer_get_time();
+    uint32_t sequence = 0;
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        for (const std::vector<uint8_t> &jpeg : frames) {
+            sequence++;
+            bool ok = legacy ? writeLegacyFrame(fds[0], sequence, jpeg)
+                             : MjpegFramer::writeFrame(&session, sequence, esp_timer_get_time(),
+                                                       jpeg.data(), jpeg.size());
+            if (!ok) {
+                printf("FAIL: write failed\n");
+                exit(1);
+            }
+            result.frames++;
+            result.jpegBytes += jpeg.size();
+        }
+    }
+    result.elapsedUs = esp_timer_get_time() - start;
+    counting = false;
+    result.writes = socketWrites;
+
+    shutdown(fds[0], SHUT_WR);
+    reader.join();
+    close(fds[0]);
+    close(fds[1]);
+    result.bytes = bytesReceived;
+    return result;
+}
+
+void report(const char *name, const Result &result) {
+    printf("%-9s %8.2f writes/frame %9.1f bytes/frame %7.1f framing bytes/frame %7.1f us/frame\n", name,
+           (double)result.writes / result.frames, (double)result.bytes / result.frames,
+           (double)(result.bytes - result.jpegBytes) / result.frames, (double)result.elapsedUs / result.frames);
+}
+
+} // namespace
+
+extern "C" ssize_t send(int fd, const void *buffer, size_t length, int flags) {
+    if (counting) {
+        socketWrites++;
+    }
+    return syscall(SYS_sendto, fd, buffer, length, flags, nullptr, 0);
+}
+
+extern "C" ssize_t writev(int fd, const struct iovec *vector, int count) {
+    if (counting) {
+        socketWrites++;
+    }
+    return syscall(SYS_writev, fd, vector, count);
+}
+
+int main() {
+    std::vector<std::vector<uint8_t> > frames = FrameCorpus::load();
+    uint32_t passes = envNumber("MJPEG_BENCH_PASSES", 20);
+
+    Result legacy = run(frames, passes, true);
+    Result framer = run(frames, passes, false);
+    report("chunked", legacy);
+    report("writev", framer);
+
+    if (framer.writes >= legacy.writes || framer.bytes >= legacy.bytes) {
+        printf("FAIL: MjpegFramer does not save writes and bytes\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
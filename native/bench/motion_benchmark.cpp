@@ -0,0 +1,87 @@
+#include <Arduino.h>
+#include <numeric>
+#include "FrameCorpus.h"
+#include "JpegDcDecoder.h"
+#include "MotionDetector.h"
+
+// Times the motion detector over the frame corpus described in
+// FrameCorpus.h and checks it keeps up with the sensor.
+//
+//   pio run -e native_bench -t exec
+//
+// Environment:
+//   WEBCAM_FRAMES_DIR       JPEG corpus to replay
+//   WEBCAM_SENSOR_FPS       sensor rate to compare against (default 25)
+//   MOTION_BENCH_PASSES     times to run over the corpus (default 20)
+//   MOTION_BENCH_BUDGET_US  per-frame limit for the exit status
+//                           (default: one sensor frame period)
+
+using FrameCorpus::envNumber;
+using FrameCorpus::percentile;
+
+int main() {
+    std::vector<std::vector<uint8_t> > frames = FrameCorpus::load();
+    uint32_t sensorFps = envNumber("WEBCAM_SENSOR_FPS", 25);
+    uint32_t passes = envNumber("MOTION_BENCH_PASSES", 20);
+    uint32_t budgetUs = envNumber("MOTION_BENCH_BUDGET_US", 1000000 / sensorFps);
+
+    // Decoding on its own, to separate it from the comparison kernel
+    static uint8_t map[200 * 150];
+    JpegDcDecoder decoder;
+    uint16_t blocksWide = 0;
+    uint16_t blocksHigh = 0;
+    std::vector<uint32_t> decodeUs;
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        for (const std::vector<uint8_t> &jpeg : frames) {
+            int64_t start = esp_timer_get_time();
+            decoder.decodeLumaDc(jpeg.data(), jpeg.size(), map, sizeof(map), blocksWide, blocksHigh);
+            decodeUs.push_back((uint32_t)(esp_timer_get_time() - start));
+        }
+    }
+
+    // The full detector, fed at the sensor rate as the capture task would
+    std::vector<uint32_t> frameUs;
+    uint32_t failures = 0;
+    uint32_t starts = 0;
+    uint32_t sequence = 0;
+    bool wasActive = false;
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        for (const std::vector<uint8_t> &jpeg : frames) {
+            sequence++;
+            int64_t start = esp_timer_get_time();
+            if (!MotionDetector::processFrame(jpeg.data(), jpeg.size(), sequence, sequence * 1000 / sensorFps)) {
+                failures++;
+            }
+            frameUs.push_back((uint32_t)(esp_timer_get_time() - start));
+
+            bool active = MotionDetector::isMotionActive();
+            if (active && !wasActive) {
+                starts++;
+            }
+            wasActive = active;
+        }
+    }
+
+    uint64_t total = 0;
+    for (uint32_t us : frameUs) {
+        total += us;
+    }
+    uint32_t averageUs = (uint32_t)(total / frameUs.size());
+    uint32_t p99Us = percentile(frameUs, 99);
+
+    printf("Map: %ux%u blocks\n", blocksWide, blocksHigh);
+    printf("Frames: %u analysed, %u failed, %u motion start(s)\n", (unsigned)frameUs.size(), failures, starts);
+    printf("Decode only: avg %u us, p99 %u us\n",
+        (unsigned)(std::accumulate(decodeUs.begin(), decodeUs.end(), (uint64_t)0) / decodeUs.size()),
+        percentile(decodeUs, 99));
+    printf("Per frame:   avg %u us, p99 %u us, max %u us\n", averageUs, p99Us, percentile(frameUs, 100));
+    printf("Throughput:  %.0f fps against a %u fps sensor (budget %u us/frame)\n",
+        averageUs > 0 ? 1e6 / averageUs : 0.0, sensorFps, budgetUs);
+
+    if (failures > 0 || p99Us > budgetUs) {
+        printf("FAIL: detector cannot keep up\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
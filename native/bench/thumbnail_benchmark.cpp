@@ -0,0 +1,109 @@
+#include <Arduino.h>
+#include <numeric>
+#include "FrameCorpus.h"
+#include "JpegThumbnailer.h"
+
+// Times /stream?scale= thumbnail transcodes over the frame corpus described
+// in FrameCorpus.h. Every frame is transcoded at 1/8 and at 1/4, as happens
+// when both scales have viewers; each must take less than the budget.
+//
+//   pio run -e native_thumbnail_bench -t exec
+//
+// Environment:
+//   WEBCAM_FRAMES_DIR       JPEG corpus to replay
+//   WEBCAM_SENSOR_FPS       sensor rate (default 25)
+//   THUMB_BENCH_PASSES      times to run over the corpus (default 20)
+//   THUMB_BENCH_BUDGET_US   per-transcode limit for the exit status
+//                           (default: half a sensor frame period, so both
+//                           scales fit in one)
+
+using FrameCorpus::envNumber;
+using FrameCorpus::percentile;
+
+namespace {
+
+// Frame size from the SOF, as the driver would report it
+void readFrameSize(const std::vector<uint8_t> &jpeg, camera_fb_t &fb) {
+    fb.width = 0;
+    fb.height = 0;
+    for (size_t i = 2; i + 9 < jpeg.size(); i++) {
+        if (jpeg[i] == 0xff && (jpeg[i + 1] == 0xc0 || jpeg[i + 1] == 0xc1)) {
+            fb.height = (uint16_t)(jpeg[i + 5] << 8 | jpeg[i + 6]);
+            fb.width = (uint16_t)(jpeg[i + 7] << 8 | jpeg[i + 8]);
+            return;
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::vector<uint8_t> > frames = FrameCorpus::load();
+    uint32_t sensorFps = envNumber("WEBCAM_SENSOR_FPS", 25);
+    uint32_t passes = envNumber("THUMB_BENCH_PASSES", 20);
+    uint32_t budgetUs = envNumber("THUMB_BENCH_BUDGET_US", 1000000 / sensorFps / 2);
+
+    if (!JpegThumbnailer::begin()) {
+        return 1;
+    }
+
+    uint8_t *buffer = nullptr;
+    size_t capacity = 0;
+    uint32_t sequence = 0;
+    uint32_t failures = 0;
+    uint64_t frameBytes = 0;
+    uint64_t thumbnailBytes[2] = {0, 0};
+    std::vector<uint32_t> transcodeUs[2];
+    const uint8_t divisors[2] = {8, 4};
+
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        for (std::vector<uint8_t> &jpeg : frames) {
+            camera_fb_t fb = {};
+            fb.buf = jpeg.data();
+            fb.len = jpeg.size();
+            fb.format = PIXFORMAT_JPEG;
+            readFrameSize(jpeg, fb);
+            // A new sequence number each time so the cache never answers
+            SharedFrame frame = {&fb, ++sequence, 1, 0};
+            frameBytes += jpeg.size();
+
+            for (uint8_t i = 0; i < 2; i++) {
+                size_t length = 0;
+                int64_t start = esp_timer_get_time();
+                if (!JpegThumbnailer::copyThumbnail(&frame, divisors[i], buffer, capacity, length)) {
+                    failures++;
+                    continue;
+                }
+                transcodeUs[i].push_back((uint32_t)(esp_timer_get_time() - start));
+                thumbnailBytes[i] += length;
+            }
+        }
+    }
+    free(buffer);
+
+    uint32_t frameCount = passes * (uint32_t)frames.size();
+    printf("Frames: %u transcoded at each scale, %u failed, avg %u bytes\n",
+        frameCount, failures, (unsigned)(frameBytes / frameCount));
+    bool overBudget = false;
+    for (uint8_t i = 0; i < 2; i++) {
+        if (transcodeUs[i].empty()) {
+            continue;
+        }
+        uint32_t averageUs = (uint32_t)(std::accumulate(transcodeUs[i].begin(), transcodeUs[i].end(), (uint64_t)0) /
+                                        transcodeUs[i].size());
+        uint32_t p99Us = percentile(transcodeUs[i], 99);
+        uint32_t averageBytes = (uint32_t)(thumbnailBytes[i] / transcodeUs[i].size());
+        printf("1/%u: avg %u us, p99 %u us, max %u us, avg %u bytes (%.1f%% of the frame)\n",
+            divisors[i], averageUs, p99Us, percentile(transcodeUs[i], 100), averageBytes,
+            100.0 * averageBytes * frameCount / frameBytes);
+        overBudget = overBudget || p99Us > budgetUs;
+    }
+    printf("Budget: %u us per transcode\n", budgetUs);
+
+    if (failures > 0 || overBudget) {
+        printf("FAIL: thumbnails cannot keep up\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
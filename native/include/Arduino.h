@@ -0,0 +1,178 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Host (native) stand-in for the subset of the Arduino-ESP32 core used by
+// the firmware. Only what the sources in src/ need is provided.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::min;
+using std::max;
+
+class String {
+public:
+    String() {}
+    String(const char *text) : value(text ? text : "") {}
+    String(const std::string &text) : value(text) {}
+    explicit String(char c) : value(1, c) {}
+    explicit String(int number) : value(std::to_string(number)) {}
+    explicit String(unsigned int number) : value(std::to_string(number)) {}
+    explicit String(long number) : value(std::to_string(number)) {}
+    explicit String(unsigned long number) : value(std::to_string(number)) {}
+    explicit String(float number, unsigned int decimals = 2) : value(format(number, decimals)) {}
+    explicit String(double number, unsigned int decimals = 2) : value(format(number, decimals)) {}
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.size(); }
+    bool isEmpty() const { return value.empty(); }
+    void reserve(unsigned int size) { value.reserve(size); }
+    bool concat(const String &other) { value += other.value; return true; }
+    bool concat(const char *text, unsigned int length) { value.append(text, length); return true; }
+    int toInt() const { return atoi(value.c_str()); }
+    float toFloat() const { return atof(value.c_str()); }
+    char charAt(unsigned int index) const { return index < value.size() ? value[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t found = value.find(c, from);
+        return found == std::string::npos ? -1 : (int)found;
+    }
+    int indexOf(const String &text, unsigned int from = 0) const {
+        size_t found = value.find(text.value, from);
+        return found == std::string::npos ? -1 : (int)found;
+    }
+    String substring(unsigned int from) const { return from < value.size() ? String(value.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > value.size()) {
+            return String();
+        }
+        return String(value.substr(from, to > from ? to - from : 0));
+    }
+    bool startsWith(const String &prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    bool endsWith(const String &suffix) const {
+        return value.size() >= suffix.value.size() &&
+               value.compare(value.size() - suffix.value.size(), suffix.value.size(), suffix.value) == 0;
+    }
+    void toCharArray(char *buffer, unsigned int size) const {
+        if (size == 0) {
+            return;
+        }
+        strncpy(buffer, value.c_str(), size - 1);
+        buffer[size - 1] = '\0';
+    }
+    void trim() {
+        size_t start = value.find_first_not_of(" \t\r\n");
+        size_t end = value.find_last_not_of(" \t\r\n");
+        value = start == std::string::npos ? std::string() : value.substr(start, end - start + 1);
+    }
+
+    String &operator+=(const String &other) { value += other.value; return *this; }
+    String &operator+=(const char *other) { value += other; return *this; }
+    String &operator+=(char c) { value += c; return *this; }
+    bool operator==(const String &other) const { return value == other.value; }
+    bool operator==(const char *other) const { return value == other; }
+    bool operator!=(const String &other) const { return value != other.value; }
+    bool operator!=(const char *other) const { return value != other; }
+    bool operator<(const String &other) const { return value < other.value; }
+
+    friend String operator+(const String &a, const String &b) { return String(a.value + b.value); }
+    friend String operator+(const String &a, const char *b) { return String(a.value + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.value); }
+
+private:
+    std::string value;
+
+    static std::string format(double number, unsigned int decimals) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+        return buffer;
+    }
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+    size_t write(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+
+    size_t print(const String &text) { return write((const uint8_t *)text.c_str(), text.length()); }
+    size_t print(const char *text) { return write(text); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int number) { return print(String(number)); }
+    size_t print(unsigned int number) { return print(String(number)); }
+    size_t print(long number) { return print(String(number)); }
+    size_t print(unsigned long number) { return print(String(number)); }
+    size_t print(double number, int decimals = 2) { return print(String(number, decimals)); }
+    template <typename T> size_t println(const T &value) { return print(value) + println(); }
+    size_t println() { return write("\r\n"); }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() { fflush(stdout); }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getPsramSize();
+    uint32_t getFreePsram();
+    uint32_t getMinFreePsram();
+    void restart();
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+bool psramFound();
+void *ps_malloc(size_t size);
+
+void setup();
+void loop();
+
+#endif // NATIVE_ARDUINO_H
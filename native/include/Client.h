@@ -0,0 +1,23 @@
+#ifndef NATIVE_CLIENT_H
+#define NATIVE_CLIENT_H
+
+// Host stand-in for the Arduino Client interface implemented by WiFiClient.
+
+#include "Arduino.h"
+
+class Client {
+public:
+    virtual ~Client() {}
+    virtual int connect(const char *host, uint16_t port) = 0;
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int read(uint8_t *buffer, size_t size) = 0;
+    virtual void flush() = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+};
+
+#endif // NATIVE_CLIENT_H
@@ -0,0 +1,33 @@
+#ifndef NATIVE_CONFIGURATION_MANAGER_H
+#define NATIVE_CONFIGURATION_MANAGER_H
+
+// Host stand-in for the esp32-configuration-manager library. Values come
+// from WEBCAM_* environment variables instead of the serial setup prompt.
+
+#include "Arduino.h"
+
+struct DeviceConfig {
+    String uuid;
+    String mqttClientName;
+    String wifiSSID;
+    String wifiPassword;
+    String mqttServer;
+    int mqttPort;
+    String mqttUsername;
+    String mqttPassword;
+    int bootCount;
+    int wifiTimeoutSeconds;
+    int mqttTimeoutSeconds;
+};
+
+class ConfigurationManager {
+public:
+    static void setup();
+    static void incrementBootCount();
+    static DeviceConfig getConfig();
+
+private:
+    static DeviceConfig config;
+};
+
+#endif // NATIVE_CONFIGURATION_MANAGER_H
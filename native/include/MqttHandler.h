@@ -0,0 +1,27 @@
+#ifndef NATIVE_MQTT_HANDLER_H
+#define NATIVE_MQTT_HANDLER_H
+
+// Host stand-in for the esp32-mqtt-handler library. Publishes are printed
+// to stdout (one "MQTT <topic> <payload>" line each) instead of being sent
+// to a broker, so heartbeats can be inspected or piped into a checker.
+
+#include "Arduino.h"
+
+class MqttHandler {
+public:
+    static void setBufferSize(uint16_t size);
+    static void setup(int lightPin);
+    static bool connect(int timeoutSeconds);
+    static bool isConnected();
+    static void loop();
+    static bool publish(const char *topic, const String &payload);
+    static bool publish(const String &topic, const String &payload);
+    static uint32_t getPublishCount();
+
+private:
+    static uint16_t bufferSize;
+    static bool connected;
+    static uint32_t publishCount;
+};
+
+#endif // NATIVE_MQTT_HANDLER_H
@@ -0,0 +1,45 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+// Host stand-in for the NVS-backed Preferences library. Values live in
+// memory for the lifetime of the process, keyed by namespace.
+
+#include "Arduino.h"
+#include <map>
+#include <vector>
+
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false);
+    void end();
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putBool(const char *key, bool value);
+    size_t putUChar(const char *key, uint8_t value);
+    size_t putInt(const char *key, int32_t value);
+    size_t putUInt(const char *key, uint32_t value);
+    size_t putString(const char *key, const String &value);
+    size_t putBytes(const char *key, const void *value, size_t length);
+
+    bool getBool(const char *key, bool defaultValue = false);
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0);
+    int32_t getInt(const char *key, int32_t defaultValue = 0);
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+    String getString(const char *key, const String &defaultValue = String());
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buffer, size_t maxLength);
+
+private:
+    typedef std::vector<uint8_t> Value;
+    typedef std::map<std::string, Value> Namespace;
+
+    Namespace *current = nullptr;
+    bool readOnly = false;
+
+    size_t put(const char *key, const void *value, size_t length);
+    const Value *find(const char *key);
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,71 @@
+#ifndef NATIVE_PUB_SUB_CLIENT_H
+#define NATIVE_PUB_SUB_CLIENT_H
+
+// Host stand-in for knolleary/PubSubClient: a small MQTT 3.1.1 client
+// (QoS 0 only) over any Client, with the same public API and the same
+// buffer rules. publish() fails for packets larger than the buffer, while
+// beginPublish()/write()/endPublish() stream a payload of any size.
+
+#include "Arduino.h"
+#include "Client.h"
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST    -3
+#define MQTT_CONNECT_FAILED     -2
+#define MQTT_DISCONNECTED       -1
+#define MQTT_CONNECTED           0
+
+#define MQTT_KEEPALIVE 15
+#define MQTT_SOCKET_TIMEOUT 15
+#define MQTT_MAX_PACKET_SIZE 256
+
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char *, uint8_t *, unsigned int)
+
+class PubSubClient {
+public:
+    explicit PubSubClient(Client &client);
+    ~PubSubClient();
+
+    PubSubClient &setServer(const char *domain, uint16_t port);
+    PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE);
+    PubSubClient &setKeepAlive(uint16_t keepAlive);
+    PubSubClient &setSocketTimeout(uint16_t timeout);
+    bool setBufferSize(uint16_t size);
+    uint16_t getBufferSize();
+
+    bool connect(const char *id, const char *user, const char *pass);
+    void disconnect();
+    bool connected();
+    int state();
+    bool loop();
+
+    bool subscribe(const char *topic);
+    bool publish(const char *topic, const char *payload);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false);
+    bool beginPublish(const char *topic, unsigned int length, bool retained);
+    size_t write(uint8_t value);
+    size_t write(const uint8_t *buffer, size_t size);
+    int endPublish();
+
+private:
+    Client *client;
+    const char *domain;
+    uint16_t port;
+    void (*callback)(char *, uint8_t *, unsigned int);
+    uint8_t *buffer;
+    uint16_t bufferSize;
+    uint16_t keepAlive;
+    uint16_t socketTimeout;
+    uint16_t nextPacketId;
+    unsigned long lastOutActivity;
+    unsigned long lastInActivity;
+    bool pingOutstanding;
+    int status;
+
+    size_t writeHeader(uint8_t type, size_t length, uint8_t *header);
+    bool sendPacket(uint8_t type, const uint8_t *body, size_t length);
+    bool readByte(uint8_t *value);
+    bool readPacket(uint8_t *type, size_t *length, bool *truncated);
+};
+
+#endif // NATIVE_PUB_SUB_CLIENT_H
@@ -0,0 +1,84 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+// Host stand-in for the Arduino WiFi library: the "station" is connected
+// and reports the loopback address, apart from the simulated outages set
+// by WEBCAM_WIFI_OUTAGE (see NativeArduino.cpp). WiFiClient is a real TCP
+// client, so MQTT code can talk to a broker on the host.
+
+#include "Arduino.h"
+#include "Client.h"
+
+#define WL_IDLE_STATUS 0
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+#define WIFI_STA 1
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef void (*WiFiEventCb)(arduino_event_id_t event);
+
+class IPAddress {
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+    uint8_t operator[](int index) const { return octets[index & 3]; }
+    String toString() const {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+        return String(text);
+    }
+
+private:
+    uint8_t octets[4];
+};
+
+class WiFiClass {
+public:
+    int status();
+    int RSSI() { return -55; }
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+    String macAddress() { return String("02:00:00:00:00:01"); }
+    void mode(int mode) { (void)mode; }
+    void setSleep(bool enable) { (void)enable; }
+    void setAutoReconnect(bool enable) { (void)enable; }
+    void persistent(bool enable) { (void)enable; }
+    void begin(const char *ssid, const char *password) { (void)ssid; (void)password; }
+    void disconnect(bool wifiOff = false) { (void)wifiOff; }
+    void reconnect() {}
+    int onEvent(WiFiEventCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public Client {
+public:
+    WiFiClient() : fd(-1), timeoutMs(3000) {}
+    ~WiFiClient() { stop(); }
+
+    int connect(const char *host, uint16_t port) override;
+    int setTimeout(uint32_t seconds) { timeoutMs = seconds * 1000; return 0; }   // Connect timeout, as ESP32's
+    size_t write(uint8_t value) override { return write(&value, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t *buffer, size_t size) override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return fd >= 0; }
+
+private:
+    int fd;
+    uint32_t timeoutMs;
+
+    WiFiClient(const WiFiClient &) = delete;
+    WiFiClient &operator=(const WiFiClient &) = delete;
+};
+
+#endif // NATIVE_WIFI_H
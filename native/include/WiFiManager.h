@@ -0,0 +1,23 @@
+#ifndef NATIVE_WIFI_MANAGER_H
+#define NATIVE_WIFI_MANAGER_H
+
+// Host stand-in for the esp32-wifi-manager library; connectivity follows the
+// simulated Wi-Fi link (see WiFi.h).
+
+#include "Arduino.h"
+
+enum class WiFiPowerMode {
+    HIGH_PERFORMANCE,
+    BALANCED,
+    LOW_POWER
+};
+
+class WiFiManager {
+public:
+    static void setupLowPower(WiFiPowerMode mode);
+    static bool connectQuick(int timeoutSeconds);
+    static bool isConnected();
+    static String getIPAddress();
+};
+
+#endif // NATIVE_WIFI_MANAGER_H
@@ -0,0 +1,9 @@
+#ifndef NATIVE_ESP_SYSTEM_H
+#define NATIVE_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+uint32_t esp_random();
+void esp_restart();
+
+#endif // NATIVE_ESP_SYSTEM_H
@@ -0,0 +1,11 @@
+#ifndef NATIVE_ESP_TIMER_H
+#define NATIVE_ESP_TIMER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Microseconds since the simulated device booted
+ */
+int64_t esp_timer_get_time();
+
+#endif // NATIVE_ESP_TIMER_H
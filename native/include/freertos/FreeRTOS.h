@@ -0,0 +1,57 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+// Host stand-in for the FreeRTOS API on top of std::thread. One tick is one
+// millisecond, tasks are detached threads and core affinity is ignored.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t EventBits_t;
+typedef uint32_t StackType_t;
+
+struct NativeTask;
+struct NativeSemaphore;
+struct NativeQueue;
+struct NativeEventGroup;
+
+typedef NativeTask *TaskHandle_t;
+typedef NativeSemaphore *SemaphoreHandle_t;
+typedef NativeQueue *QueueHandle_t;
+typedef NativeEventGroup *EventGroupHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define pdFAIL 0
+#define errQUEUE_FULL 0
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7fffffff
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configUSE_TRACE_FACILITY 1
+#define configGENERATE_RUN_TIME_STATS 1
+#define configTASKLIST_INCLUDE_COREID 1
+
+/**
+ * @brief Spinlock stand-in; a recursive mutex is close enough on the host
+ */
+struct portMUX_TYPE {
+    std::recursive_mutex mutex;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) ((mux)->mutex.lock())
+#define portEXIT_CRITICAL(mux) ((mux)->mutex.unlock())
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+
+#endif // NATIVE_FREERTOS_H
@@ -0,0 +1,20 @@
+#ifndef NATIVE_IMG_CONVERTERS_H
+#define NATIVE_IMG_CONVERTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+
+/**
+ * @brief Encode a raw image as a JPEG
+ *
+ * Only PIXFORMAT_YUV422 is supported on the host. @p out is allocated with
+ * malloc() and must be freed by the caller.
+ *
+ * @param quality 1-100, higher is better
+ * @return true if @p out holds the JPEG
+ */
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+             uint8_t **out, size_t *out_len);
+
+#endif // NATIVE_IMG_CONVERTERS_H
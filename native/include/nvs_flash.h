@@ -0,0 +1,9 @@
+#ifndef NATIVE_NVS_FLASH_H
+#define NATIVE_NVS_FLASH_H
+
+#include "esp_err.h"
+
+inline esp_err_t nvs_flash_init() { return ESP_OK; }
+inline esp_err_t nvs_flash_erase() { return ESP_OK; }
+
+#endif // NATIVE_NVS_FLASH_H
@@ -0,0 +1,447 @@
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <img_converters.h>
+#include <dirent.h>
+#include <algorithm>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include "SyntheticJpeg.h"
+
+// esp32-camera driver for the host build. Frames come from a corpus of JPEG
+// files (WEBCAM_FRAMES_DIR, default native/frames) replayed in name order,
+// or from SyntheticJpeg when the directory is empty. The "sensor" completes
+// a frame every 1/WEBCAM_SENSOR_FPS seconds (default 25, halved above SVGA
+// and for windows in UXGA mode, as on the OV2640); set_res_raw() crops
+// synthetic frames as the OV2640's DSP window does. Driving pin_pwdn high
+// stops the sensor; the first frame after it is released completes one frame
+// period later. esp_camera_fb_get() waits for the next frame not yet handed
+// out and fails after four seconds if every framebuffer is taken, matching
+// the driver's behaviour with fb_count buffers. fmt2jpg() from the driver's
+// image converters is backed by SyntheticJpeg's encoder.
+
+const resolution_info_t resolution[FRAMESIZE_INVALID] = {
+    {96, 96}, {160, 120}, {176, 144}, {240, 176}, {240, 240}, {320, 240}, {400, 296},
+    {480, 320}, {640, 480}, {800, 600}, {1024, 768}, {1280, 720}, {1280, 1024}, {1600, 1200}
+};
+
+namespace {
+
+const uint32_t FB_GET_TIMEOUT_MS = 4000;
+const uint32_t DEFAULT_SENSOR_FPS = 25;
+
+struct Framebuffer {
+    camera_fb_t fb;
+    std::vector<uint8_t> data;
+    bool inUse;
+};
+
+std::mutex cameraMutex;
+std::condition_variable framebufferReturned;
+bool initialised = false;
+camera_config_t activeConfig;
+std::vector<Framebuffer> framebuffers;
+std::vector<std::vector<uint8_t>> corpus;
+uint32_t sensorFps = DEFAULT_SENSOR_FPS;
+int64_t sensorStartUs = 0;
+int64_t sensorPeriodUs = 0;
+int64_t lastFrameIndex = -1;
+// The sensor finishes the frames already under way at the old size
+int64_t framesizeFromIndex = 0;
+framesize_t previousFramesize = FRAMESIZE_QVGA;
+sensor_t fakeSensor;
+
+// OV2640 DSP window from set_res_raw(), cleared by set_framesize()
+struct SensorWindow {
+    bool set;
+    int mode;                   // 0 UXGA, 1 SVGA, 2 CIF
+    int offsetX;
+    int offsetY;
+    int width;
+    int height;
+    int outputWidth;
+    int outputHeight;
+};
+SensorWindow window;
+// PWDN held high
+bool poweredDown = false;
+
+uint32_t envNumber(const char *name, uint32_t defaultValue) {
+    const char *value = getenv(name);
+    return value != nullptr && atoi(value) > 0 ? (uint32_t)atoi(value) : defaultValue;
+}
+
+void loadCorpus() {
+    corpus.clear();
+    const char *directory = getenv("WEBCAM_FRAMES_DIR");
+    std::string path = directory != nullptr ? directory : "native/frames";
+
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        size_t dot = name.rfind('.');
+        std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+        if (extension == ".jpg" || extension == ".jpeg" || extension == ".JPG") {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string &name : names) {
+        FILE *file = fopen((path + "/" + name).c_str(), "rb");
+        if (file == nullptr) {
+            continue;
+        }
+        std::vector<uint8_t> jpeg;
+        uint8_t chunk[4096];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            jpeg.insert(jpeg.end(), chunk, chunk + count);
+        }
+        fclose(file);
+        if (jpeg.size() > 4 && jpeg[0] == 0xff && jpeg[1] == 0xd8) {
+            corpus.push_back(jpeg);
+        }
+    }
+    Serial.printf("[fake camera] %u corpus frames from %s\n", (unsigned)corpus.size(), path.c_str());
+}
+
+int64_t framePeriodUs() {
+    bool uxgaMode = window.set ? window.mode == 0 : fakeSensor.status.framesize > FRAMESIZE_SVGA;
+    uint32_t fps = uxgaMode ? std::max<uint32_t>(1, sensorFps / 2) : sensorFps;
+    return 1000000 / fps;
+}
+
+void renderFrame(Framebuffer &framebuffer, uint32_t index, framesize_t size, const SensorWindow &frameWindow) {
+    uint16_t width = resolution[size].width;
+    uint16_t height = resolution[size].height;
+    if (!corpus.empty()) {
+        framebuffer.data = corpus[index % corpus.size()];
+    } else if (frameWindow.set) {
+        // The test pattern covers the mode's field; the window picks part of it
+        int factor = frameWindow.mode == 0 ? 1 : (frameWindow.mode == 1 ? 2 : 4);
+        width = frameWindow.outputWidth;
+        height = frameWindow.outputHeight;
+        SyntheticJpeg::encodeWindow(width, height, fakeSensor.status.quality, index, 1600 / factor, 1200 / factor,
+                                    frameWindow.offsetX, frameWindow.offsetY, frameWindow.width, frameWindow.height,
+                                    framebuffer.data);
+    } else {
+        SyntheticJpeg::encode(width, height, fakeSensor.status.quality, index, framebuffer.data);
+    }
+
+    // Corpus frames keep their own dimensions and are not cropped; report the requested size
+    framebuffer.fb.buf = framebuffer.data.data();
+    framebuffer.fb.len = framebuffer.data.size();
+    framebuffer.fb.width = width;
+    framebuffer.fb.height = height;
+    framebuffer.fb.format = PIXFORMAT_JPEG;
+}
+
+// sensor_t setters: record the value in status like the real driver does
+#define FAKE_SETTER(function, field)                  \
+    int function(sensor_t *sensor, int value) {       \
+        sensor->status.field = value;                 \
+        return 0;                                     \
+    }
+
+FAKE_SETTER(setContrast, contrast)
+FAKE_SETTER(setBrightness, brightness)
+FAKE_SETTER(setSaturation, saturation)
+FAKE_SETTER(setSharpness, sharpness)
+FAKE_SETTER(setDenoise, denoise)
+FAKE_SETTER(setGainCeiling, gainceiling)
+FAKE_SETTER(setColorbar, colorbar)
+FAKE_SETTER(setWhitebal, awb)
+FAKE_SETTER(setGainCtrl, agc)
+FAKE_SETTER(setExposureCtrl, aec)
+FAKE_SETTER(setHmirror, hmirror)
+FAKE_SETTER(setVflip, vflip)
+FAKE_SETTER(setAec2, aec2)
+FAKE_SETTER(setAwbGain, awb_gain)
+FAKE_SETTER(setAgcGain, agc_gain)
+FAKE_SETTER(setAecValue, aec_value)
+FAKE_SETTER(setSpecialEffect, special_effect)
+FAKE_SETTER(setWbMode, wb_mode)
+FAKE_SETTER(setAeLevel, ae_level)
+FAKE_SETTER(setDcw, dcw)
+FAKE_SETTER(setBpc, bpc)
+FAKE_SETTER(setWpc, wpc)
+FAKE_SETTER(setRawGma, raw_gma)
+FAKE_SETTER(setLenc, lenc)
+
+int setQuality(sensor_t *sensor, int quality) {
+    if (quality < 0 || quality > 63) {
+        return -1;
+    }
+    sensor->status.quality = quality;
+    return 0;
+}
+
+int setFramesize(sensor_t *sensor, framesize_t framesize) {
+    if (framesize < 0 || framesize >= FRAMESIZE_INVALID) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(cameraMutex);
+    if (framesize != sensor->status.framesize) {
+        previousFramesize = sensor->status.framesize;
+        framesizeFromIndex = lastFrameIndex + 2;
+    }
+    sensor->status.framesize = framesize;
+    window.set = false;
+    return 0;
+}
+
+int setPixformat(sensor_t *sensor, pixformat_t pixformat) {
+    sensor->pixformat = pixformat;
+    return 0;
+}
+
+int setResRaw(sensor_t *sensor, int startX, int startY, int endX, int endY, int offsetX, int offsetY,
+              int totalX, int totalY, int outputX, int outputY, bool scale, bool binning) {
+    // As the OV2640 driver: startX is the sensor mode, the rest of the window is in its pixels
+    (void)startY; (void)endX; (void)endY;
+    static const int MODE_WIDTHS[] = {1600, 800, 400};
+    static const int MODE_HEIGHTS[] = {1200, 600, 296};
+    if (startX < 0 || startX > 2 || offsetX < 0 || offsetY < 0 || totalX <= 0 || totalY <= 0 ||
+        offsetX + totalX > MODE_WIDTHS[startX] || offsetY + totalY > MODE_HEIGHTS[startX] ||
+        outputX <= 0 || outputY <= 0 || outputX > totalX || outputY > totalY) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(cameraMutex);
+    window = {true, startX, offsetX, offsetY, totalX, totalY, outputX, outputY};
+    sensor->status.scale = scale;
+    sensor->status.binning = binning;
+    return 0;
+}
+
+int noStatus(sensor_t *sensor) {
+    (void)sensor;
+    return 0;
+}
+
+int getReg(sensor_t *sensor, int reg, int mask) {
+    (void)sensor; (void)reg; (void)mask;
+    return 0;
+}
+
+int setReg(sensor_t *sensor, int reg, int mask, int value) {
+    (void)sensor; (void)reg; (void)mask; (void)value;
+    return 0;
+}
+
+int setPll(sensor_t *sensor, int bypass, int mul, int sys, int root, int pre, int seld5, int pclken, int pclk) {
+    (void)sensor; (void)bypass; (void)mul; (void)sys; (void)root; (void)pre; (void)seld5; (void)pclken; (void)pclk;
+    return 0;
+}
+
+int setXclk(sensor_t *sensor, int timer, int xclk) {
+    (void)timer;
+    sensor->xclk_freq_hz = xclk;
+    return 0;
+}
+
+void resetSensor(const camera_config_t &config) {
+    memset(&fakeSensor, 0, sizeof(fakeSensor));
+    fakeSensor.id.PID = OV2640_PID;
+    fakeSensor.slv_addr = 0x30;
+    fakeSensor.pixformat = config.pixel_format;
+    fakeSensor.xclk_freq_hz = config.xclk_freq_hz;
+    fakeSensor.status.framesize = config.frame_size;
+    fakeSensor.status.quality = config.jpeg_quality;
+    fakeSensor.status.awb = 1;
+    fakeSensor.status.aec = 1;
+    fakeSensor.status.agc = 1;
+
+    fakeSensor.init_status = noStatus;
+    fakeSensor.reset = noStatus;
+    fakeSensor.set_pixformat = setPixformat;
+    fakeSensor.set_framesize = setFramesize;
+    fakeSensor.set_contrast = setContrast;
+    fakeSensor.set_brightness = setBrightness;
+    fakeSensor.set_saturation = setSaturation;
+    fakeSensor.set_sharpness = setSharpness;
+    fakeSensor.set_denoise = setDenoise;
+    fakeSensor.set_gainceiling = setGainCeiling;
+    fakeSensor.set_quality = setQuality;
+    fakeSensor.set_colorbar = setColorbar;
+    fakeSensor.set_whitebal = setWhitebal;
+    fakeSensor.set_gain_ctrl = setGainCtrl;
+    fakeSensor.set_exposure_ctrl = setExposureCtrl;
+    fakeSensor.set_hmirror = setHmirror;
+    fakeSensor.set_vflip = setVflip;
+    fakeSensor.set_aec2 = setAec2;
+    fakeSensor.set_awb_gain = setAwbGain;
+    fakeSensor.set_agc_gain = setAgcGain;
+    fakeSensor.set_aec_value = setAecValue;
+    fakeSensor.set_special_effect = setSpecialEffect;
+    fakeSensor.set_wb_mode = setWbMode;
+    fakeSensor.set_ae_level = setAeLevel;
+    fakeSensor.set_dcw = setDcw;
+    fakeSensor.set_bpc = setBpc;
+    fakeSensor.set_wpc = setWpc;
+    fakeSensor.set_raw_gma = setRawGma;
+    fakeSensor.set_lenc = setLenc;
+    fakeSensor.get_reg = getReg;
+    fakeSensor.set_reg = setReg;
+    fakeSensor.set_res_raw = setResRaw;
+    fakeSensor.set_pll = setPll;
+    fakeSensor.set_xclk = setXclk;
+}
+
+} // namespace
+
+esp_err_t esp_camera_init(const camera_config_t *config) {
+    std::lock_guard<std::mutex> guard(cameraMutex);
+    if (initialised) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (getenv("WEBCAM_NO_CAMERA") != nullptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (config->fb_location == CAMERA_FB_IN_PSRAM && !psramFound()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    activeConfig = *config;
+    resetSensor(activeConfig);
+    loadCorpus();
+    sensorFps = envNumber("WEBCAM_SENSOR_FPS", DEFAULT_SENSOR_FPS);
+    sensorStartUs = esp_timer_get_time();
+    sensorPeriodUs = 0;
+    lastFrameIndex = -1;
+    framesizeFromIndex = 0;
+    window.set = false;
+    poweredDown = false;
+
+    framebuffers.clear();
+    framebuffers.resize(config->fb_count > 0 ? config->fb_count : 1);
+    for (Framebuffer &framebuffer : framebuffers) {
+        memset(&framebuffer.fb, 0, sizeof(framebuffer.fb));
+        framebuffer.inUse = false;
+    }
+
+    initialised = true;
+    Serial.printf("[fake camera] %u fb, %s, %u fps sensor\n", (unsigned)framebuffers.size(),
+                  config->grab_mode == CAMERA_GRAB_LATEST ? "grab latest" : "grab when empty",
+                  (unsigned)sensorFps);
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+    std::lock_guard<std::mutex> guard(cameraMutex);
+    if (!initialised) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    initialised = false;
+    framebuffers.clear();
+    framebufferReturned.notify_all();
+    return ESP_OK;
+}
+
+camera_fb_t *esp_camera_fb_get() {
+    std::unique_lock<std::mutex> lock(cameraMutex);
+    if (!initialised) {
+        return nullptr;
+    }
+
+    // A powered-down sensor sends no frames, so the driver times out
+    if (!framebufferReturned.wait_for(lock, std::chrono::milliseconds(FB_GET_TIMEOUT_MS),
+                                      []() { return !poweredDown || !initialised; }) || !initialised) {
+        return nullptr;
+    }
+
+    Framebuffer *framebuffer = nullptr;
+    auto findFree = [&framebuffer]() {
+        for (Framebuffer &candidate : framebuffers) {
+            if (!candidate.inUse) {
+                framebuffer = &candidate;
+                return true;
+            }
+        }
+        return !initialised;
+    };
+    if (!framebufferReturned.wait_for(lock, std::chrono::milliseconds(FB_GET_TIMEOUT_MS), findFree) ||
+        framebuffer == nullptr) {
+        return nullptr;
+    }
+    framebuffer->inUse = true;
+
+    // Next frame the sensor completes that has not been handed out yet
+    int64_t periodUs = framePeriodUs();
+    if (periodUs != sensorPeriodUs) {
+        // Keep the frame numbering when the mode changes the frame rate
+        if (lastFrameIndex >= 0) {
+            sensorStartUs += (lastFrameIndex + 1) * (sensorPeriodUs - periodUs);
+        }
+        sensorPeriodUs = periodUs;
+    }
+    int64_t completed = (esp_timer_get_time() - sensorStartUs) / periodUs;
+    int64_t index = std::max(completed, lastFrameIndex + 1);
+    lastFrameIndex = index;
+    framesize_t size = index >= framesizeFromIndex ? fakeSensor.status.framesize : previousFramesize;
+    int64_t readyUs = sensorStartUs + index * periodUs;
+    SensorWindow frameWindow = window;
+
+    lock.unlock();
+    int64_t waitUs = readyUs - esp_timer_get_time();
+    if (waitUs > 0) {
+        delayMicroseconds(waitUs);
+    }
+    renderFrame(*framebuffer, (uint32_t)index, size, frameWindow);
+    framebuffer->fb.timestamp.tv_sec = readyUs / 1000000;
+    framebuffer->fb.timestamp.tv_usec = readyUs % 1000000;
+    return &framebuffer->fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb) {
+    std::lock_guard<std::mutex> guard(cameraMutex);
+    for (Framebuffer &framebuffer : framebuffers) {
+        if (&framebuffer.fb == fb) {
+            framebuffer.inUse = false;
+            framebufferReturned.notify_all();
+            return;
+        }
+    }
+}
+
+sensor_t *esp_camera_sensor_get() {
+    return initialised ? &fakeSensor : nullptr;
+}
+
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+             uint8_t **out, size_t *out_len) {
+    if (format != PIXFORMAT_YUV422 || (width & 1) != 0 || src_len < (size_t)width * height * 2) {
+        return false;
+    }
+    std::vector<uint8_t> jpeg;
+    SyntheticJpeg::encodeYuyv(src, width, height, quality, jpeg);
+    *out = (uint8_t *)malloc(jpeg.size());
+    if (*out == nullptr) {
+        return false;
+    }
+    memcpy(*out, jpeg.data(), jpeg.size());
+    *out_len = jpeg.size();
+    return true;
+}
+
+void fakeCameraWritePin(uint8_t pin, uint8_t value) {
+    std::lock_guard<std::mutex> guard(cameraMutex);
+    if (!initialised || activeConfig.pin_pwdn < 0 || pin != activeConfig.pin_pwdn || (value != 0) == poweredDown) {
+        return;
+    }
+    poweredDown = value != 0;
+    if (!poweredDown) {
+        // The sensor starts a new frame as it powers up, keeping the frame numbering
+        if (sensorPeriodUs == 0) {
+            sensorPeriodUs = framePeriodUs();
+        }
+        sensorStartUs = esp_timer_get_time() - lastFrameIndex * sensorPeriodUs;
+        framebufferReturned.notify_all();
+    }
+    Serial.printf("[fake camera] sensor %s\n", poweredDown ? "powered down" : "powered up");
+}
@@ -0,0 +1,821 @@
+#include <Arduino.h>
+#include <esp_http_server.h>
+#include <lwip/sockets.h>
+#include <poll.h>
+#include <strings.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// esp_http_server for the host build. Like the ESP-IDF server it is a single
+// task polling a listening socket plus every open session, calling one URI
+// handler at a time; handlers may take a session's socket over (see
+// httpd_req_to_sockfd) and ask for it to be closed from any task with
+// httpd_sess_trigger_close. Limits from httpd_config_t (max_uri_handlers,
+// max_open_sockets, LRU purging, send/receive timeouts) are enforced so
+// configuration mistakes show up here before they show up on a board.
+//
+// WebSocket endpoints (is_websocket) behave as in ESP-IDF: the server
+// answers the handshake, calls the handler once with HTTP_GET, then calls it
+// with method 0 for every text or binary message, which the handler reads
+// with httpd_ws_recv_frame; httpd_ws_send_frame sends control frames. Pings
+// are answered and a close frame closes the session without involving the
+// handler.
+//
+// Privileged ports are shifted by WEBCAM_PORT_OFFSET (default 8000), so the
+// firmware's port 80 is served on 8080.
+
+namespace {
+
+const size_t MAX_REQUEST_HEADER_BYTES = 8192;
+const size_t MAX_REQUEST_BODY_BYTES = 64 * 1024;
+
+typedef std::vector<std::pair<std::string, std::string>> HeaderList;
+
+struct RegisteredHandler {
+    std::string uri;
+    httpd_uri_t definition;
+};
+
+struct Session {
+    int fd;
+    std::string buffer;
+    int64_t lastUsedUs;
+    bool webSocket;
+    httpd_uri_t webSocketHandler;
+};
+
+struct NativeServer {
+    httpd_config_t config;
+    uint16_t port;
+    int listenFd;
+    int wakePipe[2];
+    volatile bool running;
+    std::vector<RegisteredHandler> handlers;
+    std::vector<Session> sessions;
+    std::mutex pendingMutex;
+    std::vector<int> pendingCloses;
+};
+
+struct NativeRequest {
+    NativeServer *server;
+    int fd;
+    std::string query;
+    HeaderList headers;
+    std::string body;
+    size_t bodyOffset;
+    std::string status;
+    std::string contentType;
+    HeaderList responseHeaders;
+    bool headersSent;
+    httpd_ws_type_t messageType;
+    bool messageFinal;
+    std::string message;
+};
+
+NativeRequest *nativeRequest(httpd_req_t *req) {
+    return static_cast<NativeRequest *>(req->aux);
+}
+
+bool sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+std::string responseHead(NativeRequest *request, const char *lengthHeader) {
+    std::string head = "HTTP/1.1 " + request->status + "\r\n";
+    head += "Content-Type: " + request->contentType + "\r\n";
+    head += lengthHeader;
+    for (const auto &header : request->responseHeaders) {
+        head += header.first + ": " + header.second + "\r\n";
+    }
+    head += "\r\n";
+    return head;
+}
+
+const char *errorStatus(httpd_err_code_t error) {
+    switch (error) {
+        case HTTPD_501_METHOD_NOT_IMPLEMENTED: return "501 Method Not Implemented";
+        case HTTPD_505_VERSION_NOT_SUPPORTED: return "505 Version Not Supported";
+        case HTTPD_400_BAD_REQUEST: return "400 Bad Request";
+        case HTTPD_401_UNAUTHORIZED: return "401 Unauthorized";
+        case HTTPD_403_FORBIDDEN: return "403 Forbidden";
+        case HTTPD_404_NOT_FOUND: return "404 Not Found";
+        case HTTPD_405_METHOD_NOT_ALLOWED: return "405 Method Not Allowed";
+        case HTTPD_408_REQ_TIMEOUT: return "408 Request Timeout";
+        case HTTPD_411_LENGTH_REQUIRED: return "411 Length Required";
+        case HTTPD_414_URI_TOO_LONG: return "414 URI Too Long";
+        case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE: return "431 Request Header Fields Too Large";
+        case HTTPD_500_INTERNAL_SERVER_ERROR:
+        default: return "500 Internal Server Error";
+    }
+}
+
+const char *WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1, only for the Sec-WebSocket-Accept handshake value
+std::string sha1(const std::string &input) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = input;
+    uint64_t bitLength = (uint64_t)input.size() * 8;
+    data += (char)0x80;
+    while (data.size() % 64 != 56) {
+        data += (char)0;
+    }
+    for (int i = 7; i >= 0; i--) {
+        data += (char)(bitLength >> (i * 8));
+    }
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t *bytes = (const uint8_t *)data.data() + block + i * 4;
+            w[i] = (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::string digest;
+    for (int i = 0; i < 5; i++) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            digest += (char)(h[i] >> shift);
+        }
+    }
+    return digest;
+}
+
+std::string base64(const std::string &input) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string output;
+    for (size_t i = 0; i < input.size(); i += 3) {
+        uint32_t group = (uint32_t)(uint8_t)input[i] << 16;
+        if (i + 1 < input.size()) group |= (uint32_t)(uint8_t)input[i + 1] << 8;
+        if (i + 2 < input.size()) group |= (uint8_t)input[i + 2];
+        output += alphabet[(group >> 18) & 0x3F];
+        output += alphabet[(group >> 12) & 0x3F];
+        output += i + 1 < input.size() ? alphabet[(group >> 6) & 0x3F] : '=';
+        output += i + 2 < input.size() ? alphabet[group & 0x3F] : '=';
+    }
+    return output;
+}
+
+const std::string *findHeader(const HeaderList &headers, const char *name) {
+    for (const auto &header : headers) {
+        if (strcasecmp(header.first.c_str(), name) == 0) {
+            return &header.second;
+        }
+    }
+    return nullptr;
+}
+
+bool sendWebSocketFrame(int fd, httpd_ws_type_t type, const std::string &payload) {
+    // Control frames only: payloads are under 126 bytes
+    std::string frame;
+    frame += (char)(0x80 | type);
+    frame += (char)payload.size();
+    frame += payload;
+    return sendAll(fd, frame.data(), frame.size());
+}
+
+int parseMethod(const std::string &name) {
+    if (name == "GET") return HTTP_GET;
+    if (name == "POST") return HTTP_POST;
+    if (name == "PUT") return HTTP_PUT;
+    if (name == "DELETE") return HTTP_DELETE;
+    if (name == "HEAD") return HTTP_HEAD;
+    return -1;
+}
+
+void closeSession(NativeServer *server, int fd) {
+    for (size_t i = 0; i < server->sessions.size(); i++) {
+        if (server->sessions[i].fd == fd) {
+            server->sessions.erase(server->sessions.begin() + i);
+            if (server->config.close_fn != nullptr) {
+                server->config.close_fn(server, fd);
+            } else {
+                close(fd);
+            }
+            return;
+        }
+    }
+}
+
+void acceptSession(NativeServer *server) {
+    int fd = accept(server->listenFd, nullptr, nullptr);
+    if (fd < 0) {
+        return;
+    }
+    if (server->sessions.size() >= server->config.max_open_sockets) {
+        if (!server->config.lru_purge_enable) {
+            close(fd);
+            return;
+        }
+        size_t oldest = 0;
+        for (size_t i = 1; i < server->sessions.size(); i++) {
+            if (server->sessions[i].lastUsedUs < server->sessions[oldest].lastUsedUs) {
+                oldest = i;
+            }
+        }
+        closeSession(server, server->sessions[oldest].fd);
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = server->config.recv_wait_timeout;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    timeout.tv_sec = server->config.send_wait_timeout;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (server->config.open_fn != nullptr && server->config.open_fn(server, fd) != ESP_OK) {
+        close(fd);
+        return;
+    }
+    Session session;
+    session.fd = fd;
+    session.lastUsedUs = esp_timer_get_time();
+    session.webSocket = false;
+    server->sessions.push_back(session);
+}
+
+const httpd_uri_t *findHandler(NativeServer *server, const std::string &path, int method, bool *pathKnown) {
+    *pathKnown = false;
+    for (const RegisteredHandler &handler : server->handlers) {
+        bool matches = server->config.uri_match_fn != nullptr
+            ? server->config.uri_match_fn(handler.uri.c_str(), path.c_str(), path.size())
+            : handler.uri == path;
+        if (!matches) {
+            continue;
+        }
+        *pathKnown = true;
+        if (handler.definition.method == method) {
+            return &handler.definition;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Dispatch one complete WebSocket message from the session buffer.
+ * Returns false while more bytes are needed or if the session was closed.
+ */
+bool handleWebSocketMessage(NativeServer *server, Session *session) {
+    const std::string &buffer = session->buffer;
+    if (buffer.size() < 2) {
+        return false;
+    }
+    uint8_t first = (uint8_t)buffer[0];
+    uint8_t second = (uint8_t)buffer[1];
+    bool masked = (second & 0x80) != 0;
+    uint64_t length = second & 0x7F;
+    size_t position = 2;
+    if (length == 126 || length == 127) {
+        size_t bytes = length == 126 ? 2 : 8;
+        if (buffer.size() < position + bytes) {
+            return false;
+        }
+        length = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            length = (length << 8) | (uint8_t)buffer[position + i];
+        }
+        position += bytes;
+    }
+    if (length > MAX_REQUEST_BODY_BYTES) {
+        closeSession(server, session->fd);
+        return false;
+    }
+    size_t maskPosition = position;
+    if (masked) {
+        position += 4;
+    }
+    if (buffer.size() < position + length) {
+        return false;
+    }
+
+    NativeRequest request;
+    request.server = server;
+    request.fd = session->fd;
+    request.bodyOffset = 0;
+    request.headersSent = true;
+    request.messageType = (httpd_ws_type_t)(first & 0x0F);
+    request.messageFinal = (first & 0x80) != 0;
+    request.message = buffer.substr(position, length);
+    if (masked) {
+        for (size_t i = 0; i < request.message.size(); i++) {
+            request.message[i] ^= buffer[maskPosition + i % 4];
+        }
+    }
+    session->buffer.erase(0, position + length);
+    session->lastUsedUs = esp_timer_get_time();
+
+    int fd = session->fd;
+    switch (request.messageType) {
+        case HTTPD_WS_TYPE_CLOSE:
+            sendWebSocketFrame(fd, HTTPD_WS_TYPE_CLOSE, "");
+            closeSession(server, fd);
+            return false;
+        case HTTPD_WS_TYPE_PING:
+            return sendWebSocketFrame(fd, HTTPD_WS_TYPE_PONG, request.message);
+        case HTTPD_WS_TYPE_PONG:
+            return true;
+        default:
+            break;
+    }
+
+    httpd_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.handle = server;
+    req.method = 0;
+    strncpy(req.uri, session->webSocketHandler.uri, HTTPD_MAX_URI_LEN);
+    req.aux = &request;
+    req.user_ctx = session->webSocketHandler.user_ctx;
+    if (session->webSocketHandler.handler(&req) != ESP_OK) {
+        closeSession(server, fd);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Answer a WebSocket handshake and call the handler for the new connection.
+ */
+esp_err_t openWebSocket(Session *session, NativeRequest *request, httpd_req_t *req, const httpd_uri_t *handler) {
+    const std::string *upgrade = findHeader(request->headers, "Upgrade");
+    const std::string *key = findHeader(request->headers, "Sec-WebSocket-Key");
+    if (upgrade == nullptr || strcasecmp(upgrade->c_str(), "websocket") != 0 || key == nullptr) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "WebSocket handshake expected");
+        return ESP_FAIL;
+    }
+
+    std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: " + base64(sha1(*key + WEBSOCKET_GUID)) + "\r\n"
+        "\r\n";
+    if (!sendAll(request->fd, response.data(), response.size())) {
+        return ESP_FAIL;
+    }
+    request->headersSent = true;
+    session->webSocket = true;
+    session->webSocketHandler = *handler;
+    return handler->handler(req);
+}
+
+/**
+ * Parse and dispatch one complete request from the session buffer.
+ * Returns false while more bytes are needed or if the session was closed.
+ */
+bool handleRequest(NativeServer *server, int fd) {
+    Session *session = nullptr;
+    for (Session &candidate : server->sessions) {
+        if (candidate.fd == fd) {
+            session = &candidate;
+        }
+    }
+    if (session == nullptr) {
+        return false;
+    }
+    if (session->webSocket) {
+        return handleWebSocketMessage(server, session);
+    }
+
+    size_t headerEnd = session->buffer.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) {
+        if (session->buffer.size() > MAX_REQUEST_HEADER_BYTES) {
+            closeSession(server, fd);
+        }
+        return false;
+    }
+
+    NativeRequest request;
+    request.server = server;
+    request.fd = fd;
+    request.bodyOffset = 0;
+    request.status = HTTPD_200;
+    request.contentType = "text/html";
+    request.headersSent = false;
+
+    std::string head = session->buffer.substr(0, headerEnd);
+    size_t lineEnd = head.find("\r\n");
+    std::string requestLine = head.substr(0, lineEnd);
+    size_t firstSpace = requestLine.find(' ');
+    size_t secondSpace = requestLine.find(' ', firstSpace + 1);
+    if (firstSpace == std::string::npos || secondSpace == std::string::npos) {
+        closeSession(server, fd);
+        return false;
+    }
+    std::string methodName = requestLine.substr(0, firstSpace);
+    std::string uri = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+
+    size_t position = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+    size_t contentLength = 0;
+    while (position < head.size()) {
+        size_t next = head.find("\r\n", position);
+        if (next == std::string::npos) {
+            next = head.size();
+        }
+        std::string line = head.substr(position, next - position);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            request.headers.push_back(std::make_pair(line.substr(0, colon), value));
+            if (strcasecmp(line.substr(0, colon).c_str(), "Content-Length") == 0) {
+                contentLength = strtoul(value.c_str(), nullptr, 10);
+            }
+        }
+        position = next + 2;
+    }
+
+    if (contentLength > MAX_REQUEST_BODY_BYTES) {
+        closeSession(server, fd);
+        return false;
+    }
+    if (session->buffer.size() < headerEnd + 4 + contentLength) {
+        return false;
+    }
+    request.body = session->buffer.substr(headerEnd + 4, contentLength);
+    session->buffer.erase(0, headerEnd + 4 + contentLength);
+    session->lastUsedUs = esp_timer_get_time();
+
+    size_t queryStart = uri.find('?');
+    std::string path = uri.substr(0, queryStart);
+    if (queryStart != std::string::npos) {
+        request.query = uri.substr(queryStart + 1);
+    }
+
+    httpd_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.handle = server;
+    req.method = parseMethod(methodName);
+    strncpy(req.uri, uri.c_str(), HTTPD_MAX_URI_LEN);
+    req.content_len = contentLength;
+    req.aux = &request;
+
+    bool pathKnown;
+    const httpd_uri_t *handler = findHandler(server, path, req.method, &pathKnown);
+    esp_err_t result;
+    if (handler == nullptr) {
+        httpd_resp_send_err(&req, pathKnown ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, nullptr);
+        result = ESP_OK;
+    } else if (handler->is_websocket) {
+        req.user_ctx = handler->user_ctx;
+        result = openWebSocket(session, &request, &req, handler);
+    } else {
+        req.user_ctx = handler->user_ctx;
+        result = handler->handler(&req);
+    }
+
+    if (result != ESP_OK) {
+        // The IDF server closes the session when a handler fails
+        closeSession(server, fd);
+        return false;
+    }
+    return true;
+}
+
+void readSession(NativeServer *server, int fd) {
+    char chunk[2048];
+    ssize_t received = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (received <= 0) {
+        closeSession(server, fd);
+        return;
+    }
+    for (Session &session : server->sessions) {
+        if (session.fd == fd) {
+            session.buffer.append(chunk, received);
+            break;
+        }
+    }
+    while (handleRequest(server, fd)) {
+    }
+}
+
+void serverTask(void *parameter) {
+    NativeServer *server = static_cast<NativeServer *>(parameter);
+    std::vector<struct pollfd> polls;
+
+    while (server->running) {
+        polls.clear();
+        polls.push_back({server->wakePipe[0], POLLIN, 0});
+        bool acceptWanted = server->config.lru_purge_enable ||
+                            server->sessions.size() < server->config.max_open_sockets;
+        polls.push_back({acceptWanted ? server->listenFd : -1, POLLIN, 0});
+        for (const Session &session : server->sessions) {
+            polls.push_back({session.fd, POLLIN, 0});
+        }
+
+        if (poll(polls.data(), polls.size(), 1000) <= 0) {
+            continue;
+        }
+
+        if (polls[0].revents & POLLIN) {
+            char drain[64];
+            while (read(server->wakePipe[0], drain, sizeof(drain)) == (ssize_t)sizeof(drain)) {
+            }
+            std::vector<int> closes;
+            {
+                std::lock_guard<std::mutex> guard(server->pendingMutex);
+                closes.swap(server->pendingCloses);
+            }
+            for (int fd : closes) {
+                closeSession(server, fd);
+            }
+        }
+
+        for (size_t i = 2; i < polls.size(); i++) {
+            if (polls[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                readSession(server, polls[i].fd);
+            }
+        }
+
+        if (polls[1].revents & POLLIN) {
+            acceptSession(server);
+        }
+    }
+    vTaskDelete(nullptr);
+}
+
+esp_err_t copyValue(const std::string &value, char *buffer, size_t size) {
+    if (size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strncpy(buffer, value.c_str(), size - 1);
+    buffer[size - 1] = '\0';
+    return value.size() >= size ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+} // namespace
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    NativeServer *server = new NativeServer();
+    server->config = *config;
+    server->running = true;
+
+    const char *offsetSetting = getenv("WEBCAM_PORT_OFFSET");
+    uint16_t offset = offsetSetting != nullptr ? (uint16_t)atoi(offsetSetting) : 8000;
+    server->port = config->server_port < 1024 ? config->server_port + offset : config->server_port;
+
+    server->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(server->listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(server->port);
+    if (bind(server->listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server->listenFd, config->backlog_conn) != 0 ||
+        pipe(server->wakePipe) != 0) {
+        Serial.printf("[fake httpd] cannot listen on port %u: %s\n", server->port, strerror(errno));
+        close(server->listenFd);
+        delete server;
+        return ESP_ERR_HTTPD_TASK;
+    }
+    fcntl(server->wakePipe[0], F_SETFL, O_NONBLOCK);
+
+    if (xTaskCreatePinnedToCore(serverTask, "httpd", config->stack_size, server, config->task_priority,
+                                nullptr, config->core_id) != pdPASS) {
+        return ESP_ERR_HTTPD_TASK;
+    }
+    Serial.printf("[fake httpd] listening on http://127.0.0.1:%u/\n", server->port);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    NativeServer *server = static_cast<NativeServer *>(handle);
+    if (server == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The server object is left allocated; the task may still be polling
+    server->running = false;
+    (void)!write(server->wakePipe[1], "x", 1);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+    NativeServer *server = static_cast<NativeServer *>(handle);
+    for (const RegisteredHandler &handler : server->handlers) {
+        if (handler.uri == uri_handler->uri && handler.definition.method == uri_handler->method) {
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (server->handlers.size() >= server->config.max_uri_handlers) {
+        Serial.printf("[fake httpd] no slot left for %s (max_uri_handlers = %u)\n",
+                      uri_handler->uri, server->config.max_uri_handlers);
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    RegisteredHandler handler;
+    handler.uri = uri_handler->uri;
+    handler.definition = *uri_handler;
+    server->handlers.push_back(handler);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status) {
+    nativeRequest(req)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type) {
+    nativeRequest(req)->contentType = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value) {
+    NativeRequest *request = nativeRequest(req);
+    if (request->responseHeaders.size() >= request->server->config.max_resp_headers) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    request->responseHeaders.push_back(std::make_pair(std::string(field), std::string(value)));
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+    NativeRequest *request = nativeRequest(req);
+    size_t length = buf_len == HTTPD_RESP_USE_STRLEN ? (buf ? strlen(buf) : 0) : (size_t)buf_len;
+    char lengthHeader[48];
+    snprintf(lengthHeader, sizeof(lengthHeader), "Content-Length: %u\r\n", (unsigned)length);
+
+    std::string response = responseHead(request, lengthHeader);
+    if (length > 0) {
+        response.append(buf, length);
+    }
+    request->headersSent = true;
+    return sendAll(request->fd, response.data(), response.size()) ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+    NativeRequest *request = nativeRequest(req);
+    size_t length = buf == nullptr ? 0 : (buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len);
+
+    std::string data;
+    if (!request->headersSent) {
+        data = responseHead(request, "Transfer-Encoding: chunked\r\n");
+        request->headersSent = true;
+    }
+    char size[16];
+    snprintf(size, sizeof(size), "%x\r\n", (unsigned)length);
+    data += size;
+    if (length > 0) {
+        data.append(buf, length);
+    }
+    data += "\r\n";
+    return sendAll(request->fd, data.data(), data.size()) ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *req, const char *str) {
+    return httpd_resp_send(req, str, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *message) {
+    NativeRequest *request = nativeRequest(req);
+    const char *status = errorStatus(error);
+    request->status = status;
+    request->contentType = "text/html";
+    return httpd_resp_send(req, message != nullptr ? message : status, HTTPD_RESP_USE_STRLEN);
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *req) {
+    return nativeRequest(req)->query.size();
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t buf_len) {
+    const std::string &query = nativeRequest(req)->query;
+    if (query.empty()) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return copyValue(query, buf, buf_len);
+}
+
+esp_err_t httpd_query_key_value(const char *query, const char *key, char *val, size_t val_size) {
+    std::string text = query;
+    std::string wanted = key;
+    size_t position = 0;
+    while (position <= text.size()) {
+        size_t end = text.find('&', position);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string pair = text.substr(position, end - position);
+        size_t equals = pair.find('=');
+        if (pair.substr(0, equals) == wanted) {
+            return copyValue(equals == std::string::npos ? "" : pair.substr(equals + 1), val, val_size);
+        }
+        position = end + 1;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *req, const char *field) {
+    for (const auto &header : nativeRequest(req)->headers) {
+        if (strcasecmp(header.first.c_str(), field) == 0) {
+            return header.second.size();
+        }
+    }
+    return 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size) {
+    for (const auto &header : nativeRequest(req)->headers) {
+        if (strcasecmp(header.first.c_str(), field) == 0) {
+            return copyValue(header.second, val, val_size);
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len) {
+    NativeRequest *request = nativeRequest(req);
+    size_t available = request->body.size() - request->bodyOffset;
+    size_t count = available < buf_len ? available : buf_len;
+    memcpy(buf, request->body.data() + request->bodyOffset, count);
+    request->bodyOffset += count;
+    return (int)count;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len) {
+    NativeRequest *request = nativeRequest(req);
+    frame->type = request->messageType;
+    frame->final = request->messageFinal;
+    frame->fragmented = false;
+    frame->len = request->message.size();
+    if (max_len == 0) {
+        return ESP_OK;
+    }
+    if (max_len < frame->len || frame->payload == nullptr) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(frame->payload, request->message.data(), frame->len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame) {
+    if (frame->len >= 126) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    std::string payload((const char *)frame->payload, frame->len);
+    return sendWebSocketFrame(nativeRequest(req)->fd, frame->type, payload) ? ESP_OK : ESP_FAIL;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *req) {
+    return nativeRequest(req)->fd;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+    NativeServer *server = static_cast<NativeServer *>(handle);
+    {
+        std::lock_guard<std::mutex> guard(server->pendingMutex);
+        server->pendingCloses.push_back(sockfd);
+    }
+    (void)!write(server->wakePipe[1], "x", 1);
+    return ESP_OK;
+}
@@ -0,0 +1,238 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Arduino core, ESP system and heap functions for the host build.
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+
+namespace {
+
+const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+// Nominal ESP32-CAM figures so heap gauges and heartbeats look plausible
+const uint32_t SIMULATED_HEAP_BYTES = 320 * 1024;
+const uint32_t SIMULATED_PSRAM_BYTES = 4 * 1024 * 1024;
+
+// WEBCAM_WIFI_OUTAGE=<period>,<length> drops the station for the last
+// <length> seconds of every <period> seconds of uptime
+bool inWiFiOutage() {
+    static unsigned periodSeconds = 0;
+    static unsigned lengthSeconds = 0;
+    static std::once_flag parsed;
+    std::call_once(parsed, [] {
+        const char *setting = getenv("WEBCAM_WIFI_OUTAGE");
+        if (setting != nullptr && sscanf(setting, "%u,%u", &periodSeconds, &lengthSeconds) != 2) {
+            periodSeconds = 0;
+        }
+        if (lengthSeconds >= periodSeconds) {
+            periodSeconds = 0;
+        }
+    });
+    if (periodSeconds == 0) {
+        return false;
+    }
+    uint64_t periodMs = periodSeconds * 1000ULL;
+    return millis() % periodMs >= periodMs - lengthSeconds * 1000ULL;
+}
+
+struct WiFiListener {
+    WiFiEventCb callback;
+    arduino_event_id_t event;
+};
+
+std::mutex listenerMutex;
+std::vector<WiFiListener> wifiListeners;
+
+void notifyWiFiListeners(arduino_event_id_t event) {
+    std::vector<WiFiListener> listeners;
+    {
+        std::lock_guard<std::mutex> guard(listenerMutex);
+        listeners = wifiListeners;
+    }
+    for (const WiFiListener &listener : listeners) {
+        if (listener.event == event || listener.event == ARDUINO_EVENT_MAX) {
+            listener.callback(event);
+        }
+    }
+}
+
+// Stands in for the Arduino event task: reports outages starting and ending
+void watchWiFi() {
+    bool connected = WiFi.status() == WL_CONNECTED;
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        bool now = WiFi.status() == WL_CONNECTED;
+        if (now != connected) {
+            connected = now;
+            notifyWiFiListeners(now ? ARDUINO_EVENT_WIFI_STA_GOT_IP : ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+        }
+    }
+}
+
+bool psramEnabled() {
+    const char *setting = getenv("WEBCAM_PSRAM");
+    return setting == nullptr || strcmp(setting, "0") != 0;
+}
+
+} // namespace
+
+int WiFiClass::status() {
+    return inWiFiOutage() ? WL_DISCONNECTED : WL_CONNECTED;
+}
+
+int WiFiClass::onEvent(WiFiEventCb callback, arduino_event_id_t event) {
+    static std::once_flag started;
+    std::call_once(started, [] { std::thread(watchWiFi).detach(); });
+
+    std::lock_guard<std::mutex> guard(listenerMutex);
+    wifiListeners.push_back({callback, event});
+    return (int)wifiListeners.size();
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    size_t written = fwrite(buffer, 1, size, stdout);
+    fflush(stdout);
+    return written;
+}
+
+size_t Print::printf(const char *format, ...) {
+    char stackBuffer[256];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, arguments);
+    va_end(arguments);
+    if (length < 0) {
+        return 0;
+    }
+    if ((size_t)length < sizeof(stackBuffer)) {
+        return write((const uint8_t *)stackBuffer, length);
+    }
+
+    std::string heapBuffer(length + 1, '\0');
+    va_start(arguments, format);
+    vsnprintf(&heapBuffer[0], heapBuffer.size(), format, arguments);
+    va_end(arguments);
+    return write((const uint8_t *)heapBuffer.data(), length);
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return SIMULATED_HEAP_BYTES / 2;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return SIMULATED_HEAP_BYTES / 3;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return SIMULATED_HEAP_BYTES / 4;
+}
+
+uint32_t EspClass::getPsramSize() {
+    return psramEnabled() ? SIMULATED_PSRAM_BYTES : 0;
+}
+
+uint32_t EspClass::getFreePsram() {
+    return psramEnabled() ? SIMULATED_PSRAM_BYTES / 2 : 0;
+}
+
+uint32_t EspClass::getMinFreePsram() {
+    return psramEnabled() ? SIMULATED_PSRAM_BYTES / 3 : 0;
+}
+
+void EspClass::restart() {
+    esp_restart();
+}
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+uint32_t esp_random() {
+    static std::mt19937 generator(std::random_device{}());
+    static std::mutex generatorMutex;
+    std::lock_guard<std::mutex> guard(generatorMutex);
+    return generator();
+}
+
+void esp_restart() {
+    Serial.println("Restart requested - exiting");
+    fflush(stdout);
+    _exit(0);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+    (void)caps;
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? ESP.getFreePsram() : ESP.getFreeHeap();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? ESP.getMinFreePsram() : ESP.getMinFreeHeap();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? ESP.getFreePsram() / 2 : ESP.getMaxAllocHeap();
+}
+
+unsigned long millis() {
+    return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)esp_timer_get_time();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+// FakeCamera.cpp: the sensor's PWDN line
+void fakeCameraWritePin(uint8_t pin, uint8_t value);
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    fakeCameraWritePin(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+    // Buttons are pull-ups, so an unpressed pin reads high
+    (void)pin;
+    return HIGH;
+}
+
+bool psramFound() {
+    return psramEnabled();
+}
+
+void *ps_malloc(size_t size) {
+    return psramEnabled() ? malloc(size) : nullptr;
+}
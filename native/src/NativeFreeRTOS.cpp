@@ -0,0 +1,379 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <freertos/event_groups.h>
+#include <esp_timer.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+// FreeRTOS on std::thread. Every task is a detached thread with its own
+// notification counter; semaphores, queues and event groups are a mutex
+// plus a condition variable. Priorities and core affinity are recorded for
+// reporting but not enforced - the host scheduler decides.
+
+struct NativeTask {
+    std::string name;
+    uint32_t stackDepth;
+    UBaseType_t priority;
+    BaseType_t coreId;
+    UBaseType_t number;
+    pthread_t thread;
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifyValue = 0;
+};
+
+struct NativeSemaphore {
+    std::mutex mutex;
+    std::condition_variable available;
+    UBaseType_t count;
+    UBaseType_t maxCount;
+};
+
+struct NativeQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+struct NativeEventGroup {
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+namespace {
+
+std::mutex registryMutex;
+std::vector<NativeTask *> tasks;
+UBaseType_t nextTaskNumber = 1;
+thread_local NativeTask *currentTask = nullptr;
+
+struct TaskStart {
+    NativeTask *task;
+    TaskFunction_t function;
+    void *parameter;
+};
+
+NativeTask *registerTask(const char *name, uint32_t stackDepth, UBaseType_t priority, BaseType_t coreId) {
+    NativeTask *task = new NativeTask();
+    task->name = name ? name : "";
+    task->stackDepth = stackDepth;
+    task->priority = priority;
+    task->coreId = coreId;
+    task->thread = pthread_self();
+
+    std::lock_guard<std::mutex> guard(registryMutex);
+    task->number = nextTaskNumber++;
+    tasks.push_back(task);
+    return task;
+}
+
+void unregisterTask(NativeTask *task) {
+    std::lock_guard<std::mutex> guard(registryMutex);
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (tasks[i] == task) {
+            tasks.erase(tasks.begin() + i);
+            break;
+        }
+    }
+    // Handles may still be held by other tasks, so the object is kept
+}
+
+void *runTask(void *argument) {
+    TaskStart *start = static_cast<TaskStart *>(argument);
+    currentTask = start->task;
+    currentTask->thread = pthread_self();
+    TaskFunction_t function = start->function;
+    void *parameter = start->parameter;
+    delete start;
+
+    function(parameter);
+
+    // A FreeRTOS task must never return; treat it as deleting itself
+    unregisterTask(currentTask);
+    return nullptr;
+}
+
+NativeTask *current() {
+    if (currentTask == nullptr) {
+        // The main thread (Arduino's loopTask) is registered on first use
+        currentTask = registerTask("loopTask", 8192, 1, 1);
+    }
+    return currentTask;
+}
+
+template <typename Lock, typename Predicate>
+bool waitFor(std::condition_variable &condition, Lock &lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        condition.wait(lock, ready);
+        return true;
+    }
+    return condition.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+uint32_t threadCpuTimeUs(pthread_t thread) {
+    clockid_t clock;
+    struct timespec now;
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &now) != 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000);
+}
+
+} // namespace
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth,
+                                   void *parameter, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t coreId) {
+    NativeTask *task = registerTask(name, stackDepth, priority, coreId);
+    if (handle != nullptr) {
+        *handle = task;
+    }
+
+    TaskStart *start = new TaskStart{task, function, parameter};
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int result = pthread_create(&thread, &attributes, runTask, start);
+    pthread_attr_destroy(&attributes);
+    if (result != 0) {
+        delete start;
+        unregisterTask(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth,
+                       void *parameter, UBaseType_t priority, TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != nullptr && task != currentTask) {
+        // Deleting another task is not needed by the firmware
+        return;
+    }
+    unregisterTask(current());
+    pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t increment) {
+    *previousWakeTime += increment;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*previousWakeTime - now) > 0) {
+        vTaskDelay(*previousWakeTime - now);
+    }
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current();
+}
+
+const char *pcTaskGetName(TaskHandle_t task) {
+    return (task != nullptr ? task : current())->name.c_str();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    // Host stacks are not instrumented; report the requested depth as unused
+    return (task != nullptr ? task : current())->stackDepth;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+    std::lock_guard<std::mutex> guard(registryMutex);
+    return tasks.size();
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *statuses, UBaseType_t size, uint32_t *totalRunTime) {
+    std::lock_guard<std::mutex> guard(registryMutex);
+    if (size < tasks.size()) {
+        return 0;
+    }
+    for (size_t i = 0; i < tasks.size(); i++) {
+        NativeTask *task = tasks[i];
+        TaskStatus_t &status = statuses[i];
+        status.xHandle = task;
+        status.pcTaskName = task->name.c_str();
+        status.xTaskNumber = task->number;
+        status.eCurrentState = task == currentTask ? eRunning : eBlocked;
+        status.uxCurrentPriority = task->priority;
+        status.uxBasePriority = task->priority;
+        status.ulRunTimeCounter = threadCpuTimeUs(task->thread);
+        status.pxStackBase = nullptr;
+        status.usStackHighWaterMark = task->stackDepth;
+        status.xCoreID = task->coreId;
+    }
+    if (totalRunTime != nullptr) {
+        *totalRunTime = (uint32_t)esp_timer_get_time();
+    }
+    return tasks.size();
+}
+
+BaseType_t xPortGetCoreID() {
+    BaseType_t core = current()->coreId;
+    return core == tskNO_AFFINITY ? 0 : core;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> guard(task->mutex);
+    task->notifyValue++;
+    task->notified.notify_all();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    NativeTask *task = current();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    waitFor(task->notified, lock, ticks, [task] { return task->notifyValue > 0; });
+    uint32_t value = task->notifyValue;
+    if (value > 0) {
+        task->notifyValue = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    NativeSemaphore *semaphore = new NativeSemaphore();
+    semaphore->count = initialCount;
+    semaphore->maxCount = maxCount;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    if (!waitFor(semaphore->available, lock, ticks, [semaphore] { return semaphore->count > 0; })) {
+        return pdFALSE;
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->mutex);
+    if (semaphore->count >= semaphore->maxCount) {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->available.notify_one();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    NativeQueue *queue = new NativeQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->changed, lock, ticks, [queue] { return queue->items.size() < queue->length; })) {
+        return errQUEUE_FULL;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return xQueueSendToBack(queue, item, ticks);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    std::lock_guard<std::mutex> guard(queue->mutex);
+    const uint8_t *bytes = static_cast<const uint8_t *>(item);
+    queue->items.clear();
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->changed, lock, ticks, [queue] { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->mutex);
+    return queue->items.size();
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new NativeEventGroup();
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> guard(group->mutex);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> guard(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> guard(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto satisfied = [group, bits, waitForAll] {
+        return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool met = waitFor(group->changed, lock, ticks, satisfied);
+    EventBits_t value = group->bits;
+    if (met && clearOnExit) {
+        group->bits &= ~bits;
+    }
+    return value;
+}
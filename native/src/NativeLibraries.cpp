@@ -0,0 +1,116 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include "ConfigurationManager.h"
+#include "MqttHandler.h"
+#include "WiFiManager.h"
+
+// Stand-ins for the bottlehall configuration, Wi-Fi and MQTT libraries.
+
+DeviceConfig ConfigurationManager::config;
+uint16_t MqttHandler::bufferSize = 2048;
+bool MqttHandler::connected = false;
+uint32_t MqttHandler::publishCount = 0;
+
+namespace {
+
+String envString(const char *name, const char *defaultValue) {
+    const char *value = getenv(name);
+    return String(value != nullptr ? value : defaultValue);
+}
+
+} // namespace
+
+void ConfigurationManager::setup() {
+    config.uuid = envString("WEBCAM_UUID", "native-webcam");
+    config.mqttClientName = envString("WEBCAM_MQTT_CLIENT", "esp32-web-cam-native");
+    config.wifiSSID = "host";
+    config.wifiPassword = "";
+    config.mqttServer = envString("WEBCAM_MQTT_SERVER", "127.0.0.1");
+    config.mqttPort = atoi(envString("WEBCAM_MQTT_PORT", "1883").c_str());
+    config.mqttUsername = "";
+    config.mqttPassword = "";
+    config.bootCount = 0;
+    config.wifiTimeoutSeconds = 10;
+    config.mqttTimeoutSeconds = 5;
+}
+
+void ConfigurationManager::incrementBootCount() {
+    config.bootCount++;
+}
+
+DeviceConfig ConfigurationManager::getConfig() {
+    return config;
+}
+
+void WiFiManager::setupLowPower(WiFiPowerMode mode) {
+    (void)mode;
+}
+
+bool WiFiManager::connectQuick(int timeoutSeconds) {
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start < (unsigned long)timeoutSeconds * 1000) {
+        delay(100);
+    }
+    return WiFi.status() == WL_CONNECTED;
+}
+
+bool WiFiManager::isConnected() {
+    return WiFi.status() == WL_CONNECTED;
+}
+
+String WiFiManager::getIPAddress() {
+    return WiFi.localIP().toString();
+}
+
+void MqttHandler::setBufferSize(uint16_t size) {
+    bufferSize = size;
+}
+
+void MqttHandler::setup(int lightPin) {
+    (void)lightPin;
+}
+
+bool MqttHandler::connect(int timeoutSeconds) {
+    // Without Wi-Fi the library keeps trying until the timeout
+    if (WiFi.status() != WL_CONNECTED) {
+        delay(timeoutSeconds * 1000);
+        connected = false;
+        return false;
+    }
+    connected = true;
+    return true;
+}
+
+bool MqttHandler::isConnected() {
+    if (WiFi.status() != WL_CONNECTED) {
+        connected = false;
+    }
+    return connected;
+}
+
+void MqttHandler::loop() {
+}
+
+bool MqttHandler::publish(const char *topic, const String &payload) {
+    if (!isConnected()) {
+        return false;
+    }
+    // PubSubClient drops anything larger than its buffer; so does the fake
+    size_t packetSize = 5 + 2 + strlen(topic) + payload.length();
+    if (packetSize > bufferSize) {
+        Serial.printf("[fake mqtt] dropped %s: %u bytes exceeds buffer of %u\n",
+                      topic, (unsigned)packetSize, bufferSize);
+        return false;
+    }
+    publishCount++;
+    Serial.printf("MQTT %s %s\n", topic, payload.c_str());
+    return true;
+}
+
+bool MqttHandler::publish(const String &topic, const String &payload) {
+    return publish(topic.c_str(), payload);
+}
+
+uint32_t MqttHandler::getPublishCount() {
+    return publishCount;
+}
@@ -0,0 +1,15 @@
+#include <Arduino.h>
+#include <signal.h>
+
+// Program entry point for the simulated device: drives setup() and loop()
+// like the Arduino task does on the board.
+
+int main() {
+    // Clients disconnecting mid-send must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    setup();
+    for (;;) {
+        loop();
+    }
+}
@@ -0,0 +1,134 @@
+#include <Preferences.h>
+
+// Namespaces are kept in memory for the lifetime of the process, which is
+// enough to exercise code that persists settings and reads them back.
+
+namespace {
+
+std::mutex storeMutex;
+std::map<std::string, std::map<std::string, std::vector<uint8_t>>> store;
+
+} // namespace
+
+bool Preferences::begin(const char *name, bool readOnlyMode) {
+    std::lock_guard<std::mutex> guard(storeMutex);
+    current = &store[name];
+    readOnly = readOnlyMode;
+    return true;
+}
+
+void Preferences::end() {
+    current = nullptr;
+}
+
+bool Preferences::clear() {
+    std::lock_guard<std::mutex> guard(storeMutex);
+    if (current == nullptr || readOnly) {
+        return false;
+    }
+    current->clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key) {
+    std::lock_guard<std::mutex> guard(storeMutex);
+    if (current == nullptr || readOnly) {
+        return false;
+    }
+    return current->erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+    return find(key) != nullptr;
+}
+
+size_t Preferences::put(const char *key, const void *value, size_t length) {
+    std::lock_guard<std::mutex> guard(storeMutex);
+    if (current == nullptr || readOnly) {
+        return 0;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(value);
+    (*current)[key] = Value(bytes, bytes + length);
+    return length;
+}
+
+const Preferences::Value *Preferences::find(const char *key) {
+    std::lock_guard<std::mutex> guard(storeMutex);
+    if (current == nullptr) {
+        return nullptr;
+    }
+    auto entry = current->find(key);
+    return entry == current->end() ? nullptr : &entry->second;
+}
+
+size_t Preferences::putBool(const char *key, bool value) {
+    uint8_t stored = value ? 1 : 0;
+    return put(key, &stored, sizeof(stored));
+}
+
+size_t Preferences::putUChar(const char *key, uint8_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putInt(const char *key, int32_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putString(const char *key, const String &value) {
+    return put(key, value.c_str(), value.length());
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length) {
+    return put(key, value, length);
+}
+
+bool Preferences::getBool(const char *key, bool defaultValue) {
+    const Value *value = find(key);
+    return value != nullptr && value->size() == 1 ? (*value)[0] != 0 : defaultValue;
+}
+
+uint8_t Preferences::getUChar(const char *key, uint8_t defaultValue) {
+    const Value *value = find(key);
+    return value != nullptr && value->size() == 1 ? (*value)[0] : defaultValue;
+}
+
+int32_t Preferences::getInt(const char *key, int32_t defaultValue) {
+    const Value *value = find(key);
+    int32_t result = defaultValue;
+    if (value != nullptr && value->size() == sizeof(result)) {
+        memcpy(&result, value->data(), sizeof(result));
+    }
+    return result;
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue) {
+    const Value *value = find(key);
+    uint32_t result = defaultValue;
+    if (value != nullptr && value->size() == sizeof(result)) {
+        memcpy(&result, value->data(), sizeof(result));
+    }
+    return result;
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) {
+    const Value *value = find(key);
+    return value != nullptr ? String(std::string(value->begin(), value->end())) : defaultValue;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+    const Value *value = find(key);
+    return value != nullptr ? value->size() : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength) {
+    const Value *value = find(key);
+    if (value == nullptr || value->size() > maxLength) {
+        return 0;
+    }
+    memcpy(buffer, value->data(), value->size());
+    return value->size();
+}
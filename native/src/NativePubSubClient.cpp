@@ -0,0 +1,309 @@
+#include <PubSubClient.h>
+
+// Minimal MQTT 3.1.1 client matching the parts of PubSubClient the
+// firmware uses. Only QoS 0 is supported, which is all the firmware sends.
+
+namespace {
+
+const uint8_t CONNECT = 0x10;
+const uint8_t CONNACK = 0x20;
+const uint8_t PUBLISH = 0x30;
+const uint8_t SUBSCRIBE = 0x82;
+const uint8_t PINGREQ = 0xc0;
+const uint8_t PINGRESP = 0xd0;
+const uint8_t DISCONNECT = 0xe0;
+
+size_t putString(uint8_t *cursor, const char *text) {
+    size_t length = strlen(text);
+    cursor[0] = length >> 8;
+    cursor[1] = length & 0xff;
+    memcpy(cursor + 2, text, length);
+    return length + 2;
+}
+
+} // namespace
+
+PubSubClient::PubSubClient(Client &client)
+    : client(&client), domain(nullptr), port(1883), callback(nullptr), buffer(nullptr), bufferSize(0),
+      keepAlive(MQTT_KEEPALIVE), socketTimeout(MQTT_SOCKET_TIMEOUT), nextPacketId(1),
+      lastOutActivity(0), lastInActivity(0), pingOutstanding(false), status(MQTT_DISCONNECTED) {
+    setBufferSize(MQTT_MAX_PACKET_SIZE);
+}
+
+PubSubClient::~PubSubClient() {
+    free(buffer);
+}
+
+PubSubClient &PubSubClient::setServer(const char *serverDomain, uint16_t serverPort) {
+    domain = serverDomain;
+    port = serverPort;
+    return *this;
+}
+
+PubSubClient &PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+    this->callback = callback;
+    return *this;
+}
+
+PubSubClient &PubSubClient::setKeepAlive(uint16_t seconds) {
+    keepAlive = seconds;
+    return *this;
+}
+
+PubSubClient &PubSubClient::setSocketTimeout(uint16_t seconds) {
+    socketTimeout = seconds;
+    return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+    if (size == 0) {
+        return false;
+    }
+    uint8_t *resized = (uint8_t *)realloc(buffer, size);
+    if (resized == nullptr) {
+        return false;
+    }
+    buffer = resized;
+    bufferSize = size;
+    return true;
+}
+
+uint16_t PubSubClient::getBufferSize() {
+    return bufferSize;
+}
+
+size_t PubSubClient::writeHeader(uint8_t type, size_t length, uint8_t *header) {
+    size_t count = 0;
+    header[count++] = type;
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        header[count++] = digit | (length > 0 ? 0x80 : 0);
+    } while (length > 0);
+    return count;
+}
+
+bool PubSubClient::sendPacket(uint8_t type, const uint8_t *body, size_t length) {
+    uint8_t header[5];
+    size_t headerLength = writeHeader(type, length, header);
+    bool ok = client->write(header, headerLength) == headerLength &&
+              (length == 0 || client->write(body, length) == length);
+    lastOutActivity = millis();
+    return ok;
+}
+
+bool PubSubClient::readByte(uint8_t *value) {
+    unsigned long start = millis();
+    while (client->connected()) {
+        int result = client->read();
+        if (result >= 0) {
+            *value = (uint8_t)result;
+            return true;
+        }
+        if (millis() - start >= (unsigned long)socketTimeout * 1000) {
+            return false;
+        }
+        delay(1);
+    }
+    return false;
+}
+
+bool PubSubClient::readPacket(uint8_t *type, size_t *length, bool *truncated) {
+    uint8_t value;
+    if (!readByte(type)) {
+        return false;
+    }
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    do {
+        if (!readByte(&value)) {
+            return false;
+        }
+        remaining += (value & 0x7f) * multiplier;
+        multiplier *= 128;
+    } while (value & 0x80);
+
+    // Like PubSubClient, packets larger than the buffer are read and dropped
+    *truncated = remaining > bufferSize;
+    for (size_t i = 0; i < remaining; i++) {
+        if (!readByte(&value)) {
+            return false;
+        }
+        if (!*truncated) {
+            buffer[i] = value;
+        }
+    }
+    *length = remaining;
+    lastInActivity = millis();
+    return true;
+}
+
+bool PubSubClient::connect(const char *id, const char *user, const char *pass) {
+    if (connected()) {
+        return true;
+    }
+    if (domain == nullptr || !client->connect(domain, port)) {
+        status = MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    uint8_t *cursor = buffer;
+    cursor += putString(cursor, "MQTT");
+    *cursor++ = 4;  // Protocol level 3.1.1
+    uint8_t flags = 0x02;  // Clean session
+    if (user != nullptr) {
+        flags |= 0x80;
+        if (pass != nullptr) {
+            flags |= 0x40;
+        }
+    }
+    *cursor++ = flags;
+    *cursor++ = keepAlive >> 8;
+    *cursor++ = keepAlive & 0xff;
+    cursor += putString(cursor, id);
+    if (user != nullptr) {
+        cursor += putString(cursor, user);
+        if (pass != nullptr) {
+            cursor += putString(cursor, pass);
+        }
+    }
+
+    uint8_t type;
+    size_t length;
+    bool truncated;
+    if (!sendPacket(CONNECT, buffer, cursor - buffer) || !readPacket(&type, &length, &truncated)) {
+        client->stop();
+        status = MQTT_CONNECTION_TIMEOUT;
+        return false;
+    }
+    if ((type & 0xf0) != CONNACK || length < 2 || buffer[1] != 0) {
+        client->stop();
+        status = length >= 2 ? buffer[1] : MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    pingOutstanding = false;
+    status = MQTT_CONNECTED;
+    return true;
+}
+
+void PubSubClient::disconnect() {
+    if (client->connected()) {
+        sendPacket(DISCONNECT, nullptr, 0);
+    }
+    client->stop();
+    status = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() {
+    if (status == MQTT_CONNECTED && !client->connected()) {
+        status = MQTT_CONNECTION_LOST;
+    }
+    return status == MQTT_CONNECTED;
+}
+
+int PubSubClient::state() {
+    return status;
+}
+
+bool PubSubClient::loop() {
+    if (!connected()) {
+        return false;
+    }
+
+    unsigned long now = millis();
+    if (now - lastOutActivity > (unsigned long)keepAlive * 1000 ||
+        now - lastInActivity > (unsigned long)keepAlive * 1000) {
+        if (pingOutstanding) {
+            client->stop();
+            status = MQTT_CONNECTION_TIMEOUT;
+            return false;
+        }
+        sendPacket(PINGREQ, nullptr, 0);
+        lastInActivity = now;
+        pingOutstanding = true;
+    }
+
+    while (client->available() > 0) {
+        uint8_t type;
+        size_t length;
+        bool truncated;
+        if (!readPacket(&type, &length, &truncated)) {
+            return connected();
+        }
+        if ((type & 0xf0) == PUBLISH && !truncated && callback != nullptr && length >= 2) {
+            size_t topicLength = (buffer[0] << 8) | buffer[1];
+            size_t offset = 2 + topicLength + (((type >> 1) & 3) > 0 ? 2 : 0);
+            if (offset <= length) {
+                // The topic is made NUL-terminated in place, as PubSubClient does
+                char topic[256];
+                size_t copied = topicLength < sizeof(topic) - 1 ? topicLength : sizeof(topic) - 1;
+                memcpy(topic, buffer + 2, copied);
+                topic[copied] = '\0';
+                callback(topic, buffer + offset, length - offset);
+            }
+        } else if ((type & 0xf0) == PINGRESP) {
+            pingOutstanding = false;
+        }
+    }
+    return connected();
+}
+
+bool PubSubClient::subscribe(const char *topic) {
+    if (!connected() || strlen(topic) + 5 > bufferSize) {
+        return false;
+    }
+    uint8_t *cursor = buffer;
+    *cursor++ = nextPacketId >> 8;
+    *cursor++ = nextPacketId & 0xff;
+    nextPacketId = nextPacketId == 0xffff ? 1 : nextPacketId + 1;
+    cursor += putString(cursor, topic);
+    *cursor++ = 0;  // QoS 0
+    return sendPacket(SUBSCRIBE, buffer, cursor - buffer);
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload) {
+    return publish(topic, (const uint8_t *)payload, payload != nullptr ? strlen(payload) : 0, false);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained) {
+    size_t topicLength = strlen(topic);
+    if (!connected() || 5 + 2 + topicLength + length > bufferSize) {
+        return false;
+    }
+    uint8_t *cursor = buffer;
+    cursor += putString(cursor, topic);
+    memcpy(cursor, payload, length);
+    cursor += length;
+    return sendPacket(PUBLISH | (retained ? 1 : 0), buffer, cursor - buffer);
+}
+
+bool PubSubClient::beginPublish(const char *topic, unsigned int length, bool retained) {
+    if (!connected()) {
+        return false;
+    }
+    uint8_t header[5];
+    uint8_t topicBytes[2];
+    size_t topicLength = strlen(topic);
+    size_t headerLength = writeHeader(PUBLISH | (retained ? 1 : 0), 2 + topicLength + length, header);
+    topicBytes[0] = topicLength >> 8;
+    topicBytes[1] = topicLength & 0xff;
+    lastOutActivity = millis();
+    return client->write(header, headerLength) == headerLength &&
+           client->write(topicBytes, 2) == 2 &&
+           client->write((const uint8_t *)topic, topicLength) == topicLength;
+}
+
+size_t PubSubClient::write(uint8_t value) {
+    lastOutActivity = millis();
+    return client->write(value);
+}
+
+size_t PubSubClient::write(const uint8_t *data, size_t size) {
+    lastOutActivity = millis();
+    return client->write(data, size);
+}
+
+int PubSubClient::endPublish() {
+    return 1;
+}
@@ -0,0 +1,115 @@
+#include <WiFi.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Blocking TCP client with the Arduino WiFiClient semantics: read() and
+// available() never wait, write() sends everything or fails.
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+    stop();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(host, service, &hints, &result) != 0 || result == nullptr) {
+        return 0;
+    }
+    fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd >= 0) {
+        // Connect without blocking for longer than the timeout
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        bool connected = ::connect(fd, result->ai_addr, result->ai_addrlen) == 0;
+        if (!connected && errno == EINPROGRESS) {
+            struct pollfd watch = {fd, POLLOUT, 0};
+            int error = 0;
+            socklen_t length = sizeof(error);
+            connected = poll(&watch, 1, timeoutMs) > 0 &&
+                        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+        }
+        fcntl(fd, F_SETFL, flags);
+        if (!connected) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    return fd >= 0 ? 1 : 0;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (fd >= 0 && written < size) {
+        ssize_t sent = send(fd, buffer + written, size - written, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            stop();
+            break;
+        }
+        written += sent;
+    }
+    return written;
+}
+
+int WiFiClient::available() {
+    if (fd < 0) {
+        return 0;
+    }
+    int count = 0;
+    if (ioctl(fd, FIONREAD, &count) != 0) {
+        return 0;
+    }
+    return count;
+}
+
+int WiFiClient::read() {
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t received = recv(fd, buffer, size, MSG_DONTWAIT);
+    if (received == 0) {
+        stop();
+        return -1;
+    }
+    return received < 0 ? -1 : (int)received;
+}
+
+void WiFiClient::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+uint8_t WiFiClient::connected() {
+    if (fd < 0) {
+        return 0;
+    }
+    // A readable socket with nothing to read has been closed by the peer
+    struct pollfd watch = {fd, POLLIN, 0};
+    if (poll(&watch, 1, 0) > 0 && available() == 0) {
+        uint8_t probe;
+        if (recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT) <= 0) {
+            stop();
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,433 @@
+#include "SyntheticJpeg.h"
+#include <math.h>
+#include <string.h>
+
+// Minimal baseline JPEG encoder laid out like the camera sensor's output:
+// YCbCr with 4:2:2 sampling, the ITU T.81 Annex K quantisation and Huffman
+// tables and no restart markers, so RTP/JPEG (RFC 2435) can carry it. A
+// float DCT keeps it short rather than fast.
+
+namespace {
+
+const uint8_t ZIGZAG[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// ITU T.81 Annex K luminance table, row-major
+const uint8_t BASE_QUANT[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,
+    12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77,
+    24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103, 99
+};
+
+// ITU T.81 Annex K chrominance table, row-major
+const uint8_t BASE_CHROMA_QUANT[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// ITU T.81 Annex K.3 Huffman tables: code counts per length, then symbols.
+// These are the tables the camera sensor uses, and the ones RFC 2435
+// receivers assume.
+const uint8_t DC_LUMA_COUNTS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+const uint8_t DC_CHROMA_COUNTS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+const uint8_t DC_SYMBOLS[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+const uint8_t AC_LUMA_COUNTS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+const uint8_t AC_LUMA_SYMBOLS[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+const uint8_t AC_CHROMA_COUNTS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+const uint8_t AC_CHROMA_SYMBOLS[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t> &output) : output(output) {}
+
+    void write(uint32_t bits, int count) {
+        while (count-- > 0) {
+            current = (current << 1) | ((bits >> count) & 1);
+            if (++filled == 8) {
+                emit();
+            }
+        }
+    }
+
+    void flush() {
+        // Pad the final byte with 1 bits as the standard requires
+        while (filled != 0) {
+            write(1, 1);
+        }
+    }
+
+private:
+    std::vector<uint8_t> &output;
+    uint32_t current = 0;
+    int filled = 0;
+
+    void emit() {
+        uint8_t byte = current & 0xff;
+        output.push_back(byte);
+        if (byte == 0xff) {
+            output.push_back(0x00);
+        }
+        current = 0;
+        filled = 0;
+    }
+};
+
+/**
+ * Canonical Huffman codes for one table, indexed by symbol
+ */
+struct HuffmanCodes {
+    uint16_t code[256];
+    uint8_t length[256];
+
+    HuffmanCodes(const uint8_t *counts, const uint8_t *symbols) {
+        memset(length, 0, sizeof(length));
+        uint16_t next = 0;
+        int symbol = 0;
+        for (int bits = 1; bits <= 16; bits++) {
+            for (int i = 0; i < counts[bits - 1]; i++) {
+                code[symbols[symbol]] = next++;
+                length[symbols[symbol]] = bits;
+                symbol++;
+            }
+            next <<= 1;
+        }
+    }
+
+    void write(BitWriter &writer, uint8_t symbol) const {
+        writer.write(code[symbol], length[symbol]);
+    }
+};
+
+int magnitudeBits(int value) {
+    int magnitude = value < 0 ? -value : value;
+    int bits = 0;
+    while (magnitude > 0) {
+        bits++;
+        magnitude >>= 1;
+    }
+    return bits;
+}
+
+uint32_t magnitudeValue(int value, int bits) {
+    return value >= 0 ? (uint32_t)value : (uint32_t)(value + (1 << bits) - 1);
+}
+
+void put16(std::vector<uint8_t> &output, uint16_t value) {
+    output.push_back(value >> 8);
+    output.push_back(value & 0xff);
+}
+
+void writeQuantTable(std::vector<uint8_t> &output, uint8_t id, const uint8_t *quant) {
+    // Stored in zigzag order
+    output.push_back(0xff);
+    output.push_back(0xdb);
+    put16(output, 67);
+    output.push_back(id);
+    for (int i = 0; i < 64; i++) {
+        output.push_back(quant[ZIGZAG[i]]);
+    }
+}
+
+void writeHuffmanTable(std::vector<uint8_t> &output, uint8_t classAndId, const uint8_t *counts,
+                       const uint8_t *symbols) {
+    int symbolCount = 0;
+    for (int i = 0; i < 16; i++) {
+        symbolCount += counts[i];
+    }
+    output.push_back(0xff);
+    output.push_back(0xc4);
+    put16(output, 2 + 1 + 16 + symbolCount);
+    output.push_back(classAndId);
+    output.insert(output.end(), counts, counts + 16);
+    output.insert(output.end(), symbols, symbols + symbolCount);
+}
+
+void writeHeaders(std::vector<uint8_t> &output, uint16_t width, uint16_t height,
+                  const uint8_t *lumaQuant, const uint8_t *chromaQuant) {
+    static const uint8_t JFIF[] = {0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+                                   0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+    output.push_back(0xff);
+    output.push_back(0xd8);
+    output.insert(output.end(), JFIF, JFIF + sizeof(JFIF));
+
+    writeQuantTable(output, 0, lumaQuant);
+    writeQuantTable(output, 1, chromaQuant);
+
+    // Baseline frame header: YCbCr with 4:2:2 sampling, as the sensor produces
+    static const uint8_t COMPONENTS[] = {1, 0x21, 0, 2, 0x11, 1, 3, 0x11, 1};
+    output.push_back(0xff);
+    output.push_back(0xc0);
+    put16(output, 8 + sizeof(COMPONENTS));
+    output.push_back(8);
+    put16(output, height);
+    put16(output, width);
+    output.push_back(3);
+    output.insert(output.end(), COMPONENTS, COMPONENTS + sizeof(COMPONENTS));
+
+    writeHuffmanTable(output, 0x00, DC_LUMA_COUNTS, DC_SYMBOLS);
+    writeHuffmanTable(output, 0x10, AC_LUMA_COUNTS, AC_LUMA_SYMBOLS);
+    writeHuffmanTable(output, 0x01, DC_CHROMA_COUNTS, DC_SYMBOLS);
+    writeHuffmanTable(output, 0x11, AC_CHROMA_COUNTS, AC_CHROMA_SYMBOLS);
+
+    static const uint8_t SCAN[] = {0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11,
+                                   0x00, 0x3f, 0x00};
+    output.insert(output.end(), SCAN, SCAN + sizeof(SCAN));
+}
+
+bool insideSquare(int x, int y, int width, int height, uint32_t index) {
+    // A square crossing the frame every 120 frames
+    int size = height / 4;
+    int left = (int)((index % 120) * (uint32_t)(width + size) / 120) - size;
+    int top = height / 2 - size / 2;
+    return x >= left && x < left + size && y >= top && y < top + size;
+}
+
+uint8_t samplePixel(int x, int y, int width, int height, uint32_t index) {
+    // Diagonal gradient with a bright square
+    if (insideSquare(x, y, width, height, index)) {
+        return 235;
+    }
+    return (uint8_t)(40 + (x * 100) / width + (y * 60) / height);
+}
+
+uint8_t sampleChroma(int x, int y, int width, int height, uint32_t index, bool red) {
+    // Grey background; the square is tinted orange
+    if (insideSquare(x, y, width, height, index)) {
+        return red ? 170 : 90;
+    }
+    return 128;
+}
+
+struct CosineTable {
+    float values[8][8];
+
+    CosineTable() {
+        for (int u = 0; u < 8; u++) {
+            float scale = u == 0 ? sqrtf(0.125f) : 0.5f;
+            for (int x = 0; x < 8; x++) {
+                values[u][x] = scale * cosf((2 * x + 1) * u * (float)M_PI / 16);
+            }
+        }
+    }
+};
+
+void encodeBlock(BitWriter &bits, const float (&pixels)[8][8], const uint8_t *quant, int &previousDc,
+                 const HuffmanCodes &dcCodes, const HuffmanCodes &acCodes) {
+    static const CosineTable table;
+    const float (&cosines)[8][8] = table.values;
+
+    // Separable 2-D DCT: rows, then columns
+    float rows[8][8];
+    for (int y = 0; y < 8; y++) {
+        for (int u = 0; u < 8; u++) {
+            float sum = 0;
+            for (int x = 0; x < 8; x++) {
+                sum += cosines[u][x] * pixels[y][x];
+            }
+            rows[y][u] = sum;
+        }
+    }
+    int coefficients[64];
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            float sum = 0;
+            for (int y = 0; y < 8; y++) {
+                sum += cosines[v][y] * rows[y][u];
+            }
+            coefficients[v * 8 + u] = (int)lroundf(sum / quant[v * 8 + u]);
+        }
+    }
+
+    int difference = coefficients[0] - previousDc;
+    previousDc = coefficients[0];
+    int dcBits = magnitudeBits(difference);
+    dcCodes.write(bits, dcBits);
+    bits.write(magnitudeValue(difference, dcBits), dcBits);
+
+    int run = 0;
+    for (int i = 1; i < 64; i++) {
+        int value = coefficients[ZIGZAG[i]];
+        if (value == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            acCodes.write(bits, 0xf0);  // ZRL
+            run -= 16;
+        }
+        // Magnitude categories go up to 10
+        value = value > 1023 ? 1023 : (value < -1023 ? -1023 : value);
+        int acBits = magnitudeBits(value);
+        acCodes.write(bits, (uint8_t)((run << 4) | acBits));
+        bits.write(magnitudeValue(value, acBits), acBits);
+        run = 0;
+    }
+    if (run > 0) {
+        acCodes.write(bits, 0x00);  // EOB
+    }
+}
+
+void scaleQuant(const uint8_t *base, int scale, uint8_t *quant) {
+    for (int i = 0; i < 64; i++) {
+        int value = (base[i] * scale + 50) / 100;
+        quant[i] = (uint8_t)(value < 1 ? 1 : (value > 255 ? 255 : value));
+    }
+}
+
+struct TestPattern {
+    int width;
+    int height;
+    uint32_t index;
+    // Part of the pattern, laid out over the whole field, that the image shows
+    int fieldWidth;
+    int fieldHeight;
+    int windowX;
+    int windowY;
+    int windowWidth;
+    int windowHeight;
+};
+
+uint8_t sampleTestPattern(const void *context, int x, int y, int component) {
+    const TestPattern &pattern = *(const TestPattern *)context;
+    int fieldX = pattern.windowX + x * pattern.windowWidth / pattern.width;
+    int fieldY = pattern.windowY + y * pattern.windowHeight / pattern.height;
+    if (component == 0) {
+        return samplePixel(fieldX, fieldY, pattern.fieldWidth, pattern.fieldHeight, pattern.index);
+    }
+    return sampleChroma(fieldX, fieldY, pattern.fieldWidth, pattern.fieldHeight, pattern.index, component == 2);
+}
+
+struct YuyvImage {
+    const uint8_t *pixels;
+    int width;
+    int height;
+};
+
+uint8_t sampleYuyv(const void *context, int x, int y, int component) {
+    const YuyvImage &image = *(const YuyvImage *)context;
+    // Edge pixels fill the padding of partial MCUs
+    x = x < image.width ? x : image.width - 1;
+    y = y < image.height ? y : image.height - 1;
+    const uint8_t *pair = image.pixels + ((size_t)y * image.width + (x & ~1)) * 2;
+    if (component == 0) {
+        return pair[(x & 1) * 2];
+    }
+    return pair[component == 1 ? 1 : 3];
+}
+
+// Encode an image given as a function returning Y, Cb or Cr at a pixel;
+// chroma is asked for at even x only
+void encodeImage(uint16_t width, uint16_t height, int ijgQuality,
+                 uint8_t (*sample)(const void *, int, int, int), const void *context,
+                 std::vector<uint8_t> &output) {
+    static const HuffmanCodes dcLuma(DC_LUMA_COUNTS, DC_SYMBOLS);
+    static const HuffmanCodes acLuma(AC_LUMA_COUNTS, AC_LUMA_SYMBOLS);
+    static const HuffmanCodes dcChroma(DC_CHROMA_COUNTS, DC_SYMBOLS);
+    static const HuffmanCodes acChroma(AC_CHROMA_COUNTS, AC_CHROMA_SYMBOLS);
+
+    ijgQuality = ijgQuality < 5 ? 5 : (ijgQuality > 95 ? 95 : ijgQuality);
+    int scale = ijgQuality < 50 ? 5000 / ijgQuality : 200 - ijgQuality * 2;
+    uint8_t lumaQuant[64];
+    uint8_t chromaQuant[64];
+    scaleQuant(BASE_QUANT, scale, lumaQuant);
+    scaleQuant(BASE_CHROMA_QUANT, scale, chromaQuant);
+
+    // 4:2:2 MCUs are 16x8 pixels
+    int paddedWidth = (width + 15) & ~15;
+    int paddedHeight = (height + 7) & ~7;
+
+    output.clear();
+    output.reserve(paddedWidth * paddedHeight / 4);
+    writeHeaders(output, width, height, lumaQuant, chromaQuant);
+
+    BitWriter bits(output);
+    int previousDc[3] = {0, 0, 0};
+    float pixels[8][8];
+    for (int mcuY = 0; mcuY < paddedHeight; mcuY += 8) {
+        for (int mcuX = 0; mcuX < paddedWidth; mcuX += 16) {
+            // Two luma blocks side by side
+            for (int half = 0; half < 2; half++) {
+                for (int y = 0; y < 8; y++) {
+                    for (int x = 0; x < 8; x++) {
+                        pixels[y][x] = sample(context, mcuX + half * 8 + x, mcuY + y, 0) - 128.0f;
+                    }
+                }
+                encodeBlock(bits, pixels, lumaQuant, previousDc[0], dcLuma, acLuma);
+            }
+            // Cb then Cr, each sample covering two pixels across
+            for (int component = 1; component <= 2; component++) {
+                for (int y = 0; y < 8; y++) {
+                    for (int x = 0; x < 8; x++) {
+                        pixels[y][x] = sample(context, mcuX + x * 2, mcuY + y, component) - 128.0f;
+                    }
+                }
+                encodeBlock(bits, pixels, chromaQuant, previousDc[component], dcChroma, acChroma);
+            }
+        }
+    }
+    bits.flush();
+
+    output.push_back(0xff);
+    output.push_back(0xd9);
+}
+
+} // namespace
+
+void SyntheticJpeg::encode(uint16_t width, uint16_t height, int quality, uint32_t index, std::vector<uint8_t> &output) {
+    // Map esp32-camera quality (0-63, lower is better) onto the IJG 1-100 scale
+    encodeWindow(width, height, quality, index, width, height, 0, 0, width, height, output);
+}
+
+void SyntheticJpeg::encodeWindow(uint16_t width, uint16_t height, int quality, uint32_t index,
+                                 uint16_t fieldWidth, uint16_t fieldHeight, uint16_t windowX, uint16_t windowY,
+                                 uint16_t windowWidth, uint16_t windowHeight, std::vector<uint8_t> &output) {
+    TestPattern pattern = {width, height, index, fieldWidth, fieldHeight, windowX, windowY, windowWidth, windowHeight};
+    encodeImage(width, height, 100 - quality * 3 / 2, sampleTestPattern, &pattern, output);
+}
+
+void SyntheticJpeg::encodeYuyv(const uint8_t *pixels, uint16_t width, uint16_t height, int quality,
+                               std::vector<uint8_t> &output) {
+    YuyvImage image = {pixels, width, height};
+    encodeImage(width, height, quality, sampleYuyv, &image, output);
+}
@@ -0,0 +1,58 @@
+#ifndef NATIVE_SYNTHETIC_JPEG_H
+#define NATIVE_SYNTHETIC_JPEG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * @brief Renders and encodes test frames when no JPEG corpus is available
+ *
+ * Produces baseline 4:2:2 JPEGs of a gradient background with a bright
+ * tinted square sweeping across it, so stream, snapshot and motion code all see
+ * real, decodable frames whose content changes over time. The same encoder
+ * stands in for esp32-camera's fmt2jpg().
+ */
+class SyntheticJpeg {
+public:
+    /**
+     * @brief Encode frame number @p index of the test sequence
+     *
+     * @param width Width in pixels
+     * @param height Height in pixels
+     * @param quality esp32-camera quality (0-63, lower is better)
+     * @param index Frame number, which sets the position of the moving square
+     * @param output Receives the encoded JPEG
+     */
+    static void encode(uint16_t width, uint16_t height, int quality, uint32_t index, std::vector<uint8_t> &output);
+
+    /**
+     * @brief Encode part of frame @p index, as a sensor window cropped and scaled by the DSP
+     *
+     * @param width Output width in pixels
+     * @param height Output height in pixels
+     * @param fieldWidth Width the whole test pattern is laid out over
+     * @param fieldHeight Height the whole test pattern is laid out over
+     * @param windowX Left of the window in field pixels
+     * @param windowY Top of the window in field pixels
+     * @param windowWidth Window width in field pixels
+     * @param windowHeight Window height in field pixels
+     */
+    static void encodeWindow(uint16_t width, uint16_t height, int quality, uint32_t index,
+                             uint16_t fieldWidth, uint16_t fieldHeight, uint16_t windowX, uint16_t windowY,
+                             uint16_t windowWidth, uint16_t windowHeight, std::vector<uint8_t> &output);
+
+    /**
+     * @brief Encode a YUYV (YUV 4:2:2) image, as fmt2jpg() does on the device
+     *
+     * @param pixels Y0 U Y1 V for every pair of pixels, row by row
+     * @param width Width in pixels, even
+     * @param height Height in pixels
+     * @param quality IJG quality (1-100, higher is better)
+     * @param output Receives the encoded JPEG
+     */
+    static void encodeYuyv(const uint8_t *pixels, uint16_t width, uint16_t height, int quality,
+                           std::vector<uint8_t> &output);
+};
+
+#endif // NATIVE_SYNTHETIC_JPEG_H
@@ -0,0 +1,206 @@
+#include "AdaptiveStreamController.h"
+#include "FrameBroker.h"
+#include "RegionOfInterest.h"
+
+// Sizes the ladder steps down through, largest first
+const framesize_t AdaptiveStreamController::LADDER_SIZES[AdaptiveStreamController::LADDER_SIZE_COUNT] = {
+    FRAMESIZE_UXGA,  // 1600x1200
+    FRAMESIZE_SXGA,  // 1280x1024
+    FRAMESIZE_XGA,   // 1024x768
+    FRAMESIZE_SVGA,  // 800x600
+    FRAMESIZE_VGA,   // 640x480
+    FRAMESIZE_CIF,   // 400x296
+    FRAMESIZE_QVGA   // 320x240
+};
+// Indexed by framesize_t
+const char *const AdaptiveStreamController::FRAME_SIZE_NAMES[AdaptiveStreamController::MAX_FRAME_SIZE + 1] = {
+    "96X96",
+    "QQVGA",
+    "QCIF",
+    "HQVGA",
+    "240X240",
+    "QVGA",
+    "CIF",
+    "HVGA",
+    "VGA",
+    "SVGA",
+    "XGA",
+    "HD",
+    "SXGA",
+    "UXGA"
+};
+
+framesize_t AdaptiveStreamController::baseFrameSize = AdaptiveStreamController::DEFAULT_FRAME_SIZE;
+int AdaptiveStreamController::baseQuality = AdaptiveStreamController::DEFAULT_QUALITY;
+bool AdaptiveStreamController::adaptive = true;
+uint8_t AdaptiveStreamController::level = 0;
+framesize_t AdaptiveStreamController::appliedFrameSize = AdaptiveStreamController::DEFAULT_FRAME_SIZE;
+int AdaptiveStreamController::appliedQuality = AdaptiveStreamController::DEFAULT_QUALITY;
+uint8_t AdaptiveStreamController::goodWindows = 0;
+uint32_t AdaptiveStreamController::windowStartMs = 0;
+uint32_t AdaptiveStreamController::framesSent = 0;
+uint32_t AdaptiveStreamController::framesSkipped = 0;
+uint64_t AdaptiveStreamController::totalSendTimeUs = 0;
+uint64_t AdaptiveStreamController::totalLatencyUs = 0;
+portMUX_TYPE AdaptiveStreamController::statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void AdaptiveStreamController::begin() {
+    sensor_t * s = esp_camera_sensor_get();
+    if (s != nullptr) {
+        appliedFrameSize = (framesize_t)s->status.framesize;
+        appliedQuality = s->status.quality;
+        applyLevel();
+    }
+    windowStartMs = millis();
+    FrameBroker::addBetweenFramesCallback(update);
+}
+
+void AdaptiveStreamController::recordFrameSent(uint32_t sendTimeUs, uint32_t latencyUs, uint32_t skipped) {
+    portENTER_CRITICAL(&statsMux);
+    framesSent++;
+    framesSkipped += skipped;
+    totalSendTimeUs += sendTimeUs;
+    totalLatencyUs += latencyUs;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void AdaptiveStreamController::update() {
+    uint32_t now = millis();
+    if (now - windowStartMs < WINDOW_MS) {
+        return;
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    uint32_t sent = framesSent;
+    uint32_t skipped = framesSkipped;
+    uint64_t sendTimeUs = totalSendTimeUs;
+    uint64_t latencyUs = totalLatencyUs;
+    framesSent = 0;
+    framesSkipped = 0;
+    totalSendTimeUs = 0;
+    totalLatencyUs = 0;
+    portEXIT_CRITICAL(&statsMux);
+    windowStartMs = now;
+
+    if (!adaptive) {
+        return;
+    }
+
+    if (sent == 0) {
+        // No stream clients this window - nothing to judge the link by
+        goodWindows = 0;
+        return;
+    }
+
+    uint32_t averageSendMs = (uint32_t)(sendTimeUs / sent / 1000);
+    uint32_t averageLatencyMs = (uint32_t)(latencyUs / sent / 1000);
+    uint32_t skipPercent = skipped * 100 / (sent + skipped);
+    uint32_t frameBudgetMs = 1000 / TARGET_FPS;
+
+    bool congested = averageSendMs > frameBudgetMs ||
+                     averageLatencyMs > TARGET_LATENCY_MS ||
+                     skipPercent > 20;
+    bool comfortable = averageSendMs < frameBudgetMs / 2 &&
+                       averageLatencyMs < TARGET_LATENCY_MS / 2 &&
+                       skipPercent < 5;
+
+    if (congested) {
+        goodWindows = 0;
+        if (level < MAX_LEVEL) {
+            level++;
+        }
+    } else if (comfortable) {
+        if (level > 0 && ++goodWindows >= UPGRADE_WINDOWS) {
+            goodWindows = 0;
+            level--;
+        }
+    } else {
+        goodWindows = 0;
+    }
+
+    if (getFrameSize() != appliedFrameSize || getQuality() != appliedQuality) {
+        applyLevel();
+        Serial.printf("Stream operating point: %s q%d (send %ums, latency %ums, skipped %u%%)\n",
+                      getFrameSizeName(), getQuality(), averageSendMs, averageLatencyMs, skipPercent);
+    }
+}
+
+void AdaptiveStreamController::applyLevel() {
+    sensor_t * s = esp_camera_sensor_get();
+    if (s == nullptr) {
+        return;
+    }
+
+    if (getFrameSize() != appliedFrameSize) {
+        s->set_framesize(s, getFrameSize());
+        RegionOfInterest::apply();
+    }
+    s->set_quality(s, getQuality());
+    appliedFrameSize = getFrameSize();
+    appliedQuality = getQuality();
+}
+
+void AdaptiveStreamController::configure(framesize_t frameSize, int quality, bool adaptiveEnabled) {
+    baseFrameSize = frameSize;
+    baseQuality = quality;
+    adaptive = adaptiveEnabled;
+    level = 0;
+    goodWindows = 0;
+    applyLevel();
+}
+
+framesize_t AdaptiveStreamController::getBaseFrameSize() {
+    return baseFrameSize;
+}
+
+int AdaptiveStreamController::getBaseQuality() {
+    return baseQuality;
+}
+
+bool AdaptiveStreamController::isAdaptive() {
+    return adaptive;
+}
+
+framesize_t AdaptiveStreamController::frameSizeAt(uint8_t steps) {
+    framesize_t size = baseFrameSize;
+    for (uint8_t step = 0; step < steps; step++) {
+        // Next ladder size below the current one; the smallest rung repeats
+        for (uint8_t i = 0; i < LADDER_SIZE_COUNT; i++) {
+            if (LADDER_SIZES[i] < size) {
+                size = LADDER_SIZES[i];
+                break;
+            }
+        }
+    }
+    return size;
+}
+
+uint8_t AdaptiveStreamController::getLevel() {
+    return level;
+}
+
+int AdaptiveStreamController::getQuality() {
+    int quality = baseQuality + (level % QUALITY_STEPS) * QUALITY_STEP;
+    return quality < WORST_QUALITY ? quality : WORST_QUALITY;
+}
+
+framesize_t AdaptiveStreamController::getFrameSize() {
+    return frameSizeAt(level / QUALITY_STEPS);
+}
+
+const char *AdaptiveStreamController::getFrameSizeName() {
+    return getFrameSizeName(getFrameSize());
+}
+
+const char *AdaptiveStreamController::getFrameSizeName(framesize_t frameSize) {
+    return (int)frameSize >= 0 && frameSize <= MAX_FRAME_SIZE ? FRAME_SIZE_NAMES[frameSize] : "UNKNOWN";
+}
+
+framesize_t AdaptiveStreamController::parseFrameSize(const char *name) {
+    for (int i = 0; i <= MAX_FRAME_SIZE; i++) {
+        if (strcasecmp(name, FRAME_SIZE_NAMES[i]) == 0) {
+            return (framesize_t)i;
+        }
+    }
+    return FRAMESIZE_INVALID;
+}
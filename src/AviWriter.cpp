@@ -0,0 +1,153 @@
+#include "AviWriter.h"
+
+// Sizes of the fixed part of the file: RIFF header (12), hdrl list (12)
+// holding avih (8 + 56) and the strl list (12) with strh (8 + 56) and
+// strf (8 + 40), then the movi list header (12)
+#define AVIH_SIZE 56
+#define STRH_SIZE 56
+#define STRF_SIZE 40
+#define STRL_LIST_SIZE (4 + 8 + STRH_SIZE + 8 + STRF_SIZE)
+#define HDRL_LIST_SIZE (4 + 8 + AVIH_SIZE + 8 + STRL_LIST_SIZE)
+
+#define AVIF_HASINDEX 0x10
+#define AVIIF_KEYFRAME 0x10
+
+static void put32(uint8_t *&cursor, uint32_t value) {
+    cursor[0] = value & 0xff;
+    cursor[1] = (value >> 8) & 0xff;
+    cursor[2] = (value >> 16) & 0xff;
+    cursor[3] = (value >> 24) & 0xff;
+    cursor += 4;
+}
+
+static void put16(uint8_t *&cursor, uint16_t value) {
+    cursor[0] = value & 0xff;
+    cursor[1] = (value >> 8) & 0xff;
+    cursor += 2;
+}
+
+static void putTag(uint8_t *&cursor, const char *tag) {
+    memcpy(cursor, tag, 4);
+    cursor += 4;
+}
+
+uint32_t AviWriter::getChunkSize(size_t length) {
+    // Chunks are padded to an even length
+    return 8 + length + (length & 1);
+}
+
+uint32_t AviWriter::getFileSize(const AviClipInfo &clip) {
+    return HEADER_SIZE + clip.chunkBytes + 8 + 16 * clip.frameCount;
+}
+
+uint32_t AviWriter::getFirstChunkOffset() {
+    return 4;
+}
+
+bool AviWriter::writeHeader(StreamSession *session, const AviClipInfo &clip) {
+    uint8_t header[HEADER_SIZE];
+    uint8_t *cursor = header;
+    uint32_t bytesPerSecond = clip.usPerFrame > 0
+        ? (uint32_t)((uint64_t)clip.maxFrameBytes * 1000000 / clip.usPerFrame) : 0;
+
+    putTag(cursor, "RIFF");
+    put32(cursor, getFileSize(clip) - 8);
+    putTag(cursor, "AVI ");
+
+    putTag(cursor, "LIST");
+    put32(cursor, HDRL_LIST_SIZE);
+    putTag(cursor, "hdrl");
+
+    putTag(cursor, "avih");
+    put32(cursor, AVIH_SIZE);
+    put32(cursor, clip.usPerFrame);
+    put32(cursor, bytesPerSecond);
+    put32(cursor, 0);                 // Padding granularity
+    put32(cursor, AVIF_HASINDEX);
+    put32(cursor, clip.frameCount);
+    put32(cursor, 0);                 // Initial frames
+    put32(cursor, 1);                 // Streams
+    put32(cursor, clip.maxFrameBytes);
+    put32(cursor, clip.width);
+    put32(cursor, clip.height);
+    for (int i = 0; i < 4; i++) {
+        put32(cursor, 0);
+    }
+
+    putTag(cursor, "LIST");
+    put32(cursor, STRL_LIST_SIZE);
+    putTag(cursor, "strl");
+
+    putTag(cursor, "strh");
+    put32(cursor, STRH_SIZE);
+    putTag(cursor, "vids");
+    putTag(cursor, "MJPG");
+    put32(cursor, 0);                 // Flags
+    put16(cursor, 0);                 // Priority
+    put16(cursor, 0);                 // Language
+    put32(cursor, 0);                 // Initial frames
+    put32(cursor, clip.usPerFrame);   // Scale / rate = seconds per frame
+    put32(cursor, 1000000);
+    put32(cursor, 0);                 // Start
+    put32(cursor, clip.frameCount);
+    put32(cursor, clip.maxFrameBytes);
+    put32(cursor, 0xffffffff);        // Quality: driver default
+    put32(cursor, 0);                 // Sample size: varies per frame
+    put16(cursor, 0);
+    put16(cursor, 0);
+    put16(cursor, clip.width);
+    put16(cursor, clip.height);
+
+    putTag(cursor, "strf");
+    put32(cursor, STRF_SIZE);
+    put32(cursor, STRF_SIZE);
+    put32(cursor, clip.width);
+    put32(cursor, clip.height);
+    put16(cursor, 1);                 // Planes
+    put16(cursor, 24);                // Bits per pixel once decoded
+    putTag(cursor, "MJPG");
+    put32(cursor, (uint32_t)clip.width * clip.height * 3);
+    for (int i = 0; i < 4; i++) {
+        put32(cursor, 0);
+    }
+
+    putTag(cursor, "LIST");
+    put32(cursor, 4 + clip.chunkBytes);
+    putTag(cursor, "movi");
+
+    return StreamSessionManager::sendAll(session, header, cursor - header);
+}
+
+bool AviWriter::writeFrame(StreamSession *session, const uint8_t *jpeg, size_t length) {
+    static const uint8_t padding[1] = {0};
+    uint8_t chunkHeader[8];
+    uint8_t *cursor = chunkHeader;
+    putTag(cursor, "00dc");
+    put32(cursor, length);
+
+    struct iovec vector[3];
+    vector[0].iov_base = chunkHeader;
+    vector[0].iov_len = sizeof(chunkHeader);
+    vector[1].iov_base = (void *)jpeg;
+    vector[1].iov_len = length;
+    vector[2].iov_base = (void *)padding;
+    vector[2].iov_len = length & 1;
+
+    uint32_t writes = 0;
+    return StreamSessionManager::sendVector(session, vector, (length & 1) ? 3 : 2, &writes);
+}
+
+bool AviWriter::writeIndexHeader(StreamSession *session, uint32_t frameCount) {
+    uint8_t header[8];
+    uint8_t *cursor = header;
+    putTag(cursor, "idx1");
+    put32(cursor, 16 * frameCount);
+    return StreamSessionManager::sendAll(session, header, sizeof(header));
+}
+
+void AviWriter::formatIndexEntry(uint8_t *entry, uint32_t offset, size_t length) {
+    putTag(entry, "00dc");
+    put32(entry, AVIIF_KEYFRAME);
+    put32(entry, offset);
+    put32(entry, length);
+}
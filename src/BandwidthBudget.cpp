@@ -0,0 +1,121 @@
+#include "BandwidthBudget.h"
+#include <esp_timer.h>
+
+uint32_t BandwidthBudget::limitBytesPerSecond = 0;
+int64_t BandwidthBudget::tokens = 0;
+int64_t BandwidthBudget::lastRefillUs = 0;
+uint32_t BandwidthBudget::windowStartMs = 0;
+uint32_t BandwidthBudget::windowBytes = 0;
+uint32_t BandwidthBudget::usedKbps = 0;
+uint32_t BandwidthBudget::throttledMs = 0;
+portMUX_TYPE BandwidthBudget::budgetMux = portMUX_INITIALIZER_UNLOCKED;
+
+void BandwidthBudget::setLimitKbps(uint32_t kbps) {
+    portENTER_CRITICAL(&budgetMux);
+    limitBytesPerSecond = kbps * 1000 / 8;
+    tokens = limitBytesPerSecond;
+    lastRefillUs = esp_timer_get_time();
+    portEXIT_CRITICAL(&budgetMux);
+}
+
+uint32_t BandwidthBudget::getLimitKbps() {
+    return limitBytesPerSecond * 8 / 1000;
+}
+
+uint32_t BandwidthBudget::acquire(size_t bytes, StreamPriority priority) {
+    uint32_t waitedMs = 0;
+
+    while (true) {
+        portENTER_CRITICAL(&budgetMux);
+
+        bool granted = true;
+        uint32_t waitMs = 0;
+        if (limitBytesPerSecond > 0) {
+            refill(esp_timer_get_time());
+
+            // Lower classes leave part of the bucket for higher ones
+            int64_t reserve = 0;
+            if (priority == StreamPriority::STANDARD) {
+                reserve = limitBytesPerSecond / 4;
+            } else if (priority == StreamPriority::BACKGROUND) {
+                reserve = limitBytesPerSecond / 2;
+            }
+
+            if (tokens >= reserve) {
+                // The bucket may go into debt for a large frame; later
+                // clients then wait until it has been paid back
+                tokens -= bytes;
+            } else {
+                granted = false;
+                waitMs = (uint32_t)((reserve - tokens) * 1000 / limitBytesPerSecond) + 1;
+                if (waitMs > MAX_WAIT_STEP_MS) {
+                    waitMs = MAX_WAIT_STEP_MS;
+                }
+            }
+        }
+
+        if (granted) {
+            uint32_t now = millis();
+            windowBytes += bytes;
+            if (now - windowStartMs >= USAGE_WINDOW_MS) {
+                usedKbps = windowBytes * 8 / (now - windowStartMs);
+                windowBytes = 0;
+                windowStartMs = now;
+            }
+            throttledMs += waitedMs;
+        }
+
+        portEXIT_CRITICAL(&budgetMux);
+
+        if (granted) {
+            return waitedMs;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(waitMs));
+        waitedMs += waitMs;
+    }
+}
+
+uint32_t BandwidthBudget::getUsedKbps() {
+    if (millis() - windowStartMs > 2 * USAGE_WINDOW_MS) {
+        // No frames sent recently
+        return 0;
+    }
+    return usedKbps;
+}
+
+uint32_t BandwidthBudget::getThrottledMs() {
+    return throttledMs;
+}
+
+StreamPriority BandwidthBudget::parsePriority(const char *name) {
+    if (strcmp(name, "high") == 0) {
+        return StreamPriority::PRIMARY;
+    }
+    if (strcmp(name, "low") == 0) {
+        return StreamPriority::BACKGROUND;
+    }
+    return StreamPriority::STANDARD;
+}
+
+const char *BandwidthBudget::getPriorityName(StreamPriority priority) {
+    switch (priority) {
+        case StreamPriority::PRIMARY:
+            return "high";
+        case StreamPriority::BACKGROUND:
+            return "low";
+        default:
+            return "normal";
+    }
+}
+
+void BandwidthBudget::refill(int64_t nowUs) {
+    int64_t elapsedUs = nowUs - lastRefillUs;
+    lastRefillUs = nowUs;
+
+    tokens += elapsedUs * limitBytesPerSecond / 1000000;
+    if (tokens > (int64_t)limitBytesPerSecond) {
+        // Burst capacity of one second
+        tokens = limitBytesPerSecond;
+    }
+}
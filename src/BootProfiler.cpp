@@ -0,0 +1,99 @@
+#include "BootProfiler.h"
+#include <stdarg.h>
+
+BootProfiler::Phase BootProfiler::phases[BootProfiler::MAX_PHASES];
+uint8_t BootProfiler::phaseCount = 0;
+std::atomic<int32_t> BootProfiler::firstFrameMs(-1);
+
+namespace {
+
+// snprintf at the end of the buffer contents, stopping at its last byte
+// rather than letting the next offset run past it
+size_t appendFormat(char *buffer, size_t size, size_t length, const char *format, ...) {
+    if (length + 1 >= size) {
+        return size - 1;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + length, size - length, format, args);
+    va_end(args);
+    if (written > 0) {
+        length += written;
+    }
+    return length < size ? length : size - 1;
+}
+
+} // namespace
+
+int8_t BootProfiler::beginPhase(const char *name) {
+    if (phaseCount >= MAX_PHASES) {
+        return -1;
+    }
+    Phase &phase = phases[phaseCount];
+    phase.name = name;
+    phase.startMs = (uint32_t)(esp_timer_get_time() / 1000);
+    phase.endMs = phase.startMs;
+    phase.finished = false;
+    return phaseCount++;
+}
+
+void BootProfiler::endPhase(int8_t phase) {
+    if (phase < 0 || phase >= phaseCount) {
+        return;
+    }
+    phases[phase].endMs = (uint32_t)(esp_timer_get_time() / 1000);
+    phases[phase].finished = true;
+}
+
+void BootProfiler::recordFrameCaptured() {
+    if (firstFrameMs.load(std::memory_order_relaxed) >= 0) {
+        return;
+    }
+    int32_t unset = -1;
+    firstFrameMs.compare_exchange_strong(unset, (int32_t)(esp_timer_get_time() / 1000));
+}
+
+int32_t BootProfiler::getTimeToFirstFrameMs() {
+    return firstFrameMs.load(std::memory_order_relaxed);
+}
+
+void BootProfiler::report() {
+    Serial.println("Boot phases (start + duration, ms since reset):");
+    for (uint8_t i = 0; i < phaseCount; i++) {
+        if (phases[i].finished) {
+            Serial.printf("  %-8s %5u + %5u\n", phases[i].name, phases[i].startMs,
+                          phases[i].endMs - phases[i].startMs);
+        } else {
+            Serial.printf("  %-8s %5u + (running)\n", phases[i].name, phases[i].startMs);
+        }
+    }
+    int32_t ttff = getTimeToFirstFrameMs();
+    if (ttff >= 0) {
+        Serial.printf("Time to first frame: %d ms\n", ttff);
+    } else {
+        Serial.println("Time to first frame: no frame yet");
+    }
+}
+
+int BootProfiler::formatSummary(char *buffer, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    size_t length = 0;
+    int32_t ttff = getTimeToFirstFrameMs();
+    if (ttff >= 0) {
+        length = appendFormat(buffer, size, length, ",\"ttff_ms\":%d", ttff);
+    }
+    length = appendFormat(buffer, size, length, ",\"boot_ms\":{");
+    bool first = true;
+    for (uint8_t i = 0; i < phaseCount; i++) {
+        if (!phases[i].finished) {
+            continue;
+        }
+        length = appendFormat(buffer, size, length, "%s\"%s\":%u", first ? "" : ",",
+                              phases[i].name, phases[i].endMs - phases[i].startMs);
+        first = false;
+    }
+    length = appendFormat(buffer, size, length, "}");
+    return length;
+}
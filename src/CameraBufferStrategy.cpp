@@ -0,0 +1,101 @@
+#include "CameraBufferStrategy.h"
+#include <esp_timer.h>
+
+CameraBufferMode CameraBufferStrategy::mode = CameraBufferMode::DRAM_SINGLE;
+uint32_t CameraBufferStrategy::averageLatencyUs = 0;
+uint32_t CameraBufferStrategy::maxLatencyUs = 0;
+portMUX_TYPE CameraBufferStrategy::latencyMux = portMUX_INITIALIZER_UNLOCKED;
+
+void CameraBufferStrategy::select() {
+    mode = psramFound() ? CameraBufferMode::PSRAM_TRIPLE_LATEST : CameraBufferMode::DRAM_SINGLE;
+}
+
+void CameraBufferStrategy::apply(camera_config_t &config) {
+    switch (mode) {
+        case CameraBufferMode::PSRAM_TRIPLE_LATEST:
+            config.fb_count = 3;
+            config.fb_location = CAMERA_FB_IN_PSRAM;
+            config.grab_mode = CAMERA_GRAB_LATEST;
+            break;
+        case CameraBufferMode::PSRAM_DOUBLE_LATEST:
+            config.fb_count = 2;
+            config.fb_location = CAMERA_FB_IN_PSRAM;
+            config.grab_mode = CAMERA_GRAB_LATEST;
+            break;
+        case CameraBufferMode::DRAM_SINGLE:
+        default:
+            config.fb_count = 1;
+            config.fb_location = CAMERA_FB_IN_DRAM;
+            config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+            break;
+    }
+}
+
+bool CameraBufferStrategy::fallBack() {
+    switch (mode) {
+        case CameraBufferMode::PSRAM_TRIPLE_LATEST:
+            mode = CameraBufferMode::PSRAM_DOUBLE_LATEST;
+            return true;
+        case CameraBufferMode::PSRAM_DOUBLE_LATEST:
+            mode = CameraBufferMode::DRAM_SINGLE;
+            return true;
+        case CameraBufferMode::DRAM_SINGLE:
+        default:
+            return false;
+    }
+}
+
+uint8_t CameraBufferStrategy::getPipelineFrameCount() {
+    switch (mode) {
+        case CameraBufferMode::PSRAM_TRIPLE_LATEST:
+            return 2;
+        case CameraBufferMode::PSRAM_DOUBLE_LATEST:
+        case CameraBufferMode::DRAM_SINGLE:
+        default:
+            return 1;
+    }
+}
+
+CameraBufferMode CameraBufferStrategy::getMode() {
+    return mode;
+}
+
+const char *CameraBufferStrategy::getName() {
+    switch (mode) {
+        case CameraBufferMode::PSRAM_TRIPLE_LATEST:
+            return "psram_x3_latest";
+        case CameraBufferMode::PSRAM_DOUBLE_LATEST:
+            return "psram_x2_latest";
+        case CameraBufferMode::DRAM_SINGLE:
+        default:
+            return "dram_x1_when_empty";
+    }
+}
+
+void CameraBufferStrategy::recordSendStart(int64_t captureTimeUs) {
+    int64_t latency = esp_timer_get_time() - captureTimeUs;
+    if (latency < 0) {
+        return;
+    }
+    uint32_t latencyUs = (uint32_t)latency;
+
+    portENTER_CRITICAL(&latencyMux);
+    if (averageLatencyUs == 0) {
+        averageLatencyUs = latencyUs;
+    } else {
+        // Exponential moving average with a weight of 1/8 for the new sample
+        averageLatencyUs = averageLatencyUs - (averageLatencyUs >> 3) + (latencyUs >> 3);
+    }
+    if (latencyUs > maxLatencyUs) {
+        maxLatencyUs = latencyUs;
+    }
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+uint32_t CameraBufferStrategy::getAverageLatencyMs() {
+    return averageLatencyUs / 1000;
+}
+
+uint32_t CameraBufferStrategy::getMaxLatencyMs() {
+    return maxLatencyUs / 1000;
+}
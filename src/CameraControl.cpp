@@ -0,0 +1,329 @@
+#include "CameraControl.h"
+#include "AdaptiveStreamController.h"
+#include "CameraPower.h"
+#include "FrameBroker.h"
+#include "RegionOfInterest.h"
+#include "WebCamConfiguration.h"
+
+// Sensor controls take their current value from the sensor status
+#define SENSOR_CONTROL(name, setter, field, minimum, maximum)                    \
+    { name, minimum, maximum, &sensor_t::setter,                                 \
+      [](const camera_status_t &status) { return (int)status.field; } }
+
+// Order is the layout of the saved settings: append new controls at the end
+const CameraControl::Control CameraControl::CONTROLS[CameraSettings::CONTROL_COUNT] = {
+    { "framesize", 0, AdaptiveStreamController::MAX_FRAME_SIZE, nullptr, nullptr },
+    { "quality", 4, 63, nullptr, nullptr },
+    { "adaptive", 0, 1, nullptr, nullptr },
+    SENSOR_CONTROL("brightness", set_brightness, brightness, -2, 2),
+    SENSOR_CONTROL("contrast", set_contrast, contrast, -2, 2),
+    SENSOR_CONTROL("saturation", set_saturation, saturation, -2, 2),
+    SENSOR_CONTROL("special_effect", set_special_effect, special_effect, 0, 6),
+    SENSOR_CONTROL("whitebal", set_whitebal, awb, 0, 1),
+    SENSOR_CONTROL("awb_gain", set_awb_gain, awb_gain, 0, 1),
+    SENSOR_CONTROL("wb_mode", set_wb_mode, wb_mode, 0, 4),
+    SENSOR_CONTROL("exposure_ctrl", set_exposure_ctrl, aec, 0, 1),
+    SENSOR_CONTROL("aec2", set_aec2, aec2, 0, 1),
+    SENSOR_CONTROL("ae_level", set_ae_level, ae_level, -2, 2),
+    SENSOR_CONTROL("aec_value", set_aec_value, aec_value, 0, 1200),
+    SENSOR_CONTROL("gain_ctrl", set_gain_ctrl, agc, 0, 1),
+    SENSOR_CONTROL("agc_gain", set_agc_gain, agc_gain, 0, 30),
+    SENSOR_CONTROL("bpc", set_bpc, bpc, 0, 1),
+    SENSOR_CONTROL("wpc", set_wpc, wpc, 0, 1),
+    SENSOR_CONTROL("raw_gma", set_raw_gma, raw_gma, 0, 1),
+    SENSOR_CONTROL("lenc", set_lenc, lenc, 0, 1),
+    SENSOR_CONTROL("hmirror", set_hmirror, hmirror, 0, 1),
+    SENSOR_CONTROL("vflip", set_vflip, vflip, 0, 1),
+    SENSOR_CONTROL("dcw", set_dcw, dcw, 0, 1),
+    { "roi_x", 0, RegionOfInterest::FIELD_WIDTH - RegionOfInterest::MIN_SIZE, nullptr, nullptr },
+    { "roi_y", 0, RegionOfInterest::FIELD_HEIGHT - RegionOfInterest::MIN_SIZE, nullptr, nullptr },
+    { "roi_w", 0, RegionOfInterest::FIELD_WIDTH, nullptr, nullptr },
+    { "roi_h", 0, RegionOfInterest::FIELD_HEIGHT, nullptr, nullptr },
+    { "standby_timeout_s", 0, CameraPower::MAX_STANDBY_TIMEOUT_S, nullptr, nullptr }
+};
+
+CameraSettings CameraControl::saved = {};
+CameraSettings CameraControl::pending = {};
+framesize_t CameraControl::initFrameSize = AdaptiveStreamController::DEFAULT_FRAME_SIZE;
+uint32_t CameraControl::savedGeneration = 0;
+portMUX_TYPE CameraControl::settingsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void CameraControl::loadSettings() {
+    if (!WebCamConfiguration::loadCameraSettings(saved)) {
+        saved = CameraSettings();
+    } else {
+        // Drop anything a corrupted or older blob holds that is now out of range
+        for (uint8_t i = 0; i < CameraSettings::CONTROL_COUNT; i++) {
+            if ((saved.mask & (1u << i)) &&
+                (saved.values[i] < CONTROLS[i].minimum || saved.values[i] > CONTROLS[i].maximum)) {
+                saved.mask &= ~(1u << i);
+            }
+        }
+        Serial.printf("Loaded %d saved camera control(s)\n", __builtin_popcount(saved.mask));
+    }
+
+    framesize_t frameSize = (saved.mask & (1u << FRAMESIZE)) ?
+        (framesize_t)saved.values[FRAMESIZE] : AdaptiveStreamController::DEFAULT_FRAME_SIZE;
+    int quality = (saved.mask & (1u << QUALITY)) ?
+        saved.values[QUALITY] : (int)AdaptiveStreamController::DEFAULT_QUALITY;
+    bool adaptive = !(saved.mask & (1u << ADAPTIVE)) || saved.values[ADAPTIVE] != 0;
+    AdaptiveStreamController::configure(frameSize, quality, adaptive);
+    CameraPower::setStandbyTimeout((saved.mask & (1u << STANDBY_TIMEOUT)) ?
+        saved.values[STANDBY_TIMEOUT] : (int16_t)CameraPower::DEFAULT_STANDBY_TIMEOUT_S);
+}
+
+void CameraControl::begin(framesize_t cameraFrameSize) {
+    initFrameSize = cameraFrameSize;
+    applySensorControls(saved);
+    configureRegion(saved, saved);
+    RegionOfInterest::apply();
+    FrameBroker::addBetweenFramesCallback(applyPending);
+}
+
+bool CameraControl::parse(CameraSettings &changes, const char *name, const char *value) {
+    int index = findControl(name);
+    if (index < 0 || value == nullptr || *value == '\0') {
+        return false;
+    }
+
+    long number;
+    framesize_t frameSize = index == FRAMESIZE ? AdaptiveStreamController::parseFrameSize(value) : FRAMESIZE_INVALID;
+    if (frameSize != FRAMESIZE_INVALID) {
+        number = frameSize;
+    } else if (strcasecmp(value, "true") == 0) {
+        number = 1;
+    } else if (strcasecmp(value, "false") == 0) {
+        number = 0;
+    } else {
+        char *end;
+        number = strtol(value, &end, 10);
+        if (*end != '\0') {
+            return false;
+        }
+    }
+
+    if (number < CONTROLS[index].minimum || number > CONTROLS[index].maximum) {
+        return false;
+    }
+    changes.values[index] = (int16_t)number;
+    changes.mask |= 1u << index;
+    return true;
+}
+
+bool CameraControl::apply(const CameraSettings &changes) {
+    if (changes.mask == 0) {
+        return true;
+    }
+
+    // Stage and record the batch together, so concurrent batches reach
+    // the saved copy in the order they are applied
+    portENTER_CRITICAL(&settingsMux);
+    merge(pending, changes);
+    merge(saved, changes);
+    savedGeneration++;
+    portEXIT_CRITICAL(&settingsMux);
+    // Not a sensor setting: the capture task may be parked, so set it here
+    if (changes.mask & (1u << STANDBY_TIMEOUT)) {
+        CameraPower::setStandbyTimeout(changes.values[STANDBY_TIMEOUT]);
+    }
+
+    // Saving can take a while, so it happens here rather than on the capture
+    // task, from a snapshot. Another batch may have saved a newer snapshot
+    // while this one was written; if so, write again so NVS keeps the latest.
+    bool stored;
+    bool superseded;
+    do {
+        portENTER_CRITICAL(&settingsMux);
+        CameraSettings snapshot = saved;
+        uint32_t generation = savedGeneration;
+        portEXIT_CRITICAL(&settingsMux);
+
+        stored = WebCamConfiguration::saveCameraSettings(snapshot);
+
+        portENTER_CRITICAL(&settingsMux);
+        superseded = savedGeneration != generation;
+        portEXIT_CRITICAL(&settingsMux);
+    } while (stored && superseded);
+
+    if (!stored) {
+        Serial.println("Failed to save camera controls");
+    }
+    return stored;
+}
+
+framesize_t CameraControl::getMaxFrameSize() {
+    return initFrameSize;
+}
+
+bool CameraControl::isRestartRequired() {
+    portENTER_CRITICAL(&settingsMux);
+    bool required = (saved.mask & (1u << FRAMESIZE)) && saved.values[FRAMESIZE] > initFrameSize;
+    portEXIT_CRITICAL(&settingsMux);
+    return required;
+}
+
+void CameraControl::addStatus(JsonDocument &doc) {
+    portENTER_CRITICAL(&settingsMux);
+    CameraSettings staged = pending;
+    CameraSettings stored = saved;
+    portEXIT_CRITICAL(&settingsMux);
+
+    sensor_t * s = esp_camera_sensor_get();
+    for (uint8_t i = 0; i < CameraSettings::CONTROL_COUNT; i++) {
+        uint32_t bit = 1u << i;
+        int value;
+        if (staged.mask & bit) {
+            value = staged.values[i];
+        } else if (CONTROLS[i].setter == nullptr) {
+            // Report the configured stream settings, even those waiting for a restart
+            if (stored.mask & bit) {
+                value = stored.values[i];
+            } else if (ROI_MASK & bit) {
+                value = 0;
+            } else if (i == STANDBY_TIMEOUT) {
+                value = CameraPower::getStandbyTimeout();
+            } else if (i == FRAMESIZE) {
+                value = AdaptiveStreamController::getBaseFrameSize();
+            } else if (i == QUALITY) {
+                value = AdaptiveStreamController::getBaseQuality();
+            } else {
+                value = AdaptiveStreamController::isAdaptive();
+            }
+        } else if (s != nullptr) {
+            value = CONTROLS[i].read(s->status);
+        } else {
+            continue;
+        }
+
+        if (i == FRAMESIZE) {
+            doc[CONTROLS[i].name] = AdaptiveStreamController::getFrameSizeName((framesize_t)value);
+        } else if (i == ADAPTIVE) {
+            doc[CONTROLS[i].name] = value != 0;
+        } else {
+            doc[CONTROLS[i].name] = value;
+        }
+    }
+
+    doc["stream_framesize"] = AdaptiveStreamController::getFrameSizeName();
+    doc["stream_quality"] = AdaptiveStreamController::getQuality();
+    doc["max_framesize"] = AdaptiveStreamController::getFrameSizeName(initFrameSize);
+    doc["restart_required"] = isRestartRequired();
+    RegionOfInterest::addStatus(doc);
+    CameraPower::addStatus(doc);
+}
+
+void CameraControl::handleCommand(JsonDocument &command) {
+    CameraSettings changes = {};
+    for (uint8_t i = 0; i < CameraSettings::CONTROL_COUNT; i++) {
+        JsonVariant value = command[CONTROLS[i].name];
+        if (value.isNull()) {
+            continue;
+        }
+
+        char text[16];
+        if (value.is<const char *>()) {
+            snprintf(text, sizeof(text), "%s", value.as<const char *>());
+        } else if (value.is<bool>()) {
+            snprintf(text, sizeof(text), "%d", value.as<bool>() ? 1 : 0);
+        } else {
+            snprintf(text, sizeof(text), "%ld", value.as<long>());
+        }
+        if (!parse(changes, CONTROLS[i].name, text)) {
+            Serial.printf("Control command rejected: invalid %s\n", CONTROLS[i].name);
+            return;
+        }
+    }
+
+    if (changes.mask == 0) {
+        Serial.println("Control command names no known control");
+        return;
+    }
+    apply(changes);
+}
+
+uint8_t CameraControl::getControlCount() {
+    return CameraSettings::CONTROL_COUNT;
+}
+
+const char *CameraControl::getControlName(uint8_t index) {
+    return index < CameraSettings::CONTROL_COUNT ? CONTROLS[index].name : nullptr;
+}
+
+void CameraControl::applyPending() {
+    if (pending.mask == 0) {
+        return;
+    }
+
+    // The saved copy already holds the staged changes; it fills in the
+    // parts of the region the batch leaves out
+    portENTER_CRITICAL(&settingsMux);
+    CameraSettings changes = pending;
+    CameraSettings current = saved;
+    pending.mask = 0;
+    portEXIT_CRITICAL(&settingsMux);
+
+    applySensorControls(changes);
+
+    if (changes.mask & STREAM_MASK) {
+        framesize_t frameSize = (changes.mask & (1u << FRAMESIZE)) ?
+            (framesize_t)changes.values[FRAMESIZE] : AdaptiveStreamController::getBaseFrameSize();
+        int quality = (changes.mask & (1u << QUALITY)) ?
+            changes.values[QUALITY] : AdaptiveStreamController::getBaseQuality();
+        bool adaptive = (changes.mask & (1u << ADAPTIVE)) ?
+            changes.values[ADAPTIVE] != 0 : AdaptiveStreamController::isAdaptive();
+        if (frameSize > initFrameSize) {
+            // Frames this large would overflow the framebuffers until a restart
+            frameSize = initFrameSize;
+        }
+        AdaptiveStreamController::configure(frameSize, quality, adaptive);
+    }
+
+    if (changes.mask & ROI_MASK) {
+        configureRegion(changes, current);
+        RegionOfInterest::apply();
+    }
+
+    Serial.printf("Camera controls applied (%d changed), stream %s q%d\n", __builtin_popcount(changes.mask),
+                  AdaptiveStreamController::getFrameSizeName(), AdaptiveStreamController::getQuality());
+}
+
+void CameraControl::configureRegion(const CameraSettings &settings, const CameraSettings &current) {
+    uint16_t region[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        uint32_t bit = 1u << (ROI_X + i);
+        region[i] = (settings.mask & bit) ? settings.values[ROI_X + i] :
+                    (current.mask & bit) ? current.values[ROI_X + i] : 0;
+    }
+    RegionOfInterest::configure(region[0], region[1], region[2], region[3]);
+}
+
+void CameraControl::applySensorControls(const CameraSettings &settings) {
+    sensor_t * s = esp_camera_sensor_get();
+    if (s == nullptr) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < CameraSettings::CONTROL_COUNT; i++) {
+        if ((settings.mask & (1u << i)) && CONTROLS[i].setter != nullptr) {
+            (s->*CONTROLS[i].setter)(s, settings.values[i]);
+        }
+    }
+}
+
+void CameraControl::merge(CameraSettings &target, const CameraSettings &changes) {
+    for (uint8_t i = 0; i < CameraSettings::CONTROL_COUNT; i++) {
+        if (changes.mask & (1u << i)) {
+            target.values[i] = changes.values[i];
+        }
+    }
+    target.mask |= changes.mask;
+}
+
+int CameraControl::findControl(const char *name) {
+    for (uint8_t i = 0; i < CameraSettings::CONTROL_COUNT; i++) {
+        if (strcmp(name, CONTROLS[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
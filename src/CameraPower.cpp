@@ -0,0 +1,207 @@
+#include "CameraPower.h"
+#include "StreamMetrics.h"
+#include <esp_timer.h>
+
+// Sensor standby bits for set_reg(); the OV2640 takes its register bank in bit 8
+static const int OV2640_COM2 = 0x109;
+static const int OV2640_STANDBY = 0x10;
+static const int OV3660_SYSTEM_CTROL0 = 0x3008;   // Same register on the OV5640
+static const int OV3660_POWER_DOWN = 0x40;
+
+int CameraPower::pwdnPin = -1;
+volatile CameraPowerState CameraPower::state = CameraPowerState::ACTIVE;
+uint16_t CameraPower::standbyTimeoutS = CameraPower::DEFAULT_STANDBY_TIMEOUT_S;
+uint32_t CameraPower::idleTimeoutMs = 0;
+uint32_t CameraPower::idleSinceMs = 0;
+bool CameraPower::unsupportedWarned = false;
+int64_t CameraPower::wakeStartUs = 0;
+uint8_t CameraPower::framesToDiscard = 0;
+uint32_t CameraPower::wakeCount = 0;
+uint32_t CameraPower::lastWakeMs = 0;
+uint32_t CameraPower::maxWakeMs = 0;
+uint64_t CameraPower::standbyTotalMs = 0;
+uint32_t CameraPower::standbySinceMs = 0;
+portMUX_TYPE CameraPower::statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void CameraPower::begin(int pin) {
+    pwdnPin = pin;
+    if (pwdnPin >= 0) {
+        // esp_camera_init() left the line low, powering the sensor
+        pinMode(pwdnPin, OUTPUT);
+        digitalWrite(pwdnPin, LOW);
+    }
+    // Counting down from boot parks a camera nobody opens
+    state = CameraPowerState::IDLE;
+    idleSinceMs = millis();
+    idleTimeoutMs = (uint32_t)standbyTimeoutS * 1000;
+}
+
+void CameraPower::setStandbyTimeout(uint16_t seconds) {
+    standbyTimeoutS = min(seconds, (uint16_t)MAX_STANDBY_TIMEOUT_S);
+}
+
+uint16_t CameraPower::getStandbyTimeout() {
+    return standbyTimeoutS;
+}
+
+void CameraPower::resume() {
+    if (state == CameraPowerState::STANDBY) {
+        wake();
+    } else if (state == CameraPowerState::IDLE) {
+        state = CameraPowerState::ACTIVE;
+    }
+}
+
+uint32_t CameraPower::idle() {
+    if (state == CameraPowerState::STANDBY) {
+        return NEVER;
+    }
+    uint32_t now = millis();
+    if (state != CameraPowerState::IDLE) {
+        // A wake nobody waited for is not timed
+        state = CameraPowerState::IDLE;
+        idleSinceMs = now;
+        idleTimeoutMs = (uint32_t)standbyTimeoutS * 1000;
+    }
+    if (idleTimeoutMs == 0) {
+        return NEVER;
+    }
+
+    uint32_t idleMs = now - idleSinceMs;
+    if (idleMs < idleTimeoutMs) {
+        return idleTimeoutMs - idleMs;
+    }
+    if (!park()) {
+        // Nothing to park with; stay powered until the next idle period
+        idleTimeoutMs = 0;
+    }
+    return NEVER;
+}
+
+bool CameraPower::acceptFrame(const camera_fb_t *fb) {
+    if (state != CameraPowerState::WAKING) {
+        return true;
+    }
+
+    // Frames the driver held from before the sensor was parked
+    int64_t captureUs = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    if (captureUs < wakeStartUs) {
+        return false;
+    }
+    if (framesToDiscard > 0) {
+        framesToDiscard--;
+        return false;
+    }
+
+    uint32_t wakeUs = (uint32_t)(esp_timer_get_time() - wakeStartUs);
+    StreamMetrics::recordCameraWake(wakeUs);
+    portENTER_CRITICAL(&statsMux);
+    lastWakeMs = wakeUs / 1000;
+    if (lastWakeMs > maxWakeMs) {
+        maxWakeMs = lastWakeMs;
+    }
+    wakeCount++;
+    portEXIT_CRITICAL(&statsMux);
+    state = CameraPowerState::ACTIVE;
+    Serial.printf("Camera awake, first frame after %u ms\n", (unsigned)(wakeUs / 1000));
+    return true;
+}
+
+bool CameraPower::isParked() {
+    return state == CameraPowerState::STANDBY;
+}
+
+CameraPowerState CameraPower::getState() {
+    return state;
+}
+
+const char *CameraPower::getStateName() {
+    return getStateName(state);
+}
+
+const char *CameraPower::getStateName(CameraPowerState powerState) {
+    static const char *const NAMES[] = {"active", "idle", "standby", "waking"};
+    return NAMES[(uint8_t)powerState];
+}
+
+uint32_t CameraPower::getWakeCount() {
+    return wakeCount;
+}
+
+uint32_t CameraPower::getLastWakeMs() {
+    return lastWakeMs;
+}
+
+uint32_t CameraPower::getMaxWakeMs() {
+    return maxWakeMs;
+}
+
+uint32_t CameraPower::getStandbySeconds() {
+    portENTER_CRITICAL(&statsMux);
+    uint64_t totalMs = standbyTotalMs;
+    if (state == CameraPowerState::STANDBY) {
+        totalMs += millis() - standbySinceMs;
+    }
+    portEXIT_CRITICAL(&statsMux);
+    return (uint32_t)(totalMs / 1000);
+}
+
+void CameraPower::addStatus(JsonDocument &doc) {
+    doc["camera_state"] = getStateName();
+    doc["camera_standby_s"] = getStandbySeconds();
+    doc["camera_wakes"] = getWakeCount();
+    doc["camera_wake_ms"] = getLastWakeMs();
+    doc["camera_wake_avg_ms"] = StreamMetrics::getAverageWakeMs();
+    doc["camera_wake_max_ms"] = getMaxWakeMs();
+}
+
+bool CameraPower::park() {
+    if (pwdnPin >= 0) {
+        digitalWrite(pwdnPin, HIGH);
+    } else if (!setSensorStandby(true)) {
+        if (!unsupportedWarned) {
+            Serial.println("Camera standby needs a PWDN pin or an OV2640, OV3660 or OV5640 sensor");
+            unsupportedWarned = true;
+        }
+        return false;
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    standbySinceMs = millis();
+    portEXIT_CRITICAL(&statsMux);
+    state = CameraPowerState::STANDBY;
+    Serial.printf("Camera in standby after %u s without viewers\n", (unsigned)(idleTimeoutMs / 1000));
+    return true;
+}
+
+void CameraPower::wake() {
+    wakeStartUs = esp_timer_get_time();
+    if (pwdnPin >= 0) {
+        digitalWrite(pwdnPin, LOW);
+        vTaskDelay(pdMS_TO_TICKS(PWDN_SETTLE_MS));
+    } else {
+        setSensorStandby(false);
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    standbyTotalMs += millis() - standbySinceMs;
+    portEXIT_CRITICAL(&statsMux);
+    framesToDiscard = WAKE_DISCARD_FRAMES;
+    state = CameraPowerState::WAKING;
+}
+
+bool CameraPower::setSensorStandby(bool standby) {
+    sensor_t * s = esp_camera_sensor_get();
+    if (s == nullptr || s->set_reg == nullptr) {
+        return false;
+    }
+    switch (s->id.PID) {
+        case OV2640_PID:
+            return s->set_reg(s, OV2640_COM2, OV2640_STANDBY, standby ? OV2640_STANDBY : 0) == 0;
+        case OV3660_PID:
+        case OV5640_PID:
+            return s->set_reg(s, OV3660_SYSTEM_CTROL0, OV3660_POWER_DOWN, standby ? OV3660_POWER_DOWN : 0) == 0;
+        default:
+            return false;
+    }
+}
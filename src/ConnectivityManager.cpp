@@ -0,0 +1,174 @@
+#include "ConnectivityManager.h"
+#include "ConfigurationManager.h"
+#include "MqttCommandChannel.h"
+#include "MqttHandler.h"
+
+LinkState ConnectivityManager::wifiState = LinkState::WAITING;
+LinkState ConnectivityManager::mqttState = LinkState::WAITING;
+uint32_t ConnectivityManager::wifiRetryAtMs = 0;
+uint32_t ConnectivityManager::wifiDeadlineMs = 0;
+uint32_t ConnectivityManager::wifiBackoffMs = ConnectivityManager::MIN_BACKOFF_MS;
+uint32_t ConnectivityManager::wifiLostAtMs = 0;
+uint32_t ConnectivityManager::mqttRetryAtMs = 0;
+uint32_t ConnectivityManager::mqttBackoffMs = ConnectivityManager::MIN_BACKOFF_MS;
+uint32_t ConnectivityManager::commandRetryAtMs = 0;
+uint32_t ConnectivityManager::commandBackoffMs = ConnectivityManager::MIN_BACKOFF_MS;
+uint32_t ConnectivityManager::wifiReconnects = 0;
+uint32_t ConnectivityManager::mqttReconnects = 0;
+TaskScheduler::Job ConnectivityManager::mqttConnectedJob = nullptr;
+
+void ConnectivityManager::begin(TaskScheduler::Job onMqttConnected) {
+    mqttConnectedJob = onMqttConnected;
+    // The bits below are set before the scheduler task starts
+    TaskScheduler::init();
+
+    uint32_t now = millis();
+    wifiState = WiFi.status() == WL_CONNECTED ? LinkState::CONNECTED : LinkState::WAITING;
+    mqttState = MqttHandler::isConnected() ? LinkState::CONNECTED : LinkState::WAITING;
+    wifiRetryAtMs = now;
+    mqttRetryAtMs = now;
+    commandRetryAtMs = now;
+    wifiLostAtMs = now;
+    if (wifiState == LinkState::CONNECTED) {
+        TaskScheduler::setEvents(TaskScheduler::WIFI_UP);
+    }
+    if (mqttState == LinkState::CONNECTED) {
+        TaskScheduler::setEvents(TaskScheduler::MQTT_UP);
+    }
+
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    TaskScheduler::addPeriodic(service, SERVICE_INTERVAL_MS);
+}
+
+void ConnectivityManager::service() {
+    uint32_t now = millis();
+    updateWiFi(now);
+    updateMqtt(now);
+    updateCommandChannel(now);
+}
+
+uint32_t ConnectivityManager::getWiFiReconnects() {
+    return wifiReconnects;
+}
+
+uint32_t ConnectivityManager::getMqttReconnects() {
+    return mqttReconnects;
+}
+
+void ConnectivityManager::onWiFiEvent(arduino_event_id_t event) {
+    // React now rather than at the next service run
+    TaskScheduler::post(service);
+}
+
+void ConnectivityManager::updateWiFi(uint32_t nowMs) {
+    bool associated = WiFi.status() == WL_CONNECTED;
+
+    if (wifiState == LinkState::CONNECTED) {
+        if (!associated) {
+            // Give the driver's own reconnect a moment before starting over
+            Serial.println("Wi-Fi lost");
+            TaskScheduler::clearEvents(TaskScheduler::WIFI_UP);
+            wifiState = LinkState::WAITING;
+            wifiLostAtMs = nowMs;
+            wifiRetryAtMs = nowMs + MIN_BACKOFF_MS;
+            wifiBackoffMs = MIN_BACKOFF_MS;
+        }
+        return;
+    }
+
+    if (associated) {
+        wifiState = LinkState::CONNECTED;
+        wifiReconnects++;
+        TaskScheduler::setEvents(TaskScheduler::WIFI_UP);
+        Serial.printf("Wi-Fi reconnected after %u ms, IP %s\n",
+                      nowMs - wifiLostAtMs, WiFi.localIP().toString().c_str());
+        return;
+    }
+
+    if (wifiState == LinkState::WAITING && (int32_t)(nowMs - wifiRetryAtMs) >= 0) {
+        // Start associating and come back to see how it went
+        auto config = ConfigurationManager::getConfig();
+        WiFi.disconnect();
+        WiFi.begin(config.wifiSSID.c_str(), config.wifiPassword.c_str());
+        wifiState = LinkState::CONNECTING;
+        wifiDeadlineMs = nowMs + (uint32_t)config.wifiTimeoutSeconds * 1000;
+    } else if (wifiState == LinkState::CONNECTING && (int32_t)(nowMs - wifiDeadlineMs) >= 0) {
+        Serial.printf("Wi-Fi association timed out, retrying in %u s\n", wifiBackoffMs / 1000);
+        wifiState = LinkState::WAITING;
+        wifiRetryAtMs = nowMs + wifiBackoffMs;
+        wifiBackoffMs = wifiBackoffMs * 2 < MAX_BACKOFF_MS ? wifiBackoffMs * 2 : MAX_BACKOFF_MS;
+    }
+}
+
+void ConnectivityManager::updateMqtt(uint32_t nowMs) {
+    if (wifiState != LinkState::CONNECTED) {
+        if (mqttState == LinkState::CONNECTED) {
+            TaskScheduler::clearEvents(TaskScheduler::MQTT_UP);
+            mqttState = LinkState::WAITING;
+        }
+        // Try as soon as Wi-Fi is back
+        mqttRetryAtMs = nowMs;
+        mqttBackoffMs = MIN_BACKOFF_MS;
+        return;
+    }
+
+    if (mqttState == LinkState::CONNECTED) {
+        if (MqttHandler::isConnected()) {
+            MqttHandler::loop();
+            return;
+        }
+        Serial.println("MQTT lost");
+        TaskScheduler::clearEvents(TaskScheduler::MQTT_UP);
+        mqttState = LinkState::WAITING;
+        mqttRetryAtMs = nowMs;
+        mqttBackoffMs = MIN_BACKOFF_MS;
+    }
+
+    if ((int32_t)(nowMs - mqttRetryAtMs) < 0) {
+        return;
+    }
+
+    // One short attempt; a broker that is down costs this task a second
+    // at most, and nothing else
+    if (MqttHandler::connect(MQTT_ATTEMPT_TIMEOUT_S)) {
+        mqttState = LinkState::CONNECTED;
+        mqttReconnects++;
+        mqttBackoffMs = MIN_BACKOFF_MS;
+        TaskScheduler::setEvents(TaskScheduler::MQTT_UP);
+        Serial.println("MQTT reconnected");
+        if (mqttConnectedJob != nullptr) {
+            TaskScheduler::post(mqttConnectedJob);
+        }
+    } else {
+        mqttRetryAtMs = millis() + mqttBackoffMs;
+        mqttBackoffMs = mqttBackoffMs * 2 < MAX_BACKOFF_MS ? mqttBackoffMs * 2 : MAX_BACKOFF_MS;
+    }
+}
+
+void ConnectivityManager::updateCommandChannel(uint32_t nowMs) {
+    if (wifiState != LinkState::CONNECTED) {
+        return;
+    }
+    if (MqttCommandChannel::isConnected()) {
+        MqttCommandChannel::loop();
+        return;
+    }
+    if (mqttState != LinkState::CONNECTED) {
+        // Try as soon as the main connection is back
+        commandRetryAtMs = nowMs;
+        commandBackoffMs = MIN_BACKOFF_MS;
+        return;
+    }
+    if ((int32_t)(nowMs - commandRetryAtMs) < 0) {
+        return;
+    }
+
+    if (MqttCommandChannel::connect()) {
+        commandBackoffMs = MIN_BACKOFF_MS;
+        MqttCommandChannel::loop();
+    } else {
+        commandRetryAtMs = millis() + commandBackoffMs;
+        commandBackoffMs = commandBackoffMs * 2 < MAX_BACKOFF_MS ? commandBackoffMs * 2 : MAX_BACKOFF_MS;
+    }
+}
@@ -0,0 +1,479 @@
+#include "FrameBroker.h"
+#include "BootProfiler.h"
+#include "CameraPower.h"
+#include "RegionOfInterest.h"
+#include "StreamMetrics.h"
+#include "TaskConfig.h"
+#include <esp_timer.h>
+
+SharedFrame FrameBroker::frames[FrameBroker::MAX_FRAMES];
+FrameBroker::Subscriber FrameBroker::subscribers[FrameBroker::MAX_SUBSCRIBERS];
+SharedFrame *FrameBroker::latest = nullptr;
+uint8_t FrameBroker::framebufferCount = 1;
+uint8_t FrameBroker::outstandingFrames = 0;
+uint8_t FrameBroker::subscriberCount = 0;
+uint8_t FrameBroker::awakeSubscriberCount = 0;
+uint32_t FrameBroker::sequence = 0;
+uint32_t FrameBroker::epoch = 0;
+SemaphoreHandle_t FrameBroker::lock = nullptr;
+SemaphoreHandle_t FrameBroker::frameReleased = nullptr;
+TaskHandle_t FrameBroker::captureTask = nullptr;
+void (*FrameBroker::betweenFramesCallbacks[FrameBroker::MAX_CALLBACKS])();
+uint8_t FrameBroker::callbackCount = 0;
+FrameBroker::StillRequest FrameBroker::still = {};
+SemaphoreHandle_t FrameBroker::stillLock = nullptr;
+SemaphoreHandle_t FrameBroker::stillReady = nullptr;
+int64_t FrameBroker::lastPublishUs = 0;
+int64_t FrameBroker::stillGapStartUs = 0;
+uint32_t FrameBroker::lastStillGapMs = 0;
+
+bool FrameBroker::begin(uint8_t count) {
+    framebufferCount = count;
+    if (framebufferCount < 1) {
+        framebufferCount = 1;
+    } else if (framebufferCount > MAX_FRAMES) {
+        framebufferCount = MAX_FRAMES;
+    }
+
+    if (captureTask != nullptr) {
+        return true;
+    }
+
+    epoch = esp_random();
+    lock = xSemaphoreCreateMutex();
+    frameReleased = xSemaphoreCreateBinary();
+    stillLock = xSemaphoreCreateMutex();
+    stillReady = xSemaphoreCreateBinary();
+    if (lock == nullptr || frameReleased == nullptr || stillLock == nullptr || stillReady == nullptr) {
+        Serial.println("Failed to create frame broker semaphores");
+        return false;
+    }
+
+    for (uint8_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        subscribers[i].active = false;
+        subscribers[i].frameReady = xSemaphoreCreateBinary();
+        if (subscribers[i].frameReady == nullptr) {
+            Serial.println("Failed to create subscriber semaphore");
+            return false;
+        }
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        captureLoop, "capture", CAPTURE_TASK_STACK, nullptr,
+        CAPTURE_TASK_PRIORITY, &captureTask, CAPTURE_TASK_CORE);
+    if (created != pdPASS) {
+        Serial.println("Failed to start capture task");
+        captureTask = nullptr;
+        return false;
+    }
+
+    Serial.printf("Capture task started (%u framebuffer(s))\n", framebufferCount);
+    return true;
+}
+
+int FrameBroker::subscribe(bool keepAwake) {
+    int subscriberId = -1;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        if (!subscribers[i].active) {
+            subscribers[i].active = true;
+            subscribers[i].keepsAwake = keepAwake;
+            // Only frames captured from now on are of interest
+            subscribers[i].lastSequence = sequence;
+            subscribers[i].droppedFrames = 0;
+            xSemaphoreTake(subscribers[i].frameReady, 0);
+            subscriberCount++;
+            if (keepAwake) {
+                awakeSubscriberCount++;
+            }
+            subscriberId = i;
+            break;
+        }
+    }
+    xSemaphoreGive(lock);
+
+    if (subscriberId >= 0) {
+        xTaskNotifyGive(captureTask);
+    }
+    return subscriberId;
+}
+
+void FrameBroker::unsubscribe(int subscriberId) {
+    if (subscriberId < 0 || subscriberId >= MAX_SUBSCRIBERS) {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (subscribers[subscriberId].active) {
+        subscribers[subscriberId].active = false;
+        subscriberCount--;
+        if (subscribers[subscriberId].keepsAwake) {
+            awakeSubscriberCount--;
+        }
+    }
+    xSemaphoreGive(lock);
+}
+
+SharedFrame *FrameBroker::waitForFrame(int subscriberId, TickType_t timeout) {
+    if (subscriberId < 0 || subscriberId >= MAX_SUBSCRIBERS) {
+        return nullptr;
+    }
+
+    Subscriber &subscriber = subscribers[subscriberId];
+    TickType_t start = xTaskGetTickCount();
+
+    while (true) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        if (latest != nullptr && latest->sequence > subscriber.lastSequence) {
+            SharedFrame *frame = latest;
+            frame->refCount++;
+            subscriber.droppedFrames += frame->sequence - subscriber.lastSequence - 1;
+            subscriber.lastSequence = frame->sequence;
+            xSemaphoreGive(lock);
+            return frame;
+        }
+        xSemaphoreGive(lock);
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return nullptr;
+        }
+        xSemaphoreTake(subscriber.frameReady, timeout - elapsed);
+    }
+}
+
+SharedFrame *FrameBroker::acquireLatest(uint32_t maxAgeMs) {
+    SharedFrame *frame = nullptr;
+    int64_t oldestCaptureUs = esp_timer_get_time() - (int64_t)maxAgeMs * 1000;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (latest != nullptr && latest->captureTimeUs >= oldestCaptureUs) {
+        frame = latest;
+        frame->refCount++;
+    }
+    xSemaphoreGive(lock);
+
+    return frame;
+}
+
+SharedFrame *FrameBroker::waitForFrameAfter(uint32_t afterSequence, TickType_t timeout) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (latest != nullptr && latest->sequence > afterSequence) {
+        SharedFrame *frame = latest;
+        frame->refCount++;
+        xSemaphoreGive(lock);
+        return frame;
+    }
+    xSemaphoreGive(lock);
+
+    if (timeout == 0) {
+        return nullptr;
+    }
+
+    int subscriberId = subscribe();
+    if (subscriberId < 0) {
+        return nullptr;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (afterSequence < subscribers[subscriberId].lastSequence) {
+        subscribers[subscriberId].lastSequence = afterSequence;
+    }
+    xSemaphoreGive(lock);
+
+    SharedFrame *frame = waitForFrame(subscriberId, timeout);
+    unsubscribe(subscriberId);
+    return frame;
+}
+
+void FrameBroker::release(SharedFrame *frame) {
+    if (frame == nullptr) {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    releaseLocked(frame);
+    xSemaphoreGive(lock);
+}
+
+uint32_t FrameBroker::getCapturedFrameCount() {
+    return sequence;
+}
+
+uint32_t FrameBroker::getDroppedFrameCount(int subscriberId) {
+    if (subscriberId < 0 || subscriberId >= MAX_SUBSCRIBERS) {
+        return 0;
+    }
+    return subscribers[subscriberId].droppedFrames;
+}
+
+uint8_t FrameBroker::getSubscriberCount() {
+    return subscriberCount;
+}
+
+uint32_t FrameBroker::getEpoch() {
+    return epoch;
+}
+
+bool FrameBroker::addBetweenFramesCallback(void (*callback)()) {
+    if (callbackCount >= MAX_CALLBACKS) {
+        return false;
+    }
+    betweenFramesCallbacks[callbackCount++] = callback;
+    return true;
+}
+
+SharedFrame *FrameBroker::captureStill(framesize_t frameSize, int quality, TickType_t timeout) {
+    if (captureTask == nullptr || frameSize >= FRAMESIZE_INVALID) {
+        return nullptr;
+    }
+    if (xSemaphoreTake(stillLock, timeout) != pdTRUE) {
+        return nullptr;
+    }
+
+    xSemaphoreTake(stillReady, 0);
+    xSemaphoreTake(lock, portMAX_DELAY);
+    still.frameSize = frameSize;
+    still.quality = quality;
+    still.frame = nullptr;
+    still.pending = true;
+    xSemaphoreGive(lock);
+    xTaskNotifyGive(captureTask);
+
+    xSemaphoreTake(stillReady, timeout);
+
+    // Clearing pending abandons a still that has not arrived in time
+    xSemaphoreTake(lock, portMAX_DELAY);
+    SharedFrame *frame = still.frame;
+    still.frame = nullptr;
+    still.pending = false;
+    xSemaphoreGive(lock);
+
+    xSemaphoreGive(stillLock);
+    return frame;
+}
+
+uint32_t FrameBroker::getLastStillGapMs() {
+    return lastStillGapMs;
+}
+
+void FrameBroker::captureLoop(void *parameter) {
+    while (true) {
+        if (awakeSubscriberCount > 0 || still.pending || still.switched) {
+            CameraPower::resume();
+        } else {
+            uint32_t standbyInMs = CameraPower::idle();
+            if (subscriberCount == 0 || CameraPower::isParked()) {
+                // Nobody is watching - sleep until the next subscribe() or still,
+                // or until it is time to park the sensor
+                ulTaskNotifyTake(pdTRUE, standbyInMs == CameraPower::NEVER ?
+                                 portMAX_DELAY : pdMS_TO_TICKS(standbyInMs) + 1);
+                continue;
+            }
+        }
+
+        waitForFreeFramebuffer();
+
+        if (!still.switched) {
+            for (uint8_t i = 0; i < callbackCount; i++) {
+                betweenFramesCallbacks[i]();
+            }
+        }
+        beginStill();
+
+        int64_t fbGetStart = esp_timer_get_time();
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (!fb) {
+            StreamMetrics::recordCaptureFailure();
+            Serial.println("Camera capture failed");
+            vTaskDelay(pdMS_TO_TICKS(CAPTURE_RETRY_DELAY_MS));
+            continue;
+        }
+        if (!CameraPower::acceptFrame(fb)) {
+            // From before the sensor was parked, or not yet settled after it woke
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        if (fb->format != PIXFORMAT_JPEG) {
+            Serial.println("Non-JPEG format not supported");
+            esp_camera_fb_return(fb);
+            vTaskDelay(pdMS_TO_TICKS(CAPTURE_RETRY_DELAY_MS));
+            continue;
+        }
+
+        StreamMetrics::recordFrameCaptured((uint32_t)(esp_timer_get_time() - fbGetStart));
+        BootProfiler::recordFrameCaptured();
+        if (!takeStill(fb)) {
+            RegionOfInterest::recordFrame(fb);
+            publish(fb);
+        }
+    }
+}
+
+void FrameBroker::beginStill() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool pending = still.pending;
+    xSemaphoreGive(lock);
+
+    if (still.switched) {
+        if (!pending) {
+            // Abandoned by the requester
+            endStill();
+        }
+        return;
+    }
+    if (!pending) {
+        return;
+    }
+
+    sensor_t * s = esp_camera_sensor_get();
+    if (s == nullptr) {
+        return;
+    }
+    still.streamFrameSize = (framesize_t)s->status.framesize;
+    still.streamQuality = s->status.quality;
+    still.framesWaited = 0;
+    s->set_quality(s, still.quality);
+    // Stills take the whole field, so a cropped stream needs the window reset too
+    if (still.frameSize != still.streamFrameSize || RegionOfInterest::isActive()) {
+        s->set_framesize(s, still.frameSize);
+    }
+    still.switched = true;
+}
+
+bool FrameBroker::takeStill(camera_fb_t *fb) {
+    if (!still.switched) {
+        return false;
+    }
+
+    // Frames captured before the switch are still at the old size
+    bool matches = fb->width == resolution[still.frameSize].width &&
+                   fb->height == resolution[still.frameSize].height;
+    if (!matches && ++still.framesWaited < STILL_MAX_FRAMES) {
+        return false;
+    }
+    endStill();
+
+    bool taken = false;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool pending = still.pending;
+    if (pending && matches) {
+        for (uint8_t i = 0; i < MAX_FRAMES; i++) {
+            if (frames[i].fb == nullptr) {
+                // Not part of the stream, so it takes no sequence number
+                frames[i].fb = fb;
+                frames[i].sequence = 0;
+                frames[i].refCount = 1;   // Held by the requester
+                frames[i].captureTimeUs = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+                outstandingFrames++;
+                still.frame = &frames[i];
+                stillGapStartUs = lastPublishUs;
+                taken = true;
+                break;
+            }
+        }
+    }
+    still.pending = false;
+    xSemaphoreGive(lock);
+
+    if (pending) {
+        if (!matches) {
+            Serial.printf("Sensor did not switch to %ux%u for a still\n",
+                          resolution[still.frameSize].width, resolution[still.frameSize].height);
+        }
+        xSemaphoreGive(stillReady);
+    }
+    return taken;
+}
+
+void FrameBroker::endStill() {
+    sensor_t * s = esp_camera_sensor_get();
+    if (s != nullptr) {
+        s->set_quality(s, still.streamQuality);
+        if (still.frameSize != still.streamFrameSize || RegionOfInterest::isActive()) {
+            s->set_framesize(s, still.streamFrameSize);
+            RegionOfInterest::apply();
+        }
+    }
+    still.switched = false;
+}
+
+void FrameBroker::waitForFreeFramebuffer() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    while (outstandingFrames >= framebufferCount) {
+        if (latest != nullptr && latest->refCount == 1) {
+            // Only the slot itself holds the latest frame, so hand its buffer back
+            SharedFrame *stale = latest;
+            latest = nullptr;
+            releaseLocked(stale);
+            break;
+        }
+
+        // Every framebuffer is still being sent to a client
+        xSemaphoreGive(lock);
+        xSemaphoreTake(frameReleased, pdMS_TO_TICKS(CAPTURE_RETRY_DELAY_MS));
+        xSemaphoreTake(lock, portMAX_DELAY);
+    }
+    xSemaphoreGive(lock);
+}
+
+void FrameBroker::publish(camera_fb_t *fb) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    SharedFrame *slot = nullptr;
+    for (uint8_t i = 0; i < MAX_FRAMES; i++) {
+        if (frames[i].fb == nullptr) {
+            slot = &frames[i];
+            break;
+        }
+    }
+
+    if (slot == nullptr) {
+        xSemaphoreGive(lock);
+        Serial.println("No free frame slot, dropping frame");
+        esp_camera_fb_return(fb);
+        return;
+    }
+
+    slot->fb = fb;
+    slot->sequence = ++sequence;
+    slot->refCount = 1;  // Reference held by the latest frame slot
+    slot->captureTimeUs = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    outstandingFrames++;
+
+    if (stillGapStartUs != 0) {
+        lastStillGapMs = (uint32_t)((slot->captureTimeUs - stillGapStartUs) / 1000);
+        stillGapStartUs = 0;
+    }
+    lastPublishUs = slot->captureTimeUs;
+
+    SharedFrame *previous = latest;
+    latest = slot;
+    if (previous != nullptr) {
+        releaseLocked(previous);
+    }
+
+    for (uint8_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active) {
+            xSemaphoreGive(subscribers[i].frameReady);
+        }
+    }
+
+    xSemaphoreGive(lock);
+}
+
+void FrameBroker::releaseLocked(SharedFrame *frame) {
+    if (frame->refCount == 0) {
+        return;
+    }
+
+    frame->refCount--;
+    if (frame->refCount == 0) {
+        esp_camera_fb_return(frame->fb);
+        frame->fb = nullptr;
+        outstandingFrames--;
+        xSemaphoreGive(frameReleased);
+    }
+}
@@ -0,0 +1,337 @@
+#include "FrameHistory.h"
+#include "AdaptiveStreamController.h"
+#include "FrameBroker.h"
+#include "TaskConfig.h"
+#include <esp_timer.h>
+
+JpegArena FrameHistory::arena(FrameHistory::MAX_RECORDS, FrameHistory::canEvict);
+uint32_t FrameHistory::averageFrameBytes = 0;
+uint32_t FrameHistory::framesRecorded = 0;
+uint32_t FrameHistory::framesRejected = 0;
+
+ClipState FrameHistory::clipState = ClipState::IDLE;
+uint32_t FrameHistory::clipFirstRecord = 0;
+uint32_t FrameHistory::clipLastRecord = 0;
+int64_t FrameHistory::clipEndUs = 0;
+uint32_t FrameHistory::clipReadyMs = 0;
+bool FrameHistory::clipTruncated = false;
+uint8_t FrameHistory::exportCount = 0;
+
+SemaphoreHandle_t FrameHistory::lock = nullptr;
+TaskHandle_t FrameHistory::recordTask = nullptr;
+
+bool FrameHistory::begin() {
+    if (recordTask != nullptr) {
+        return true;
+    }
+
+    if (!psramFound()) {
+        Serial.println("No PSRAM - frame history disabled");
+        return false;
+    }
+
+    // Take what PSRAM can spare after the framebuffers, up to the maximum
+    size_t size = JpegArena::getAvailableSize(ARENA_MAX_BYTES, ARENA_MIN_BYTES, PSRAM_RESERVE_BYTES);
+    if (size == 0) {
+        Serial.println("Not enough PSRAM for frame history");
+        return false;
+    }
+
+    lock = xSemaphoreCreateMutex();
+    if (lock == nullptr || !arena.allocate(size)) {
+        Serial.println("Failed to allocate frame history");
+        return false;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        recordLoop, "history", TASK_STACK, nullptr,
+        HISTORY_TASK_PRIORITY, &recordTask, HISTORY_TASK_CORE);
+    if (created != pdPASS) {
+        Serial.println("Failed to start frame history task");
+        recordTask = nullptr;
+        return false;
+    }
+
+    Serial.printf("Frame history: %u KB of PSRAM at %u fps\n", (unsigned)(arena.getSize() / 1024), RECORD_FPS);
+    return true;
+}
+
+bool FrameHistory::isAvailable() {
+    return recordTask != nullptr;
+}
+
+bool FrameHistory::trigger(uint32_t preSeconds, uint32_t postSeconds) {
+    if (!isAvailable()) {
+        return false;
+    }
+    if (preSeconds > MAX_PRE_SECONDS) {
+        preSeconds = MAX_PRE_SECONDS;
+    }
+    if (postSeconds > MAX_POST_SECONDS) {
+        postSeconds = MAX_POST_SECONDS;
+    }
+
+    int64_t nowUs = esp_timer_get_time();
+    int64_t startUs = nowUs - (int64_t)preSeconds * 1000000;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    updateClipLocked(nowUs);
+    if (clipState != ClipState::IDLE) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    clipFirstRecord = arena.getNext();
+    for (uint32_t serial = arena.getOldest(); serial != arena.getNext(); serial++) {
+        if (arena.at(serial).captureTimeUs >= startUs) {
+            clipFirstRecord = serial;
+            break;
+        }
+    }
+    clipEndUs = nowUs + (int64_t)postSeconds * 1000000;
+    clipTruncated = false;
+    clipState = ClipState::RECORDING;
+    updateClipLocked(nowUs);
+    xSemaphoreGive(lock);
+
+    Serial.printf("Clip triggered: %u s before, %u s after\n", preSeconds, postSeconds);
+    return true;
+}
+
+void FrameHistory::releaseClip() {
+    if (!isAvailable()) {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (exportCount > 0) {
+        // Expire the clip as soon as the running export finishes
+        clipReadyMs = millis() - CLIP_HOLD_MS;
+    } else {
+        clipState = ClipState::IDLE;
+    }
+    xSemaphoreGive(lock);
+}
+
+void FrameHistory::handleCommand(JsonDocument &command) {
+    if (command["release"] | false) {
+        releaseClip();
+        return;
+    }
+    uint32_t pre = command["pre"] | (uint32_t)DEFAULT_PRE_SECONDS;
+    uint32_t post = command["post"] | (uint32_t)DEFAULT_POST_SECONDS;
+    if (!trigger(pre, post)) {
+        Serial.println("Clip command ignored: no history or a clip is already held");
+    }
+}
+
+ClipState FrameHistory::getClipState() {
+    if (!isAvailable()) {
+        return ClipState::IDLE;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    updateClipLocked(esp_timer_get_time());
+    ClipState state = clipState;
+    xSemaphoreGive(lock);
+    return state;
+}
+
+void FrameHistory::updateClipLocked(int64_t nowUs) {
+    if (clipState == ClipState::RECORDING && (nowUs >= clipEndUs || clipTruncated)) {
+        // The clip ends with the last frame captured inside the window
+        uint32_t count = arena.getNext() - clipFirstRecord;
+        while (count > 0 && arena.at(clipFirstRecord + count - 1).captureTimeUs > clipEndUs) {
+            count--;
+        }
+        if (count == 0) {
+            Serial.println("Clip window held no frames");
+            clipState = ClipState::IDLE;
+            return;
+        }
+        clipLastRecord = clipFirstRecord + count - 1;
+        clipReadyMs = millis();
+        clipState = ClipState::READY;
+        Serial.printf("Clip ready: %u frames%s\n", count, clipTruncated ? " (truncated, history full)" : "");
+    } else if (clipState == ClipState::READY && exportCount == 0 && millis() - clipReadyMs >= CLIP_HOLD_MS) {
+        clipState = ClipState::IDLE;
+    }
+}
+
+bool FrameHistory::canEvict(uint32_t serial) {
+    // Frames of the held clip stay until it is released or expires
+    return clipState == ClipState::IDLE || serial < clipFirstRecord ||
+           (clipState == ClipState::READY && serial > clipLastRecord);
+}
+
+bool FrameHistory::store(const uint8_t *jpeg, size_t length, uint16_t width, uint16_t height,
+                         uint32_t sequence, int64_t captureTimeUs) {
+    if (length > arena.getSize()) {
+        framesRejected++;
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    updateClipLocked(captureTimeUs);
+    uint8_t *space = arena.reserve(length);
+    if (space == nullptr) {
+        framesRejected++;
+        if (clipState == ClipState::RECORDING) {
+            // The clip fills the whole history; end it here
+            clipTruncated = true;
+            updateClipLocked(captureTimeUs);
+        }
+        xSemaphoreGive(lock);
+        return false;
+    }
+    xSemaphoreGive(lock);
+
+    // Only this task reserves, and readers only touch clip frames, which can
+    // never be in the space just reserved, so copy without the lock
+    memcpy(space, jpeg, length);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    arena.commit(length, width, height, sequence, captureTimeUs);
+    averageFrameBytes = framesRecorded == 0 ? length
+        : (uint32_t)((int32_t)averageFrameBytes + ((int32_t)length - (int32_t)averageFrameBytes) / 16);
+    framesRecorded++;
+    xSemaphoreGive(lock);
+
+    return true;
+}
+
+bool FrameHistory::beginExport(AviClipInfo &info) {
+    if (!isAvailable()) {
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    updateClipLocked(esp_timer_get_time());
+    if (clipState != ClipState::READY) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.frameCount = clipLastRecord - clipFirstRecord + 1;
+    for (uint32_t serial = clipFirstRecord; serial <= clipLastRecord; serial++) {
+        const JpegRecord &record = arena.at(serial);
+        info.width = record.width > info.width ? record.width : info.width;
+        info.height = record.height > info.height ? record.height : info.height;
+        info.maxFrameBytes = record.length > info.maxFrameBytes ? record.length : info.maxFrameBytes;
+        info.chunkBytes += AviWriter::getChunkSize(record.length);
+    }
+
+    // Play back at the rate the frames were recorded
+    int64_t spanUs = arena.at(clipLastRecord).captureTimeUs - arena.at(clipFirstRecord).captureTimeUs;
+    info.usPerFrame = info.frameCount > 1 ? (uint32_t)(spanUs / (info.frameCount - 1)) : 1000000 / RECORD_FPS;
+    if (info.usPerFrame == 0) {
+        info.usPerFrame = 1000000 / RECORD_FPS;
+    }
+
+    exportCount++;
+    xSemaphoreGive(lock);
+    return true;
+}
+
+bool FrameHistory::getClipFrame(uint32_t index, const uint8_t **data, size_t *length) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool found = exportCount > 0 && index <= clipLastRecord - clipFirstRecord;
+    if (found) {
+        const JpegRecord &record = arena.at(clipFirstRecord + index);
+        *data = arena.getData(record);
+        *length = record.length;
+    }
+    xSemaphoreGive(lock);
+    return found;
+}
+
+void FrameHistory::endExport() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (exportCount > 0) {
+        exportCount--;
+    }
+    updateClipLocked(esp_timer_get_time());
+    xSemaphoreGive(lock);
+}
+
+void FrameHistory::addStatus(JsonDocument &doc) {
+    doc["available"] = isAvailable();
+    if (!isAvailable()) {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    updateClipLocked(esp_timer_get_time());
+    uint32_t frames = arena.getNext() - arena.getOldest();
+    int64_t spanUs = frames > 1 ? arena.at(arena.getNext() - 1).captureTimeUs - arena.at(arena.getOldest()).captureTimeUs : 0;
+    uint32_t averageBytes = averageFrameBytes;
+    ClipState state = clipState;
+    uint32_t clipFrames = state == ClipState::READY ? clipLastRecord - clipFirstRecord + 1
+                        : state == ClipState::RECORDING ? arena.getNext() - clipFirstRecord : 0;
+    bool truncated = clipTruncated;
+    xSemaphoreGive(lock);
+
+    uint32_t recordFps = RECORD_FPS;
+    doc["arena_bytes"] = (uint32_t)arena.getSize();
+    doc["record_fps"] = recordFps;
+    doc["frame_size"] = AdaptiveStreamController::getFrameSizeName();
+    doc["quality"] = AdaptiveStreamController::getQuality();
+    doc["avg_frame_bytes"] = averageBytes;
+    doc["history_frames"] = frames;
+    doc["history_seconds"] = (float)(spanUs / 100000) / 10;
+    // What the arena holds at the current frame size and quality once full
+    doc["capacity_seconds"] = averageBytes > 0 ? (float)(arena.getSize() * 10 / averageBytes / recordFps) / 10 : 0.0f;
+    doc["frames_recorded"] = framesRecorded;
+    doc["frames_rejected"] = framesRejected;
+
+    static const char *const STATE_NAMES[] = {"idle", "recording", "ready"};
+    doc["clip_state"] = STATE_NAMES[(uint8_t)state];
+    doc["clip_frames"] = clipFrames;
+    doc["clip_truncated"] = truncated;
+}
+
+void FrameHistory::recordLoop(void *parameter) {
+    const uint32_t intervalMs = 1000 / RECORD_FPS;
+    int subscriberId = -1;
+    bool subscribedAwake = false;
+
+    while (true) {
+        // History is kept while the sensor is awake but is no reason to wake
+        // it; the post-event window of a clip is
+        bool keepAwake = clipState == ClipState::RECORDING;
+        if (subscriberId >= 0 && keepAwake != subscribedAwake) {
+            FrameBroker::unsubscribe(subscriberId);
+            subscriberId = -1;
+        }
+        if (subscriberId < 0) {
+            subscriberId = FrameBroker::subscribe(keepAwake);
+            subscribedAwake = keepAwake;
+            if (subscriberId < 0) {
+                // Every slot is taken by stream clients; try again later
+                vTaskDelay(pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+                continue;
+            }
+        }
+
+        SharedFrame *frame = FrameBroker::waitForFrame(subscriberId, pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+        if (frame == nullptr) {
+            // Keep the clip window moving even if the camera has stopped
+            xSemaphoreTake(lock, portMAX_DELAY);
+            updateClipLocked(esp_timer_get_time());
+            xSemaphoreGive(lock);
+            continue;
+        }
+
+        uint32_t startMs = millis();
+        store(frame->fb->buf, frame->fb->len, frame->fb->width, frame->fb->height,
+              frame->sequence, frame->captureTimeUs);
+        FrameBroker::release(frame);
+
+        // Sleep until the next frame is due; the broker then hands over the newest
+        uint32_t elapsedMs = millis() - startMs;
+        if (elapsedMs < intervalMs) {
+            vTaskDelay(pdMS_TO_TICKS(intervalMs - elapsedMs));
+        }
+    }
+}
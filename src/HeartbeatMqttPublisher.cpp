@@ -1,41 +1,255 @@
 #include "HeartbeatMqttPublisher.h"
+#include "AdaptiveStreamController.h"
+#include "BandwidthBudget.h"
+#include "BootProfiler.h"
+#include "CameraBufferStrategy.h"
+#include "MqttCommandChannel.h"
+#include "StreamMetrics.h"
+#include <stdarg.h>
 
-void HeartbeatMqttPublisher::publishHeartbeat() {
-    Serial.println("Publishing heartbeat...");
+char HeartbeatMqttPublisher::identity[HeartbeatMqttPublisher::IDENTITY_BUFFER_SIZE];
+char HeartbeatMqttPublisher::idMember[64];
+char HeartbeatMqttPublisher::network[HeartbeatMqttPublisher::NETWORK_BUFFER_SIZE];
+char HeartbeatMqttPublisher::dynamic[HeartbeatMqttPublisher::DYNAMIC_BUFFER_SIZE];
+char HeartbeatMqttPublisher::streamStatus[HeartbeatMqttPublisher::STREAM_BUFFER_SIZE];
+size_t HeartbeatMqttPublisher::identityLength = 0;
+size_t HeartbeatMqttPublisher::idMemberLength = 0;
+size_t HeartbeatMqttPublisher::networkLength = 0;
+uint8_t HeartbeatMqttPublisher::lastIp[4] = {0, 0, 0, 0};
+uint32_t HeartbeatMqttPublisher::lastFreeHeap = 0;
+int HeartbeatMqttPublisher::lastRssi = 0;
+uint32_t HeartbeatMqttPublisher::lastFullMs = 0;
+uint32_t HeartbeatMqttPublisher::lastFramesCaptured = 0;
+uint32_t HeartbeatMqttPublisher::publishCount = 0;
+bool HeartbeatMqttPublisher::publishedFull = false;
+bool HeartbeatMqttPublisher::bootReported = false;
+CameraPowerState HeartbeatMqttPublisher::lastCameraState = CameraPowerState::ACTIVE;
+String HeartbeatMqttPublisher::fallbackPayload;
+
+bool HeartbeatMqttPublisher::publishHeartbeat() {
+    if (identityLength == 0) {
+        begin();
+    }
+    bool networkChanged = updateNetwork();
     
-    JsonDocument heartbeatDoc;
+    uint32_t now = millis();
+    uint32_t freeHeap = ESP.getFreeHeap();
+    int rssi = WiFi.RSSI();
+    bool full = !publishedFull || networkChanged || now - lastFullMs >= FULL_HEARTBEAT_INTERVAL_MS;
     
-    auto config = ConfigurationManager::getConfig();
+    // System metrics and WiFi signal, the only fields encoded on every beat
+    size_t length;
+    if (full) {
+        length = appendFormat(dynamic, sizeof(dynamic), 0, ",\"uptime\":%lu,\"free_heap\":%u,\"rssi\":%d",
+                              (unsigned long)(now / 1000), freeHeap, rssi);
+    } else {
+        length = appendFormat(dynamic, sizeof(dynamic), 0, ",\"delta\":true,\"uptime\":%lu",
+                              (unsigned long)(now / 1000));
+        uint32_t heapChange = freeHeap > lastFreeHeap ? freeHeap - lastFreeHeap : lastFreeHeap - freeHeap;
+        if (heapChange >= HEAP_DELTA_BYTES) {
+            length = appendFormat(dynamic, sizeof(dynamic), length, ",\"free_heap\":%u", freeHeap);
+        } else {
+            freeHeap = lastFreeHeap;
+        }
+        if (abs(rssi - lastRssi) >= RSSI_DELTA_DB) {
+            length = appendFormat(dynamic, sizeof(dynamic), length, ",\"rssi\":%d", rssi);
+        } else {
+            rssi = lastRssi;
+        }
+    }
     
-    // Device identification
-    heartbeatDoc["id"] = config.uuid;
-    heartbeatDoc["name"] = config.mqttClientName;
-    heartbeatDoc["type"] = "webcam";
-    heartbeatDoc["version"] = getVersionStringWithBuild();
-    heartbeatDoc["boot_count"] = config.bootCount;
+    // Camera power state; wake latencies go in heartbeat/stream
+    CameraPowerState cameraState = CameraPower::getState();
+    if (full || cameraState != lastCameraState) {
+        length = appendFormat(dynamic, sizeof(dynamic), length,
+                              ",\"camera_active\":%s,\"camera_state\":\"%s\",\"camera_standby_s\":%u",
+                              cameraState != CameraPowerState::STANDBY ? "true" : "false",
+                              CameraPower::getStateName(cameraState), CameraPower::getStandbySeconds());
+    }
     
-    // System metrics
-    heartbeatDoc["uptime"] = millis() / 1000;
-    heartbeatDoc["free_heap"] = ESP.getFreeHeap();
-    heartbeatDoc["psram_found"] = psramFound();
+    // Boot figures go in the first full heartbeat, and again once the
+    // first frame arrives if it had not when that was sent
+    bool firstFrameSeen = BootProfiler::getTimeToFirstFrameMs() >= 0;
+    if (!bootReported && (full || firstFrameSeen)) {
+        length += BootProfiler::formatSummary(dynamic + length, sizeof(dynamic) - length);
+    }
+    // A full buffer means something was cut short; the JSON would not parse
+    if (length + 1 >= sizeof(dynamic)) {
+        Serial.println("Heartbeat does not fit its buffer");
+        return false;
+    }
+    dynamic[length++] = '}';
+    dynamic[length] = '\0';
     
-    // WiFi status
-    heartbeatDoc["rssi"] = WiFi.RSSI();
-    heartbeatDoc["ip_address"] = WiFi.localIP().toString();
+    bool published;
+    if (full) {
+        const char *segments[] = {identity, network, dynamic};
+        const size_t lengths[] = {identityLength, networkLength, length};
+        published = publishSegments("heartbeat", segments, lengths, 3);
+    } else {
+        const char *segments[] = {idMember, dynamic};
+        const size_t lengths[] = {idMemberLength, length};
+        published = publishSegments("heartbeat", segments, lengths, 2);
+    }
+    if (!published) {
+        Serial.println("Heartbeat not published");
+        return false;
+    }
     
-    // Camera status
-    heartbeatDoc["camera_active"] = true;
-    heartbeatDoc["stream_url"] = "http://" + WiFi.localIP().toString() + "/";
+    // Deltas are measured from the values last reported
+    lastFreeHeap = freeHeap;
+    lastRssi = rssi;
+    lastCameraState = cameraState;
+    if (full) {
+        lastFullMs = now;
+        publishedFull = true;
+    }
+    if (firstFrameSeen) {
+        bootReported = true;
+    }
+    publishCount++;
+    Serial.printf("Heartbeat published (%s, %u bytes)\n", full ? "full" : "delta",
+                  (unsigned)(full ? identityLength + networkLength + length : idMemberLength + length));
     
-    // Power settings (webcam doesn't use deep sleep)
-    heartbeatDoc["deep_sleep_enabled"] = false;
-    heartbeatDoc["always_on"] = true;
+    // Pipeline figures only change while the camera is capturing
+    uint32_t framesCaptured = StreamMetrics::getFramesCaptured();
+    if (full || framesCaptured != lastFramesCaptured || StreamMetrics::getActiveClients() > 0) {
+        lastFramesCaptured = framesCaptured;
+        publishStreamStatus();
+    }
+    return true;
+}
+
+uint32_t HeartbeatMqttPublisher::getPublishCount() {
+    return publishCount;
+}
+
+void HeartbeatMqttPublisher::begin() {
+    auto config = ConfigurationManager::getConfig();
     
-    String heartbeatJson;
-    serializeJson(heartbeatDoc, heartbeatJson);
+    // Device identification, version, framebuffers and power settings
+    // (webcam doesn't use deep sleep); none change while running
+    size_t length = appendFormat(idMember, sizeof(idMember), 0, "{\"id\":");
+    idMemberLength = appendJsonString(idMember, sizeof(idMember), length, config.uuid.c_str());
     
-    MqttHandler::publish("heartbeat", heartbeatJson);
+    memcpy(identity, idMember, idMemberLength);
+    length = appendFormat(identity, sizeof(identity), idMemberLength, ",\"name\":");
+    length = appendJsonString(identity, sizeof(identity), length, config.mqttClientName.c_str());
+    identityLength = appendFormat(identity, sizeof(identity), length,
+        ",\"type\":\"webcam\",\"version\":\"%s\",\"boot_count\":%d,\"psram_found\":%s,"
+        "\"fb_strategy\":\"%s\",\"deep_sleep_enabled\":false,\"always_on\":true",
+        getVersionStringWithBuild(), config.bootCount, psramFound() ? "true" : "false",
+        CameraBufferStrategy::getName());
     
-    Serial.println("Heartbeat published");
-    Serial.println(heartbeatJson);
+    // The largest message the fallback path can join, so joining it never
+    // grows the String
+    fallbackPayload.reserve(max(identityLength + NETWORK_BUFFER_SIZE + DYNAMIC_BUFFER_SIZE,
+                                idMemberLength + STREAM_BUFFER_SIZE));
+}
+
+bool HeartbeatMqttPublisher::updateNetwork() {
+    IPAddress ip = WiFi.localIP();
+    if (networkLength > 0 && ip[0] == lastIp[0] && ip[1] == lastIp[1] && ip[2] == lastIp[2] && ip[3] == lastIp[3]) {
+        return false;
+    }
+    
+    for (int i = 0; i < 4; i++) {
+        lastIp[i] = ip[i];
+    }
+    int length = snprintf(network, sizeof(network),
+        ",\"ip_address\":\"%u.%u.%u.%u\",\"stream_url\":\"http://%u.%u.%u.%u/\"",
+        lastIp[0], lastIp[1], lastIp[2], lastIp[3], lastIp[0], lastIp[1], lastIp[2], lastIp[3]);
+    networkLength = length > 0 ? length : 0;
+    return true;
+}
+
+bool HeartbeatMqttPublisher::publishStreamStatus() {
+    int length = snprintf(streamStatus, sizeof(streamStatus),
+        ",\"capture_to_send_ms\":%u,\"capture_to_send_max_ms\":%u,"
+        "\"stream_framesize\":\"%s\",\"stream_quality\":%d,\"stream_level\":%u,"
+        "\"bandwidth_limit_kbps\":%u,\"bandwidth_used_kbps\":%u,\"bandwidth_throttled_ms\":%u,"
+        "\"camera_wake_ms\":%u,\"camera_wake_max_ms\":%u,",
+        CameraBufferStrategy::getAverageLatencyMs(), CameraBufferStrategy::getMaxLatencyMs(),
+        AdaptiveStreamController::getFrameSizeName(), AdaptiveStreamController::getQuality(),
+        AdaptiveStreamController::getLevel(), BandwidthBudget::getLimitKbps(),
+        BandwidthBudget::getUsedKbps(), BandwidthBudget::getThrottledMs(),
+        CameraPower::getLastWakeMs(), CameraPower::getMaxWakeMs());
+    if (length > 0 && (size_t)length < sizeof(streamStatus)) {
+        length += StreamMetrics::formatSummary(streamStatus + length, sizeof(streamStatus) - length);
+    }
+    if (length <= 0 || (size_t)length + 1 >= sizeof(streamStatus)) {
+        Serial.println("Stream status does not fit its buffer");
+        return false;
+    }
+    streamStatus[length++] = '}';
+    streamStatus[length] = '\0';
+    
+    const char *segments[] = {idMember, streamStatus};
+    const size_t lengths[] = {idMemberLength, (size_t)length};
+    return publishSegments("heartbeat/stream", segments, lengths, 2);
+}
+
+bool HeartbeatMqttPublisher::publishSegments(const char *topic, const char *const *segments,
+                                             const size_t *lengths, uint8_t count) {
+    size_t total = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        total += lengths[i];
+    }
+    
+    if (MqttCommandChannel::isConnected()) {
+        PubSubClient &client = MqttCommandChannel::getClient();
+        if (!client.beginPublish(topic, total, false)) {
+            return false;
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            if (client.write((const uint8_t *)segments[i], lengths[i]) != lengths[i]) {
+                client.disconnect();
+                return false;
+            }
+        }
+        return client.endPublish();
+    }
+    
+    if (!MqttHandler::isConnected()) {
+        return false;
+    }
+    // MqttHandler only publishes a String; join the segments into the one
+    // reserved in begin() so the fallback does not allocate either
+    fallbackPayload = "";
+    for (uint8_t i = 0; i < count; i++) {
+        fallbackPayload.concat(segments[i], lengths[i]);
+    }
+    return MqttHandler::publish(topic, fallbackPayload);
+}
+
+size_t HeartbeatMqttPublisher::appendFormat(char *buffer, size_t size, size_t length, const char *format, ...) {
+    if (length + 1 >= size) {
+        return size - 1;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + length, size - length, format, args);
+    va_end(args);
+    if (written > 0) {
+        length += written;
+    }
+    return length < size ? length : size - 1;
+}
+
+size_t HeartbeatMqttPublisher::appendJsonString(char *buffer, size_t size, size_t length, const char *value) {
+    if (length + 3 > size) {
+        return length;
+    }
+    buffer[length++] = '"';
+    for (; *value != '\0' && length + 3 < size; value++) {
+        if (*value == '"' || *value == '\\') {
+            buffer[length++] = '\\';
+        } else if ((uint8_t)*value < 0x20) {
+            continue;
+        }
+        buffer[length++] = *value;
+    }
+    buffer[length++] = '"';
+    buffer[length] = '\0';
+    return length;
 }
@@ -0,0 +1,121 @@
+#include "JpegArena.h"
+#include <esp_heap_caps.h>
+
+JpegArena::JpegArena(uint32_t maxRecords, EvictionPolicy canEvict)
+    : maxRecords(maxRecords), canEvict(canEvict), data(nullptr), size(0), records(nullptr),
+      oldest(0), next(0), writeOffset(0), reservedOffset(0) {
+}
+
+size_t JpegArena::getAvailableSize(size_t maxBytes, size_t minBytes, size_t reserveBytes) {
+    size_t freePsram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t available = freePsram > reserveBytes ? freePsram - reserveBytes : 0;
+    if (available > maxBytes) {
+        available = maxBytes;
+    }
+    return available < minBytes ? 0 : available;
+}
+
+bool JpegArena::allocate(size_t arenaSize) {
+    if (data != nullptr) {
+        return true;
+    }
+
+    uint8_t *newData = (uint8_t *)ps_malloc(arenaSize);
+    JpegRecord *newRecords = (JpegRecord *)ps_malloc(maxRecords * sizeof(JpegRecord));
+    if (newData == nullptr || newRecords == nullptr) {
+        free(newData);
+        free(newRecords);
+        return false;
+    }
+    data = newData;
+    records = newRecords;
+    size = arenaSize;
+    return true;
+}
+
+bool JpegArena::isAllocated() const {
+    return data != nullptr;
+}
+
+size_t JpegArena::getSize() const {
+    return size;
+}
+
+bool JpegArena::evictOldest() {
+    if (!canEvict(oldest)) {
+        return false;
+    }
+    oldest++;
+    return true;
+}
+
+uint8_t *JpegArena::reserve(size_t length) {
+    uint32_t needed = (length + 3) & ~3u;
+    if (data == nullptr || needed > size) {
+        return nullptr;
+    }
+
+    bool ok = true;
+    if (next - oldest == maxRecords) {
+        ok = evictOldest();
+    }
+
+    uint32_t start = writeOffset;
+    if (ok && needed > size - start) {
+        // No room before the end of the arena: everything from the write
+        // position on is from the previous lap, so it goes first
+        while (ok && oldest != next && at(oldest).offset >= start) {
+            ok = evictOldest();
+        }
+        start = 0;
+    }
+
+    // Free the records the new one will overwrite. The oldest record is
+    // always the first one after the write position, if there is one.
+    while (ok && oldest != next) {
+        const JpegRecord &record = at(oldest);
+        if (record.offset < start || record.offset >= start + needed) {
+            break;
+        }
+        ok = evictOldest();
+    }
+
+    if (!ok) {
+        return nullptr;
+    }
+    reservedOffset = start;
+    writeOffset = start + needed;
+    return data + start;
+}
+
+void JpegArena::commit(size_t length, uint16_t width, uint16_t height, uint32_t sequence, int64_t captureTimeUs) {
+    JpegRecord &record = records[next % maxRecords];
+    record.offset = reservedOffset;
+    record.length = length;
+    record.sequence = sequence;
+    record.width = width;
+    record.height = height;
+    record.captureTimeUs = captureTimeUs;
+    next++;
+}
+
+void JpegArena::clear() {
+    oldest = next;
+    writeOffset = 0;
+}
+
+uint32_t JpegArena::getOldest() const {
+    return oldest;
+}
+
+uint32_t JpegArena::getNext() const {
+    return next;
+}
+
+const JpegRecord &JpegArena::at(uint32_t serial) const {
+    return records[serial % maxRecords];
+}
+
+const uint8_t *JpegArena::getData(const JpegRecord &record) const {
+    return data + record.offset;
+}
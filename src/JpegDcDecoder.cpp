@@ -0,0 +1,481 @@
+#include "JpegDcDecoder.h"
+
+namespace {
+
+uint16_t readUint16(const uint8_t *data) {
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+int extend(uint32_t value, int bits) {
+    // Values with a clear top bit are negative (ITU T.81 F.2.2.1)
+    return value < (1u << (bits - 1)) ? (int)value - (1 << bits) + 1 : (int)value;
+}
+
+uint8_t clampPixel(int value) {
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+struct LumaDcTarget {
+    uint8_t *output;
+    uint16_t blocksWide;
+    uint16_t blocksHigh;
+};
+
+struct ScaledTarget {
+    JpegScaledImage *image;
+    uint8_t divisor;
+};
+
+void storeLumaDc(void *context, uint8_t component, uint32_t blockX, uint32_t blockY, const int *coefficients) {
+    LumaDcTarget *target = (LumaDcTarget *)context;
+    if (component == 0 && blockX < target->blocksWide && blockY < target->blocksHigh) {
+        // DC value d is the block mean scaled by 8 around 128 after dequantisation
+        target->output[blockY * target->blocksWide + blockX] = clampPixel(128 + coefficients[0] / 8);
+    }
+}
+
+void storeScaled(void *context, uint8_t component, uint32_t blockX, uint32_t blockY, const int *coefficients) {
+    ScaledTarget *target = (ScaledTarget *)context;
+    JpegScaledImage &image = *target->image;
+    uint16_t planeWidth = image.planeWidths[component];
+    uint8_t pixelsPerBlock = 8 / target->divisor;
+    uint32_t x = blockX * pixelsPerBlock;
+    uint32_t y = blockY * pixelsPerBlock;
+    if (x >= planeWidth || y >= image.planeHeights[component]) {
+        return;
+    }
+    uint8_t *pixel = image.planes[component] + y * planeWidth + x;
+    int mean = 128 + coefficients[0] / 8;
+    if (pixelsPerBlock == 1) {
+        *pixel = clampPixel(mean);
+        return;
+    }
+
+    // Averaging the IDCT over a 4x4 quadrant leaves the first horizontal
+    // (zigzag 1), vertical (2) and diagonal (4) terms weighted by about
+    // 0.113, 0.113 and 0.102; F(0,2) and F(2,0) average out to zero and
+    // the higher terms are small enough to leave out
+    int horizontal = coefficients[1] * 29 / 256;
+    int vertical = coefficients[2] * 29 / 256;
+    int diagonal = coefficients[4] * 26 / 256;
+    pixel[0] = clampPixel(mean + horizontal + vertical + diagonal);
+    pixel[1] = clampPixel(mean - horizontal + vertical - diagonal);
+    pixel[planeWidth] = clampPixel(mean + horizontal - vertical - diagonal);
+    pixel[planeWidth + 1] = clampPixel(mean - horizontal - vertical + diagonal);
+}
+
+} // namespace
+
+bool JpegDcDecoder::buildTable(HuffmanTable &table, const uint8_t *counts, const uint8_t *symbols, int symbolCount) {
+    if (symbolCount > 256) {
+        return false;
+    }
+    memset(table.lookahead, 0, sizeof(table.lookahead));
+    memcpy(table.values, symbols, symbolCount);
+
+    // Canonical code assignment (ITU T.81 Annex C)
+    int32_t code = 0;
+    int index = 0;
+    for (int length = 1; length <= 16; length++) {
+        int count = counts[length - 1];
+        table.valueOffset[length] = index - code;
+        if (count > 0) {
+            for (int i = 0; i < count; i++) {
+                if (length <= LOOKAHEAD_BITS) {
+                    int shift = LOOKAHEAD_BITS - length;
+                    for (int fill = 0; fill < (1 << shift); fill++) {
+                        table.lookahead[(code << shift) | fill] = (uint16_t)((length << 8) | symbols[index]);
+                    }
+                }
+                code++;
+                index++;
+            }
+            table.maxCode[length] = code - 1;
+        } else {
+            table.maxCode[length] = -1;
+        }
+        if (code > (1 << length)) {
+            return false;
+        }
+        code <<= 1;
+    }
+    table.maxCode[17] = 0x7fffffff;
+    table.defined = true;
+    return true;
+}
+
+bool JpegDcDecoder::parseHeaders(const uint8_t *jpeg, size_t length, const uint8_t **scan,
+                                 uint8_t *scanOrder, uint8_t &scanCount) {
+    if (length < 4 || jpeg[0] != 0xff || jpeg[1] != 0xd8) {
+        return false;
+    }
+
+    dcTables[0].defined = dcTables[1].defined = false;
+    acTables[0].defined = acTables[1].defined = false;
+    componentCount = 0;
+    restartInterval = 0;
+    width = height = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        for (uint8_t k = 0; k < LOW_FREQUENCIES; k++) {
+            quantLow[i][k] = 1;
+        }
+    }
+
+    const uint8_t *cursor = jpeg + 2;
+    const uint8_t *limit = jpeg + length;
+    while (cursor + 4 <= limit) {
+        if (cursor[0] != 0xff) {
+            return false;
+        }
+        uint8_t marker = cursor[1];
+        if (marker == 0xff) {
+            cursor++;
+            continue;
+        }
+        uint16_t segmentLength = readUint16(cursor + 2);
+        const uint8_t *segment = cursor + 4;
+        const uint8_t *segmentEnd = cursor + 2 + segmentLength;
+        if (segmentLength < 2 || segmentEnd > limit) {
+            return false;
+        }
+
+        switch (marker) {
+            case 0xc0:  // Baseline DCT
+            case 0xc1:  // Extended sequential, Huffman
+                if (segment[0] != 8 || segment[5] > MAX_COMPONENTS || segment[5] == 0) {
+                    return false;
+                }
+                height = readUint16(segment + 1);
+                width = readUint16(segment + 3);
+                componentCount = segment[5];
+                for (uint8_t i = 0; i < componentCount; i++) {
+                    const uint8_t *entry = segment + 6 + i * 3;
+                    components[i].id = entry[0];
+                    components[i].horizontal = entry[1] >> 4;
+                    components[i].vertical = entry[1] & 0x0f;
+                    components[i].quantTable = entry[2] & 0x03;
+                    if (components[i].horizontal == 0 || components[i].vertical == 0) {
+                        return false;
+                    }
+                }
+                break;
+
+            case 0xc2:  // Progressive and arithmetic-coded JPEGs are not produced by the sensor
+            case 0xc3:
+            case 0xc9:
+            case 0xca:
+                return false;
+
+            case 0xc4: {
+                const uint8_t *table = segment;
+                while (table + 17 <= segmentEnd) {
+                    uint8_t tableClass = table[0] >> 4;
+                    uint8_t tableId = table[0] & 0x0f;
+                    int symbolCount = 0;
+                    for (int i = 1; i <= 16; i++) {
+                        symbolCount += table[i];
+                    }
+                    if (tableId > 1 || table + 17 + symbolCount > segmentEnd) {
+                        return false;
+                    }
+                    HuffmanTable &target = tableClass == 0 ? dcTables[tableId] : acTables[tableId];
+                    if (!buildTable(target, table + 1, table + 17, symbolCount)) {
+                        return false;
+                    }
+                    table += 17 + symbolCount;
+                }
+                break;
+            }
+
+            case 0xdb: {
+                const uint8_t *table = segment;
+                while (table < segmentEnd) {
+                    bool sixteenBit = (table[0] >> 4) != 0;
+                    uint8_t tableId = table[0] & 0x03;
+                    // Only the lowest frequencies (first in zigzag order) are needed
+                    for (uint8_t k = 0; k < LOW_FREQUENCIES; k++) {
+                        quantLow[tableId][k] = sixteenBit ? readUint16(table + 1 + k * 2) : table[1 + k];
+                    }
+                    table += sixteenBit ? 129 : 65;
+                }
+                break;
+            }
+
+            case 0xdd:
+                restartInterval = readUint16(segment);
+                break;
+
+            case 0xda: {
+                scanCount = segment[0];
+                if (componentCount == 0 || scanCount == 0 || scanCount > componentCount) {
+                    return false;
+                }
+                for (uint8_t i = 0; i < scanCount; i++) {
+                    uint8_t id = segment[1 + i * 2];
+                    uint8_t tables = segment[2 + i * 2];
+                    uint8_t match = MAX_COMPONENTS;
+                    for (uint8_t c = 0; c < componentCount; c++) {
+                        if (components[c].id == id) {
+                            match = c;
+                        }
+                    }
+                    if (match == MAX_COMPONENTS) {
+                        return false;
+                    }
+                    components[match].dcTable = (tables >> 4) & 1;
+                    components[match].acTable = tables & 1;
+                    if (!dcTables[components[match].dcTable].defined ||
+                        !acTables[components[match].acTable].defined) {
+                        return false;
+                    }
+                    scanOrder[i] = match;
+                }
+                *scan = segmentEnd;
+                return true;
+            }
+
+            default:
+                break;
+        }
+        cursor = segmentEnd;
+    }
+    return false;
+}
+
+void JpegDcDecoder::fillBits() {
+    while (bitCount <= 24) {
+        uint8_t byte = 0;
+        if (position < end) {
+            byte = *position;
+            if (byte == 0xff) {
+                uint8_t next = position + 1 < end ? position[1] : 0xd9;
+                if (next == 0x00) {
+                    position += 2;  // Stuffed zero byte
+                } else {
+                    // A marker ends the entropy-coded segment; feed zeros until it is handled
+                    byte = 0;
+                }
+            } else {
+                position++;
+            }
+        }
+        bitBuffer = (bitBuffer << 8) | byte;
+        bitCount += 8;
+    }
+}
+
+uint32_t JpegDcDecoder::getBits(int count) {
+    if (count == 0) {
+        return 0;
+    }
+    if (bitCount < count) {
+        fillBits();
+    }
+    bitCount -= count;
+    return (bitBuffer >> bitCount) & ((1u << count) - 1);
+}
+
+int JpegDcDecoder::decodeSymbol(const HuffmanTable &table) {
+    if (bitCount < 16) {
+        fillBits();
+    }
+    uint16_t entry = table.lookahead[(bitBuffer >> (bitCount - LOOKAHEAD_BITS)) & ((1 << LOOKAHEAD_BITS) - 1)];
+    if (entry != 0) {
+        bitCount -= entry >> 8;
+        return entry & 0xff;
+    }
+
+    // Codes longer than the lookahead are resolved bit by bit
+    int length = LOOKAHEAD_BITS + 1;
+    int32_t code = (bitBuffer >> (bitCount - length)) & ((1 << length) - 1);
+    while (length <= 16 && code > table.maxCode[length]) {
+        length++;
+        code = (bitBuffer >> (bitCount - length)) & ((1 << length) - 1);
+    }
+    if (length > 16) {
+        return -1;
+    }
+    bitCount -= length;
+    return table.values[table.valueOffset[length] + code];
+}
+
+bool JpegDcDecoder::skipToRestart() {
+    bitBuffer = 0;
+    bitCount = 0;
+    while (position + 1 < end) {
+        if (position[0] == 0xff && position[1] >= 0xd0 && position[1] <= 0xd7) {
+            position += 2;
+            return true;
+        }
+        position++;
+    }
+    return false;
+}
+
+void JpegDcDecoder::getBlockCount(uint8_t component, uint16_t &blocksWide, uint16_t &blocksHigh) const {
+    uint8_t maxHorizontal = 1;
+    uint8_t maxVertical = 1;
+    for (uint8_t i = 0; i < componentCount; i++) {
+        maxHorizontal = components[i].horizontal > maxHorizontal ? components[i].horizontal : maxHorizontal;
+        maxVertical = components[i].vertical > maxVertical ? components[i].vertical : maxVertical;
+    }
+
+    // Component plane size in pixels, then in 8x8 blocks
+    uint32_t planeWidth = ((uint32_t)width * components[component].horizontal + maxHorizontal - 1) / maxHorizontal;
+    uint32_t planeHeight = ((uint32_t)height * components[component].vertical + maxVertical - 1) / maxVertical;
+    blocksWide = (planeWidth + 7) / 8;
+    blocksHigh = (planeHeight + 7) / 8;
+}
+
+bool JpegDcDecoder::decodeScan(const uint8_t *scan, const uint8_t *limit, const uint8_t *scanOrder, uint8_t scanCount,
+                               uint8_t lowFrequencies, BlockHandler handler, void *context) {
+    uint8_t maxHorizontal = 1;
+    uint8_t maxVertical = 1;
+    for (uint8_t i = 0; i < componentCount; i++) {
+        maxHorizontal = components[i].horizontal > maxHorizontal ? components[i].horizontal : maxHorizontal;
+        maxVertical = components[i].vertical > maxVertical ? components[i].vertical : maxVertical;
+        components[i].predictor = 0;
+    }
+
+    // An interleaved MCU holds H x V blocks of each component; a
+    // single-component scan is not interleaved and has one block per MCU
+    bool interleaved = scanCount > 1;
+    uint16_t mcusWide;
+    uint16_t mcusHigh;
+    if (interleaved) {
+        mcusWide = (width + 8 * maxHorizontal - 1) / (8 * maxHorizontal);
+        mcusHigh = (height + 8 * maxVertical - 1) / (8 * maxVertical);
+    } else {
+        getBlockCount(scanOrder[0], mcusWide, mcusHigh);
+    }
+
+    position = scan;
+    end = limit;
+    bitBuffer = 0;
+    bitCount = 0;
+
+    int coefficients[LOW_FREQUENCIES];
+    uint32_t mcusUntilRestart = restartInterval;
+
+    for (uint16_t mcuY = 0; mcuY < mcusHigh; mcuY++) {
+        for (uint16_t mcuX = 0; mcuX < mcusWide; mcuX++) {
+            if (restartInterval != 0) {
+                if (mcusUntilRestart == 0) {
+                    if (!skipToRestart()) {
+                        return false;
+                    }
+                    for (uint8_t i = 0; i < componentCount; i++) {
+                        components[i].predictor = 0;
+                    }
+                    mcusUntilRestart = restartInterval;
+                }
+                mcusUntilRestart--;
+            }
+
+            for (uint8_t s = 0; s < scanCount; s++) {
+                Component &component = components[scanOrder[s]];
+                uint8_t blocksAcross = interleaved ? component.horizontal : 1;
+                uint8_t blocksDown = interleaved ? component.vertical : 1;
+                const HuffmanTable &dcTable = dcTables[component.dcTable];
+                const HuffmanTable &acTable = acTables[component.acTable];
+                const uint16_t *quant = quantLow[component.quantTable];
+
+                for (uint8_t by = 0; by < blocksDown; by++) {
+                    for (uint8_t bx = 0; bx < blocksAcross; bx++) {
+                        int category = decodeSymbol(dcTable);
+                        if (category < 0 || category > 11) {
+                            return false;
+                        }
+                        if (category != 0) {
+                            component.predictor += extend(getBits(category), category);
+                        }
+                        coefficients[0] = component.predictor * quant[0];
+                        for (uint8_t k = 1; k < lowFrequencies; k++) {
+                            coefficients[k] = 0;
+                        }
+
+                        // Keep the lowest AC coefficients if asked; skip the
+                        // rest without dequantising them
+                        for (int k = 1; k < 64; k++) {
+                            int symbol = decodeSymbol(acTable);
+                            if (symbol < 0) {
+                                return false;
+                            }
+                            int run = symbol >> 4;
+                            int size = symbol & 0x0f;
+                            if (size == 0) {
+                                if (run != 15) {
+                                    break;  // End of block
+                                }
+                                k += 15;
+                                continue;
+                            }
+                            k += run;
+                            uint32_t bits = getBits(size);
+                            if (k < lowFrequencies) {
+                                coefficients[k] = extend(bits, size) * quant[k];
+                            }
+                        }
+
+                        handler(context, scanOrder[s], (uint32_t)mcuX * blocksAcross + bx,
+                                (uint32_t)mcuY * blocksDown + by, coefficients);
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool JpegDcDecoder::decodeLumaDc(const uint8_t *jpeg, size_t length, uint8_t *output, size_t capacity,
+                                 uint16_t &blocksWide, uint16_t &blocksHigh) {
+    const uint8_t *scan = nullptr;
+    uint8_t scanOrder[MAX_COMPONENTS];
+    uint8_t scanCount = 0;
+    if (!parseHeaders(jpeg, length, &scan, scanOrder, scanCount) || scanOrder[0] != 0) {
+        return false;
+    }
+
+    getBlockCount(0, blocksWide, blocksHigh);
+    if (blocksWide == 0 || blocksHigh == 0 || (size_t)blocksWide * blocksHigh > capacity) {
+        return false;
+    }
+
+    LumaDcTarget target = {output, blocksWide, blocksHigh};
+    return decodeScan(scan, jpeg + length, scanOrder, scanCount, 1, storeLumaDc, &target);
+}
+
+bool JpegDcDecoder::decodeScaled(const uint8_t *jpeg, size_t length, uint8_t divisor, uint8_t *output,
+                                 size_t capacity, JpegScaledImage &image) {
+    const uint8_t *scan = nullptr;
+    uint8_t scanOrder[MAX_COMPONENTS];
+    uint8_t scanCount = 0;
+    if ((divisor != 8 && divisor != 4) || !parseHeaders(jpeg, length, &scan, scanOrder, scanCount)) {
+        return false;
+    }
+    // Every component has to be in the first scan, as the sensor always writes it
+    if (scanCount != componentCount) {
+        return false;
+    }
+
+    image.componentCount = componentCount;
+    image.width = width;
+    image.height = height;
+    size_t used = 0;
+    for (uint8_t i = 0; i < componentCount; i++) {
+        uint16_t blocksWide = 0;
+        uint16_t blocksHigh = 0;
+        getBlockCount(i, blocksWide, blocksHigh);
+        image.planeWidths[i] = blocksWide * (8 / divisor);
+        image.planeHeights[i] = blocksHigh * (8 / divisor);
+        image.planes[i] = output + used;
+        used += (size_t)image.planeWidths[i] * image.planeHeights[i];
+        if (blocksWide == 0 || blocksHigh == 0 || used > capacity) {
+            return false;
+        }
+    }
+
+    ScaledTarget target = {&image, divisor};
+    return decodeScan(scan, jpeg + length, scanOrder, scanCount, divisor == 4 ? (int)LOW_FREQUENCIES : 1,
+                      storeScaled, &target);
+}
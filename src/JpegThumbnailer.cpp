@@ -0,0 +1,152 @@
+#include "JpegThumbnailer.h"
+#include "JpegDcDecoder.h"
+#include <esp_timer.h>
+#include <img_converters.h>
+#include <new>
+
+SemaphoreHandle_t JpegThumbnailer::lock = nullptr;
+JpegDcDecoder *JpegThumbnailer::decoder = nullptr;
+JpegThumbnailer::CacheEntry JpegThumbnailer::cache[2] = {};
+uint8_t *JpegThumbnailer::planes = nullptr;
+size_t JpegThumbnailer::planesCapacity = 0;
+uint8_t *JpegThumbnailer::yuyv = nullptr;
+size_t JpegThumbnailer::yuyvCapacity = 0;
+uint32_t JpegThumbnailer::lastTranscodeUs = 0;
+
+bool JpegThumbnailer::begin() {
+    if (lock != nullptr) {
+        return true;
+    }
+
+    decoder = new (std::nothrow) JpegDcDecoder();
+    lock = xSemaphoreCreateMutex();
+    if (decoder == nullptr || lock == nullptr) {
+        Serial.println("Failed to set up thumbnails");
+        delete decoder;
+        decoder = nullptr;
+        if (lock != nullptr) {
+            vSemaphoreDelete(lock);
+            lock = nullptr;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool JpegThumbnailer::parseScale(const char *text, uint8_t &divisor) {
+    if (strcmp(text, "1/8") == 0 || strcmp(text, "8") == 0) {
+        divisor = 8;
+        return true;
+    }
+    if (strcmp(text, "1/4") == 0 || strcmp(text, "4") == 0) {
+        divisor = 4;
+        return true;
+    }
+    return false;
+}
+
+bool JpegThumbnailer::copyThumbnail(const SharedFrame *frame, uint8_t divisor, uint8_t *&buffer, size_t &capacity,
+                                    size_t &length) {
+    if (lock == nullptr || (divisor != 8 && divisor != 4)) {
+        return false;
+    }
+
+    CacheEntry &entry = cache[divisor == 8 ? 0 : 1];
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool ok = (entry.valid && entry.sequence == frame->sequence) || transcode(frame->fb, divisor, entry);
+    if (ok) {
+        entry.sequence = frame->sequence;
+        if (capacity < entry.length) {
+            uint8_t *grown = (uint8_t *)realloc(buffer, entry.length);
+            if (grown == nullptr) {
+                ok = false;
+            } else {
+                buffer = grown;
+                capacity = entry.length;
+            }
+        }
+        if (ok) {
+            memcpy(buffer, entry.jpeg, entry.length);
+            length = entry.length;
+        }
+    }
+    xSemaphoreGive(lock);
+    return ok;
+}
+
+uint32_t JpegThumbnailer::getLastTranscodeUs() {
+    return lastTranscodeUs;
+}
+
+bool JpegThumbnailer::transcode(const camera_fb_t *fb, uint8_t divisor, CacheEntry &entry) {
+    int64_t start = esp_timer_get_time();
+    entry.valid = false;
+
+    // Every component has at most one block per 8x8 pixels of the frame
+    uint8_t pixelsPerBlock = 8 / divisor;
+    size_t blocks = (size_t)((fb->width + 15) / 8) * ((fb->height + 15) / 8);
+    JpegScaledImage image;
+    if (!reserve(planes, planesCapacity, 3 * blocks * pixelsPerBlock * pixelsPerBlock) ||
+        !decoder->decodeScaled(fb->buf, fb->len, divisor, planes, planesCapacity, image)) {
+        return false;
+    }
+
+    // Pack YUYV for fmt2jpg(), sampling chroma at its own resolution
+    uint16_t width = (image.width + divisor - 1) / divisor;
+    uint16_t height = (image.height + divisor - 1) / divisor;
+    width += width & 1;
+    if (!reserve(yuyv, yuyvCapacity, (size_t)width * height * 2)) {
+        return false;
+    }
+    uint16_t lumaWidth = image.planeWidths[0];
+    uint16_t lumaHeight = image.planeHeights[0];
+    bool colour = image.componentCount == 3;
+    uint8_t *out = yuyv;
+    for (uint16_t y = 0; y < height; y++) {
+        uint16_t lumaY = y < lumaHeight ? y : lumaHeight - 1;
+        const uint8_t *lumaRow = image.planes[0] + (size_t)lumaY * lumaWidth;
+        const uint8_t *cbRow = nullptr;
+        const uint8_t *crRow = nullptr;
+        if (colour) {
+            uint32_t chromaY = (uint32_t)lumaY * image.planeHeights[1] / lumaHeight;
+            cbRow = image.planes[1] + chromaY * image.planeWidths[1];
+            crRow = image.planes[2] + chromaY * image.planeWidths[2];
+        }
+        for (uint16_t x = 0; x < width; x += 2) {
+            uint16_t left = x < lumaWidth ? x : lumaWidth - 1;
+            uint16_t right = x + 1 < lumaWidth ? x + 1 : lumaWidth - 1;
+            uint32_t chromaX = colour ? (uint32_t)left * image.planeWidths[1] / lumaWidth : 0;
+            *out++ = lumaRow[left];
+            *out++ = colour ? cbRow[chromaX] : 128;
+            *out++ = lumaRow[right];
+            *out++ = colour ? crRow[chromaX] : 128;
+        }
+    }
+
+    uint8_t *jpeg = nullptr;
+    size_t length = 0;
+    if (!fmt2jpg(yuyv, (size_t)width * height * 2, width, height, PIXFORMAT_YUV422, (int)THUMBNAIL_QUALITY,
+                 &jpeg, &length)) {
+        return false;
+    }
+    free(entry.jpeg);
+    entry.jpeg = jpeg;
+    entry.length = length;
+    entry.valid = true;
+    lastTranscodeUs = (uint32_t)(esp_timer_get_time() - start);
+    return true;
+}
+
+bool JpegThumbnailer::reserve(uint8_t *&buffer, size_t &capacity, size_t size) {
+    if (capacity >= size) {
+        return true;
+    }
+    free(buffer);
+    buffer = (uint8_t *)(psramFound() ? ps_malloc(size) : malloc(size));
+    capacity = buffer != nullptr ? size : 0;
+    if (buffer == nullptr) {
+        Serial.println("Failed to allocate thumbnail buffer");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#include "MjpegFramer.h"
+#include <esp_timer.h>
+
+#define PART_BOUNDARY "frame"
+
+static const char PART_TRAILER[] = "\r\n";
+
+uint32_t MjpegFramer::framesWritten = 0;
+uint32_t MjpegFramer::socketWrites = 0;
+uint64_t MjpegFramer::overheadBytes = 0;
+portMUX_TYPE MjpegFramer::statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Seconds and microseconds, the form X-Timestamp takes in the esp32-camera examples
+#define TIME_FORMAT "%u.%06u"
+#define TIME_ARGS(us) (unsigned)((us) / 1000000), (unsigned)((us) % 1000000)
+
+bool MjpegFramer::writeResponseHeader(StreamSession *session) {
+    char response_header[RESPONSE_HEADER_SIZE];
+    int64_t now = esp_timer_get_time();
+    size_t header_length = snprintf(response_header, sizeof(response_header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: multipart/x-mixed-replace; boundary=" PART_BOUNDARY "\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "X-Server-Time: " TIME_FORMAT "\r\n"
+        "\r\n",
+        TIME_ARGS(now));
+    return StreamSessionManager::sendAll(session, response_header, header_length);
+}
+
+bool MjpegFramer::writeFrame(StreamSession *session, uint32_t sequence, int64_t captureTimeUs,
+                             const uint8_t *jpeg, size_t length) {
+    char part_header[PART_HEADER_SIZE];
+    int64_t send_start = esp_timer_get_time();
+    size_t header_length = snprintf(part_header, sizeof(part_header),
+        "--" PART_BOUNDARY "\r\n"
+        "Content-Type: image/jpeg\r\n"
+        "Content-Length: %u\r\n"
+        "X-Frame-Seq: %u\r\n"
+        "X-Timestamp: " TIME_FORMAT "\r\n"
+        "X-Send-Timestamp: " TIME_FORMAT "\r\n"
+        "\r\n",
+        length, sequence, TIME_ARGS(captureTimeUs), TIME_ARGS(send_start));
+
+    struct iovec vector[3];
+    vector[0].iov_base = part_header;
+    vector[0].iov_len = header_length;
+    vector[1].iov_base = (void *)jpeg;
+    vector[1].iov_len = length;
+    vector[2].iov_base = (void *)PART_TRAILER;
+    vector[2].iov_len = sizeof(PART_TRAILER) - 1;
+
+    uint32_t writes = 0;
+    bool ok = StreamSessionManager::sendVector(session, vector, 3, &writes);
+
+    portENTER_CRITICAL(&statsMux);
+    framesWritten++;
+    socketWrites += writes;
+    overheadBytes += header_length + sizeof(PART_TRAILER) - 1;
+    portEXIT_CRITICAL(&statsMux);
+
+    return ok;
+}
+
+uint32_t MjpegFramer::getFramesWritten() {
+    return framesWritten;
+}
+
+uint32_t MjpegFramer::getSocketWrites() {
+    return socketWrites;
+}
+
+uint64_t MjpegFramer::getOverheadBytes() {
+    portENTER_CRITICAL(&statsMux);
+    uint64_t bytes = overheadBytes;
+    portEXIT_CRITICAL(&statsMux);
+    return bytes;
+}
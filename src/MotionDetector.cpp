@@ -0,0 +1,475 @@
+#include "MotionDetector.h"
+#include "ConfigurationManager.h"
+#include "FrameBroker.h"
+#include "JpegDcDecoder.h"
+#include "MqttHandler.h"
+#include "TaskConfig.h"
+#include "TaskScheduler.h"
+#include "WebCamConfiguration.h"
+#include <esp_timer.h>
+#include <new>
+
+volatile bool MotionDetector::enabled = false;
+uint8_t MotionDetector::threshold = MotionDetector::DEFAULT_THRESHOLD;
+// Zone 0 covers the whole frame until configured otherwise
+MotionZone MotionDetector::zones[MotionDetector::MAX_ZONES] = {
+    {true, 0, 0, 100, 100, 2}
+};
+portMUX_TYPE MotionDetector::settingsMux = portMUX_INITIALIZER_UNLOCKED;
+
+JpegDcDecoder *MotionDetector::decoder = nullptr;
+uint8_t *MotionDetector::lumaMap = nullptr;
+uint16_t *MotionDetector::background = nullptr;
+uint8_t *MotionDetector::changedMask = nullptr;
+uint32_t MotionDetector::blockCapacity = 0;
+uint16_t MotionDetector::mapWidth = 0;
+uint16_t MotionDetector::mapHeight = 0;
+uint8_t MotionDetector::warmupFrames = 0;
+uint8_t MotionDetector::activeFrames = 0;
+bool MotionDetector::motionActive = false;
+uint32_t MotionDetector::motionStartMs = 0;
+uint32_t MotionDetector::lastActiveMs = 0;
+uint8_t MotionDetector::peakChangedPercent = 0;
+uint8_t MotionDetector::motionZones = 0;
+
+MotionDetector::MotionEvent MotionDetector::events[MotionDetector::EVENT_QUEUE_SIZE];
+uint8_t MotionDetector::eventHead = 0;
+uint8_t MotionDetector::eventCount = 0;
+uint32_t MotionDetector::eventsDropped = 0;
+portMUX_TYPE MotionDetector::eventMux = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t MotionDetector::framesAnalysed = 0;
+uint32_t MotionDetector::decodeFailures = 0;
+uint32_t MotionDetector::framesSkipped = 0;
+uint32_t MotionDetector::averageAnalysisUs = 0;
+uint32_t MotionDetector::maxAnalysisUs = 0;
+uint8_t MotionDetector::lastChangedPercent = 0;
+TaskHandle_t MotionDetector::detectTask = nullptr;
+
+bool MotionDetector::begin() {
+    if (detectTask != nullptr) {
+        return true;
+    }
+
+    // Off until enabled, as it keeps the sensor from going into standby
+    bool saved;
+    if (WebCamConfiguration::loadMotionEnabled(saved)) {
+        enabled = saved;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        detectLoop, "motion", TASK_STACK, nullptr,
+        MOTION_TASK_PRIORITY, &detectTask, MOTION_TASK_CORE);
+    if (created != pdPASS) {
+        Serial.println("Failed to start motion detection task");
+        detectTask = nullptr;
+        return false;
+    }
+
+    Serial.printf("Motion detection task started (%s)\n", enabled ? "enabled" : "disabled");
+    return true;
+}
+
+void MotionDetector::setEnabled(bool enable) {
+    if (enable != enabled && !WebCamConfiguration::saveMotionEnabled(enable)) {
+        Serial.println("Failed to save the motion detection setting");
+    }
+    enabled = enable;
+    if (detectTask != nullptr) {
+        xTaskNotifyGive(detectTask);
+    }
+}
+
+bool MotionDetector::isEnabled() {
+    return enabled;
+}
+
+void MotionDetector::setThreshold(uint8_t value) {
+    portENTER_CRITICAL(&settingsMux);
+    threshold = value > 0 ? value : 1;
+    portEXIT_CRITICAL(&settingsMux);
+}
+
+uint8_t MotionDetector::getThreshold() {
+    return threshold;
+}
+
+bool MotionDetector::setZone(uint8_t index, const MotionZone &zone) {
+    if (index >= MAX_ZONES || zone.width == 0 || zone.height == 0 ||
+        zone.x + zone.width > 100 || zone.y + zone.height > 100 ||
+        zone.triggerPercent == 0 || zone.triggerPercent > 100) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&settingsMux);
+    zones[index] = zone;
+    portEXIT_CRITICAL(&settingsMux);
+    return true;
+}
+
+MotionZone MotionDetector::getZone(uint8_t index) {
+    MotionZone zone = {};
+    if (index < MAX_ZONES) {
+        portENTER_CRITICAL(&settingsMux);
+        zone = zones[index];
+        portEXIT_CRITICAL(&settingsMux);
+    }
+    return zone;
+}
+
+bool MotionDetector::isMotionActive() {
+    return motionActive;
+}
+
+bool MotionDetector::allocateBuffers() {
+    if (lumaMap != nullptr) {
+        return true;
+    }
+
+    // Without PSRAM the camera is limited to VGA, so size for that
+    bool psram = psramFound();
+    uint32_t capacity = psram ? MAX_BLOCKS_PSRAM : MAX_BLOCKS_INTERNAL;
+    void *(*allocate)(size_t) = psram ? ps_malloc : malloc;
+
+    decoder = new (std::nothrow) JpegDcDecoder();
+    lumaMap = (uint8_t *)allocate(capacity);
+    background = (uint16_t *)allocate(capacity * sizeof(uint16_t));
+    changedMask = (uint8_t *)allocate(capacity);
+    if (decoder == nullptr || lumaMap == nullptr || background == nullptr || changedMask == nullptr) {
+        Serial.println("Failed to allocate motion detection buffers");
+        delete decoder;
+        free(lumaMap);
+        free(background);
+        free(changedMask);
+        decoder = nullptr;
+        lumaMap = nullptr;
+        background = nullptr;
+        changedMask = nullptr;
+        return false;
+    }
+
+    blockCapacity = capacity;
+    return true;
+}
+
+bool MotionDetector::processFrame(const uint8_t *jpeg, size_t length, uint32_t sequence, uint32_t nowMs) {
+    if (!allocateBuffers()) {
+        return false;
+    }
+
+    int64_t startUs = esp_timer_get_time();
+
+    uint16_t blocksWide = 0;
+    uint16_t blocksHigh = 0;
+    if (!decoder->decodeLumaDc(jpeg, length, lumaMap, blockCapacity, blocksWide, blocksHigh)) {
+        decodeFailures++;
+        return false;
+    }
+    uint32_t blockCount = (uint32_t)blocksWide * blocksHigh;
+
+    // Take a consistent copy of the settings the web server may be changing
+    MotionZone activeZones[MAX_ZONES];
+    portENTER_CRITICAL(&settingsMux);
+    uint8_t blockThreshold = threshold;
+    memcpy(activeZones, zones, sizeof(activeZones));
+    portEXIT_CRITICAL(&settingsMux);
+
+    if (blocksWide != mapWidth || blocksHigh != mapHeight) {
+        // First frame or a new frame size: start the background again
+        mapWidth = blocksWide;
+        mapHeight = blocksHigh;
+        for (uint32_t i = 0; i < blockCount; i++) {
+            background[i] = (uint16_t)(lumaMap[i] << 8);
+        }
+        warmupFrames = WARMUP_FRAMES;
+        activeFrames = 0;
+    }
+
+    uint32_t changed = compareWithBackground(blockCount, blockThreshold);
+    lastChangedPercent = (uint8_t)(changed * 100 / blockCount);
+
+    if (warmupFrames > 0) {
+        // Let auto exposure settle and the background catch up
+        warmupFrames--;
+    } else {
+        uint8_t active = 0;
+        uint8_t peakPercent = 0;
+        for (uint8_t i = 0; i < MAX_ZONES; i++) {
+            if (!activeZones[i].enabled) {
+                continue;
+            }
+            uint8_t percent = zoneChangedPercent(activeZones[i]);
+            if (percent >= activeZones[i].triggerPercent) {
+                active |= 1 << i;
+            }
+            if (percent > peakPercent) {
+                peakPercent = percent;
+            }
+        }
+        updateState(active, peakPercent, sequence, nowMs);
+    }
+
+    uint32_t elapsedUs = (uint32_t)(esp_timer_get_time() - startUs);
+    averageAnalysisUs = framesAnalysed == 0 ? elapsedUs
+        : (uint32_t)((int32_t)averageAnalysisUs + ((int32_t)elapsedUs - (int32_t)averageAnalysisUs) / 8);
+    if (elapsedUs > maxAnalysisUs) {
+        maxAnalysisUs = elapsedUs;
+    }
+    framesAnalysed++;
+    return true;
+}
+
+uint32_t MotionDetector::compareWithBackground(uint32_t blockCount, uint8_t blockThreshold) {
+    const uint8_t *current = lumaMap;
+    uint16_t *reference = background;
+    uint8_t *mask = changedMask;
+
+    // Remove a global brightness change (auto exposure, lights switched
+    // on) so it does not register as motion everywhere at once
+    uint32_t currentSum = 0;
+    uint32_t backgroundSum = 0;
+    for (uint32_t i = 0; i < blockCount; i++) {
+        currentSum += current[i];
+        backgroundSum += reference[i];
+    }
+    int32_t offset = (int32_t)(((int64_t)currentSum * 256 - backgroundSum) / (int32_t)blockCount);
+
+    // Straight-line loop with no branches so the compiler can unroll or
+    // vectorise it; all values are 8.8 fixed point
+    const int32_t limit = (int32_t)blockThreshold << 8;
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < blockCount; i++) {
+        int32_t sample = (int32_t)current[i] << 8;
+        int32_t learnt = reference[i];
+        int32_t difference = sample - learnt - offset;
+        int32_t magnitude = difference < 0 ? -difference : difference;
+        uint8_t isChanged = magnitude > limit;
+        mask[i] = isChanged;
+        changed += isChanged;
+
+        // Blocks that changed are learnt more slowly, so a moving object
+        // is not absorbed into the background while it is still moving
+        int32_t shift = LEARN_SHIFT + isChanged * (CHANGED_LEARN_SHIFT - LEARN_SHIFT);
+        reference[i] = (uint16_t)(learnt + ((sample - learnt) >> shift));
+    }
+    return changed;
+}
+
+uint8_t MotionDetector::zoneChangedPercent(const MotionZone &zone) {
+    uint16_t left = zone.x * mapWidth / 100;
+    uint16_t top = zone.y * mapHeight / 100;
+    uint16_t right = (zone.x + zone.width) * mapWidth / 100;
+    uint16_t bottom = (zone.y + zone.height) * mapHeight / 100;
+    if (right <= left) {
+        right = left + 1;
+    }
+    if (bottom <= top) {
+        bottom = top + 1;
+    }
+    if (right > mapWidth || bottom > mapHeight) {
+        return 0;
+    }
+
+    uint32_t changed = 0;
+    for (uint16_t y = top; y < bottom; y++) {
+        const uint8_t *row = changedMask + (uint32_t)y * mapWidth;
+        for (uint16_t x = left; x < right; x++) {
+            changed += row[x];
+        }
+    }
+    return (uint8_t)(changed * 100 / ((uint32_t)(right - left) * (bottom - top)));
+}
+
+void MotionDetector::updateState(uint8_t activeZones, uint8_t changedPercent, uint32_t sequence, uint32_t nowMs) {
+    if (activeZones != 0) {
+        lastActiveMs = nowMs;
+        if (activeFrames < 255) {
+            activeFrames++;
+        }
+    } else {
+        activeFrames = 0;
+    }
+
+    if (!motionActive) {
+        // One noisy frame is not enough to start an event
+        if (activeFrames >= START_FRAMES) {
+            motionActive = true;
+            motionStartMs = nowMs;
+            motionZones = activeZones;
+            peakChangedPercent = changedPercent;
+            MotionEvent event = {true, activeZones, changedPercent, sequence, 0};
+            queueEvent(event);
+        }
+        return;
+    }
+
+    if (activeZones != 0) {
+        motionZones |= activeZones;
+        if (changedPercent > peakChangedPercent) {
+            peakChangedPercent = changedPercent;
+        }
+    } else if (nowMs - lastActiveMs >= STOP_QUIET_MS) {
+        motionActive = false;
+        MotionEvent event = {false, motionZones, peakChangedPercent, sequence, lastActiveMs - motionStartMs};
+        queueEvent(event);
+    }
+}
+
+void MotionDetector::queueEvent(const MotionEvent &event) {
+    portENTER_CRITICAL(&eventMux);
+    if (eventCount == EVENT_QUEUE_SIZE) {
+        // MQTT has been down for a while; keep the most recent events
+        eventHead = (eventHead + 1) % EVENT_QUEUE_SIZE;
+        eventCount--;
+        eventsDropped++;
+    }
+    events[(eventHead + eventCount) % EVENT_QUEUE_SIZE] = event;
+    eventCount++;
+    portEXIT_CRITICAL(&eventMux);
+
+    Serial.printf("Motion %s (frame %u, %u%% changed)\n",
+        event.start ? "started" : "stopped", event.sequence, event.changedPercent);
+    TaskScheduler::post(publishPendingEvents);
+}
+
+void MotionDetector::publishPendingEvents() {
+    if (!MqttHandler::isConnected()) {
+        return;
+    }
+    auto config = ConfigurationManager::getConfig();
+
+    while (true) {
+        MotionEvent event;
+        portENTER_CRITICAL(&eventMux);
+        if (eventCount == 0) {
+            portEXIT_CRITICAL(&eventMux);
+            return;
+        }
+        event = events[eventHead];
+        eventHead = (eventHead + 1) % EVENT_QUEUE_SIZE;
+        eventCount--;
+        portEXIT_CRITICAL(&eventMux);
+
+        JsonDocument eventDoc;
+        eventDoc["id"] = config.uuid;
+        eventDoc["event"] = event.start ? "start" : "stop";
+        JsonArray zoneList = eventDoc["zones"].to<JsonArray>();
+        for (uint8_t i = 0; i < MAX_ZONES; i++) {
+            if (event.zones & (1 << i)) {
+                zoneList.add(i);
+            }
+        }
+        eventDoc["changed_pct"] = event.changedPercent;
+        eventDoc["frame_seq"] = event.sequence;
+        if (!event.start) {
+            eventDoc["duration_ms"] = event.durationMs;
+        }
+
+        String eventJson;
+        serializeJson(eventDoc, eventJson);
+        MqttHandler::publish("motion", eventJson);
+    }
+}
+
+void MotionDetector::addStatus(JsonDocument &doc) {
+    doc["enabled"] = isEnabled();
+    doc["threshold"] = getThreshold();
+    doc["motion"] = motionActive;
+    doc["changed_pct"] = lastChangedPercent;
+    doc["map_width"] = mapWidth;
+    doc["map_height"] = mapHeight;
+    doc["frames_analysed"] = framesAnalysed;
+    doc["frames_skipped"] = framesSkipped;
+    doc["decode_failures"] = decodeFailures;
+    doc["analysis_avg_us"] = averageAnalysisUs;
+    doc["analysis_max_us"] = maxAnalysisUs;
+    doc["events_dropped"] = eventsDropped;
+
+    JsonArray zoneList = doc["zones"].to<JsonArray>();
+    for (uint8_t i = 0; i < MAX_ZONES; i++) {
+        MotionZone zone = getZone(i);
+        JsonObject entry = zoneList.add<JsonObject>();
+        entry["enabled"] = zone.enabled;
+        entry["x"] = zone.x;
+        entry["y"] = zone.y;
+        entry["w"] = zone.width;
+        entry["h"] = zone.height;
+        entry["trigger"] = zone.triggerPercent;
+    }
+}
+
+void MotionDetector::detectLoop(void *parameter) {
+    int subscriberId = -1;
+    uint32_t skippedBefore = 0;
+    uint8_t *jpegCopy = nullptr;
+    size_t jpegCopyCapacity = 0;
+    bool psram = psramFound();
+
+    while (true) {
+        if (!enabled) {
+            if (subscriberId >= 0) {
+                FrameBroker::unsubscribe(subscriberId);
+                subscriberId = -1;
+                skippedBefore = framesSkipped;
+                if (motionActive) {
+                    updateState(0, 0, 0, lastActiveMs + STOP_QUIET_MS);
+                }
+                // Start with a fresh background when re-enabled
+                mapWidth = 0;
+                mapHeight = 0;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        if (subscriberId < 0) {
+            subscriberId = FrameBroker::subscribe();
+            if (subscriberId < 0) {
+                // Every slot is taken by stream clients; try again later
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+                continue;
+            }
+        }
+
+        SharedFrame *frame = FrameBroker::waitForFrame(subscriberId, pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+        if (frame == nullptr) {
+            continue;
+        }
+        framesSkipped = skippedBefore + FrameBroker::getDroppedFrameCount(subscriberId);
+
+        const uint8_t *jpeg = frame->fb->buf;
+        size_t length = frame->fb->len;
+        uint32_t sequence = frame->sequence;
+        uint32_t captureMs = (uint32_t)(frame->captureTimeUs / 1000);
+
+        // With PSRAM, copy the frame and hand the framebuffer straight back
+        // so the capture task never waits on analysis
+        if (psram && length <= MAX_JPEG_COPY) {
+            if (length > jpegCopyCapacity) {
+                free(jpegCopy);
+                jpegCopyCapacity = length + length / 4 < MAX_JPEG_COPY ? length + length / 4 : MAX_JPEG_COPY;
+                jpegCopy = (uint8_t *)ps_malloc(jpegCopyCapacity);
+                if (jpegCopy == nullptr) {
+                    jpegCopyCapacity = 0;
+                }
+            }
+            if (jpegCopy != nullptr) {
+                memcpy(jpegCopy, jpeg, length);
+                FrameBroker::release(frame);
+                frame = nullptr;
+                jpeg = jpegCopy;
+            }
+        }
+
+        processFrame(jpeg, length, sequence, captureMs);
+
+        if (frame != nullptr) {
+            FrameBroker::release(frame);
+            if (!psram) {
+                // Analysing in place holds a framebuffer, and without PSRAM
+                // there is only one, so leave the stream most of the frames
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NO_PSRAM_INTERVAL_MS));
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#include "MqttCommandChannel.h"
+#include "ConfigurationManager.h"
+
+WiFiClient MqttCommandChannel::wifiClient;
+PubSubClient MqttCommandChannel::client(MqttCommandChannel::wifiClient);
+MqttCommandChannel::Handler MqttCommandChannel::handlers[MqttCommandChannel::MAX_HANDLERS];
+uint8_t MqttCommandChannel::handlerCount = 0;
+char MqttCommandChannel::server[64] = "";
+char MqttCommandChannel::deviceId[40] = "";
+char MqttCommandChannel::commandTopic[64] = "";
+bool MqttCommandChannel::configured = false;
+bool MqttCommandChannel::failureReported = false;
+
+void MqttCommandChannel::begin() {
+    auto config = ConfigurationManager::getConfig();
+    config.mqttServer.toCharArray(server, sizeof(server));
+    config.uuid.toCharArray(deviceId, sizeof(deviceId));
+    snprintf(commandTopic, sizeof(commandTopic), "configure/%s", deviceId);
+
+    client.setServer(server, config.mqttPort);
+    client.setCallback(onMessage);
+    client.setBufferSize(COMMAND_BUFFER_SIZE);
+    // Both default to several seconds; attempts run on the network task
+    client.setSocketTimeout(ATTEMPT_TIMEOUT_S);
+    wifiClient.setTimeout(ATTEMPT_TIMEOUT_S);
+    configured = true;
+}
+
+bool MqttCommandChannel::addHandler(const char *action, MqttCommandHandler handler) {
+    if (handlerCount >= MAX_HANDLERS) {
+        Serial.printf("Command handler table full, '%s' not registered\n", action);
+        return false;
+    }
+    handlers[handlerCount].action = action;
+    handlers[handlerCount].handler = handler;
+    handlerCount++;
+    return true;
+}
+
+void MqttCommandChannel::loop() {
+    if (configured && WiFi.status() == WL_CONNECTED && client.connected()) {
+        client.loop();
+    }
+}
+
+bool MqttCommandChannel::isConnected() {
+    return client.connected();
+}
+
+PubSubClient &MqttCommandChannel::getClient() {
+    return client;
+}
+
+const char *MqttCommandChannel::getDeviceId() {
+    return deviceId;
+}
+
+bool MqttCommandChannel::connect() {
+    if (!configured || WiFi.status() != WL_CONNECTED) {
+        return false;
+    }
+    auto config = ConfigurationManager::getConfig();
+    String clientId = config.mqttClientName + "-cmd";
+    const char *user = config.mqttUsername.length() > 0 ? config.mqttUsername.c_str() : nullptr;
+    const char *pass = config.mqttPassword.length() > 0 ? config.mqttPassword.c_str() : nullptr;
+
+    if (!client.connect(clientId.c_str(), user, pass)) {
+        if (!failureReported) {
+            Serial.printf("Command channel: connect failed, state %d\n", client.state());
+            failureReported = true;
+        }
+        return false;
+    }
+    if (!client.subscribe(commandTopic)) {
+        Serial.println("Command channel: subscribe failed");
+        client.disconnect();
+        return false;
+    }
+
+    failureReported = false;
+    Serial.printf("Command channel: listening on %s\n", commandTopic);
+    return true;
+}
+
+void MqttCommandChannel::onMessage(char *topic, uint8_t *payload, unsigned int length) {
+    if (strcmp(topic, commandTopic) != 0) {
+        return;
+    }
+
+    JsonDocument command;
+    DeserializationError error = deserializeJson(command, payload, length);
+    if (error) {
+        Serial.printf("Command channel: invalid JSON (%s)\n", error.c_str());
+        return;
+    }
+
+    const char *action = command["action"];
+    if (action == nullptr) {
+        return;
+    }
+    for (uint8_t i = 0; i < handlerCount; i++) {
+        if (strcmp(handlers[i].action, action) == 0) {
+            handlers[i].handler(command);
+            return;
+        }
+    }
+}
@@ -0,0 +1,216 @@
+#include "RegionOfInterest.h"
+
+// OV2640 CIF mode covers the field at quarter resolution but only 296 rows of it
+static const uint16_t CIF_MODE_HEIGHT = 296;
+
+RegionOfInterest::Region RegionOfInterest::requested = {0, 0, RegionOfInterest::FIELD_WIDTH, RegionOfInterest::FIELD_HEIGHT};
+RegionOfInterest::Region RegionOfInterest::applied = {0, 0, 0, 0};
+bool RegionOfInterest::windowed = false;
+bool RegionOfInterest::warned = false;
+uint16_t RegionOfInterest::outputWidth = 0;
+uint16_t RegionOfInterest::outputHeight = 0;
+RegionOfInterest::Stats RegionOfInterest::stats[RegionOfInterest::MAX_STATS] = {};
+RegionOfInterest::Stats *RegionOfInterest::current = nullptr;
+portMUX_TYPE RegionOfInterest::statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void RegionOfInterest::configure(uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+    if (width == 0 || height == 0) {
+        requested = {0, 0, FIELD_WIDTH, FIELD_HEIGHT};
+        return;
+    }
+
+    // The window registers count in steps of 4 pixels
+    width = constrain(width, (uint16_t)MIN_SIZE, (uint16_t)FIELD_WIDTH) & ~3;
+    height = constrain(height, (uint16_t)MIN_SIZE, (uint16_t)FIELD_HEIGHT) & ~3;
+    x = min(x, (uint16_t)(FIELD_WIDTH - width)) & ~3;
+    y = min(y, (uint16_t)(FIELD_HEIGHT - height)) & ~3;
+    requested = {x, y, width, height};
+}
+
+void RegionOfInterest::apply() {
+    sensor_t * s = esp_camera_sensor_get();
+    if (s == nullptr) {
+        return;
+    }
+
+    Region region = requested;
+    framesize_t frameSize = (framesize_t)s->status.framesize;
+    uint16_t maxWidth = resolution[frameSize].width;
+    uint16_t maxHeight = resolution[frameSize].height;
+
+    bool crop = !isFullField(region);
+    if (crop && (s->id.PID != OV2640_PID || s->set_res_raw == nullptr)) {
+        if (!warned) {
+            Serial.println("Region of interest needs an OV2640 sensor; streaming the full field");
+            warned = true;
+        }
+        crop = false;
+    }
+
+    if (crop) {
+        // Scale down to fit the frame size, keeping the aspect ratio
+        uint32_t width = region.width;
+        uint32_t height = region.height;
+        if (width > maxWidth || height > maxHeight) {
+            if (width * maxHeight > height * maxWidth) {
+                height = height * maxWidth / width;
+                width = maxWidth;
+            } else {
+                width = width * maxHeight / height;
+                height = maxHeight;
+            }
+        }
+
+        // The fastest mode that still has a sensor pixel for every output pixel
+        SensorMode mode = MODE_UXGA;
+        uint8_t factor = 1;
+        if (region.width / 4 >= width && region.height / 4 >= height &&
+            (region.y + region.height) / 4 <= CIF_MODE_HEIGHT) {
+            mode = MODE_CIF;
+            factor = 4;
+        } else if (region.width / 2 >= width && region.height / 2 >= height) {
+            mode = MODE_SVGA;
+            factor = 2;
+        }
+        uint16_t windowWidth = (region.width / factor) & ~3;
+        uint16_t windowHeight = (region.height / factor) & ~3;
+        width = min(width, (uint32_t)windowWidth) & ~3;
+        height = min(height, (uint32_t)windowHeight) & ~3;
+
+        int result = s->set_res_raw(s, mode, 0, 0, 0, region.x / factor, region.y / factor,
+                                    windowWidth, windowHeight, width, height, false, false);
+        if (result == 0) {
+            // Reloading the mode registers can reset the JPEG quality
+            s->set_quality(s, s->status.quality);
+            windowed = true;
+            outputWidth = width;
+            outputHeight = height;
+            if (region.x != applied.x || region.y != applied.y ||
+                region.width != applied.width || region.height != applied.height) {
+                Serial.printf("Region of interest %ux%u at %u,%u, encoded at %ux%u\n", region.width, region.height,
+                              region.x, region.y, (unsigned)width, (unsigned)height);
+            }
+        } else {
+            Serial.printf("Failed to set the region of interest (%d)\n", result);
+            // Have the full-field window programmed again below
+            windowed = true;
+            crop = false;
+        }
+    }
+
+    if (!crop) {
+        if (windowed) {
+            // set_framesize() programs the full-field window again
+            s->set_framesize(s, frameSize);
+            windowed = false;
+        }
+        region = {0, 0, FIELD_WIDTH, FIELD_HEIGHT};
+        outputWidth = maxWidth;
+        outputHeight = maxHeight;
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    if (current == nullptr || region.x != applied.x || region.y != applied.y ||
+        region.width != applied.width || region.height != applied.height) {
+        current = selectStats(region);
+    }
+    current->outputWidth = outputWidth;
+    current->outputHeight = outputHeight;
+    portEXIT_CRITICAL(&statsMux);
+    applied = region;
+}
+
+bool RegionOfInterest::isActive() {
+    return windowed;
+}
+
+void RegionOfInterest::recordFrame(const camera_fb_t *fb) {
+    int64_t captureUs = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&statsMux);
+    if (current != nullptr) {
+        int64_t gapUs = captureUs - current->lastCaptureUs;
+        if (current->lastCaptureUs != 0 && gapUs > 0 && gapUs < MAX_FRAME_GAP_US) {
+            current->intervals++;
+            current->intervalUs += gapUs;
+        }
+        current->lastCaptureUs = captureUs;
+        current->frames++;
+        current->bytes += fb->len;
+        current->lastUsedMs = now;
+    }
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void RegionOfInterest::addStatus(JsonDocument &doc) {
+    char text[24];
+    snprintf(text, sizeof(text), "%ux%u", outputWidth, outputHeight);
+    doc["roi_output"] = text;
+    doc["roi_active"] = windowed;
+
+    RegionStats entries[MAX_STATS];
+    uint8_t count = getStats(entries);
+    JsonArray list = doc["roi_stats"].to<JsonArray>();
+    for (uint8_t i = 0; i < count; i++) {
+        JsonObject entry = list.add<JsonObject>();
+        snprintf(text, sizeof(text), "%u,%u,%u,%u", entries[i].x, entries[i].y, entries[i].width, entries[i].height);
+        entry["roi"] = text;
+        snprintf(text, sizeof(text), "%ux%u", entries[i].outputWidth, entries[i].outputHeight);
+        entry["output"] = text;
+        entry["frames"] = entries[i].frames;
+        entry["bytes_per_frame"] = entries[i].bytesPerFrame;
+        entry["fps"] = (int)(entries[i].fps * 10 + 0.5f) / 10.0;
+        entry["current"] = entries[i].current;
+    }
+}
+
+uint8_t RegionOfInterest::getStats(RegionStats *out) {
+    uint8_t count = 0;
+    portENTER_CRITICAL(&statsMux);
+    for (uint8_t i = 0; i < MAX_STATS; i++) {
+        const Stats &entry = stats[i];
+        if (entry.region.width == 0) {
+            continue;
+        }
+        RegionStats &result = out[count++];
+        result.x = entry.region.x;
+        result.y = entry.region.y;
+        result.width = entry.region.width;
+        result.height = entry.region.height;
+        result.outputWidth = entry.outputWidth;
+        result.outputHeight = entry.outputHeight;
+        result.frames = entry.frames;
+        result.bytesPerFrame = entry.frames > 0 ? (uint32_t)(entry.bytes / entry.frames) : 0;
+        result.fps = entry.intervalUs > 0 ? entry.intervals * 1000000.0f / entry.intervalUs : 0.0f;
+        result.current = &entry == current;
+    }
+    portEXIT_CRITICAL(&statsMux);
+    return count;
+}
+
+RegionOfInterest::Stats *RegionOfInterest::selectStats(const Region &region) {
+    Stats *oldest = &stats[0];
+    for (uint8_t i = 0; i < MAX_STATS; i++) {
+        Stats &entry = stats[i];
+        if (entry.region.x == region.x && entry.region.y == region.y &&
+            entry.region.width == region.width && entry.region.height == region.height) {
+            // Time spent on other regions is not part of this one's frame rate
+            entry.lastCaptureUs = 0;
+            entry.lastUsedMs = millis();
+            return &entry;
+        }
+        if (entry.region.width == 0 || (oldest->region.width != 0 && entry.lastUsedMs < oldest->lastUsedMs)) {
+            oldest = &entry;
+        }
+    }
+
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->region = region;
+    oldest->lastUsedMs = millis();
+    return oldest;
+}
+
+bool RegionOfInterest::isFullField(const Region &region) {
+    return region.width >= FIELD_WIDTH && region.height >= FIELD_HEIGHT;
+}
@@ -0,0 +1,198 @@
+#include "RtpJpeg.h"
+#include <string.h>
+
+static uint16_t readUint16(const uint8_t *data) {
+    return (uint16_t)(data[0] << 8 | data[1]);
+}
+
+static uint8_t *putUint16(uint8_t *out, uint16_t value) {
+    out[0] = (uint8_t)(value >> 8);
+    out[1] = (uint8_t)value;
+    return out + 2;
+}
+
+static uint8_t *putUint32(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+    return out + 4;
+}
+
+bool RtpJpeg::parse(const uint8_t *jpeg, size_t length, RtpJpegFrame &frame) {
+    if (length < 4 || jpeg[0] != 0xff || jpeg[1] != 0xd8) {
+        return false;
+    }
+
+    const uint8_t *quant[4] = {nullptr, nullptr, nullptr, nullptr};
+    uint8_t componentQuant[3] = {0, 0, 0};
+    uint8_t componentCount = 0;
+    bool sizeKnown = false;
+    frame.restartInterval = 0;
+
+    const uint8_t *cursor = jpeg + 2;
+    const uint8_t *limit = jpeg + length;
+    while (cursor + 4 <= limit) {
+        if (cursor[0] != 0xff) {
+            return false;
+        }
+        uint8_t marker = cursor[1];
+        if (marker == 0xff) {
+            cursor++;
+            continue;
+        }
+        uint16_t segmentLength = readUint16(cursor + 2);
+        const uint8_t *segment = cursor + 4;
+        const uint8_t *segmentEnd = cursor + 2 + segmentLength;
+        if (segmentLength < 2 || segmentEnd > limit) {
+            return false;
+        }
+
+        switch (marker) {
+            case 0xc0: {  // Baseline DCT
+                uint16_t height = readUint16(segment + 1);
+                uint16_t width = readUint16(segment + 3);
+                componentCount = segment[5];
+                if (segment[0] != 8 || componentCount != 3 || width > 2040 || height > 2040 ||
+                    segmentLength < 8 + 3 * 3) {
+                    return false;
+                }
+                // Luma sampling picks the type; both chroma components must be 1x1
+                uint8_t sampling = segment[7];
+                if (sampling == 0x21) {
+                    frame.type = 0;
+                } else if (sampling == 0x22) {
+                    frame.type = 1;
+                } else {
+                    return false;
+                }
+                for (uint8_t i = 0; i < 3; i++) {
+                    const uint8_t *entry = segment + 6 + i * 3;
+                    if (i > 0 && entry[1] != 0x11) {
+                        return false;
+                    }
+                    componentQuant[i] = entry[2] & 0x03;
+                }
+                if (componentQuant[1] != componentQuant[2]) {
+                    return false;
+                }
+                frame.width = (uint8_t)((width + 7) / 8);
+                frame.height = (uint8_t)((height + 7) / 8);
+                sizeKnown = true;
+                break;
+            }
+
+            case 0xc1:  // Only baseline fits RTP/JPEG
+            case 0xc2:
+            case 0xc3:
+            case 0xc9:
+            case 0xca:
+                return false;
+
+            case 0xdb: {
+                const uint8_t *table = segment;
+                while (table < segmentEnd) {
+                    // RTP/JPEG can carry 16-bit tables, but the sensor never makes them
+                    if ((table[0] >> 4) != 0 || table + 65 > segmentEnd) {
+                        return false;
+                    }
+                    quant[table[0] & 0x03] = table + 1;
+                    table += 65;
+                }
+                break;
+            }
+
+            case 0xdd:
+                frame.restartInterval = readUint16(segment);
+                break;
+
+            case 0xda: {
+                if (!sizeKnown || segment[0] != 3 || !quant[componentQuant[0]] || !quant[componentQuant[1]]) {
+                    return false;
+                }
+                memcpy(frame.quantTables, quant[componentQuant[0]], 64);
+                memcpy(frame.quantTables + 64, quant[componentQuant[1]], 64);
+                if (frame.restartInterval != 0) {
+                    frame.type += 64;
+                }
+
+                // The sensor pads the framebuffer after the EOI marker
+                const uint8_t *end = limit;
+                while (end - 2 >= segmentEnd && !(end[-2] == 0xff && end[-1] == 0xd9)) {
+                    end--;
+                }
+                if (end - 2 < segmentEnd) {
+                    return false;
+                }
+                frame.scan = segmentEnd;
+                frame.scanLength = end - 2 - segmentEnd;
+                return frame.scanLength > 0;
+            }
+
+            default:
+                break;
+        }
+        cursor = segmentEnd;
+    }
+    return false;
+}
+
+bool RtpJpeg::nextPacket(const RtpJpegFrame &frame, size_t &offset, uint16_t sequence,
+                         uint32_t timestamp, uint32_t ssrc, RtpJpegPacket &packet) {
+    if (offset >= frame.scanLength) {
+        return false;
+    }
+
+    // Restart marker and quantisation table headers make the first packet's payload smaller
+    size_t room = (int)MAX_PAYLOAD_SIZE;
+    if (frame.restartInterval != 0) {
+        room -= 4;
+    }
+    if (offset == 0) {
+        room -= 4 + sizeof(frame.quantTables);
+    }
+    size_t payloadLength = frame.scanLength - offset;
+    if (payloadLength > room) {
+        payloadLength = room;
+    }
+    bool last = offset + payloadLength == frame.scanLength;
+
+    // RTP header (RFC 3550)
+    uint8_t *out = packet.header;
+    *out++ = 0x80;
+    *out++ = (uint8_t)((last ? 0x80 : 0x00) | (int)PAYLOAD_TYPE);
+    out = putUint16(out, sequence);
+    out = putUint32(out, timestamp);
+    out = putUint32(out, ssrc);
+
+    // JPEG header: type-specific, 24-bit fragment offset, type, Q, width, height
+    *out++ = 0;
+    *out++ = (uint8_t)(offset >> 16);
+    *out++ = (uint8_t)(offset >> 8);
+    *out++ = (uint8_t)offset;
+    *out++ = frame.type;
+    *out++ = 255;
+    *out++ = frame.width;
+    *out++ = frame.height;
+
+    if (frame.restartInterval != 0) {
+        // Packets are not aligned to restart intervals, so F and L are both set
+        out = putUint16(out, frame.restartInterval);
+        out = putUint16(out, 0xffff);
+    }
+
+    if (offset == 0) {
+        *out++ = 0;      // MBZ
+        *out++ = 0;      // Precision: both tables 8-bit
+        out = putUint16(out, sizeof(frame.quantTables));
+        memcpy(out, frame.quantTables, sizeof(frame.quantTables));
+        out += sizeof(frame.quantTables);
+    }
+
+    packet.headerLength = out - packet.header;
+    packet.payload = frame.scan + offset;
+    packet.payloadLength = payloadLength;
+    packet.last = last;
+    offset += payloadLength;
+    return true;
+}
@@ -0,0 +1,750 @@
+#include "RtspServer.h"
+#include "BandwidthBudget.h"
+#include "FrameBroker.h"
+#include "RtpJpeg.h"
+#include "StreamMetrics.h"
+#include "StreamSessionManager.h"
+#include "TaskConfig.h"
+#include <WiFi.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+
+static const char PUBLIC_METHODS[] = "OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, GET_PARAMETER";
+static const char CNAME[] = "esp32-web-cam";
+static const uint32_t NTP_UNIX_OFFSET = 2208988800UL;   // Seconds from 1900 to 1970
+
+RtspServer::Client RtspServer::clients[RtspServer::MAX_CLIENTS];
+RtspServer::Stream RtspServer::multicastStream;
+int RtspServer::listenSocket = -1;
+int RtspServer::rtpSocket = -1;
+int RtspServer::rtcpSocket = -1;
+TaskHandle_t RtspServer::serverTask = nullptr;
+
+// Find a header in a request; names are case-insensitive
+static bool getHeader(const char *request, const char *name, char *value, size_t size) {
+    size_t nameLength = strlen(name);
+    const char *line = strstr(request, "\r\n");
+    while (line) {
+        line += 2;
+        if (strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+            const char *start = line + nameLength + 1;
+            while (*start == ' ' || *start == '\t') {
+                start++;
+            }
+            const char *end = strstr(start, "\r\n");
+            size_t length = end ? end - start : strlen(start);
+            if (length >= size) {
+                length = size - 1;
+            }
+            memcpy(value, start, length);
+            value[length] = '\0';
+            return true;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return false;
+}
+
+static const char *statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 453: return "Not Enough Bandwidth";
+        case 454: return "Session Not Found";
+        case 455: return "Method Not Valid in This State";
+        case 461: return "Unsupported Transport";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default: return "Internal Server Error";
+    }
+}
+
+// RTP time of a moment on the esp_timer clock, which is what capture times use
+static uint32_t rtpTime(uint32_t offset, int64_t timeUs) {
+    return offset + (uint32_t)((uint64_t)timeUs * 9 / 100);
+}
+
+static bool writeVector(int fd, struct iovec *vector, int count) {
+    while (count > 0) {
+        int sent = writev(fd, vector, count);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        // Skip whatever was fully written and trim a partly written buffer
+        while (count > 0 && (size_t)sent >= vector->iov_len) {
+            sent -= vector->iov_len;
+            vector++;
+            count--;
+        }
+        if (count > 0) {
+            vector->iov_base = (uint8_t *)vector->iov_base + sent;
+            vector->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+static int openUdpSocket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    uint8_t ttl = RtspServer::MULTICAST_TTL;
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool RtspServer::begin() {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].active = false;
+        clients[i].stream.writeLock = xSemaphoreCreateMutex();
+        if (!clients[i].stream.writeLock) {
+            Serial.println("RTSP: failed to create lock");
+            return false;
+        }
+    }
+    multicastStream.running = false;
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        Serial.println("RTSP: failed to create socket");
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(RTSP_PORT);
+    if (bind(listenSocket, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listenSocket, MAX_CLIENTS) != 0) {
+        Serial.printf("RTSP: failed to listen on port %d\n", RTSP_PORT);
+        close(listenSocket);
+        return false;
+    }
+
+    rtpSocket = openUdpSocket(SERVER_RTP_PORT);
+    rtcpSocket = openUdpSocket(SERVER_RTP_PORT + 1);
+    if (rtpSocket < 0 || rtcpSocket < 0) {
+        Serial.printf("RTSP: failed to open UDP ports %d-%d\n", (int)SERVER_RTP_PORT, SERVER_RTP_PORT + 1);
+        return false;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        serverLoop, "rtsp", SERVER_TASK_STACK, nullptr,
+        RTSP_TASK_PRIORITY, &serverTask, RTSP_TASK_CORE);
+    if (created != pdPASS) {
+        Serial.println("RTSP: failed to start server task");
+        return false;
+    }
+
+    Serial.printf("RTSP server on %s\n", getUrl().c_str());
+    return true;
+}
+
+String RtspServer::getUrl() {
+    String url = "rtsp://" + WiFi.localIP().toString();
+    if (RTSP_PORT != 554) {
+        url += ":" + String(RTSP_PORT);
+    }
+    return url + "/";
+}
+
+void RtspServer::serverLoop(void *parameter) {
+    for (;;) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listenSocket, &readable);
+        FD_SET(rtcpSocket, &readable);
+        int maxFd = listenSocket > rtcpSocket ? listenSocket : rtcpSocket;
+        for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i].active && !clients[i].closing) {
+                FD_SET(clients[i].fd, &readable);
+                maxFd = clients[i].fd > maxFd ? clients[i].fd : maxFd;
+            }
+        }
+
+        struct timeval timeout = {SELECT_TIMEOUT_MS / 1000, 0};
+        if (select(maxFd + 1, &readable, nullptr, nullptr, &timeout) > 0) {
+            for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+                Client &client = clients[i];
+                if (client.active && !client.closing && FD_ISSET(client.fd, &readable) && !receive(client)) {
+                    closeClient(client);
+                }
+            }
+            if (FD_ISSET(rtcpSocket, &readable)) {
+                receiveReport();
+            }
+            if (FD_ISSET(listenSocket, &readable)) {
+                acceptClient();
+            }
+        }
+
+        uint32_t now = millis();
+        for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+            Client &client = clients[i];
+            if (!client.active) {
+                continue;
+            }
+            if (!client.closing && now - client.lastActivityMs > SESSION_TIMEOUT_SECONDS * 1000) {
+                Serial.println("RTSP session timed out");
+                closeClient(client);
+            }
+            // An interleaved sender writes to the socket until it has stopped
+            if (client.closing && !client.stream.running) {
+                close(client.fd);
+                client.active = false;
+            }
+        }
+    }
+}
+
+void RtspServer::acceptClient() {
+    int fd = accept(listenSocket, nullptr, nullptr);
+    if (fd < 0) {
+        return;
+    }
+
+    Client *client = nullptr;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].active) {
+            client = &clients[i];
+            break;
+        }
+    }
+    if (!client) {
+        Serial.println("Too many RTSP clients");
+        close(fd);
+        return;
+    }
+
+    // A stalled interleaved client must not hold the write lock for long
+    struct timeval sendTimeout = {SEND_TIMEOUT_MS / 1000, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    client->active = true;
+    client->closing = false;
+    client->fd = fd;
+    client->sessionId = 0;
+    client->playing = false;
+    client->lastActivityMs = millis();
+    client->received = 0;
+    client->stream.transport = RtspTransport::NONE;
+    client->stream.fd = fd;
+    client->stream.running = false;
+    client->stream.stopRequested = false;
+}
+
+bool RtspServer::receive(Client &client) {
+    int received = recv(client.fd, client.request + client.received, REQUEST_BUFFER_SIZE - client.received, 0);
+    if (received <= 0) {
+        return received < 0 && errno == EINTR;
+    }
+    client.received += received;
+    client.lastActivityMs = millis();
+
+    while (client.received > 0) {
+        char *buffer = client.request;
+        size_t consumed;
+        if (buffer[0] == '$') {
+            // Interleaved RTCP from the client; it only counts as activity
+            if (client.received < 4) {
+                break;
+            }
+            consumed = 4 + ((uint8_t)buffer[2] << 8 | (uint8_t)buffer[3]);
+        } else {
+            buffer[client.received] = '\0';
+            char *end = strstr(buffer, "\r\n\r\n");
+            if (!end) {
+                return client.received < REQUEST_BUFFER_SIZE;
+            }
+            size_t headerLength = end + 4 - buffer;
+            char saved = buffer[headerLength];
+            buffer[headerLength] = '\0';
+            char value[12];
+            consumed = headerLength;
+            if (getHeader(buffer, "Content-Length", value, sizeof(value))) {
+                consumed += strtoul(value, nullptr, 10);
+            }
+            if (consumed <= client.received) {
+                handleRequest(client, buffer);
+            } else {
+                buffer[headerLength] = saved;
+            }
+        }
+        if (consumed > REQUEST_BUFFER_SIZE) {
+            return false;
+        }
+        if (consumed > client.received) {
+            break;
+        }
+        memmove(client.request, client.request + consumed, client.received - consumed);
+        client.received -= consumed;
+    }
+    return true;
+}
+
+void RtspServer::handleRequest(Client &client, char *request) {
+    char method[16];
+    char url[128];
+    char value[160];
+    char cseq[12] = "0";
+    char headers[RESPONSE_BUFFER_SIZE / 2];
+    char body[RESPONSE_BUFFER_SIZE / 2];
+    int status = 200;
+    uint32_t sessionId = client.sessionId;
+
+    headers[0] = '\0';
+    body[0] = '\0';
+    getHeader(request, "CSeq", cseq, sizeof(cseq));
+    bool hasSession = getHeader(request, "Session", value, sizeof(value));
+
+    if (sscanf(request, "%15s %127s", method, url) != 2) {
+        status = 400;
+    } else if (hasSession && strtoul(value, nullptr, 16) != client.sessionId) {
+        status = 454;
+    } else if (strcmp(method, "OPTIONS") == 0) {
+        snprintf(headers, sizeof(headers), "Public: %s\r\n", PUBLIC_METHODS);
+    } else if (strcmp(method, "DESCRIBE") == 0) {
+        String ip = WiFi.localIP().toString();
+        int bodyLength = snprintf(body, sizeof(body),
+            "v=0\r\n"
+            "o=- %u 1 IN IP4 %s\r\n"
+            "s=%s\r\n"
+            "c=IN IP4 0.0.0.0\r\n"
+            "t=0 0\r\n"
+            "a=control:*\r\n"
+            "a=range:npt=0-\r\n"
+            "m=video 0 RTP/AVP %d\r\n"
+            "a=rtpmap:%d JPEG/%u\r\n"
+            "a=control:track1\r\n",
+            (unsigned)FrameBroker::getEpoch(), ip.c_str(), CNAME,
+            (int)RtpJpeg::PAYLOAD_TYPE, (int)RtpJpeg::PAYLOAD_TYPE, (unsigned)RtpJpeg::CLOCK_RATE);
+        // Relative control URLs resolve against the base, so it must end in a slash
+        snprintf(headers, sizeof(headers),
+                 "Content-Base: %s%s\r\nContent-Type: application/sdp\r\nContent-Length: %d\r\n",
+                 url, url[strlen(url) - 1] == '/' ? "" : "/", bodyLength);
+    } else if (strcmp(method, "SETUP") == 0) {
+        if (!getHeader(request, "Transport", value, sizeof(value))) {
+            status = 461;
+        } else {
+            status = setup(client, value, headers, sizeof(headers));
+            sessionId = client.sessionId;
+        }
+    } else if (strcmp(method, "PLAY") == 0) {
+        status = client.sessionId == 0 ? 454 : play(client, url, headers, sizeof(headers));
+    } else if (strcmp(method, "PAUSE") == 0) {
+        status = client.sessionId == 0 ? 454 : 200;
+        stopPlaying(client);
+    } else if (strcmp(method, "TEARDOWN") == 0) {
+        stopPlaying(client);
+        client.sessionId = 0;
+        client.stream.transport = RtspTransport::NONE;
+    } else if (strcmp(method, "GET_PARAMETER") != 0 && strcmp(method, "SET_PARAMETER") != 0) {
+        // GET_PARAMETER and SET_PARAMETER are only keep-alives
+        status = 501;
+    }
+
+    char response[RESPONSE_BUFFER_SIZE + RESPONSE_BUFFER_SIZE / 2];
+    int length = snprintf(response, sizeof(response), "RTSP/1.0 %d %s\r\nCSeq: %s\r\nServer: %s\r\n",
+                          status, statusText(status), cseq, CNAME);
+    if (sessionId != 0 && status == 200) {
+        length += snprintf(response + length, sizeof(response) - length, "Session: %08X;timeout=%u\r\n",
+                           (unsigned)sessionId, (unsigned)SESSION_TIMEOUT_SECONDS);
+    }
+    length += snprintf(response + length, sizeof(response) - length, "%s\r\n%s", headers, body);
+    if (length >= (int)sizeof(response)) {
+        length = sizeof(response) - 1;
+    }
+    sendLocked(client.fd, client.stream.writeLock, response, length);
+}
+
+int RtspServer::setup(Client &client, const char *transport, char *reply, size_t replySize) {
+    if (client.playing) {
+        return 455;
+    }
+
+    // Only the first of the transports the client offers is considered
+    char first[160];
+    strncpy(first, transport, sizeof(first) - 1);
+    first[sizeof(first) - 1] = '\0';
+    char *comma = strchr(first, ',');
+    if (comma) {
+        *comma = '\0';
+    }
+    if (strncmp(first, "RTP/AVP", 7) != 0) {
+        return 461;
+    }
+
+    Stream &stream = client.stream;
+    resetStream(stream);
+    const char *parameter;
+    if (strncmp(first, "RTP/AVP/TCP", 11) == 0) {
+        unsigned channel = 0;
+        parameter = strstr(first, "interleaved=");
+        if (parameter) {
+            channel = strtoul(parameter + 12, nullptr, 10);
+        }
+        if (channel > 254) {
+            return 461;
+        }
+        stream.transport = RtspTransport::TCP;
+        stream.channel = (uint8_t)channel;
+        snprintf(reply, replySize, "Transport: RTP/AVP/TCP;unicast;interleaved=%u-%u;ssrc=%08X\r\n",
+                 channel, channel + 1, (unsigned)stream.ssrc);
+    } else if (strstr(first, "multicast")) {
+        if (!RTSP_MULTICAST_ENABLED) {
+            return 461;
+        }
+        stream.transport = RtspTransport::MULTICAST;
+        struct in_addr group = getMulticastGroup();
+        snprintf(reply, replySize, "Transport: RTP/AVP;multicast;destination=%s;port=%u-%u;ttl=%u\r\n",
+                 inet_ntoa(group), (unsigned)MULTICAST_PORT, MULTICAST_PORT + 1, (unsigned)MULTICAST_TTL);
+    } else {
+        unsigned rtpPort = 0;
+        unsigned rtcpPort = 0;
+        parameter = strstr(first, "client_port=");
+        if (!parameter || sscanf(parameter + 12, "%u-%u", &rtpPort, &rtcpPort) < 1 ||
+            rtpPort == 0 || rtpPort > 65534) {
+            return 461;
+        }
+        if (rtcpPort == 0 || rtcpPort > 65535) {
+            rtcpPort = rtpPort + 1;
+        }
+        struct sockaddr_in peer;
+        socklen_t peerLength = sizeof(peer);
+        if (getpeername(client.fd, (struct sockaddr *)&peer, &peerLength) != 0) {
+            return 500;
+        }
+        stream.transport = RtspTransport::UDP;
+        stream.rtpAddress = peer;
+        stream.rtpAddress.sin_port = htons(rtpPort);
+        stream.rtcpAddress = peer;
+        stream.rtcpAddress.sin_port = htons(rtcpPort);
+        snprintf(reply, replySize,
+                 "Transport: RTP/AVP;unicast;client_port=%u-%u;server_port=%u-%u;ssrc=%08X\r\n",
+                 rtpPort, rtcpPort, (unsigned)SERVER_RTP_PORT, SERVER_RTP_PORT + 1, (unsigned)stream.ssrc);
+    }
+
+    if (client.sessionId == 0) {
+        client.sessionId = esp_random() | 1;
+    }
+    return 200;
+}
+
+int RtspServer::play(Client &client, const char *url, char *reply, size_t replySize) {
+    if (client.stream.transport == RtspTransport::NONE) {
+        return 455;
+    }
+
+    bool multicast = client.stream.transport == RtspTransport::MULTICAST;
+    Stream &stream = multicast ? multicastStream : client.stream;
+    if (!client.playing && !(multicast && stream.running && !stream.stopRequested)) {
+        // A sender told to stop by PAUSE or by the last multicast viewer leaving may still be winding down
+        if (!stopSender(stream)) {
+            return 503;
+        }
+        if (multicast) {
+            resetStream(stream);
+            stream.transport = RtspTransport::MULTICAST;
+            stream.rtpAddress.sin_family = AF_INET;
+            stream.rtpAddress.sin_addr = getMulticastGroup();
+            stream.rtpAddress.sin_port = htons(MULTICAST_PORT);
+            stream.rtcpAddress = stream.rtpAddress;
+            stream.rtcpAddress.sin_port = htons(MULTICAST_PORT + 1);
+            // Send from the station interface, whatever address it has now
+            struct in_addr interface;
+            if (inet_aton(WiFi.localIP().toString().c_str(), &interface)) {
+                setsockopt(rtpSocket, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface));
+                setsockopt(rtcpSocket, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface));
+            }
+        }
+        // The sender takes a stream slot, given back as it exits
+        if (!StreamSessionManager::claimSlot(STREAM_PRIORITY)) {
+            Serial.println("RTSP client turned away: every stream slot is taken");
+            snprintf(reply, replySize, "Retry-After: %u\r\n", (unsigned)StreamSessionManager::RETRY_AFTER_SECONDS);
+            return 503;
+        }
+        stream.subscriber = FrameBroker::subscribe();
+        if (stream.subscriber < 0) {
+            StreamSessionManager::releaseSlot(STREAM_PRIORITY);
+            Serial.println("Too many stream clients");
+            return 453;
+        }
+        if (!startSender(stream, multicast ? "rtsp-mcast" : "rtsp")) {
+            FrameBroker::unsubscribe(stream.subscriber);
+            StreamSessionManager::releaseSlot(STREAM_PRIORITY);
+            return 500;
+        }
+    }
+
+    if (!client.playing) {
+        static const char *const TRANSPORT_NAMES[] = {"", "UDP", "TCP", "multicast"};
+        Serial.printf("RTSP client playing over %s\n", TRANSPORT_NAMES[(int)client.stream.transport]);
+    }
+    client.playing = true;
+    snprintf(reply, replySize, "Range: npt=0.000-\r\nRTP-Info: url=%s;seq=%u;rtptime=%u\r\n",
+             url, (unsigned)stream.sequence, (unsigned)rtpTime(stream.timestampOffset, esp_timer_get_time()));
+    return 200;
+}
+
+void RtspServer::stopPlaying(Client &client) {
+    if (!client.playing) {
+        return;
+    }
+    client.playing = false;
+
+    if (client.stream.transport != RtspTransport::MULTICAST) {
+        client.stream.stopRequested = true;
+        return;
+    }
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].active && clients[i].playing && clients[i].stream.transport == RtspTransport::MULTICAST) {
+            return;
+        }
+    }
+    multicastStream.stopRequested = true;
+}
+
+void RtspServer::closeClient(Client &client) {
+    stopPlaying(client);
+    client.closing = true;
+    // Fails any interleaved write the sender is blocked in; the socket is closed once it has stopped
+    shutdown(client.fd, SHUT_RDWR);
+}
+
+bool RtspServer::startSender(Stream &stream, const char *name) {
+    stream.stopRequested = false;
+    stream.running = true;
+    BaseType_t created = xTaskCreatePinnedToCore(
+        streamSender, name, SENDER_TASK_STACK, &stream,
+        STREAM_TASK_PRIORITY, nullptr, STREAM_TASK_CORE);
+    if (created != pdPASS) {
+        Serial.println("Failed to start sender task");
+        stream.running = false;
+        return false;
+    }
+    return true;
+}
+
+bool RtspServer::stopSender(Stream &stream) {
+    stream.stopRequested = true;
+    uint32_t start = millis();
+    while (stream.running && millis() - start < SENDER_STOP_WAIT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return !stream.running;
+}
+
+void RtspServer::resetStream(Stream &stream) {
+    stream.ssrc = esp_random();
+    stream.sequence = (uint16_t)esp_random();
+    stream.timestampOffset = esp_random();
+    stream.packetCount = 0;
+    stream.octetCount = 0;
+    stream.lastReportMs = millis() - REPORT_INTERVAL_MS;
+}
+
+void RtspServer::streamSender(void *parameter) {
+    Stream *stream = (Stream *)parameter;
+    size_t last_frame_len = 0;
+    uint32_t skipped_total = 0;
+    bool ok = true;
+
+    StreamMetrics::recordClientConnected();
+
+    while (ok && !stream->stopRequested) {
+        // Charge the budget before taking a frame so a throttled client
+        // never holds a framebuffer while it waits
+        BandwidthBudget::acquire(last_frame_len, STREAM_PRIORITY);
+
+        SharedFrame *frame = FrameBroker::waitForFrame(stream->subscriber, pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+        if (!frame) {
+            continue;
+        }
+
+        last_frame_len = frame->fb->len;
+        int64_t send_start = esp_timer_get_time();
+        ok = sendFrame(*stream, frame->fb->buf, frame->fb->len, rtpTime(stream->timestampOffset, frame->captureTimeUs));
+
+        if (ok) {
+            int64_t send_end = esp_timer_get_time();
+            uint32_t skipped = FrameBroker::getDroppedFrameCount(stream->subscriber);
+            StreamMetrics::recordFrameSent(stream->subscriber, frame->fb->len, (uint32_t)(send_end - send_start));
+            StreamMetrics::recordFramesDropped(stream->subscriber, skipped - skipped_total);
+            skipped_total = skipped;
+        }
+
+        FrameBroker::release(frame);
+
+        if (ok) {
+            sendReport(*stream);
+        }
+    }
+
+    StreamMetrics::recordClientDisconnected();
+    FrameBroker::unsubscribe(stream->subscriber);
+    StreamSessionManager::releaseSlot(STREAM_PRIORITY);
+    stream->running = false;
+    vTaskDelete(nullptr);
+}
+
+bool RtspServer::sendFrame(Stream &stream, const uint8_t *jpeg, size_t length, uint32_t timestamp) {
+    RtpJpegFrame frame;
+    if (!RtpJpeg::parse(jpeg, length, frame)) {
+        Serial.println("Frame cannot be sent as RTP/JPEG");
+        return true;
+    }
+
+    RtpJpegPacket packet;
+    size_t offset = 0;
+    while (RtpJpeg::nextPacket(frame, offset, stream.sequence, timestamp, stream.ssrc, packet)) {
+        stream.sequence++;
+        if (!sendPacket(stream, false, packet.header, packet.headerLength, packet.payload, packet.payloadLength)) {
+            // A lost datagram only spoils this frame; a failed interleaved write ends the stream
+            return stream.transport != RtspTransport::TCP;
+        }
+        stream.packetCount++;
+        stream.octetCount += packet.headerLength - 12 + packet.payloadLength;
+    }
+    return true;
+}
+
+void RtspServer::sendReport(Stream &stream) {
+    uint32_t now = millis();
+    if (now - stream.lastReportMs < REPORT_INTERVAL_MS) {
+        return;
+    }
+    stream.lastReportMs = now;
+
+    struct timeval wallClock;
+    gettimeofday(&wallClock, nullptr);
+    uint32_t timestamp = rtpTime(stream.timestampOffset, esp_timer_get_time());
+    uint32_t words[] = {
+        // Sender report (RFC 3550 section 6.4.1)
+        0x80c80006, stream.ssrc,
+        (uint32_t)wallClock.tv_sec + NTP_UNIX_OFFSET,
+        (uint32_t)(((uint64_t)wallClock.tv_usec << 32) / 1000000),
+        timestamp, stream.packetCount, stream.octetCount,
+        // Source description with the CNAME every compound packet needs
+        0x81ca0000 | (uint32_t)((sizeof(CNAME) + 1 + 4 + 3) / 4), stream.ssrc,
+    };
+
+    uint8_t report[sizeof(words) + sizeof(CNAME) + 5];
+    size_t length = 0;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        report[length++] = (uint8_t)(words[i] >> 24);
+        report[length++] = (uint8_t)(words[i] >> 16);
+        report[length++] = (uint8_t)(words[i] >> 8);
+        report[length++] = (uint8_t)words[i];
+    }
+    report[length++] = 1;    // CNAME
+    report[length++] = sizeof(CNAME) - 1;
+    memcpy(report + length, CNAME, sizeof(CNAME) - 1);
+    length += sizeof(CNAME) - 1;
+    // A zero item type ends the chunk, padded to a whole word
+    do {
+        report[length++] = 0;
+    } while (length % 4 != 0);
+
+    sendPacket(stream, true, report, length, nullptr, 0);
+}
+
+bool RtspServer::sendPacket(Stream &stream, bool rtcp, const uint8_t *header, size_t headerLength,
+                            const uint8_t *payload, size_t payloadLength) {
+    struct iovec vector[3];
+    int count = 0;
+
+    if (stream.transport == RtspTransport::TCP) {
+        size_t total = headerLength + payloadLength;
+        uint8_t prefix[4] = {'$', (uint8_t)(stream.channel + (rtcp ? 1 : 0)), (uint8_t)(total >> 8), (uint8_t)total};
+        vector[count].iov_base = prefix;
+        vector[count++].iov_len = sizeof(prefix);
+        vector[count].iov_base = (void *)header;
+        vector[count++].iov_len = headerLength;
+        if (payloadLength > 0) {
+            vector[count].iov_base = (void *)payload;
+            vector[count++].iov_len = payloadLength;
+        }
+        if (xSemaphoreTake(stream.writeLock, pdMS_TO_TICKS(SEND_TIMEOUT_MS)) != pdTRUE) {
+            return false;
+        }
+        bool ok = writeVector(stream.fd, vector, count);
+        xSemaphoreGive(stream.writeLock);
+        return ok;
+    }
+
+    vector[count].iov_base = (void *)header;
+    vector[count++].iov_len = headerLength;
+    if (payloadLength > 0) {
+        vector[count].iov_base = (void *)payload;
+        vector[count++].iov_len = payloadLength;
+    }
+    struct msghdr message = {};
+    message.msg_name = rtcp ? &stream.rtcpAddress : &stream.rtpAddress;
+    message.msg_namelen = sizeof(struct sockaddr_in);
+    message.msg_iov = vector;
+    message.msg_iovlen = count;
+
+    for (uint8_t attempt = 0;; attempt++) {
+        if (sendmsg(rtcp ? rtcpSocket : rtpSocket, &message, 0) >= 0) {
+            return true;
+        }
+        // A whole frame at once can use up lwIP's packet buffers; give the driver a tick to drain them
+        if ((errno != ENOMEM && errno != ENOBUFS && errno != EAGAIN) || attempt >= SEND_RETRY_LIMIT) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+}
+
+bool RtspServer::sendLocked(int fd, SemaphoreHandle_t writeLock, const char *data, size_t length) {
+    struct iovec vector;
+    vector.iov_base = (void *)data;
+    vector.iov_len = length;
+    if (xSemaphoreTake(writeLock, pdMS_TO_TICKS(SEND_TIMEOUT_MS)) != pdTRUE) {
+        return false;
+    }
+    bool ok = writeVector(fd, &vector, 1);
+    xSemaphoreGive(writeLock);
+    return ok;
+}
+
+void RtspServer::receiveReport() {
+    uint8_t report[128];
+    struct sockaddr_in source;
+    socklen_t sourceLength = sizeof(source);
+    if (recvfrom(rtcpSocket, report, sizeof(report), 0, (struct sockaddr *)&source, &sourceLength) <= 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        Client &client = clients[i];
+        if (client.active && !client.closing && client.stream.transport == RtspTransport::UDP &&
+            client.stream.rtcpAddress.sin_addr.s_addr == source.sin_addr.s_addr &&
+            client.stream.rtcpAddress.sin_port == source.sin_port) {
+            client.lastActivityMs = millis();
+        }
+    }
+}
+
+struct in_addr RtspServer::getMulticastGroup() {
+    IPAddress ip = WiFi.localIP();
+    struct in_addr group;
+    group.s_addr = htonl(0xefff0000UL | (uint32_t)ip[2] << 8 | ip[3]);
+    return group;
+}
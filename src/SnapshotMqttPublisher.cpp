@@ -0,0 +1,140 @@
+#include "SnapshotMqttPublisher.h"
+#include "TaskScheduler.h"
+
+bool SnapshotMqttPublisher::pending = false;
+bool SnapshotMqttPublisher::pendingChunked = false;
+size_t SnapshotMqttPublisher::pendingChunkSize = SnapshotMqttPublisher::DEFAULT_CHUNK_SIZE;
+
+static void putBigEndian(uint8_t *cursor, uint32_t value, uint8_t bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        cursor[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+void SnapshotMqttPublisher::begin() {
+    MqttCommandChannel::addHandler("snapshot", handleCommand);
+}
+
+void SnapshotMqttPublisher::handleCommand(JsonDocument &command) {
+    const char *mode = command["mode"] | "stream";
+    pendingChunked = strcmp(mode, "chunks") == 0;
+    pendingChunkSize = command["chunk_size"] | (uint32_t)DEFAULT_CHUNK_SIZE;
+    pending = true;
+    TaskScheduler::post(publishPending);
+}
+
+void SnapshotMqttPublisher::publishPending() {
+    if (!pending || !MqttCommandChannel::isConnected()) {
+        return;
+    }
+    pending = false;
+    publishSnapshot(pendingChunked, pendingChunkSize);
+}
+
+bool SnapshotMqttPublisher::publishSnapshot(bool chunked, size_t chunkSize) {
+    PubSubClient &client = MqttCommandChannel::getClient();
+    if (!client.connected()) {
+        return false;
+    }
+
+    SharedFrame *frame = FrameBroker::acquireLatest(FRAME_MAX_AGE_MS);
+    if (frame == nullptr) {
+        frame = FrameBroker::waitForFrameAfter(FrameBroker::getCapturedFrameCount(),
+                                               pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+    }
+    if (frame == nullptr) {
+        Serial.println("Snapshot: no frame captured");
+        return false;
+    }
+
+    if (chunkSize < MIN_CHUNK_SIZE) {
+        chunkSize = MIN_CHUNK_SIZE;
+    } else if (chunkSize > MAX_CHUNK_SIZE) {
+        chunkSize = MAX_CHUNK_SIZE;
+    }
+    size_t length = frame->fb->len;
+    uint32_t chunkCount = chunked ? (length + chunkSize - 1) / chunkSize : 1;
+
+    bool sent = publishInfo(client, frame, chunked, chunkCount);
+    if (sent && chunked) {
+        sent = publishChunks(client, frame, chunkSize, chunkCount);
+    } else if (sent) {
+        char topic[64];
+        snprintf(topic, sizeof(topic), "snapshot/%s", MqttCommandChannel::getDeviceId());
+        sent = client.beginPublish(topic, length, false) &&
+               writeAll(client, frame->fb->buf, length) &&
+               client.endPublish();
+    }
+
+    Serial.printf("Snapshot %u: %u bytes as %u message(s) %s\n", frame->sequence, (unsigned)length,
+                  chunkCount, sent ? "published" : "failed");
+    FrameBroker::release(frame);
+
+    // A partly written message leaves the connection unusable
+    if (!sent) {
+        client.disconnect();
+    }
+    return sent;
+}
+
+bool SnapshotMqttPublisher::publishInfo(PubSubClient &client, const SharedFrame *frame, bool chunked,
+                                        uint32_t chunkCount) {
+    char topic[64];
+    char info[192];
+    snprintf(topic, sizeof(topic), "snapshot/%s/info", MqttCommandChannel::getDeviceId());
+    int length = snprintf(info, sizeof(info),
+        "{\"id\":\"%s\",\"frame_seq\":%u,\"size\":%u,\"width\":%u,\"height\":%u,\"mode\":\"%s\",\"chunks\":%u}",
+        MqttCommandChannel::getDeviceId(), frame->sequence, (unsigned)frame->fb->len,
+        (unsigned)frame->fb->width, (unsigned)frame->fb->height, chunked ? "chunks" : "stream", chunkCount);
+    if (length < 0 || length >= (int)sizeof(info)) {
+        return false;
+    }
+    return client.beginPublish(topic, length, false) &&
+           writeAll(client, (const uint8_t *)info, length) &&
+           client.endPublish();
+}
+
+bool SnapshotMqttPublisher::publishChunks(PubSubClient &client, const SharedFrame *frame, size_t chunkSize,
+                                          uint32_t chunkCount) {
+    char topic[64];
+    snprintf(topic, sizeof(topic), "snapshot/%s/chunk", MqttCommandChannel::getDeviceId());
+    const uint8_t *data = frame->fb->buf;
+    size_t remaining = frame->fb->len;
+
+    for (uint32_t index = 0; index < chunkCount; index++) {
+        size_t length = remaining < chunkSize ? remaining : chunkSize;
+
+        // Frame sequence, chunk index, chunk count and JPEG size, big-endian
+        uint8_t header[CHUNK_HEADER_SIZE];
+        putBigEndian(header, frame->sequence, 4);
+        putBigEndian(header + 4, index, 2);
+        putBigEndian(header + 6, chunkCount, 2);
+        putBigEndian(header + 8, frame->fb->len, 4);
+
+        if (!client.beginPublish(topic, sizeof(header) + length, false) ||
+            !writeAll(client, header, sizeof(header)) ||
+            !writeAll(client, data, length) ||
+            !client.endPublish()) {
+            return false;
+        }
+
+        // Serve incoming packets between chunks so keepalives are answered
+        client.loop();
+        data += length;
+        remaining -= length;
+    }
+    return true;
+}
+
+bool SnapshotMqttPublisher::writeAll(PubSubClient &client, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        size_t written = client.write(data, length);
+        if (written == 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
@@ -0,0 +1,379 @@
+#include "StreamMetrics.h"
+#include "CameraPower.h"
+#include "ConnectivityManager.h"
+#include "JpegThumbnailer.h"
+#include "MjpegFramer.h"
+#include "RegionOfInterest.h"
+#include "StreamSessionManager.h"
+#include "TaskMonitor.h"
+#include "TaskScheduler.h"
+#include <stdarg.h>
+
+const uint32_t LatencyHistogram::BUCKET_BOUNDS_MS[LatencyHistogram::BUCKET_COUNT] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000
+};
+
+std::atomic<uint32_t> StreamMetrics::framesCaptured(0);
+std::atomic<uint32_t> StreamMetrics::captureFailures(0);
+std::atomic<uint32_t> StreamMetrics::framesSent[FrameBroker::MAX_SUBSCRIBERS];
+std::atomic<uint32_t> StreamMetrics::framesDropped[FrameBroker::MAX_SUBSCRIBERS];
+uint64_t StreamMetrics::bytesSent = 0;
+std::atomic<uint32_t> StreamMetrics::activeClients(0);
+LatencyHistogram StreamMetrics::fbGetLatency;
+LatencyHistogram StreamMetrics::sendLatency;
+LatencyHistogram StreamMetrics::ackLatency;
+LatencyHistogram StreamMetrics::wakeLatency;
+portMUX_TYPE StreamMetrics::bytesMux = portMUX_INITIALIZER_UNLOCKED;
+portMUX_TYPE LatencyHistogram::sumMux = portMUX_INITIALIZER_UNLOCKED;
+
+namespace {
+
+/**
+ * @brief Collects Prometheus text in a stack buffer and sends it in chunks
+ */
+class MetricsWriter {
+public:
+    explicit MetricsWriter(httpd_req_t *req) : req(req), length(0), result(ESP_OK) {}
+
+    void printf(const char *format, ...) {
+        if (result != ESP_OK) {
+            return;
+        }
+
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer + length, sizeof(buffer) - length, format, args);
+        va_end(args);
+
+        if (written >= 0 && (size_t)written >= sizeof(buffer) - length) {
+            // Did not fit - send what we have and format the line again
+            flush();
+            va_start(args, format);
+            written = vsnprintf(buffer, sizeof(buffer), format, args);
+            va_end(args);
+        }
+        if (written > 0) {
+            length += written;
+            if (length > sizeof(buffer) - 1) {
+                length = sizeof(buffer) - 1;
+            }
+        }
+    }
+
+    void histogram(const char *name, const char *help, const LatencyHistogram &histogram) {
+        printf("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+        for (uint8_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+            printf("%s_bucket{le=\"%.3f\"} %u\n", name,
+                   LatencyHistogram::BUCKET_BOUNDS_MS[i] / 1000.0f, histogram.getCumulativeCount(i));
+        }
+        printf("%s_bucket{le=\"+Inf\"} %u\n", name, histogram.getCount());
+        printf("%s_sum %.6f\n%s_count %u\n", name, histogram.getSumUs() / 1000000.0, name, histogram.getCount());
+    }
+
+    esp_err_t finish() {
+        flush();
+        if (result == ESP_OK) {
+            result = httpd_resp_send_chunk(req, nullptr, 0);
+        }
+        return result;
+    }
+
+private:
+    httpd_req_t *req;
+    char buffer[512];
+    size_t length;
+    esp_err_t result;
+
+    void flush() {
+        if (length > 0 && result == ESP_OK) {
+            result = httpd_resp_send_chunk(req, buffer, length);
+        }
+        length = 0;
+    }
+};
+
+}  // namespace
+
+void LatencyHistogram::record(uint32_t durationUs) {
+    uint8_t bucket = 0;
+    while (bucket < BUCKET_COUNT && durationUs > BUCKET_BOUNDS_MS[bucket] * 1000) {
+        bucket++;
+    }
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    portENTER_CRITICAL(&sumMux);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumUs += durationUs;
+    portEXIT_CRITICAL(&sumMux);
+}
+
+uint32_t LatencyHistogram::getCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::getAverageMs() const {
+    portENTER_CRITICAL(&sumMux);
+    uint32_t observations = count.load(std::memory_order_relaxed);
+    uint64_t total = sumUs;
+    portEXIT_CRITICAL(&sumMux);
+    if (observations == 0) {
+        return 0;
+    }
+    return (uint32_t)(total / observations / 1000);
+}
+
+uint32_t LatencyHistogram::getCumulativeCount(uint8_t bucket) const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i <= bucket && i < BUCKET_COUNT; i++) {
+        total += buckets[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::getSumUs() const {
+    portENTER_CRITICAL(&sumMux);
+    uint64_t total = sumUs;
+    portEXIT_CRITICAL(&sumMux);
+    return total;
+}
+
+void StreamMetrics::recordFrameCaptured(uint32_t fbGetUs) {
+    framesCaptured.fetch_add(1, std::memory_order_relaxed);
+    fbGetLatency.record(fbGetUs);
+}
+
+void StreamMetrics::recordCaptureFailure() {
+    captureFailures.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StreamMetrics::recordFrameSent(int client, size_t bytes, uint32_t sendUs) {
+    if (client >= 0 && client < FrameBroker::MAX_SUBSCRIBERS) {
+        framesSent[client].fetch_add(1, std::memory_order_relaxed);
+    }
+    portENTER_CRITICAL(&bytesMux);
+    bytesSent += bytes;
+    portEXIT_CRITICAL(&bytesMux);
+    sendLatency.record(sendUs);
+}
+
+void StreamMetrics::recordFramesDropped(int client, uint32_t frames) {
+    if (frames > 0 && client >= 0 && client < FrameBroker::MAX_SUBSCRIBERS) {
+        framesDropped[client].fetch_add(frames, std::memory_order_relaxed);
+    }
+}
+
+void StreamMetrics::recordFrameAcknowledged(uint32_t ackUs) {
+    ackLatency.record(ackUs);
+}
+
+void StreamMetrics::recordCameraWake(uint32_t wakeUs) {
+    wakeLatency.record(wakeUs);
+}
+
+void StreamMetrics::recordClientConnected() {
+    activeClients.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StreamMetrics::recordClientDisconnected() {
+    activeClients.fetch_sub(1, std::memory_order_relaxed);
+}
+
+esp_err_t StreamMetrics::sendPrometheus(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    MetricsWriter writer(req);
+
+    writer.printf("# HELP webcam_frames_captured_total Frames captured by the capture task\n"
+                  "# TYPE webcam_frames_captured_total counter\n"
+                  "webcam_frames_captured_total %u\n",
+                  framesCaptured.load(std::memory_order_relaxed));
+    writer.printf("# HELP webcam_capture_failures_total Failed esp_camera_fb_get calls\n"
+                  "# TYPE webcam_capture_failures_total counter\n"
+                  "webcam_capture_failures_total %u\n",
+                  captureFailures.load(std::memory_order_relaxed));
+
+    writer.printf("# HELP webcam_stream_frames_sent_total Frames sent per stream client slot\n"
+                  "# TYPE webcam_stream_frames_sent_total counter\n");
+    for (uint8_t i = 0; i < FrameBroker::MAX_SUBSCRIBERS; i++) {
+        writer.printf("webcam_stream_frames_sent_total{client=\"%u\"} %u\n",
+                      i, framesSent[i].load(std::memory_order_relaxed));
+    }
+    writer.printf("# HELP webcam_stream_frames_dropped_total Frames skipped per stream client slot\n"
+                  "# TYPE webcam_stream_frames_dropped_total counter\n");
+    for (uint8_t i = 0; i < FrameBroker::MAX_SUBSCRIBERS; i++) {
+        writer.printf("webcam_stream_frames_dropped_total{client=\"%u\"} %u\n",
+                      i, framesDropped[i].load(std::memory_order_relaxed));
+    }
+
+    writer.printf("# HELP webcam_stream_bytes_sent_total JPEG bytes sent to stream clients\n"
+                  "# TYPE webcam_stream_bytes_sent_total counter\n"
+                  "webcam_stream_bytes_sent_total %llu\n",
+                  (unsigned long long)getBytesSent());
+    writer.printf("# HELP webcam_mjpeg_parts_total MJPEG parts written to /stream clients\n"
+                  "# TYPE webcam_mjpeg_parts_total counter\n"
+                  "webcam_mjpeg_parts_total %u\n"
+                  "# HELP webcam_mjpeg_socket_writes_total Socket writes made for MJPEG parts\n"
+                  "# TYPE webcam_mjpeg_socket_writes_total counter\n"
+                  "webcam_mjpeg_socket_writes_total %u\n"
+                  "# HELP webcam_mjpeg_framing_bytes_total Boundary, part header and trailer bytes written\n"
+                  "# TYPE webcam_mjpeg_framing_bytes_total counter\n"
+                  "webcam_mjpeg_framing_bytes_total %llu\n",
+                  MjpegFramer::getFramesWritten(), MjpegFramer::getSocketWrites(),
+                  (unsigned long long)MjpegFramer::getOverheadBytes());
+    writer.printf("# HELP webcam_stream_clients Connected stream clients\n"
+                  "# TYPE webcam_stream_clients gauge\n"
+                  "webcam_stream_clients %u\n",
+                  activeClients.load(std::memory_order_relaxed));
+    writer.printf("# HELP webcam_stream_slots Stream slots, and those kept for high priority viewers\n"
+                  "# TYPE webcam_stream_slots gauge\n"
+                  "webcam_stream_slots{class=\"all\"} %u\n"
+                  "webcam_stream_slots{class=\"high\"} %u\n",
+                  StreamSessionManager::getStreamSlots(), StreamSessionManager::getHighPrioritySlots());
+    const StreamPriority priorities[] = {StreamPriority::PRIMARY, StreamPriority::STANDARD, StreamPriority::BACKGROUND};
+    writer.printf("# HELP webcam_stream_slots_used Streams holding a slot per priority class\n"
+                  "# TYPE webcam_stream_slots_used gauge\n");
+    for (StreamPriority priority : priorities) {
+        writer.printf("webcam_stream_slots_used{priority=\"%s\"} %u\n",
+                      BandwidthBudget::getPriorityName(priority), StreamSessionManager::getActiveStreamCount(priority));
+    }
+    writer.printf("# HELP webcam_stream_rejected_total Viewers turned away with every slot taken\n"
+                  "# TYPE webcam_stream_rejected_total counter\n");
+    for (StreamPriority priority : priorities) {
+        writer.printf("webcam_stream_rejected_total{priority=\"%s\"} %u\n",
+                      BandwidthBudget::getPriorityName(priority), StreamSessionManager::getRejectedCount(priority));
+    }
+    writer.printf("# HELP webcam_stream_reaped_total Streams ended because their client stopped reading\n"
+                  "# TYPE webcam_stream_reaped_total counter\n"
+                  "webcam_stream_reaped_total{reason=\"send_timeout\"} %u\n"
+                  "webcam_stream_reaped_total{reason=\"stalled\"} %u\n",
+                  StreamSessionManager::getTimedOutCount(), StreamSessionManager::getReclaimedCount());
+    writer.printf("# HELP webcam_thumbnail_transcode_seconds Time the last /stream?scale= thumbnail took to make\n"
+                  "# TYPE webcam_thumbnail_transcode_seconds gauge\n"
+                  "webcam_thumbnail_transcode_seconds %.6f\n",
+                  JpegThumbnailer::getLastTranscodeUs() / 1000000.0f);
+
+    RegionStats regions[RegionOfInterest::MAX_STATS];
+    uint8_t regionCount = RegionOfInterest::getStats(regions);
+    writer.printf("# HELP webcam_roi_frame_bytes Average captured frame size per region of interest\n"
+                  "# TYPE webcam_roi_frame_bytes gauge\n");
+    for (uint8_t i = 0; i < regionCount; i++) {
+        writer.printf("webcam_roi_frame_bytes{roi=\"%u,%u,%u,%u\"} %u\n", regions[i].x, regions[i].y,
+                      regions[i].width, regions[i].height, regions[i].bytesPerFrame);
+    }
+    writer.printf("# HELP webcam_roi_fps Capture frame rate per region of interest\n"
+                  "# TYPE webcam_roi_fps gauge\n");
+    for (uint8_t i = 0; i < regionCount; i++) {
+        writer.printf("webcam_roi_fps{roi=\"%u,%u,%u,%u\"} %.1f\n", regions[i].x, regions[i].y,
+                      regions[i].width, regions[i].height, regions[i].fps);
+    }
+
+    writer.printf("# HELP webcam_camera_state Camera power state, 1 for the current one\n"
+                  "# TYPE webcam_camera_state gauge\n");
+    CameraPowerState powerState = CameraPower::getState();
+    for (uint8_t i = 0; i <= (uint8_t)CameraPowerState::WAKING; i++) {
+        writer.printf("webcam_camera_state{state=\"%s\"} %u\n", CameraPower::getStateName((CameraPowerState)i),
+                      (uint8_t)powerState == i ? 1u : 0u);
+    }
+    writer.printf("# HELP webcam_camera_standby_seconds_total Time the sensor has spent parked\n"
+                  "# TYPE webcam_camera_standby_seconds_total counter\n"
+                  "webcam_camera_standby_seconds_total %u\n",
+                  CameraPower::getStandbySeconds());
+
+    writer.histogram("webcam_fb_get_seconds", "Time spent in esp_camera_fb_get", fbGetLatency);
+    writer.histogram("webcam_frame_send_seconds", "Time taken to write one frame to a client", sendLatency);
+    writer.histogram("webcam_ws_ack_seconds", "Time from sending a frame over /ws to the client acknowledging it",
+                     ackLatency);
+    writer.histogram("webcam_camera_wake_seconds", "Time from waking the sensor to its first usable frame",
+                     wakeLatency);
+
+    writer.printf("# HELP webcam_heap_free_bytes Free internal heap\n"
+                  "# TYPE webcam_heap_free_bytes gauge\n"
+                  "webcam_heap_free_bytes %u\n"
+                  "# HELP webcam_heap_min_free_bytes Lowest free internal heap since boot\n"
+                  "# TYPE webcam_heap_min_free_bytes gauge\n"
+                  "webcam_heap_min_free_bytes %u\n",
+                  ESP.getFreeHeap(), ESP.getMinFreeHeap());
+    if (psramFound()) {
+        writer.printf("# HELP webcam_psram_free_bytes Free PSRAM\n"
+                      "# TYPE webcam_psram_free_bytes gauge\n"
+                      "webcam_psram_free_bytes %u\n"
+                      "# HELP webcam_psram_min_free_bytes Lowest free PSRAM since boot\n"
+                      "# TYPE webcam_psram_min_free_bytes gauge\n"
+                      "webcam_psram_min_free_bytes %u\n",
+                      ESP.getFreePsram(), ESP.getMinFreePsram());
+    }
+
+    // Static rather than on the HTTP server's stack; it runs one handler
+    // at a time
+    static TaskUsage tasks[TaskMonitor::MAX_TASKS];
+    uint8_t taskCount = TaskMonitor::getUsage(tasks, TaskMonitor::MAX_TASKS);
+    if (taskCount > 0) {
+        writer.printf("# HELP webcam_task_cpu_percent CPU use per task over the last sample interval\n"
+                      "# TYPE webcam_task_cpu_percent gauge\n");
+        for (uint8_t i = 0; i < taskCount; i++) {
+            writer.printf("webcam_task_cpu_percent{task=\"%s\",core=\"%d\"} %u\n",
+                          tasks[i].name, tasks[i].core, tasks[i].cpuPercent);
+        }
+        writer.printf("# HELP webcam_task_stack_free_bytes Lowest free stack per task since it started\n"
+                      "# TYPE webcam_task_stack_free_bytes gauge\n");
+        for (uint8_t i = 0; i < taskCount; i++) {
+            writer.printf("webcam_task_stack_free_bytes{task=\"%s\"} %u\n",
+                          tasks[i].name, tasks[i].stackFreeBytes);
+        }
+    }
+    writer.printf("# HELP webcam_task_samples_skipped_total Task samples skipped with more tasks than fit\n"
+                  "# TYPE webcam_task_samples_skipped_total counter\n"
+                  "webcam_task_samples_skipped_total %u\n",
+                  TaskMonitor::getSkippedSamples());
+
+    writer.printf("# HELP webcam_wifi_reconnects_total Times Wi-Fi has been re-established\n"
+                  "# TYPE webcam_wifi_reconnects_total counter\n"
+                  "webcam_wifi_reconnects_total %u\n"
+                  "# HELP webcam_mqtt_reconnects_total Times MQTT has been re-established\n"
+                  "# TYPE webcam_mqtt_reconnects_total counter\n"
+                  "webcam_mqtt_reconnects_total %u\n"
+                  "# HELP webcam_scheduler_jobs_dropped_total Network task jobs dropped on a full queue\n"
+                  "# TYPE webcam_scheduler_jobs_dropped_total counter\n"
+                  "webcam_scheduler_jobs_dropped_total %u\n",
+                  ConnectivityManager::getWiFiReconnects(), ConnectivityManager::getMqttReconnects(),
+                  TaskScheduler::getDroppedJobs());
+
+    return writer.finish();
+}
+
+int StreamMetrics::formatSummary(char *buffer, size_t size) {
+    uint32_t sent = 0;
+    uint32_t dropped = 0;
+    for (uint8_t i = 0; i < FrameBroker::MAX_SUBSCRIBERS; i++) {
+        sent += framesSent[i].load(std::memory_order_relaxed);
+        dropped += framesDropped[i].load(std::memory_order_relaxed);
+    }
+
+    int length = snprintf(buffer, size,
+        "\"frames_captured\":%u,\"frames_sent\":%u,\"frames_dropped\":%u,\"stream_clients\":%u,"
+        "\"fb_get_avg_ms\":%u,\"send_avg_ms\":%u,\"min_free_heap\":%u",
+        getFramesCaptured(), sent, dropped, getActiveClients(),
+        fbGetLatency.getAverageMs(), sendLatency.getAverageMs(), ESP.getMinFreeHeap());
+    if (psramFound() && length >= 0 && (size_t)length < size) {
+        length += snprintf(buffer + length, size - length, ",\"min_free_psram\":%u", ESP.getMinFreePsram());
+    }
+    return length;
+}
+
+uint32_t StreamMetrics::getFramesCaptured() {
+    return framesCaptured.load(std::memory_order_relaxed);
+}
+
+uint64_t StreamMetrics::getBytesSent() {
+    portENTER_CRITICAL(&bytesMux);
+    uint64_t bytes = bytesSent;
+    portEXIT_CRITICAL(&bytesMux);
+    return bytes;
+}
+
+uint32_t StreamMetrics::getActiveClients() {
+    return activeClients.load(std::memory_order_relaxed);
+}
+
+uint32_t StreamMetrics::getAverageWakeMs() {
+    return wakeLatency.getAverageMs();
+}
@@ -0,0 +1,356 @@
+#include "StreamSessionManager.h"
+#include "TaskConfig.h"
+#include <lwip/sockets.h>
+
+StreamSession StreamSessionManager::sessions[StreamSessionManager::MAX_SESSIONS];
+portMUX_TYPE StreamSessionManager::sessionMux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t StreamSessionManager::streamSlots = STREAM_SLOTS;
+uint8_t StreamSessionManager::highPrioritySlots = STREAM_HIGH_PRIORITY_SLOTS;
+uint8_t StreamSessionManager::claimedSlots[3] = {0, 0, 0};
+uint32_t StreamSessionManager::rejectedCounts[3] = {0, 0, 0};
+uint32_t StreamSessionManager::timedOutCount = 0;
+uint32_t StreamSessionManager::reclaimedCount = 0;
+
+bool StreamSessionManager::admit(StreamPriority priority) {
+    uint32_t now = millis();
+    uint8_t limit = priority == StreamPriority::PRIMARY ? streamSlots : streamSlots - highPrioritySlots;
+    uint8_t streaming = 0;
+    StreamSession *stalled = nullptr;
+    uint32_t stalledMs = 0;
+
+    portENTER_CRITICAL(&sessionMux);
+    for (uint8_t i = 0; i < 3; i++) {
+        streaming += claimedSlots[i];
+    }
+    for (uint8_t i = 0; i < MAX_SESSIONS; i++) {
+        StreamSession &session = sessions[i];
+        if (!session.active || !session.stream || session.reclaimed) {
+            continue;
+        }
+        streaming++;
+        uint32_t since = session.sendingSinceMs;
+        if (since != 0 && !session.socketClosed && now - since >= stalledMs) {
+            stalled = &session;
+            stalledMs = now - since;
+        }
+    }
+
+    bool admitted = streaming < limit;
+    int fd = -1;
+    if (!admitted && stalled != nullptr && stalledMs >= STALL_RECLAIM_MS) {
+        stalled->reclaimed = true;
+        fd = stalled->fd;
+        reclaimedCount++;
+        admitted = true;
+    } else if (!admitted) {
+        rejectedCounts[(uint8_t)priority]++;
+    }
+    portEXIT_CRITICAL(&sessionMux);
+
+    if (fd >= 0) {
+        // The blocked write fails at once and the sender finishes as usual.
+        // Sockets are only closed on the server task, which is running this,
+        // so the descriptor cannot have been reused in the meantime.
+        Serial.printf("Reclaiming stream slot from a client stalled for %u ms\n", (unsigned)stalledMs);
+        shutdown(fd, SHUT_RDWR);
+
+        // Let it release its frame broker subscription before the new viewer subscribes
+        uint32_t start = millis();
+        while (millis() - start < RECLAIM_WAIT_MS) {
+            portENTER_CRITICAL(&sessionMux);
+            bool finished = !stalled->active;
+            portEXIT_CRITICAL(&sessionMux);
+            if (finished) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    return admitted;
+}
+
+bool StreamSessionManager::claimSlot(StreamPriority priority) {
+    uint8_t limit = priority == StreamPriority::PRIMARY ? streamSlots : streamSlots - highPrioritySlots;
+    uint8_t streaming = 0;
+
+    portENTER_CRITICAL(&sessionMux);
+    for (uint8_t i = 0; i < 3; i++) {
+        streaming += claimedSlots[i];
+    }
+    for (uint8_t i = 0; i < MAX_SESSIONS; i++) {
+        if (sessions[i].active && sessions[i].stream && !sessions[i].reclaimed) {
+            streaming++;
+        }
+    }
+    bool admitted = streaming < limit;
+    if (admitted) {
+        claimedSlots[(uint8_t)priority]++;
+    } else {
+        rejectedCounts[(uint8_t)priority]++;
+    }
+    portEXIT_CRITICAL(&sessionMux);
+
+    return admitted;
+}
+
+void StreamSessionManager::releaseSlot(StreamPriority priority) {
+    portENTER_CRITICAL(&sessionMux);
+    if (claimedSlots[(uint8_t)priority] > 0) {
+        claimedSlots[(uint8_t)priority]--;
+    }
+    portEXIT_CRITICAL(&sessionMux);
+}
+
+StreamSession *StreamSessionManager::open(httpd_req_t *req, int subscriber, bool stream) {
+    StreamSession *session = nullptr;
+    int fd = httpd_req_to_sockfd(req);
+
+    portENTER_CRITICAL(&sessionMux);
+    for (uint8_t i = 0; i < MAX_SESSIONS; i++) {
+        if (!sessions[i].active) {
+            session = &sessions[i];
+            session->active = true;
+            session->socketClosed = false;
+            session->server = req->handle;
+            session->fd = fd;
+            session->subscriber = subscriber;
+            session->afterSequence = 0;
+            session->timeoutMs = 0;
+            session->longPoll = false;
+            session->etagMatched = false;
+            session->maxFps = 0;
+            session->priority = StreamPriority::STANDARD;
+            session->scale = 1;
+            session->ackWindow = 0;
+            session->ackedSequence = 0;
+            session->acked = false;
+            session->task = nullptr;
+            session->stream = stream;
+            session->sendingSinceMs = 0;
+            session->timedOut = false;
+            session->reclaimed = false;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&sessionMux);
+
+    return session;
+}
+
+bool StreamSessionManager::start(StreamSession *session, TaskFunction_t sender, const char *name, uint32_t stackSize) {
+    BaseType_t created = xTaskCreatePinnedToCore(
+        sender, name, stackSize, session,
+        STREAM_TASK_PRIORITY, &session->task, STREAM_TASK_CORE);
+    if (created == pdPASS) {
+        return true;
+    }
+
+    Serial.println("Failed to start sender task");
+    portENTER_CRITICAL(&sessionMux);
+    session->active = false;
+    portEXIT_CRITICAL(&sessionMux);
+    return false;
+}
+
+void StreamSessionManager::finish(StreamSession *session, bool keepAlive) {
+    portENTER_CRITICAL(&sessionMux);
+    bool closed = session->socketClosed;
+    int fd = session->fd;
+    httpd_handle_t server = session->server;
+    if (session->timedOut && !session->reclaimed) {
+        timedOutCount++;
+    }
+    session->active = false;
+    portEXIT_CRITICAL(&sessionMux);
+
+    if (closed) {
+        // The server dropped the session while we were sending and left the socket to us
+        close(fd);
+    } else if (!keepAlive) {
+        httpd_sess_trigger_close(server, fd);
+    }
+}
+
+bool StreamSessionManager::sendAll(StreamSession *session, const void *data, size_t length) {
+    const uint8_t *cursor = (const uint8_t *)data;
+
+    while (length > 0) {
+        if (isClosed(session)) {
+            return false;
+        }
+
+        session->sendingSinceMs = millis() | 1;
+        int sent = send(session->fd, cursor, length, 0);
+        session->sendingSinceMs = 0;
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            recordSendError(session);
+            return false;
+        }
+
+        cursor += sent;
+        length -= sent;
+    }
+
+    return true;
+}
+
+bool StreamSessionManager::sendVector(StreamSession *session, struct iovec *vector, int count, uint32_t *writes) {
+    while (count > 0) {
+        if (isClosed(session)) {
+            return false;
+        }
+
+        session->sendingSinceMs = millis() | 1;
+        int sent = writev(session->fd, vector, count);
+        session->sendingSinceMs = 0;
+        (*writes)++;
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            recordSendError(session);
+            return false;
+        }
+
+        // Skip whatever was fully written and trim a partly written buffer
+        while (count > 0 && (size_t)sent >= vector->iov_len) {
+            sent -= vector->iov_len;
+            vector++;
+            count--;
+        }
+        if (count > 0) {
+            vector->iov_base = (uint8_t *)vector->iov_base + sent;
+            vector->iov_len -= sent;
+        }
+    }
+
+    return true;
+}
+
+bool StreamSessionManager::acknowledge(httpd_handle_t server, int fd, uint32_t sequence) {
+    TaskHandle_t task = nullptr;
+
+    portENTER_CRITICAL(&sessionMux);
+    for (uint8_t i = 0; i < MAX_SESSIONS; i++) {
+        StreamSession &session = sessions[i];
+        if (session.active && session.server == server && session.fd == fd) {
+            // Acknowledgements are cumulative; a late one for an older frame changes nothing
+            if (!session.acked || (int32_t)(sequence - session.ackedSequence) > 0) {
+                session.ackedSequence = sequence;
+                session.acked = true;
+            }
+            task = session.task;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&sessionMux);
+
+    if (task == nullptr) {
+        return false;
+    }
+    xTaskNotifyGive(task);
+    return true;
+}
+
+bool StreamSessionManager::getAcknowledged(StreamSession *session, uint32_t *sequence) {
+    portENTER_CRITICAL(&sessionMux);
+    bool acked = session->acked;
+    *sequence = session->ackedSequence;
+    portEXIT_CRITICAL(&sessionMux);
+    return acked;
+}
+
+bool StreamSessionManager::isClosed(StreamSession *session) {
+    portENTER_CRITICAL(&sessionMux);
+    bool closed = session->socketClosed;
+    portEXIT_CRITICAL(&sessionMux);
+    return closed;
+}
+
+void StreamSessionManager::onSocketClose(httpd_handle_t server, int fd) {
+    bool owned = false;
+
+    portENTER_CRITICAL(&sessionMux);
+    for (uint8_t i = 0; i < MAX_SESSIONS; i++) {
+        if (sessions[i].active && sessions[i].server == server && sessions[i].fd == fd) {
+            sessions[i].socketClosed = true;
+            owned = true;
+        }
+    }
+    portEXIT_CRITICAL(&sessionMux);
+
+    if (!owned) {
+        close(fd);
+    }
+}
+
+uint8_t StreamSessionManager::getActiveCount() {
+    uint8_t count = 0;
+
+    portENTER_CRITICAL(&sessionMux);
+    for (uint8_t i = 0; i < MAX_SESSIONS; i++) {
+        if (sessions[i].active) {
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&sessionMux);
+
+    return count;
+}
+
+bool StreamSessionManager::setStreamSlots(uint8_t slots, uint8_t highSlots) {
+    if (slots == 0 || slots > MAX_SESSIONS || highSlots >= slots) {
+        return false;
+    }
+    portENTER_CRITICAL(&sessionMux);
+    streamSlots = slots;
+    highPrioritySlots = highSlots;
+    portEXIT_CRITICAL(&sessionMux);
+    return true;
+}
+
+uint8_t StreamSessionManager::getStreamSlots() {
+    return streamSlots;
+}
+
+uint8_t StreamSessionManager::getHighPrioritySlots() {
+    return highPrioritySlots;
+}
+
+uint8_t StreamSessionManager::getActiveStreamCount(StreamPriority priority) {
+    uint8_t count = 0;
+
+    portENTER_CRITICAL(&sessionMux);
+    count += claimedSlots[(uint8_t)priority];
+    for (uint8_t i = 0; i < MAX_SESSIONS; i++) {
+        if (sessions[i].active && sessions[i].stream && !sessions[i].reclaimed && sessions[i].priority == priority) {
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&sessionMux);
+
+    return count;
+}
+
+uint32_t StreamSessionManager::getRejectedCount(StreamPriority priority) {
+    return rejectedCounts[(uint8_t)priority];
+}
+
+uint32_t StreamSessionManager::getTimedOutCount() {
+    return timedOutCount;
+}
+
+uint32_t StreamSessionManager::getReclaimedCount() {
+    return reclaimedCount;
+}
+
+void StreamSessionManager::recordSendError(StreamSession *session) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        portENTER_CRITICAL(&sessionMux);
+        session->timedOut = true;
+        portEXIT_CRITICAL(&sessionMux);
+    }
+}
@@ -0,0 +1,91 @@
+#include "TaskMonitor.h"
+
+TaskUsage TaskMonitor::usage[TaskMonitor::MAX_TASKS];
+uint8_t TaskMonitor::usageCount = 0;
+UBaseType_t TaskMonitor::taskNumbers[TaskMonitor::MAX_TASKS];
+uint32_t TaskMonitor::runTimes[TaskMonitor::MAX_TASKS];
+bool TaskMonitor::lowStackReported[TaskMonitor::MAX_TASKS];
+uint8_t TaskMonitor::trackedCount = 0;
+uint32_t TaskMonitor::lastTotalRunTime = 0;
+std::atomic<uint32_t> TaskMonitor::skippedSamples(0);
+portMUX_TYPE TaskMonitor::usageMux = portMUX_INITIALIZER_UNLOCKED;
+
+void TaskMonitor::sample() {
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t statuses[MAX_TASKS];
+    static TaskUsage sampled[MAX_TASKS];
+    static UBaseType_t sampledNumbers[MAX_TASKS];
+    static uint32_t sampledRunTimes[MAX_TASKS];
+    static bool sampledReported[MAX_TASKS];
+
+    uint32_t totalRunTime = 0;
+    UBaseType_t count = uxTaskGetSystemState(statuses, MAX_TASKS, &totalRunTime);
+    if (count == 0) {
+        // More tasks than MAX_TASKS; log the first time only
+        if (skippedSamples++ == 0) {
+            Serial.printf("Task monitor has room for %u of %u tasks, skipping samples\n",
+                          (unsigned)MAX_TASKS, (unsigned)uxTaskGetNumberOfTasks());
+        }
+        return;
+    }
+    uint32_t elapsed = totalRunTime - lastTotalRunTime;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t &status = statuses[i];
+        TaskUsage &entry = sampled[i];
+        snprintf(entry.name, sizeof(entry.name), "%s", status.pcTaskName);
+#if configTASKLIST_INCLUDE_COREID
+        entry.core = status.xCoreID == tskNO_AFFINITY ? -1 : (int8_t)status.xCoreID;
+#else
+        entry.core = -1;
+#endif
+        entry.priority = (uint8_t)status.uxCurrentPriority;
+        entry.stackFreeBytes = status.usStackHighWaterMark;
+
+        // CPU time since the previous sample, if the task existed then
+        entry.cpuPercent = 0;
+        sampledReported[i] = false;
+        for (uint8_t j = 0; j < trackedCount; j++) {
+            if (taskNumbers[j] == status.xTaskNumber) {
+                uint32_t used = status.ulRunTimeCounter - runTimes[j];
+                if (elapsed > 0 && lastTotalRunTime != 0) {
+                    uint64_t percent = (uint64_t)used * 100 / elapsed;
+                    entry.cpuPercent = percent > 100 ? 100 : (uint8_t)percent;
+                }
+                sampledReported[i] = lowStackReported[j];
+                break;
+            }
+        }
+        sampledNumbers[i] = status.xTaskNumber;
+        sampledRunTimes[i] = status.ulRunTimeCounter;
+
+        if (entry.stackFreeBytes < LOW_STACK_BYTES && !sampledReported[i]) {
+            Serial.printf("Task %s is low on stack: %u bytes free\n", entry.name, entry.stackFreeBytes);
+            sampledReported[i] = true;
+        }
+    }
+
+    memcpy(taskNumbers, sampledNumbers, count * sizeof(UBaseType_t));
+    memcpy(runTimes, sampledRunTimes, count * sizeof(uint32_t));
+    memcpy(lowStackReported, sampledReported, count * sizeof(bool));
+    trackedCount = count;
+    lastTotalRunTime = totalRunTime;
+
+    portENTER_CRITICAL(&usageMux);
+    memcpy(usage, sampled, count * sizeof(TaskUsage));
+    usageCount = count;
+    portEXIT_CRITICAL(&usageMux);
+#endif
+}
+
+uint8_t TaskMonitor::getUsage(TaskUsage *copy, uint8_t maxCount) {
+    portENTER_CRITICAL(&usageMux);
+    uint8_t count = usageCount < maxCount ? usageCount : maxCount;
+    memcpy(copy, usage, count * sizeof(TaskUsage));
+    portEXIT_CRITICAL(&usageMux);
+    return count;
+}
+
+uint32_t TaskMonitor::getSkippedSamples() {
+    return skippedSamples.load();
+}
@@ -0,0 +1,118 @@
+#include "TaskScheduler.h"
+#include "TaskConfig.h"
+
+EventGroupHandle_t TaskScheduler::events = nullptr;
+QueueHandle_t TaskScheduler::jobs = nullptr;
+TaskScheduler::PeriodicJob TaskScheduler::periodicJobs[TaskScheduler::MAX_PERIODIC_JOBS];
+uint8_t TaskScheduler::periodicJobCount = 0;
+std::atomic<uint32_t> TaskScheduler::droppedJobs(0);
+TaskHandle_t TaskScheduler::task = nullptr;
+
+bool TaskScheduler::init() {
+    if (events == nullptr) {
+        events = xEventGroupCreate();
+    }
+    if (jobs == nullptr) {
+        jobs = xQueueCreate(QUEUE_LENGTH, sizeof(Job));
+    }
+    if (events == nullptr || jobs == nullptr) {
+        Serial.println("Failed to create scheduler queue");
+        return false;
+    }
+    return true;
+}
+
+bool TaskScheduler::begin() {
+    if (task != nullptr) {
+        return true;
+    }
+    if (!init()) {
+        return false;
+    }
+
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < periodicJobCount; i++) {
+        periodicJobs[i].lastRunMs = now;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        run, "network", TASK_STACK, nullptr,
+        NETWORK_TASK_PRIORITY, &task, NETWORK_TASK_CORE);
+    if (created != pdPASS) {
+        Serial.println("Failed to start network task");
+        task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool TaskScheduler::post(Job job) {
+    if (jobs == nullptr || xQueueSend(jobs, &job, 0) != pdTRUE) {
+        droppedJobs++;
+        return false;
+    }
+    xEventGroupSetBits(events, JOB_POSTED);
+    return true;
+}
+
+bool TaskScheduler::addPeriodic(Job job, uint32_t intervalMs) {
+    if (task != nullptr || periodicJobCount >= MAX_PERIODIC_JOBS) {
+        return false;
+    }
+    periodicJobs[periodicJobCount].job = job;
+    periodicJobs[periodicJobCount].intervalMs = intervalMs;
+    periodicJobs[periodicJobCount].lastRunMs = millis();
+    periodicJobCount++;
+    return true;
+}
+
+void TaskScheduler::setEvents(EventBits_t bits) {
+    if (events != nullptr) {
+        xEventGroupSetBits(events, bits);
+    }
+}
+
+void TaskScheduler::clearEvents(EventBits_t bits) {
+    if (events != nullptr) {
+        xEventGroupClearBits(events, bits);
+    }
+}
+
+EventBits_t TaskScheduler::getEvents() {
+    return events != nullptr ? xEventGroupGetBits(events) & ~JOB_POSTED : 0;
+}
+
+uint32_t TaskScheduler::getDroppedJobs() {
+    return droppedJobs.load();
+}
+
+void TaskScheduler::run(void *parameter) {
+    while (true) {
+        xEventGroupWaitBits(events, JOB_POSTED, pdTRUE, pdFALSE, ticksUntilNextJob(millis()));
+
+        Job job;
+        while (xQueueReceive(jobs, &job, 0) == pdTRUE) {
+            job();
+        }
+
+        for (uint8_t i = 0; i < periodicJobCount; i++) {
+            uint32_t now = millis();
+            if (now - periodicJobs[i].lastRunMs >= periodicJobs[i].intervalMs) {
+                periodicJobs[i].lastRunMs = now;
+                periodicJobs[i].job();
+            }
+        }
+    }
+}
+
+TickType_t TaskScheduler::ticksUntilNextJob(uint32_t nowMs) {
+    uint32_t wait = UINT32_MAX;
+    for (uint8_t i = 0; i < periodicJobCount; i++) {
+        uint32_t elapsed = nowMs - periodicJobs[i].lastRunMs;
+        uint32_t remaining = elapsed >= periodicJobs[i].intervalMs ? 0 : periodicJobs[i].intervalMs - elapsed;
+        if (remaining < wait) {
+            wait = remaining;
+        }
+    }
+    return wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait);
+}
@@ -0,0 +1,374 @@
+#include "TimeLapse.h"
+#include "AdaptiveStreamController.h"
+#include "CameraControl.h"
+#include "FrameBroker.h"
+#include "TaskConfig.h"
+#include "WebCamConfiguration.h"
+#include <esp_timer.h>
+
+TimeLapseSettings TimeLapse::settings = { 0, TimeLapse::DEFAULT_FRAME_SIZE, TimeLapse::DEFAULT_QUALITY };
+JpegArena TimeLapse::arena(TimeLapse::MAX_RECORDS, TimeLapse::canEvict);
+uint8_t TimeLapse::exportCount = 0;
+uint32_t TimeLapse::stillsTaken = 0;
+uint32_t TimeLapse::stillsFailed = 0;
+uint32_t TimeLapse::stillsSkipped = 0;
+uint32_t TimeLapse::lastStillMs = 0;
+uint32_t TimeLapse::lastSwitchMs = 0;
+
+SemaphoreHandle_t TimeLapse::lock = nullptr;
+TaskHandle_t TimeLapse::task = nullptr;
+
+void TimeLapse::loadSettings() {
+    TimeLapseSettings saved;
+    if (!WebCamConfiguration::loadTimeLapseSettings(saved)) {
+        return;
+    }
+
+    // Ignore anything a corrupted blob holds that is out of range
+    if (saved.frameSize > AdaptiveStreamController::MAX_FRAME_SIZE || saved.quality < 4 || saved.quality > 63 ||
+        (saved.intervalSeconds != 0 &&
+         (saved.intervalSeconds < MIN_INTERVAL_SECONDS || saved.intervalSeconds > MAX_INTERVAL_SECONDS))) {
+        return;
+    }
+    settings = saved;
+    if (settings.intervalSeconds != 0) {
+        Serial.printf("Time-lapse: every %u s at %s q%u\n", settings.intervalSeconds,
+                      AdaptiveStreamController::getFrameSizeName((framesize_t)settings.frameSize), settings.quality);
+    }
+}
+
+framesize_t TimeLapse::getCameraFrameSize(framesize_t streamFrameSize) {
+    if (settings.intervalSeconds == 0 || !psramFound() || settings.frameSize <= streamFrameSize) {
+        return streamFrameSize;
+    }
+    return (framesize_t)settings.frameSize;
+}
+
+bool TimeLapse::begin() {
+    if (task != nullptr) {
+        return true;
+    }
+
+    if (!psramFound()) {
+        Serial.println("No PSRAM - time-lapse disabled");
+        return false;
+    }
+
+    lock = xSemaphoreCreateMutex();
+    if (lock == nullptr) {
+        Serial.println("Failed to create time-lapse lock");
+        return false;
+    }
+
+    // Claim the arena now if a schedule is running, ahead of the frame history
+    if (settings.intervalSeconds != 0 && !allocateArena()) {
+        settings.intervalSeconds = 0;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        shootLoop, "timelapse", TASK_STACK, nullptr,
+        TIMELAPSE_TASK_PRIORITY, &task, TIMELAPSE_TASK_CORE);
+    if (created != pdPASS) {
+        Serial.println("Failed to start time-lapse task");
+        task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool TimeLapse::allocateArena() {
+    if (arena.isAllocated()) {
+        return true;
+    }
+
+    size_t size = JpegArena::getAvailableSize(ARENA_MAX_BYTES, ARENA_MIN_BYTES, PSRAM_RESERVE_BYTES);
+    if (size == 0) {
+        Serial.println("Not enough PSRAM for a time-lapse");
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool allocated = arena.allocate(size);
+    xSemaphoreGive(lock);
+    if (!allocated) {
+        Serial.println("Failed to allocate time-lapse timeline");
+        return false;
+    }
+
+    Serial.printf("Time-lapse timeline: %u KB of PSRAM\n", (unsigned)(size / 1024));
+    return true;
+}
+
+bool TimeLapse::start(uint32_t intervalSeconds, framesize_t frameSize, int quality) {
+    if (task == nullptr || !allocateArena()) {
+        return false;
+    }
+
+    TimeLapseSettings newSettings;
+    newSettings.intervalSeconds = intervalSeconds < MIN_INTERVAL_SECONDS ? MIN_INTERVAL_SECONDS
+                                : intervalSeconds > MAX_INTERVAL_SECONDS ? MAX_INTERVAL_SECONDS
+                                : intervalSeconds;
+    newSettings.frameSize = (uint8_t)frameSize;
+    newSettings.quality = (uint8_t)(quality < 4 ? 4 : quality > 63 ? 63 : quality);
+    return applySettings(newSettings);
+}
+
+bool TimeLapse::stop() {
+    if (task == nullptr) {
+        return false;
+    }
+    TimeLapseSettings newSettings = getSettings();
+    newSettings.intervalSeconds = 0;
+    return applySettings(newSettings);
+}
+
+bool TimeLapse::applySettings(const TimeLapseSettings &newSettings) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    settings = newSettings;
+    xSemaphoreGive(lock);
+
+    // The task takes a notification as a new schedule and shoots straight away
+    xTaskNotifyGive(task);
+
+    if (!WebCamConfiguration::saveTimeLapseSettings(newSettings)) {
+        Serial.println("Failed to save time-lapse settings");
+        return false;
+    }
+    if (newSettings.intervalSeconds != 0) {
+        Serial.printf("Time-lapse started: every %u s at %s q%u\n", newSettings.intervalSeconds,
+                      AdaptiveStreamController::getFrameSizeName(getCaptureFrameSize()), newSettings.quality);
+    } else {
+        Serial.println("Time-lapse stopped");
+    }
+    return true;
+}
+
+bool TimeLapse::clear() {
+    if (task == nullptr) {
+        return true;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool cleared = exportCount == 0;
+    if (cleared) {
+        arena.clear();
+    }
+    xSemaphoreGive(lock);
+    return cleared;
+}
+
+TimeLapseSettings TimeLapse::getSettings() {
+    if (lock == nullptr) {
+        return settings;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    TimeLapseSettings current = settings;
+    xSemaphoreGive(lock);
+    return current;
+}
+
+framesize_t TimeLapse::getCaptureFrameSize() {
+    framesize_t frameSize = (framesize_t)getSettings().frameSize;
+    framesize_t maxFrameSize = CameraControl::getMaxFrameSize();
+    return frameSize > maxFrameSize ? maxFrameSize : frameSize;
+}
+
+void TimeLapse::handleCommand(JsonDocument &command) {
+    if (command["stop"] | false) {
+        stop();
+        return;
+    }
+    if (command["clear"] | false) {
+        if (!clear()) {
+            Serial.println("Time-lapse command ignored: the timeline is being downloaded");
+        }
+        return;
+    }
+
+    TimeLapseSettings current = getSettings();
+    uint32_t interval = command["interval"] | (current.intervalSeconds != 0 ? current.intervalSeconds
+                                                                             : (uint32_t)DEFAULT_INTERVAL_SECONDS);
+    int quality = command["quality"] | (int)current.quality;
+    framesize_t frameSize = (framesize_t)current.frameSize;
+    const char *name = command["framesize"];
+    if (name != nullptr) {
+        frameSize = AdaptiveStreamController::parseFrameSize(name);
+        if (frameSize == FRAMESIZE_INVALID) {
+            Serial.println("Time-lapse command rejected: invalid framesize");
+            return;
+        }
+    }
+    if (!start(interval, frameSize, quality)) {
+        Serial.println("Time-lapse command failed: no PSRAM for the timeline");
+    }
+}
+
+bool TimeLapse::canEvict(uint32_t serial) {
+    // Stills being downloaded must stay put
+    return exportCount == 0;
+}
+
+bool TimeLapse::store(const uint8_t *jpeg, size_t length, uint16_t width, uint16_t height,
+                      uint32_t sequence, int64_t captureTimeUs) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint8_t *space = arena.reserve(length);
+    if (space != nullptr) {
+        // Only this task reserves, but a clear() could run while copying,
+        // so copy under the lock
+        memcpy(space, jpeg, length);
+        arena.commit(length, width, height, sequence, captureTimeUs);
+    }
+    xSemaphoreGive(lock);
+    return space != nullptr;
+}
+
+void TimeLapse::shoot() {
+    TimeLapseSettings current = getSettings();
+    framesize_t frameSize = getCaptureFrameSize();
+
+    uint32_t startMs = millis();
+    SharedFrame *frame = FrameBroker::captureStill(frameSize, current.quality, pdMS_TO_TICKS(STILL_TIMEOUT_MS));
+    if (frame == nullptr) {
+        stillsFailed++;
+        Serial.println("Time-lapse still not captured");
+        return;
+    }
+    lastSwitchMs = millis() - startMs;
+
+    bool stored = store(frame->fb->buf, frame->fb->len, frame->fb->width, frame->fb->height,
+                        frame->sequence, frame->captureTimeUs);
+    size_t length = frame->fb->len;
+    FrameBroker::release(frame);
+
+    lastStillMs = millis();
+    if (stored) {
+        stillsTaken++;
+    } else {
+        stillsSkipped++;
+        Serial.printf("Time-lapse still skipped (%u bytes): timeline busy or too small\n", (unsigned)length);
+    }
+}
+
+void TimeLapse::shootLoop(void *parameter) {
+    uint32_t nextShotMs = millis();
+    TickType_t wait = pdMS_TO_TICKS(0);
+
+    while (true) {
+        if (ulTaskNotifyTake(pdTRUE, wait) > 0) {
+            // New schedule: first still now
+            nextShotMs = millis();
+        }
+
+        uint32_t intervalMs = getSettings().intervalSeconds * 1000;
+        if (intervalMs == 0) {
+            wait = portMAX_DELAY;
+            continue;
+        }
+
+        int32_t remainingMs = (int32_t)(nextShotMs - millis());
+        if (remainingMs > 0) {
+            wait = pdMS_TO_TICKS(remainingMs);
+            continue;
+        }
+
+        shoot();
+
+        // Keep to the schedule, but skip stills missed while busy rather than catching up
+        nextShotMs += intervalMs;
+        if ((int32_t)(nextShotMs - millis()) <= 0) {
+            nextShotMs = millis() + intervalMs;
+        }
+        wait = pdMS_TO_TICKS(nextShotMs - millis());
+    }
+}
+
+bool TimeLapse::beginExport(AviClipInfo &info, uint32_t fps) {
+    if (task == nullptr || !arena.isAllocated()) {
+        return false;
+    }
+    if (fps == 0 || fps > MAX_PLAYBACK_FPS) {
+        fps = DEFAULT_PLAYBACK_FPS;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (arena.getOldest() == arena.getNext()) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.frameCount = arena.getNext() - arena.getOldest();
+    for (uint32_t serial = arena.getOldest(); serial != arena.getNext(); serial++) {
+        const JpegRecord &record = arena.at(serial);
+        info.width = record.width > info.width ? record.width : info.width;
+        info.height = record.height > info.height ? record.height : info.height;
+        info.maxFrameBytes = record.length > info.maxFrameBytes ? record.length : info.maxFrameBytes;
+        info.chunkBytes += AviWriter::getChunkSize(record.length);
+    }
+    info.usPerFrame = 1000000 / fps;
+
+    exportCount++;
+    xSemaphoreGive(lock);
+    return true;
+}
+
+bool TimeLapse::getFrame(uint32_t index, const uint8_t **data, size_t *length) {
+    // Nothing is evicted while exporting, so the oldest still is still the first one exported
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool found = exportCount > 0 && index < arena.getNext() - arena.getOldest();
+    if (found) {
+        const JpegRecord &record = arena.at(arena.getOldest() + index);
+        *data = arena.getData(record);
+        *length = record.length;
+    }
+    xSemaphoreGive(lock);
+    return found;
+}
+
+void TimeLapse::endExport() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (exportCount > 0) {
+        exportCount--;
+    }
+    xSemaphoreGive(lock);
+}
+
+void TimeLapse::addStatus(JsonDocument &doc) {
+    doc["available"] = task != nullptr;
+    if (task == nullptr) {
+        return;
+    }
+
+    TimeLapseSettings current = getSettings();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t stills = arena.getNext() - arena.getOldest();
+    uint32_t bytes = 0;
+    int64_t spanUs = 0;
+    if (stills > 0) {
+        for (uint32_t serial = arena.getOldest(); serial != arena.getNext(); serial++) {
+            bytes += arena.at(serial).length;
+        }
+        spanUs = arena.at(arena.getNext() - 1).captureTimeUs - arena.at(arena.getOldest()).captureTimeUs;
+    }
+    xSemaphoreGive(lock);
+
+    framesize_t captureFrameSize = getCaptureFrameSize();
+    doc["running"] = current.intervalSeconds != 0;
+    doc["interval_s"] = current.intervalSeconds;
+    doc["framesize"] = AdaptiveStreamController::getFrameSizeName((framesize_t)current.frameSize);
+    doc["capture_framesize"] = AdaptiveStreamController::getFrameSizeName(captureFrameSize);
+    doc["quality"] = current.quality;
+    doc["restart_required"] = current.intervalSeconds != 0 && current.frameSize > captureFrameSize;
+    doc["arena_bytes"] = (uint32_t)arena.getSize();
+    doc["stills"] = stills;
+    doc["bytes"] = bytes;
+    doc["span_s"] = (uint32_t)(spanUs / 1000000);
+    doc["taken"] = stillsTaken;
+    doc["failed"] = stillsFailed;
+    doc["skipped"] = stillsSkipped;
+    if (stillsTaken > 0) {
+        doc["last_still_age_s"] = (millis() - lastStillMs) / 1000;
+        doc["last_switch_ms"] = lastSwitchMs;
+        doc["last_stream_gap_ms"] = FrameBroker::getLastStillGapMs();
+    }
+}
@@ -2,6 +2,18 @@
 
 WebCamConfigurationSettings WebCamConfiguration::config;
 Preferences WebCamConfiguration::preferences;
+SemaphoreHandle_t WebCamConfiguration::lock = nullptr;
+
+void WebCamConfiguration::lockPreferences() {
+    if (lock == nullptr) {
+        lock = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+}
+
+void WebCamConfiguration::unlockPreferences() {
+    xSemaphoreGive(lock);
+}
 
 void WebCamConfiguration::displayConfiguration(WebCamConfigurationSettings config, bool showPassword) {
     Serial.println("\n=== Web Camera Configuration ===");
@@ -41,13 +53,16 @@ bool WebCamConfiguration::initNVS() {
 }
 
 bool WebCamConfiguration::loadConfiguration() {
+    lockPreferences();
     if (!initNVS()) {
+        unlockPreferences();
         Serial.println("Failed to initialise NVS");
         return false;
     }
     
     bool success = preferences.begin(PREFERENCE_NAMESPACE, false);
     if (!success) {
+        unlockPreferences();
         Serial.println("Failed to open preferences namespace");
         return false;
     }
@@ -58,13 +73,11 @@ bool WebCamConfiguration::loadConfiguration() {
         config.wifiSSID = preferences.getString(WIFI_SSID_KEY, "");
         config.wifiPassword = preferences.getString(WIFI_PASS_KEY, "");
         config.isConfirmed = true;
-        
-        preferences.end();
-        return true;
     }
     
     preferences.end();
-    return false;
+    unlockPreferences();
+    return confirmed;
 }
 
 void WebCamConfiguration::requestConfiguration() {
@@ -95,13 +108,16 @@ void WebCamConfiguration::requestConfiguration() {
 }
 
 bool WebCamConfiguration::saveConfiguration(WebCamConfigurationSettings newConfig) {
+    lockPreferences();
     if (!initNVS()) {
+        unlockPreferences();
         Serial.println("Failed to initialise NVS");
         return false;
     }
     
     bool success = preferences.begin(PREFERENCE_NAMESPACE, false);
     if (!success) {
+        unlockPreferences();
         Serial.println("Failed to open preferences namespace for writing");
         return false;
     }
@@ -111,11 +127,148 @@ bool WebCamConfiguration::saveConfiguration(WebCamConfigurationSettings newConfi
     preferences.putBool(CONFIRMATION_KEY, true);
     
     preferences.end();
+    unlockPreferences();
     
     config = newConfig;
     return true;
 }
 
+bool WebCamConfiguration::loadCameraSettings(CameraSettings &settings) {
+    lockPreferences();
+    if (!initNVS()) {
+        unlockPreferences();
+        Serial.println("Failed to initialise NVS");
+        return false;
+    }
+    
+    if (!preferences.begin(PREFERENCE_NAMESPACE, true)) {
+        // The namespace does not exist until something has been saved
+        unlockPreferences();
+        return false;
+    }
+    
+    // Controls are only ever appended, so a shorter blob from an older
+    // control table holds the leading values; a longer one is from another table
+    size_t length = preferences.getBytesLength(CAMERA_SETTINGS_KEY);
+    settings = CameraSettings();
+    bool found = length >= offsetof(CameraSettings, values) && length <= sizeof(CameraSettings) &&
+                 preferences.getBytes(CAMERA_SETTINGS_KEY, &settings, length) == length;
+    
+    preferences.end();
+    unlockPreferences();
+    return found;
+}
+
+bool WebCamConfiguration::saveCameraSettings(const CameraSettings &settings) {
+    lockPreferences();
+    if (!initNVS()) {
+        unlockPreferences();
+        Serial.println("Failed to initialise NVS");
+        return false;
+    }
+    
+    bool success = preferences.begin(PREFERENCE_NAMESPACE, false);
+    if (!success) {
+        unlockPreferences();
+        Serial.println("Failed to open preferences namespace for writing");
+        return false;
+    }
+    
+    size_t written = preferences.putBytes(CAMERA_SETTINGS_KEY, &settings, sizeof(CameraSettings));
+    
+    preferences.end();
+    unlockPreferences();
+    return written == sizeof(CameraSettings);
+}
+
+bool WebCamConfiguration::loadTimeLapseSettings(TimeLapseSettings &settings) {
+    lockPreferences();
+    if (!initNVS()) {
+        unlockPreferences();
+        Serial.println("Failed to initialise NVS");
+        return false;
+    }
+    
+    if (!preferences.begin(PREFERENCE_NAMESPACE, true)) {
+        unlockPreferences();
+        return false;
+    }
+    
+    bool found = preferences.getBytesLength(TIMELAPSE_SETTINGS_KEY) == sizeof(TimeLapseSettings) &&
+                 preferences.getBytes(TIMELAPSE_SETTINGS_KEY, &settings, sizeof(TimeLapseSettings)) == sizeof(TimeLapseSettings);
+    
+    preferences.end();
+    unlockPreferences();
+    return found;
+}
+
+bool WebCamConfiguration::saveTimeLapseSettings(const TimeLapseSettings &settings) {
+    lockPreferences();
+    if (!initNVS()) {
+        unlockPreferences();
+        Serial.println("Failed to initialise NVS");
+        return false;
+    }
+    
+    bool success = preferences.begin(PREFERENCE_NAMESPACE, false);
+    if (!success) {
+        unlockPreferences();
+        Serial.println("Failed to open preferences namespace for writing");
+        return false;
+    }
+    
+    size_t written = preferences.putBytes(TIMELAPSE_SETTINGS_KEY, &settings, sizeof(TimeLapseSettings));
+    
+    preferences.end();
+    unlockPreferences();
+    return written == sizeof(TimeLapseSettings);
+}
+
+bool WebCamConfiguration::loadMotionEnabled(bool &enabled) {
+    lockPreferences();
+    if (!initNVS()) {
+        unlockPreferences();
+        Serial.println("Failed to initialise NVS");
+        return false;
+    }
+    
+    if (!preferences.begin(PREFERENCE_NAMESPACE, true)) {
+        unlockPreferences();
+        return false;
+    }
+    
+    bool found = preferences.isKey(MOTION_ENABLED_KEY);
+    if (found) {
+        enabled = preferences.getBool(MOTION_ENABLED_KEY, false);
+    }
+    
+    preferences.end();
+    unlockPreferences();
+    return found;
+}
+
+bool WebCamConfiguration::saveMotionEnabled(bool enabled) {
+    lockPreferences();
+    if (!initNVS()) {
+        unlockPreferences();
+        Serial.println("Failed to initialise NVS");
+        return false;
+    }
+    
+    bool success = preferences.begin(PREFERENCE_NAMESPACE, false);
+    if (!success) {
+        unlockPreferences();
+        Serial.println("Failed to open preferences namespace for writing");
+        return false;
+    }
+    
+    size_t written = preferences.putBool(MOTION_ENABLED_KEY, enabled);
+    
+    preferences.end();
+    unlockPreferences();
+    return written == sizeof(bool);
+}
+
 bool WebCamConfiguration::shouldEnterSetupMode() {
     pinMode(BOOT_BUTTON_PIN, INPUT_PULLUP);
     bool buttonPressed = (digitalRead(BOOT_BUTTON_PIN) == LOW);
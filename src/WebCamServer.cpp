@@ -1,4 +1,23 @@
 #include "WebCamServer.h"
+#include "AdaptiveStreamController.h"
+#include "AviWriter.h"
+#include "BootProfiler.h"
+#include "BandwidthBudget.h"
+#include "CameraControl.h"
+#include "CameraBufferStrategy.h"
+#include "CameraPower.h"
+#include "FrameBroker.h"
+#include "FrameHistory.h"
+#include "JpegThumbnailer.h"
+#include "MjpegFramer.h"
+#include "MotionDetector.h"
+#include "StreamMetrics.h"
+#include "StreamSessionManager.h"
+#include "TaskConfig.h"
+#include "TimeLapse.h"
+#include "WebAssets.h"
+#include "WebSocketFramer.h"
+#include <esp_timer.h>
 
 // Camera pin definitions for AI-Thinker ESP32-CAM
 #define PWDN_GPIO_NUM     32
@@ -31,15 +50,9 @@ void WebCamServer::configureCameraPins() {
 }
 
 bool WebCamServer::initialiseCam() {
-    // Power up sequence for camera
-    Serial.println("Powering up camera module...");
-    pinMode(PWDN_GPIO_NUM, OUTPUT);
-    digitalWrite(PWDN_GPIO_NUM, LOW);  // Power ON
-    delay(100);
-    
-    // Check if camera is already initialized and deinit if needed
+    // esp_camera_init() powers the sensor up through pin_pwdn; deinit
+    // first in case the camera is already initialised
     esp_camera_deinit();
-    delay(100);
     
     camera_config_t config;
     memset(&config, 0, sizeof(camera_config_t));
@@ -65,166 +78,964 @@ bool WebCamServer::initialiseCam() {
     config.xclk_freq_hz = 10000000;  // Reduced from 20MHz for stability
     config.pixel_format = PIXFORMAT_JPEG;
     
-    config.frame_size = FRAMESIZE_QVGA;  // Start with smallest size: 320x240
-    config.jpeg_quality = 15;  // Lower quality for testing
-    config.fb_count = 1;
-    config.fb_location = CAMERA_FB_IN_DRAM;
-    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    // Start straight at the saved streaming operating point, which also
+    // sizes the framebuffers for it
+    CameraControl::loadSettings();
+    TimeLapse::loadSettings();
+    config.frame_size = TimeLapse::getCameraFrameSize(AdaptiveStreamController::getFrameSize());
+    config.jpeg_quality = AdaptiveStreamController::getQuality();
+    
+    CameraBufferStrategy::select();
     
-    Serial.println("Initializing camera with minimal settings...");
-    Serial.println("Frame size: QVGA (320x240)");
-    Serial.println("XCLK: 10MHz");
-    Serial.println("Frame buffers: 1 (DRAM)");
+    Serial.printf("Initializing camera: %s q%d, XCLK 10MHz\n",
+                  AdaptiveStreamController::getFrameSizeName(), AdaptiveStreamController::getQuality());
     
-    // Camera initialisation with error checking
-    esp_err_t err = esp_camera_init(&config);
-    if (err != ESP_OK) {
+    // Camera initialisation with error checking, stepping down the
+    // framebuffer strategy until the driver accepts one
+    esp_err_t err;
+    while (true) {
+        CameraBufferStrategy::apply(config);
+        Serial.printf("Frame buffers: %s\n", CameraBufferStrategy::getName());
+        
+        err = esp_camera_init(&config);
+        if (err == ESP_OK) {
+            break;
+        }
+        
         Serial.printf("Camera init failed with error 0x%x\n", err);
         
         if (err == ESP_ERR_NOT_FOUND) {
             Serial.println("Camera sensor not found");
+            return false;
         } else if (err == ESP_ERR_INVALID_ARG) {
             Serial.println("Invalid camera configuration");
         } else if (err == ESP_ERR_NO_MEM) {
             Serial.println("Out of memory");
         }
         
-        return false;
+        if (!CameraBufferStrategy::fallBack()) {
+            return false;
+        }
+        
+        Serial.println("Retrying with fallback framebuffer strategy...");
+        esp_camera_deinit();
+        delay(100);
     }
     
     Serial.println("Camera hardware initialized successfully");
-    delay(300);
-    
-    // Test frame capture
-    Serial.println("Testing frame capture...");
-    camera_fb_t * fb = esp_camera_fb_get();
-    if (!fb) {
-        Serial.println("Failed to capture test frame");
-        return false;
-    }
-    Serial.printf("Test frame captured: %u bytes\n", fb->len);
-    esp_camera_fb_return(fb);
     
-    // Get sensor
-    sensor_t * s = esp_camera_sensor_get();
-    if (s == nullptr) {
+    if (esp_camera_sensor_get() == nullptr) {
         Serial.println("Failed to get camera sensor");
         return false;
     }
     
-    Serial.println("Sensor acquired, applying basic settings...");
+    // Wait for the first frame out of DMA, so the time to first frame is
+    // the camera's own and is known before the first heartbeat. The
+    // capture task only pulls frames once something subscribes; it records
+    // the first frame instead if this one times out.
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (fb != nullptr) {
+        BootProfiler::recordFrameCaptured();
+        esp_camera_fb_return(fb);
+    } else {
+        Serial.println("No first frame from the camera yet");
+    }
     
-    // Minimal sensor config
-    s->set_framesize(s, FRAMESIZE_VGA);  // Upgrade to VGA now that it's working
-    s->set_quality(s, 12);
+    CameraPower::begin(PWDN_GPIO_NUM);
+    if (!FrameBroker::begin(CameraBufferStrategy::getPipelineFrameCount())) {
+        Serial.println("Failed to start frame capture");
+        return false;
+    }
+    AdaptiveStreamController::begin();
+    CameraControl::begin(config.frame_size);
+    if (!MotionDetector::begin()) {
+        Serial.println("Continuing without motion detection");
+    }
+    if (!JpegThumbnailer::begin()) {
+        Serial.println("Continuing without thumbnail streams");
+    }
+    if (!TimeLapse::begin()) {
+        Serial.println("Continuing without time-lapse");
+    }
+    if (!FrameHistory::begin()) {
+        Serial.println("Continuing without frame history");
+    }
     
     Serial.println("Camera fully initialized and ready");
     return true;
 }
 
 esp_err_t WebCamServer::streamHandler(httpd_req_t *req) {
-    camera_fb_t * fb = nullptr;
-    esp_err_t res = ESP_OK;
-    size_t jpg_buf_len = 0;
-    uint8_t * jpg_buf = nullptr;
-    char part_buf[64];
+    char query[64];
+    char value[12];
+    uint32_t max_fps = 0;
+    uint8_t scale = 1;
+    StreamPriority priority = StreamPriority::STANDARD;
     
-    res = httpd_resp_set_type(req, "multipart/x-mixed-replace; boundary=frame");
-    if (res != ESP_OK) {
-        return res;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK) {
+            max_fps = strtoul(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "priority", value, sizeof(value)) == ESP_OK) {
+            priority = BandwidthBudget::parsePriority(value);
+        }
+        // Thumbnails for dashboard tiles: "1/8" or "1/4" of the full frame
+        if (httpd_query_key_value(query, "scale", value, sizeof(value)) == ESP_OK &&
+            strcmp(value, "1") != 0 && !JpegThumbnailer::parseScale(value, scale)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Scale must be 1/4 or 1/8");
+            return ESP_FAIL;
+        }
     }
     
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    // Turn viewers away before taking anything, so a crowd at the door
+    // costs one short response each
+    if (!StreamSessionManager::admit(priority)) {
+        Serial.println("Stream slots full");
+        return sendUnavailable(req, "All stream slots are in use");
+    }
     
-    while (true) {
-        fb = esp_camera_fb_get();
-        if (!fb) {
+    int subscriber = FrameBroker::subscribe();
+    if (subscriber < 0) {
+        Serial.println("Too many stream clients");
+        return sendUnavailable(req, "Too many stream clients");
+    }
+    
+    StreamSession * session = StreamSessionManager::open(req, subscriber, true);
+    if (!session) {
+        FrameBroker::unsubscribe(subscriber);
+        Serial.println("No free stream session");
+        return sendUnavailable(req, "Too many stream clients");
+    }
+    session->maxFps = max_fps;
+    session->priority = priority;
+    session->scale = scale;
+    
+    // Hand the socket to a sender task so the server task is free again
+    if (!StreamSessionManager::start(session, streamSender, "stream", STREAM_TASK_STACK)) {
+        FrameBroker::unsubscribe(subscriber);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start stream");
+        return ESP_FAIL;
+    }
+    
+    return ESP_OK;
+}
+
+void WebCamServer::streamSender(void *parameter) {
+    StreamSession * session = (StreamSession *)parameter;
+    SharedFrame * frame = nullptr;
+    uint32_t skipped_total = 0;
+    size_t last_frame_len = 0;
+    uint32_t frame_interval_ms = session->maxFps > 0 ? 1000 / session->maxFps : 0;
+    uint32_t last_frame_ms = 0;
+    bool thumbnail = session->scale > 1;
+    uint8_t * thumbnail_buf = nullptr;
+    size_t thumbnail_capacity = 0;
+    
+    bool ok = MjpegFramer::writeResponseHeader(session);
+    StreamMetrics::recordClientConnected();
+    
+    while (ok) {
+        // Per-client frame rate cap; the broker hands over the newest
+        // frame once the wait is over
+        if (frame_interval_ms > 0) {
+            uint32_t since_last = millis() - last_frame_ms;
+            if (since_last < frame_interval_ms) {
+                vTaskDelay(pdMS_TO_TICKS(frame_interval_ms - since_last));
+            }
+        }
+        last_frame_ms = millis();
+        
+        // Charge the budget before taking a frame so a throttled client
+        // never holds a framebuffer while it waits
+        BandwidthBudget::acquire(last_frame_len, session->priority);
+        
+        frame = FrameBroker::waitForFrame(session->subscriber, pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+        if (!frame) {
             Serial.println("Camera capture failed");
-            res = ESP_FAIL;
             break;
         }
+        uint32_t sequence = frame->sequence;
+        int64_t capture_time_us = frame->captureTimeUs;
         
-        if (fb->format != PIXFORMAT_JPEG) {
-            Serial.println("Non-JPEG format not supported");
-            esp_camera_fb_return(fb);
-            res = ESP_FAIL;
-            break;
+        // A thumbnail is cut from the same framebuffer, and the frame is
+        // handed back as soon as it has been copied out
+        const uint8_t * jpeg = frame->fb->buf;
+        size_t jpeg_len = frame->fb->len;
+        if (thumbnail) {
+            bool made = JpegThumbnailer::copyThumbnail(frame, session->scale, thumbnail_buf, thumbnail_capacity,
+                                                       jpeg_len);
+            FrameBroker::release(frame);
+            frame = nullptr;
+            if (!made) {
+                Serial.println("Thumbnail transcode failed");
+                continue;
+            }
+            jpeg = thumbnail_buf;
         }
         
-        jpg_buf_len = fb->len;
-        jpg_buf = fb->buf;
+        last_frame_len = jpeg_len;
+        CameraBufferStrategy::recordSendStart(capture_time_us);
+        int64_t send_start = esp_timer_get_time();
         
-        if (res == ESP_OK) {
-            size_t hlen = snprintf(part_buf, 64,
-                "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
-                jpg_buf_len);
-            res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
+        ok = MjpegFramer::writeFrame(session, sequence, capture_time_us, jpeg, jpeg_len);
+        
+        if (ok) {
+            int64_t send_end = esp_timer_get_time();
+            uint32_t skipped = FrameBroker::getDroppedFrameCount(session->subscriber);
+            StreamMetrics::recordFrameSent(session->subscriber, jpeg_len, (uint32_t)(send_end - send_start));
+            StreamMetrics::recordFramesDropped(session->subscriber, skipped - skipped_total);
+            // Frames skipped because of the client's own rate cap are not
+            // backpressure, and a thumbnail's send time says nothing about
+            // whether full frames fit the link
+            if (!thumbnail) {
+                AdaptiveStreamController::recordFrameSent((uint32_t)(send_end - send_start),
+                                                          (uint32_t)(send_start - capture_time_us),
+                                                          frame_interval_ms > 0 ? 0 : skipped - skipped_total);
+            }
+            skipped_total = skipped;
         }
         
-        if (res == ESP_OK) {
-            res = httpd_resp_send_chunk(req, (const char *)jpg_buf, jpg_buf_len);
+        if (frame) {
+            FrameBroker::release(frame);
         }
+    }
+    
+    free(thumbnail_buf);
+    StreamMetrics::recordClientDisconnected();
+    
+    FrameBroker::unsubscribe(session->subscriber);
+    StreamSessionManager::finish(session, false);
+    vTaskDelete(nullptr);
+}
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+esp_err_t WebCamServer::webSocketHandler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // esp_http_server has already answered the handshake, so from here
+        // on a failure can only close the connection
+        char query[64];
+        char value[12];
+        uint32_t max_fps = 0;
+        uint32_t window = WS_DEFAULT_ACK_WINDOW;
+        StreamPriority priority = StreamPriority::STANDARD;
         
-        if (res == ESP_OK) {
-            res = httpd_resp_send_chunk(req, "\r\n--frame\r\n", 13);
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            if (httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK) {
+                max_fps = strtoul(value, nullptr, 10);
+            }
+            if (httpd_query_key_value(query, "priority", value, sizeof(value)) == ESP_OK) {
+                priority = BandwidthBudget::parsePriority(value);
+            }
+            if (httpd_query_key_value(query, "window", value, sizeof(value)) == ESP_OK) {
+                window = strtoul(value, nullptr, 10);
+            }
+        }
+        if (window < 1 || window > WS_MAX_ACK_WINDOW) {
+            window = WS_DEFAULT_ACK_WINDOW;
         }
         
-        esp_camera_fb_return(fb);
+        // Too late for a 503: close with 1013 (try again later) instead
+        int subscriber = -1;
+        if (StreamSessionManager::admit(priority)) {
+            subscriber = FrameBroker::subscribe();
+        }
+        if (subscriber < 0) {
+            Serial.println("Stream slots full");
+            uint8_t reason[] = {1013 >> 8, 1013 & 0xff};
+            httpd_ws_frame_t close_frame;
+            memset(&close_frame, 0, sizeof(close_frame));
+            close_frame.final = true;
+            close_frame.type = HTTPD_WS_TYPE_CLOSE;
+            close_frame.payload = reason;
+            close_frame.len = sizeof(reason);
+            httpd_ws_send_frame(req, &close_frame);
+            return ESP_FAIL;
+        }
+        StreamSession * session = StreamSessionManager::open(req, subscriber, true);
+        if (!session) {
+            FrameBroker::unsubscribe(subscriber);
+            Serial.println("No free stream session");
+            return ESP_FAIL;
+        }
+        session->maxFps = max_fps;
+        session->priority = priority;
+        session->ackWindow = (uint8_t)window;
+        
+        if (!StreamSessionManager::start(session, webSocketSender, "ws", STREAM_TASK_STACK)) {
+            FrameBroker::unsubscribe(subscriber);
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+    
+    // Any other call is a message from the client: an acknowledgement
+    uint8_t payload[WS_MAX_ACK_LENGTH];
+    httpd_ws_frame_t message;
+    memset(&message, 0, sizeof(message));
+    if (httpd_ws_recv_frame(req, &message, 0) != ESP_OK || message.len > sizeof(payload)) {
+        return ESP_FAIL;
+    }
+    message.payload = payload;
+    if (message.len > 0 && httpd_ws_recv_frame(req, &message, sizeof(payload)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+    uint32_t sequence;
+    if ((message.type == HTTPD_WS_TYPE_TEXT || message.type == HTTPD_WS_TYPE_BINARY) &&
+        WebSocketFramer::parseAck(payload, message.len, message.type == HTTPD_WS_TYPE_TEXT, &sequence)) {
+        StreamSessionManager::acknowledge(req->handle, httpd_req_to_sockfd(req), sequence);
+    }
+    return ESP_OK;
+}
+
+void WebCamServer::webSocketSender(void *parameter) {
+    StreamSession * session = (StreamSession *)parameter;
+    SharedFrame * frame = nullptr;
+    uint32_t skipped_total = 0;
+    size_t last_frame_len = 0;
+    uint32_t frame_interval_ms = session->maxFps > 0 ? 1000 / session->maxFps : 0;
+    uint32_t last_frame_ms = 0;
+    uint32_t frames_sent = 0;
+    uint32_t ack_waits = 0;
+    
+    // Frames sent and not yet acknowledged, oldest first
+    uint32_t in_flight_sequence[WS_MAX_ACK_WINDOW];
+    int64_t in_flight_sent_us[WS_MAX_ACK_WINDOW];
+    uint8_t oldest = 0;
+    uint8_t in_flight = 0;
+    
+    bool ok = true;
+    StreamMetrics::recordClientConnected();
+    
+    while (ok) {
+        // Acknowledgements are cumulative: retire every frame up to the
+        // newest one acknowledged, then wait while the window is full.
+        // Meanwhile the broker keeps only the newest frame for this client.
+        bool waited = false;
+        while (true) {
+            uint32_t acked;
+            if (StreamSessionManager::getAcknowledged(session, &acked)) {
+                int64_t now = esp_timer_get_time();
+                while (in_flight > 0 && (int32_t)(in_flight_sequence[oldest] - acked) <= 0) {
+                    StreamMetrics::recordFrameAcknowledged((uint32_t)(now - in_flight_sent_us[oldest]));
+                    oldest = (oldest + 1) % WS_MAX_ACK_WINDOW;
+                    in_flight--;
+                }
+            }
+            if (in_flight < session->ackWindow) {
+                break;
+            }
+            if (StreamSessionManager::isClosed(session)) {
+                ok = false;
+                break;
+            }
+            if (esp_timer_get_time() - in_flight_sent_us[oldest] > (int64_t)WS_ACK_TIMEOUT_MS * 1000) {
+                Serial.println("WebSocket client stopped acknowledging frames");
+                ok = false;
+                break;
+            }
+            if (!waited) {
+                ack_waits++;
+                waited = true;
+            }
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WS_ACK_POLL_MS));
+        }
+        if (!ok) {
+            break;
+        }
+        
+        if (frame_interval_ms > 0) {
+            uint32_t since_last = millis() - last_frame_ms;
+            if (since_last < frame_interval_ms) {
+                vTaskDelay(pdMS_TO_TICKS(frame_interval_ms - since_last));
+            }
+        }
+        last_frame_ms = millis();
         
-        if (res != ESP_OK) {
+        BandwidthBudget::acquire(last_frame_len, session->priority);
+        
+        frame = FrameBroker::waitForFrame(session->subscriber, pdMS_TO_TICKS(FRAME_WAIT_TIMEOUT_MS));
+        if (!frame) {
+            Serial.println("Camera capture failed");
             break;
         }
+        
+        last_frame_len = frame->fb->len;
+        CameraBufferStrategy::recordSendStart(frame->captureTimeUs);
+        int64_t send_start = esp_timer_get_time();
+        
+        ok = WebSocketFramer::writeFrame(session, frame->sequence, frame->captureTimeUs,
+                                         frame->fb->buf, frame->fb->len);
+        
+        if (ok) {
+            int64_t send_end = esp_timer_get_time();
+            uint8_t slot = (oldest + in_flight) % WS_MAX_ACK_WINDOW;
+            in_flight_sequence[slot] = frame->sequence;
+            in_flight_sent_us[slot] = send_start;
+            in_flight++;
+            frames_sent++;
+            
+            // Frames skipped while waiting for acknowledgements are backpressure too
+            uint32_t skipped = FrameBroker::getDroppedFrameCount(session->subscriber);
+            StreamMetrics::recordFrameSent(session->subscriber, frame->fb->len, (uint32_t)(send_end - send_start));
+            StreamMetrics::recordFramesDropped(session->subscriber, skipped - skipped_total);
+            AdaptiveStreamController::recordFrameSent((uint32_t)(send_end - send_start),
+                                                      (uint32_t)(send_start - frame->captureTimeUs),
+                                                      frame_interval_ms > 0 ? 0 : skipped - skipped_total);
+            skipped_total = skipped;
+        }
+        
+        FrameBroker::release(frame);
+    }
+    
+    StreamMetrics::recordClientDisconnected();
+    Serial.printf("WebSocket stream closed; %u frames sent, %u waits for acknowledgements\n",
+                  frames_sent, ack_waits);
+    
+    FrameBroker::unsubscribe(session->subscriber);
+    StreamSessionManager::finish(session, false);
+    vTaskDelete(nullptr);
+}
+
+#endif // CONFIG_HTTPD_WS_SUPPORT
+
+void WebCamServer::formatFrameTags(uint32_t sequence, char *etag, size_t etagSize, char *seq, size_t seqSize) {
+    snprintf(etag, etagSize, "\"%08x-%u\"", FrameBroker::getEpoch(), sequence);
+    snprintf(seq, seqSize, "%u", sequence);
+}
+
+esp_err_t WebCamServer::captureHandler(httpd_req_t *req) {
+    SharedFrame * frame = nullptr;
+    char query[32];
+    char value[12];
+    char if_none_match[32];
+    char etag[32];
+    char seq_buf[12];
+    
+    bool has_after = false;
+    uint32_t after = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "after", value, sizeof(value)) == ESP_OK) {
+        after = strtoul(value, nullptr, 10);
+        has_after = true;
+    }
+    
+    if (has_after) {
+        frame = FrameBroker::waitForFrameAfter(after, 0);
+    } else {
+        frame = FrameBroker::acquireLatest(CAPTURE_MAX_AGE_MS);
+    }
+    
+    if (!frame) {
+        // Waiting for the next capture would stall the server task, so a
+        // sender task waits instead: for a frame newer than the client's
+        // (long-poll), or for the next capture if nothing recent is cached
+        StreamSession * session = StreamSessionManager::open(req, -1);
+        if (!session) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Too many waiting clients");
+            return ESP_FAIL;
+        }
+        session->afterSequence = has_after ? after : FrameBroker::getCapturedFrameCount();
+        session->timeoutMs = has_after ? CAPTURE_POLL_TIMEOUT_MS : FRAME_WAIT_TIMEOUT_MS;
+        session->longPoll = has_after;
+        if (has_after) {
+            // A timed-out long-poll is only Not Modified for a client that holds frame <after>
+            formatFrameTags(after, etag, sizeof(etag), seq_buf, sizeof(seq_buf));
+            session->etagMatched =
+                httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+                strcmp(if_none_match, etag) == 0;
+        }
+        if (!StreamSessionManager::start(session, snapshotSender, "snapshot", SNAPSHOT_TASK_STACK)) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start capture");
+            return ESP_FAIL;
+        }
+        return ESP_OK;
     }
     
+    formatFrameTags(frame->sequence, etag, sizeof(etag), seq_buf, sizeof(seq_buf));
+    
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "X-Frame-Seq", seq_buf);
+    
+    esp_err_t res;
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        res = httpd_resp_send(req, nullptr, 0);
+    } else {
+        httpd_resp_set_type(req, "image/jpeg");
+        httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+        res = httpd_resp_send(req, (const char *)frame->fb->buf, frame->fb->len);
+    }
+    
+    FrameBroker::release(frame);
     return res;
 }
 
+void WebCamServer::snapshotSender(void *parameter) {
+    StreamSession * session = (StreamSession *)parameter;
+    char header_buf[256];
+    char etag[32];
+    char seq_buf[12];
+    bool ok;
+    
+    SharedFrame * frame = FrameBroker::waitForFrameAfter(session->afterSequence,
+                                                         pdMS_TO_TICKS(session->timeoutMs));
+    if (!frame) {
+        static const char capture_failed[] =
+            "HTTP/1.1 500 Internal Server Error\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 21\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "Camera capture failed";
+        if (session->longPoll) {
+            // Nothing newer than <after>: 304 needs a matching If-None-Match, anyone else gets 204
+            formatFrameTags(session->afterSequence, etag, sizeof(etag), seq_buf, sizeof(seq_buf));
+            size_t hlen = snprintf(header_buf, sizeof(header_buf),
+                "HTTP/1.1 %s\r\n"
+                "Access-Control-Allow-Origin: *\r\n"
+                "Cache-Control: no-cache\r\n"
+                "ETag: %s\r\n"
+                "X-Frame-Seq: %s\r\n"
+                "Content-Length: 0\r\n"
+                "\r\n",
+                session->etagMatched ? "304 Not Modified" : "204 No Content", etag, seq_buf);
+            ok = StreamSessionManager::sendAll(session, header_buf, hlen);
+        } else {
+            Serial.println("Camera capture failed");
+            StreamSessionManager::sendAll(session, capture_failed, sizeof(capture_failed) - 1);
+            ok = false;
+        }
+        StreamSessionManager::finish(session, ok);
+        vTaskDelete(nullptr);
+        return;
+    }
+    
+    formatFrameTags(frame->sequence, etag, sizeof(etag), seq_buf, sizeof(seq_buf));
+    size_t hlen = snprintf(header_buf, sizeof(header_buf),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: image/jpeg\r\n"
+        "Content-Length: %u\r\n"
+        "Content-Disposition: inline; filename=capture.jpg\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Cache-Control: no-cache\r\n"
+        "ETag: %s\r\n"
+        "X-Frame-Seq: %s\r\n"
+        "\r\n",
+        frame->fb->len, etag, seq_buf);
+    
+    ok = StreamSessionManager::sendAll(session, header_buf, hlen);
+    if (ok) {
+        ok = StreamSessionManager::sendAll(session, frame->fb->buf, frame->fb->len);
+    }
+    
+    FrameBroker::release(frame);
+    StreamSessionManager::finish(session, ok);
+    vTaskDelete(nullptr);
+}
+
+esp_err_t WebCamServer::sendUnavailable(httpd_req_t *req, const char *message) {
+    char retry_after[12];
+    snprintf(retry_after, sizeof(retry_after), "%u", (unsigned)StreamSessionManager::RETRY_AFTER_SECONDS);
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Retry-After", retry_after);
+    httpd_resp_sendstr(req, message);
+    return ESP_OK;
+}
+
+esp_err_t WebCamServer::streamsHandler(httpd_req_t *req) {
+    char query[32];
+    char value[12];
+    char json[320];
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        uint32_t slots = StreamSessionManager::getStreamSlots();
+        uint32_t high = StreamSessionManager::getHighPrioritySlots();
+        if (httpd_query_key_value(query, "slots", value, sizeof(value)) == ESP_OK) {
+            slots = strtoul(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "high", value, sizeof(value)) == ESP_OK) {
+            high = strtoul(value, nullptr, 10);
+        }
+        if (slots > MAX_OPEN_SOCKETS - CONTROL_SOCKETS ||
+            !StreamSessionManager::setStreamSlots((uint8_t)slots, (uint8_t)high)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid stream slots");
+            return ESP_FAIL;
+        }
+        Serial.printf("Stream slots set to %u (%u high priority)\n", (unsigned)slots, (unsigned)high);
+    }
+    
+    snprintf(json, sizeof(json),
+        "{\"slots\":%u,\"high_priority_slots\":%u,"
+        "\"active\":{\"high\":%u,\"normal\":%u,\"low\":%u},"
+        "\"rejected\":{\"high\":%u,\"normal\":%u,\"low\":%u},"
+        "\"timed_out\":%u,\"reclaimed\":%u,\"retry_after_s\":%u}",
+        StreamSessionManager::getStreamSlots(), StreamSessionManager::getHighPrioritySlots(),
+        StreamSessionManager::getActiveStreamCount(StreamPriority::PRIMARY),
+        StreamSessionManager::getActiveStreamCount(StreamPriority::STANDARD),
+        StreamSessionManager::getActiveStreamCount(StreamPriority::BACKGROUND),
+        StreamSessionManager::getRejectedCount(StreamPriority::PRIMARY),
+        StreamSessionManager::getRejectedCount(StreamPriority::STANDARD),
+        StreamSessionManager::getRejectedCount(StreamPriority::BACKGROUND),
+        StreamSessionManager::getTimedOutCount(), StreamSessionManager::getReclaimedCount(),
+        (unsigned)StreamSessionManager::RETRY_AFTER_SECONDS);
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json, strlen(json));
+}
+
+esp_err_t WebCamServer::bandwidthHandler(httpd_req_t *req) {
+    char query[32];
+    char value[12];
+    char json[128];
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "kbps", value, sizeof(value)) == ESP_OK) {
+        BandwidthBudget::setLimitKbps(strtoul(value, nullptr, 10));
+        Serial.printf("Stream bandwidth budget set to %u kbps\n", BandwidthBudget::getLimitKbps());
+    }
+    
+    snprintf(json, sizeof(json),
+        "{\"limit_kbps\":%u,\"used_kbps\":%u,\"throttled_ms\":%u}",
+        BandwidthBudget::getLimitKbps(), BandwidthBudget::getUsedKbps(), BandwidthBudget::getThrottledMs());
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json, strlen(json));
+}
+
+esp_err_t WebCamServer::controlHandler(httpd_req_t *req) {
+    char query[256];
+    char value[12];
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        // Validate the whole query before staging any of it
+        CameraSettings changes = {};
+        for (uint8_t i = 0; i < CameraControl::getControlCount(); i++) {
+            const char *name = CameraControl::getControlName(i);
+            if (httpd_query_key_value(query, name, value, sizeof(value)) == ESP_OK &&
+                !CameraControl::parse(changes, name, value)) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid camera control value");
+                return ESP_FAIL;
+            }
+        }
+        if (changes.mask == 0) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown camera control");
+            return ESP_FAIL;
+        }
+        if (!CameraControl::apply(changes)) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save camera controls");
+            return ESP_FAIL;
+        }
+    }
+    
+    JsonDocument statusDoc;
+    CameraControl::addStatus(statusDoc);
+    String json;
+    serializeJson(statusDoc, json);
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json.c_str(), json.length());
+}
+
+esp_err_t WebCamServer::motionHandler(httpd_req_t *req) {
+    char query[128];
+    char value[8];
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "enabled", value, sizeof(value)) == ESP_OK) {
+            MotionDetector::setEnabled(atoi(value) != 0);
+        }
+        if (httpd_query_key_value(query, "threshold", value, sizeof(value)) == ESP_OK) {
+            MotionDetector::setThreshold((uint8_t)constrain(atoi(value), 1, 255));
+        }
+        if (httpd_query_key_value(query, "zone", value, sizeof(value)) == ESP_OK) {
+            // Unspecified fields keep their current values
+            int index = atoi(value);
+            MotionZone zone = MotionDetector::getZone(index);
+            if (httpd_query_key_value(query, "x", value, sizeof(value)) == ESP_OK) {
+                zone.x = (uint8_t)constrain(atoi(value), 0, 100);
+            }
+            if (httpd_query_key_value(query, "y", value, sizeof(value)) == ESP_OK) {
+                zone.y = (uint8_t)constrain(atoi(value), 0, 100);
+            }
+            if (httpd_query_key_value(query, "w", value, sizeof(value)) == ESP_OK) {
+                zone.width = (uint8_t)constrain(atoi(value), 0, 100);
+            }
+            if (httpd_query_key_value(query, "h", value, sizeof(value)) == ESP_OK) {
+                zone.height = (uint8_t)constrain(atoi(value), 0, 100);
+            }
+            if (httpd_query_key_value(query, "trigger", value, sizeof(value)) == ESP_OK) {
+                zone.triggerPercent = (uint8_t)constrain(atoi(value), 0, 100);
+            }
+            zone.enabled = true;
+            if (httpd_query_key_value(query, "zone_enabled", value, sizeof(value)) == ESP_OK) {
+                zone.enabled = atoi(value) != 0;
+            }
+            if (index < 0 || !MotionDetector::setZone((uint8_t)index, zone)) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid motion zone");
+                return ESP_FAIL;
+            }
+        }
+    }
+    
+    JsonDocument statusDoc;
+    MotionDetector::addStatus(statusDoc);
+    String json;
+    serializeJson(statusDoc, json);
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json.c_str(), json.length());
+}
+
+esp_err_t WebCamServer::clipHandler(httpd_req_t *req) {
+    char query[64];
+    char value[12];
+    char action[12] = "download";
+    uint32_t pre = FrameHistory::DEFAULT_PRE_SECONDS;
+    uint32_t post = FrameHistory::DEFAULT_POST_SECONDS;
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "action", action, sizeof(action));
+        if (httpd_query_key_value(query, "pre", value, sizeof(value)) == ESP_OK) {
+            pre = strtoul(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "post", value, sizeof(value)) == ESP_OK) {
+            post = strtoul(value, nullptr, 10);
+        }
+    }
+    
+    if (strcmp(action, "download") == 0) {
+        if (FrameHistory::getClipState() != ClipState::READY) {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No clip ready");
+            return ESP_FAIL;
+        }
+        StreamSession * session = StreamSessionManager::open(req, -1);
+        if (!session) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Too many clients");
+            return ESP_FAIL;
+        }
+        if (!StreamSessionManager::start(session, clipSender, "clip", CLIP_TASK_STACK)) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start clip download");
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+    
+    if (strcmp(action, "trigger") == 0) {
+        if (!FrameHistory::trigger(pre, post)) {
+            httpd_resp_set_status(req, "409 Conflict");
+        }
+    } else if (strcmp(action, "release") == 0) {
+        FrameHistory::releaseClip();
+    } else if (strcmp(action, "status") != 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown clip action");
+        return ESP_FAIL;
+    }
+    
+    JsonDocument statusDoc;
+    FrameHistory::addStatus(statusDoc);
+    String json;
+    serializeJson(statusDoc, json);
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json.c_str(), json.length());
+}
+
+void WebCamServer::clipSender(void *parameter) {
+    StreamSession * session = (StreamSession *)parameter;
+    AviClipInfo clip;
+    
+    if (!FrameHistory::beginExport(clip)) {
+        // Released or expired since the handler checked
+        static const char not_found[] =
+            "HTTP/1.1 404 Not Found\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 13\r\n"
+            "\r\n"
+            "No clip ready";
+        bool ok = StreamSessionManager::sendAll(session, not_found, sizeof(not_found) - 1);
+        StreamSessionManager::finish(session, ok);
+        vTaskDelete(nullptr);
+        return;
+    }
+    
+    bool ok = sendAvi(session, clip, FrameHistory::getClipFrame, "clip.avi");
+    FrameHistory::endExport();
+    Serial.printf("Clip %s: %u frames, %u bytes\n", ok ? "sent" : "aborted",
+                  clip.frameCount, AviWriter::getFileSize(clip));
+    
+    StreamSessionManager::finish(session, ok);
+    vTaskDelete(nullptr);
+}
+
+esp_err_t WebCamServer::timeLapseHandler(httpd_req_t *req) {
+    char query[128];
+    char value[12];
+    char action[12] = "download";
+    uint32_t fps = TimeLapse::DEFAULT_PLAYBACK_FPS;
+    TimeLapseSettings settings = TimeLapse::getSettings();
+    uint32_t interval = settings.intervalSeconds != 0 ? settings.intervalSeconds : TimeLapse::DEFAULT_INTERVAL_SECONDS;
+    framesize_t frame_size = (framesize_t)settings.frameSize;
+    int quality = settings.quality;
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "action", action, sizeof(action));
+        if (httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK) {
+            fps = strtoul(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "interval", value, sizeof(value)) == ESP_OK) {
+            interval = strtoul(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "quality", value, sizeof(value)) == ESP_OK) {
+            quality = atoi(value);
+        }
+        if (httpd_query_key_value(query, "framesize", value, sizeof(value)) == ESP_OK) {
+            frame_size = AdaptiveStreamController::parseFrameSize(value);
+            if (frame_size == FRAMESIZE_INVALID) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid frame size");
+                return ESP_FAIL;
+            }
+        }
+    }
+    
+    if (strcmp(action, "download") == 0) {
+        StreamSession * session = StreamSessionManager::open(req, -1);
+        if (!session) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Too many clients");
+            return ESP_FAIL;
+        }
+        session->maxFps = fps;
+        if (!StreamSessionManager::start(session, timeLapseSender, "timelapse", CLIP_TASK_STACK)) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start time-lapse download");
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+    
+    if (strcmp(action, "start") == 0) {
+        if (!TimeLapse::start(interval, frame_size, quality)) {
+            httpd_resp_set_status(req, "503 Service Unavailable");
+        }
+    } else if (strcmp(action, "stop") == 0) {
+        TimeLapse::stop();
+    } else if (strcmp(action, "clear") == 0) {
+        if (!TimeLapse::clear()) {
+            httpd_resp_set_status(req, "409 Conflict");
+        }
+    } else if (strcmp(action, "status") != 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown time-lapse action");
+        return ESP_FAIL;
+    }
+    
+    JsonDocument statusDoc;
+    TimeLapse::addStatus(statusDoc);
+    String json;
+    serializeJson(statusDoc, json);
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json.c_str(), json.length());
+}
+
+void WebCamServer::timeLapseSender(void *parameter) {
+    StreamSession * session = (StreamSession *)parameter;
+    AviClipInfo clip;
+    
+    if (!TimeLapse::beginExport(clip, session->maxFps)) {
+        static const char not_found[] =
+            "HTTP/1.1 404 Not Found\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 17\r\n"
+            "\r\n"
+            "No time-lapse yet";
+        bool ok = StreamSessionManager::sendAll(session, not_found, sizeof(not_found) - 1);
+        StreamSessionManager::finish(session, ok);
+        vTaskDelete(nullptr);
+        return;
+    }
+    
+    bool ok = sendAvi(session, clip, TimeLapse::getFrame, "timelapse.avi");
+    TimeLapse::endExport();
+    Serial.printf("Time-lapse %s: %u stills, %u bytes\n", ok ? "sent" : "aborted",
+                  clip.frameCount, AviWriter::getFileSize(clip));
+    
+    StreamSessionManager::finish(session, ok);
+    vTaskDelete(nullptr);
+}
+
+bool WebCamServer::sendAvi(StreamSession *session, const AviClipInfo &clip,
+                           bool (*getFrame)(uint32_t index, const uint8_t **data, size_t *length),
+                           const char *filename) {
+    char header_buf[256];
+    size_t hlen = snprintf(header_buf, sizeof(header_buf),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: video/x-msvideo\r\n"
+        "Content-Length: %u\r\n"
+        "Content-Disposition: attachment; filename=%s\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Cache-Control: no-cache\r\n"
+        "\r\n",
+        AviWriter::getFileSize(clip), filename);
+    
+    bool ok = StreamSessionManager::sendAll(session, header_buf, hlen) &&
+              AviWriter::writeHeader(session, clip);
+    
+    // Frames are sent straight from the PSRAM arena
+    const uint8_t * jpeg;
+    size_t length;
+    for (uint32_t i = 0; ok && i < clip.frameCount; i++) {
+        ok = getFrame(i, &jpeg, &length) &&
+             AviWriter::writeFrame(session, jpeg, length);
+    }
+    
+    if (ok) {
+        ok = AviWriter::writeIndexHeader(session, clip.frameCount);
+    }
+    uint8_t entries[CLIP_INDEX_BATCH * 16];
+    uint32_t offset = AviWriter::getFirstChunkOffset();
+    uint32_t batched = 0;
+    for (uint32_t i = 0; ok && i < clip.frameCount; i++) {
+        ok = getFrame(i, &jpeg, &length);
+        AviWriter::formatIndexEntry(entries + batched * 16, offset, length);
+        offset += AviWriter::getChunkSize(length);
+        if (++batched == CLIP_INDEX_BATCH || i + 1 == clip.frameCount) {
+            ok = ok && StreamSessionManager::sendAll(session, entries, batched * 16);
+            batched = 0;
+        }
+    }
+    return ok;
+}
+
+esp_err_t WebCamServer::metricsHandler(httpd_req_t *req) {
+    return StreamMetrics::sendPrometheus(req);
+}
+
 esp_err_t WebCamServer::indexHandler(httpd_req_t *req) {
-    const char* html = R"rawliteral(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta charset="UTF-8">
-    <meta name="viewport" content="width=device-width, initial-scale=1.0">
-    <title>ESP32-CAM Stream</title>
-    <style>
-        body {
-            font-family: Arial, sans-serif;
-            margin: 0;
-            padding: 20px;
-            background-color: #f0f0f0;
-            display: flex;
-            flex-direction: column;
-            align-items: center;
-        }
-        h1 {
-            color: #333;
-        }
-        #stream {
-            max-width: 100%;
-            border: 3px solid #333;
-            border-radius: 8px;
-            box-shadow: 0 4px 6px rgba(0, 0, 0, 0.1);
-        }
-        .container {
-            background-color: white;
-            padding: 20px;
-            border-radius: 8px;
-            box-shadow: 0 2px 4px rgba(0, 0, 0, 0.1);
-        }
-    </style>
-</head>
-<body>
-    <div class="container">
-        <h1>ESP32-CAM Live Stream</h1>
-        <img id="stream" src="/stream">
-    </div>
-</body>
-</html>
-)rawliteral";
+    char if_none_match[64];
+    
+    // Browsers revalidate on every load and get a 304 while the page is unchanged
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "ETag", WEB_INDEX_HTML_ETAG);
+    
+    // A list of tags is matched too; a value too long for the buffer is a miss
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strstr(if_none_match, WEB_INDEX_HTML_ETAG) != nullptr) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, nullptr, 0);
+    }
     
     httpd_resp_set_type(req, "text/html");
-    return httpd_resp_send(req, html, strlen(html));
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)WEB_INDEX_HTML_GZ, WEB_INDEX_HTML_GZ_LENGTH);
 }
 
 bool WebCamServer::startServer() {
@@ -236,6 +1047,28 @@ bool WebCamServer::startServer() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
     config.ctrl_port = 32768;
+    config.core_id = HTTPD_TASK_CORE;
+    config.task_priority = HTTPD_TASK_PRIORITY;
+    config.close_fn = StreamSessionManager::onSocketClose;
+    config.max_uri_handlers = MAX_URI_HANDLERS;
+    // Streams never use all the sockets. No LRU purge: sockets handed to
+    // sender tasks (streams, /ws, long polls, clips) see no httpd traffic
+    // after the handshake, so the purge would close a live stream before an
+    // idle keep-alive. Streams to clients that stop reading end at the send
+    // timeout, or sooner when admit() reclaims a stalled one
+    config.max_open_sockets = MAX_OPEN_SOCKETS;
+    config.lru_purge_enable = false;
+    config.send_wait_timeout = SOCKET_TIMEOUT_SECONDS;
+    config.recv_wait_timeout = SOCKET_TIMEOUT_SECONDS;
+    
+    uint8_t slots = STREAM_SLOTS;
+    if (slots > MAX_OPEN_SOCKETS - CONTROL_SOCKETS) {
+        slots = MAX_OPEN_SOCKETS - CONTROL_SOCKETS;
+        Serial.printf("Only %u stream slots fit the HTTP sockets\n", slots);
+    }
+    if (!StreamSessionManager::setStreamSlots(slots, STREAM_HIGH_PRIORITY_SLOTS < slots ? STREAM_HIGH_PRIORITY_SLOTS : 0)) {
+        Serial.println("Invalid stream slot settings; keeping the defaults");
+    }
     
     if (httpd_start(&streamHttpd, &config) != ESP_OK) {
         Serial.println("Failed to start HTTP server");
@@ -258,6 +1091,83 @@ bool WebCamServer::startServer() {
     };
     httpd_register_uri_handler(streamHttpd, &stream_uri);
     
+    httpd_uri_t capture_uri = {
+        .uri       = "/capture",
+        .method    = HTTP_GET,
+        .handler   = captureHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &capture_uri);
+    
+    httpd_uri_t bandwidth_uri = {
+        .uri       = "/bandwidth",
+        .method    = HTTP_GET,
+        .handler   = bandwidthHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &bandwidth_uri);
+    
+    httpd_uri_t streams_uri = {
+        .uri       = "/streams",
+        .method    = HTTP_GET,
+        .handler   = streamsHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &streams_uri);
+    
+    httpd_uri_t metrics_uri = {
+        .uri       = "/metrics",
+        .method    = HTTP_GET,
+        .handler   = metricsHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &metrics_uri);
+    
+    httpd_uri_t motion_uri = {
+        .uri       = "/motion",
+        .method    = HTTP_GET,
+        .handler   = motionHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &motion_uri);
+    
+    httpd_uri_t clip_uri = {
+        .uri       = "/clip",
+        .method    = HTTP_GET,
+        .handler   = clipHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &clip_uri);
+    
+    httpd_uri_t control_uri = {
+        .uri       = "/control",
+        .method    = HTTP_GET,
+        .handler   = controlHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &control_uri);
+    
+    httpd_uri_t timelapse_uri = {
+        .uri       = "/timelapse",
+        .method    = HTTP_GET,
+        .handler   = timeLapseHandler,
+        .user_ctx  = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &timelapse_uri);
+    
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    httpd_uri_t ws_uri = {
+        .uri       = "/ws",
+        .method    = HTTP_GET,
+        .handler   = webSocketHandler,
+        .user_ctx  = nullptr,
+        .is_websocket = true,
+        .handle_ws_control_frames = false,
+        .supported_subprotocol = nullptr
+    };
+    httpd_register_uri_handler(streamHttpd, &ws_uri);
+#endif
+    
     serverRunning = true;
     Serial.println("HTTP server started successfully");
     Serial.println("Stream available at: " + getStreamUrl());
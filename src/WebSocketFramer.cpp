@@ -0,0 +1,78 @@
+#include "WebSocketFramer.h"
+
+static const uint8_t OPCODE_BINARY = 0x02;
+static const uint8_t FIN = 0x80;
+
+static void putLittleEndian(uint8_t *out, uint64_t value, uint8_t bytes) {
+    for (uint8_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+bool WebSocketFramer::writeFrame(StreamSession *session, uint32_t sequence, int64_t captureTimeUs,
+                                 const uint8_t *jpeg, size_t length) {
+    uint8_t message_header[MAX_MESSAGE_HEADER_SIZE];
+    uint8_t frame_header[FRAME_HEADER_SIZE];
+    size_t payload_length = FRAME_HEADER_SIZE + length;
+    size_t header_length;
+
+    // Server-to-client frames are never masked; the length takes 7, 16 or 64 bits
+    message_header[0] = FIN | OPCODE_BINARY;
+    if (payload_length < 126) {
+        message_header[1] = (uint8_t)payload_length;
+        header_length = 2;
+    } else if (payload_length <= 0xFFFF) {
+        message_header[1] = 126;
+        message_header[2] = (uint8_t)(payload_length >> 8);
+        message_header[3] = (uint8_t)payload_length;
+        header_length = 4;
+    } else {
+        message_header[1] = 127;
+        for (uint8_t i = 0; i < 8; i++) {
+            message_header[2 + i] = (uint8_t)((uint64_t)payload_length >> (56 - 8 * i));
+        }
+        header_length = 10;
+    }
+
+    putLittleEndian(frame_header, sequence, 4);
+    putLittleEndian(frame_header + 4, length, 4);
+    putLittleEndian(frame_header + 8, (uint64_t)captureTimeUs, 8);
+
+    struct iovec vector[3];
+    vector[0].iov_base = message_header;
+    vector[0].iov_len = header_length;
+    vector[1].iov_base = frame_header;
+    vector[1].iov_len = FRAME_HEADER_SIZE;
+    vector[2].iov_base = (void *)jpeg;
+    vector[2].iov_len = length;
+
+    uint32_t writes = 0;
+    return StreamSessionManager::sendVector(session, vector, 3, &writes);
+}
+
+bool WebSocketFramer::parseAck(const uint8_t *payload, size_t length, bool text, uint32_t *sequence) {
+    if (!text) {
+        if (length != 4) {
+            return false;
+        }
+        *sequence = (uint32_t)payload[0] | (uint32_t)payload[1] << 8 |
+                    (uint32_t)payload[2] << 16 | (uint32_t)payload[3] << 24;
+        return true;
+    }
+
+    if (length == 0 || length > 10) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (payload[i] < '0' || payload[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (payload[i] - '0');
+    }
+    if (value > 0xFFFFFFFFULL) {
+        return false;
+    }
+    *sequence = (uint32_t)value;
+    return true;
+}
@@ -1,10 +1,21 @@
 #include <Arduino.h>
 #include <WiFi.h>
+#include "BootProfiler.h"
+#include "CameraControl.h"
 #include "ConfigurationManager.h"
 #include "MqttHandler.h"
 #include "WiFiManager.h"
 #include "WebCamServer.h"
+#include "RtspServer.h"
 #include "HeartbeatMqttPublisher.h"
+#include "SnapshotMqttPublisher.h"
+#include "MqttCommandChannel.h"
+#include "FrameHistory.h"
+#include "MotionDetector.h"
+#include "TaskScheduler.h"
+#include "ConnectivityManager.h"
+#include "TaskMonitor.h"
+#include "TimeLapse.h"
 #include "version.h"
 
 // Global objects - declare camera server first
@@ -20,16 +31,61 @@ String mqttLightState = "off";
 bool mqttLightCommandReceived = false;
 
 // Heartbeat interval (milliseconds)
-const unsigned long heartbeatInterval = 60000; // 60 seconds
-unsigned long lastHeartbeat = 0;
+const uint32_t heartbeatInterval = 60000; // 60 seconds
 
 // LED pin for status indication
 const int ledPin = 33;
 
+// Load the configuration and count the boot
+DeviceConfig loadConfiguration() {
+    Serial.println("=== Configuration ===");
+    int8_t phase = BootProfiler::beginPhase("config");
+    ConfigurationManager::setup();
+    ConfigurationManager::incrementBootCount();
+    
+    auto config = ConfigurationManager::getConfig();
+    Serial.printf("Device: %s\n", config.uuid.c_str());
+    Serial.printf("Boot: %d\n", config.bootCount);
+    BootProfiler::endPhase(phase);
+    Serial.printf("Free heap: %d bytes\n\n", ESP.getFreeHeap());
+    return config;
+}
+
+// Start associating with the access point without waiting for it
+void startWiFi(const DeviceConfig &config) {
+    WiFiManager::setupLowPower(WiFiPowerMode::HIGH_PERFORMANCE);
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(config.wifiSSID.c_str(), config.wifiPassword.c_str());
+}
+
+// Wait for the association started by startWiFi(), falling back to a
+// full WiFiManager connection attempt if it does not complete in time.
+// Both share the one Wi-Fi timeout: the association gets the first half,
+// the fallback whatever is left.
+bool waitForWiFi(const DeviceConfig &config) {
+    unsigned long budgetMs = (unsigned long)config.wifiTimeoutSeconds * 1000;
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start < budgetMs / 2) {
+        delay(10);
+    }
+    if (WiFi.status() == WL_CONNECTED) {
+        return true;
+    }
+    unsigned long elapsed = millis() - start;
+    int remainingSeconds = elapsed < budgetMs ? (int)((budgetMs - elapsed) / 1000) : 0;
+    return remainingSeconds > 0 && WiFiManager::connectQuick(remainingSeconds);
+}
+
+// Periodic heartbeat job; skipped while MQTT is down
+void publishHeartbeatJob() {
+    if (TaskScheduler::getEvents() & TaskScheduler::MQTT_UP) {
+        HeartbeatMqttPublisher::publishHeartbeat();
+    }
+}
+
 void setup() {
     // Initialise serial communication
     Serial.begin(115200);
-    delay(1000);
     
     Serial.println("\n====================================");
     Serial.println("ESP32-CAM Web Streaming System");
@@ -45,8 +101,20 @@ void setup() {
     pinMode(ledPin, OUTPUT);
     digitalWrite(ledPin, LOW);
     
-    // ***Initialize camera BEFORE configuration to grab memory first***
-    Serial.println("=== Camera Initialisation (Priority Init) ===");
+    // With PSRAM the framebuffers do not compete with the Wi-Fi driver for
+    // internal RAM, so association runs while the sensor is brought up.
+    // Without it the camera initialises first to grab memory first.
+    bool parallelWiFi = psramFound();
+    DeviceConfig config;
+    int8_t wifiPhase = -1;
+    if (parallelWiFi) {
+        config = loadConfiguration();
+        wifiPhase = BootProfiler::beginPhase("wifi");
+        startWiFi(config);
+    }
+    
+    Serial.println("=== Camera Initialisation ===");
+    int8_t cameraPhase = BootProfiler::beginPhase("camera");
     if (!camServer.initialiseCam()) {
         Serial.println("❌ Camera initialisation failed!");
         while (1) {
@@ -56,40 +124,42 @@ void setup() {
             delay(500);
         }
     }
+    BootProfiler::endPhase(cameraPhase);
     Serial.println("✅ Camera initialised");
     Serial.printf("Free heap after camera: %d bytes\n\n", ESP.getFreeHeap());
     
-    // Setup configuration
-    Serial.println("=== Configuration ===");
-    ConfigurationManager::setup();
-    ConfigurationManager::incrementBootCount();
-    
-    auto config = ConfigurationManager::getConfig();
-    Serial.printf("Device: %s\n", config.uuid.c_str());
-    Serial.printf("Boot: %d\n", config.bootCount);
-    Serial.printf("Free heap: %d bytes\n\n", ESP.getFreeHeap());
+    if (!parallelWiFi) {
+        config = loadConfiguration();
+        wifiPhase = BootProfiler::beginPhase("wifi");
+        startWiFi(config);
+    }
     
     // Set MQTT buffer size SMALL for webcam
     MqttHandler::setBufferSize(512);  // Reduced from default 2048
     
     // WiFi
     Serial.println("=== WiFi ===");
-    WiFiManager::setupLowPower(WiFiPowerMode::HIGH_PERFORMANCE);
-    if (!WiFiManager::connectQuick(config.wifiTimeoutSeconds)) {
+    if (!waitForWiFi(config)) {
         Serial.println("❌ WiFi failed");
         while (1) { delay(1000); }
     }
+    BootProfiler::endPhase(wifiPhase);
     Serial.printf("✅ IP: %s\n", WiFiManager::getIPAddress().c_str());
     Serial.printf("Free heap: %d bytes\n\n", ESP.getFreeHeap());
     digitalWrite(ledPin, HIGH);
     
     // Web server
     Serial.println("=== Web Server ===");
+    int8_t serverPhase = BootProfiler::beginPhase("server");
     if (!camServer.startServer()) {
         Serial.println("❌ Server failed");
         while (1) { delay(1000); }
     }
+    BootProfiler::endPhase(serverPhase);
     Serial.println("✅ Server started");
+    if (!RtspServer::begin()) {
+        Serial.println("⚠️ RTSP server failed");
+    }
     Serial.printf("Free heap: %d bytes\n\n", ESP.getFreeHeap());
     
     // MQTT
@@ -97,47 +167,47 @@ void setup() {
     String configTopic = "configure/" + config.uuid;
     configTopic.toCharArray(mqttConfigureTopic, sizeof(mqttConfigureTopic));
     
+    HeartbeatMqttPublisher::begin();
+    int8_t mqttPhase = BootProfiler::beginPhase("mqtt");
     MqttHandler::setup(0);
-    if (MqttHandler::connect(config.mqttTimeoutSeconds)) {
+    bool mqttConnected = MqttHandler::connect(config.mqttTimeoutSeconds);
+    BootProfiler::endPhase(mqttPhase);
+    if (mqttConnected) {
         Serial.println("✅ MQTT connected");
-        for (int i = 0; i < 5; i++) {
-            MqttHandler::loop();
-            delay(50);
-        }
+        MqttHandler::loop();
         HeartbeatMqttPublisher::publishHeartbeat();
     } else {
         Serial.println("⚠️ MQTT failed - will retry");
     }
+    
+    // Commands and snapshots use a connection of their own (see MqttCommandChannel)
+    MqttCommandChannel::begin();
+    MqttCommandChannel::addHandler("clip", FrameHistory::handleCommand);
+    MqttCommandChannel::addHandler("control", CameraControl::handleCommand);
+    MqttCommandChannel::addHandler("timelapse", TimeLapse::handleCommand);
+    SnapshotMqttPublisher::begin();
+    
+    // From here on the network task owns Wi-Fi and both MQTT connections
+    ConnectivityManager::begin(MotionDetector::publishPendingEvents);
+    TaskScheduler::addPeriodic(publishHeartbeatJob, heartbeatInterval);
+    TaskScheduler::addPeriodic(TaskMonitor::sample, TaskMonitor::SAMPLE_INTERVAL_MS);
+    if (!TaskScheduler::begin()) {
+        Serial.println("❌ Network task failed");
+        while (1) { delay(1000); }
+    }
+    TaskScheduler::post(MotionDetector::publishPendingEvents);
     Serial.printf("Free heap: %d bytes\n\n", ESP.getFreeHeap());
     
     Serial.println("====================================");
     Serial.println("System Ready!");
     Serial.println("Stream: " + camServer.getStreamUrl());
+    Serial.println("RTSP: " + RtspServer::getUrl());
+    BootProfiler::report();
     Serial.println("====================================\n");
-    
-    lastHeartbeat = millis();
 }
 
 void loop() {
-    if (WiFi.status() != WL_CONNECTED) {
-        auto config = ConfigurationManager::getConfig();
-        WiFiManager::connectQuick(config.wifiTimeoutSeconds);
-    }
-    
-    if (!MqttHandler::isConnected()) {
-        auto config = ConfigurationManager::getConfig();
-        MqttHandler::connect(config.mqttTimeoutSeconds);
-    } else {
-        MqttHandler::loop();
-    }
-    
-    unsigned long currentMillis = millis();
-    if (currentMillis - lastHeartbeat >= heartbeatInterval) {
-        if (MqttHandler::isConnected()) {
-            HeartbeatMqttPublisher::publishHeartbeat();
-        }
-        lastHeartbeat = currentMillis;
-    }
-    
-    delay(100);
+    // Capture, streaming and networking all run on tasks of their own, so
+    // the loop task has nothing left to do; deleting it returns its stack
+    vTaskDelete(nullptr);
 }
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Minify and gzip the web UI in web/ into include/WebAssets.h.
+
+Every file in web/ becomes a constexpr byte array holding its minified,
+gzipped contents, with the length and a content hash to use as the ETag:
+
+    web/index.html -> WEB_INDEX_HTML_GZ, WEB_INDEX_HTML_GZ_LENGTH,
+                      WEB_INDEX_HTML_ETAG
+
+PlatformIO runs this before every build (extra_scripts in platformio.ini)
+and the header is only rewritten when its contents change, so an unchanged
+UI does not trigger a rebuild. It can also be run by hand:
+
+    tools/embed_web_assets.py [--check]
+
+With --check nothing is written; the exit status is 1 if the header is out
+of date.
+"""
+
+import argparse
+import gzip
+import hashlib
+import io
+import os
+import re
+import sys
+
+HEADER = os.path.join("include", "WebAssets.h")
+SOURCE_DIR = "web"
+BYTES_PER_LINE = 16
+
+
+def minify_css(css):
+    css = re.sub(r"/\*.*?\*/", "", css, flags=re.S)
+    css = re.sub(r"\s+", " ", css)
+    css = re.sub(r"\s*([{};:,>])\s*", r"\1", css)
+    return css.replace(";}", "}").strip()
+
+
+def minify_js(js):
+    # Line breaks are kept so automatic semicolon insertion still works
+    lines = (line.strip() for line in js.splitlines())
+    return "\n".join(line for line in lines if line and not line.startswith("//"))
+
+
+def minify_markup(markup):
+    markup = re.sub(r"<!--.*?-->", "", markup, flags=re.S)
+    markup = re.sub(r"\s+", " ", markup)
+    markup = re.sub(r">\s+<", "><", markup)
+    # Segments next to a <style> or <script> block
+    return re.sub(r"^\s+<", "<", re.sub(r">\s+$", ">", markup))
+
+
+def minify_html(html):
+    parts = []
+    position = 0
+    for match in re.finditer(r"(<(style|script)\b[^>]*>)(.*?)(</\2>)", html, flags=re.S | re.I):
+        parts.append(minify_markup(html[position:match.start()]))
+        body = minify_css(match.group(3)) if match.group(2).lower() == "style" else minify_js(match.group(3))
+        parts.append(minify_markup(match.group(1)) + body + match.group(4))
+        position = match.end()
+    parts.append(minify_markup(html[position:]))
+    return "".join(parts).strip()
+
+
+def minify(name, text):
+    extension = os.path.splitext(name)[1].lower()
+    if extension in (".html", ".htm"):
+        return minify_html(text)
+    if extension == ".css":
+        return minify_css(text)
+    if extension == ".js":
+        return minify_js(text)
+    return text
+
+
+def compress(data):
+    # mtime=0 and no file name keep the output identical between builds
+    buffer = io.BytesIO()
+    with gzip.GzipFile(filename="", mode="wb", compresslevel=9, fileobj=buffer, mtime=0) as stream:
+        stream.write(data)
+    return buffer.getvalue()
+
+
+def symbol(name):
+    return "WEB_" + re.sub(r"[^A-Za-z0-9]", "_", name).upper()
+
+
+def render(assets):
+    lines = [
+        "// Generated by tools/embed_web_assets.py from web/; do not edit.",
+        "#ifndef WEB_ASSETS_H",
+        "#define WEB_ASSETS_H",
+        "",
+        "#include <stddef.h>",
+        "#include <stdint.h>",
+        "",
+        "// Minified, gzipped web UI. Only WebCamServer.cpp includes this, so each",
+        "// array exists once in flash.",
+    ]
+    for name, original, data in assets:
+        prefix = symbol(name)
+        etag = hashlib.sha256(data).hexdigest()[:16]
+        lines += [
+            "",
+            "// %s: %d bytes, %d gzipped" % (name, original, len(data)),
+            "constexpr size_t %s_GZ_LENGTH = %d;" % (prefix, len(data)),
+            "constexpr char %s_ETAG[] = \"\\\"%s\\\"\";" % (prefix, etag),
+            "constexpr uint8_t %s_GZ[%s_GZ_LENGTH] = {" % (prefix, prefix),
+        ]
+        for offset in range(0, len(data), BYTES_PER_LINE):
+            chunk = data[offset:offset + BYTES_PER_LINE]
+            lines.append("    " + ", ".join("0x%02x" % byte for byte in chunk) + ",")
+        lines.append("};")
+    lines += ["", "#endif // WEB_ASSETS_H", ""]
+    return "\n".join(lines)
+
+
+def generate(project_dir):
+    source_dir = os.path.join(project_dir, SOURCE_DIR)
+    assets = []
+    for name in sorted(os.listdir(source_dir)):
+        path = os.path.join(source_dir, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, encoding="utf-8") as source:
+            text = source.read()
+        minified = minify(name, text).encode("utf-8")
+        assets.append((name, len(text.encode("utf-8")), compress(minified)))
+    return render(assets)
+
+
+def update(project_dir, check=False):
+    """Regenerate the header; returns True if it was already up to date."""
+    header_path = os.path.join(project_dir, HEADER)
+    contents = generate(project_dir)
+    try:
+        with open(header_path, encoding="utf-8") as header:
+            current = header.read()
+    except FileNotFoundError:
+        current = None
+    if current == contents:
+        return True
+    if not check:
+        with open(header_path, "w", encoding="utf-8") as header:
+            header.write(contents)
+        print("Regenerated %s" % HEADER)
+    return False
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--check", action="store_true", help="fail if the header is out of date")
+    args = parser.parse_args()
+    project_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    if not update(project_dir, args.check) and args.check:
+        print("%s is out of date; run tools/embed_web_assets.py" % HEADER)
+        return 1
+    return 0
+
+
+try:
+    Import("env")  # noqa: F821 - provided when PlatformIO runs this as an extra script
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
+else:
+    update(env["PROJECT_DIR"])  # noqa: F821
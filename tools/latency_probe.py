@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""Measure where /stream latency goes: on the camera, or between it and here.
+
+Every /stream part carries X-Frame-Seq, X-Timestamp (capture time) and
+X-Send-Timestamp (when the part went to the socket), all on the camera's
+boot clock. The response carries X-Server-Time; the probe takes it as the
+camera clock at the midpoint between sending the request and receiving the
+headers, which maps the camera clock to this host's to within half that
+round trip (printed as the sync error). From then on each frame splits into
+
+    capture->send     time on the camera before the send started (exact)
+    send->receive     httpd send, network and TCP until the last byte arrived
+    capture->receive  the whole path
+
+and gaps in X-Frame-Seq count frames the camera skipped for this viewer,
+including those a ?fps= cap leaves out.
+Works against a board or the native build, which serves on port 8080:
+
+    tools/latency_probe.py --url http://127.0.0.1:8080/stream --duration 20
+
+Run it before and after a configuration change to compare the two, or give
+thresholds to turn it into a check: the exit status is 1 if any is missed.
+
+    tools/latency_probe.py --max-p90-ms 150 --max-skipped 5
+"""
+
+import argparse
+import json
+import socket
+import sys
+import time
+from urllib.parse import urlsplit
+
+PERCENTILES = (50, 90, 99)
+
+
+def parse_time(value):
+    """Convert a seconds.microseconds header to microseconds."""
+    seconds, _, fraction = value.partition(".")
+    return int(seconds) * 1000000 + int(fraction.ljust(6, "0")[:6])
+
+
+def now_us():
+    return time.monotonic_ns() // 1000
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, max(0, round(p / 100 * (len(ordered) - 1))))
+    return ordered[index]
+
+
+class StreamReader:
+    """Buffered line and block reader over a socket."""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.buffer = b""
+
+    def _fill(self):
+        data = self.sock.recv(65536)
+        if not data:
+            raise ConnectionError("connection closed")
+        self.buffer += data
+
+    def read_line(self):
+        while b"\n" not in self.buffer:
+            self._fill()
+        line, _, self.buffer = self.buffer.partition(b"\n")
+        return line.decode("latin-1").strip()
+
+    def read_exactly(self, length):
+        while len(self.buffer) < length:
+            self._fill()
+        data, self.buffer = self.buffer[:length], self.buffer[length:]
+        return data
+
+    def read_headers(self):
+        """Read header lines up to the blank line and return them lower-cased."""
+        headers = {}
+        while True:
+            line = self.read_line()
+            if not line:
+                if headers:
+                    return headers
+                continue  # blank line between parts
+            if ":" in line:
+                name, value = line.split(":", 1)
+                headers[name.strip().lower()] = value.strip()
+            else:
+                headers[line] = ""
+
+
+def probe(url, duration):
+    parts = urlsplit(url)
+    host = parts.hostname or "127.0.0.1"
+    port = parts.port or 80
+    path = parts.path or "/stream"
+    if parts.query:
+        path += "?" + parts.query
+
+    samples = {"capture_send": [], "send_receive": [], "capture_receive": []}
+    result = {"frames": 0, "gaps": 0, "skipped": 0, "reordered": 0, "sync_error_ms": None, "error": None}
+
+    sock = socket.create_connection((host, port), timeout=5)
+    try:
+        reader = StreamReader(sock)
+        request_sent = now_us()
+        sock.sendall(f"GET {path} HTTP/1.1\r\nHost: {host}\r\nConnection: close\r\n\r\n".encode())
+        status = reader.read_line()
+        if " 200 " not in status:
+            raise ConnectionError(f"unexpected status: {status}")
+        headers = reader.read_headers()
+        headers_received = now_us()
+        if "x-server-time" not in headers:
+            raise ConnectionError("no X-Server-Time header; is the firmware too old?")
+
+        # Camera clock plus offset gives host monotonic time
+        offset = (request_sent + headers_received) // 2 - parse_time(headers["x-server-time"])
+        result["sync_error_ms"] = round((headers_received - request_sent) / 2000, 2)
+
+        deadline = time.monotonic() + duration
+        last_sequence = None
+        while time.monotonic() < deadline:
+            part = reader.read_headers()
+            length = int(part.get("content-length", "0"))
+            if length <= 0:
+                raise ConnectionError("part without Content-Length")
+            reader.read_exactly(length)
+            received = now_us()
+            if "x-frame-seq" not in part or "x-timestamp" not in part or "x-send-timestamp" not in part:
+                raise ConnectionError("part without X-Frame-Seq, X-Timestamp and X-Send-Timestamp")
+
+            sequence = int(part["x-frame-seq"])
+            capture = parse_time(part["x-timestamp"]) + offset
+            send = parse_time(part["x-send-timestamp"]) + offset
+            samples["capture_send"].append(send - capture)
+            samples["send_receive"].append(received - send)
+            samples["capture_receive"].append(received - capture)
+
+            if last_sequence is not None:
+                if sequence <= last_sequence:
+                    result["reordered"] += 1
+                elif sequence > last_sequence + 1:
+                    result["gaps"] += 1
+                    result["skipped"] += sequence - last_sequence - 1
+            last_sequence = sequence
+            result["frames"] += 1
+    except socket.timeout:
+        result["error"] = "timed out"
+    except (ConnectionError, OSError, ValueError) as error:
+        result["error"] = str(error) or type(error).__name__
+    finally:
+        sock.close()
+
+    for name, values in samples.items():
+        summary = {}
+        if values:
+            for p in PERCENTILES:
+                summary[f"p{p}_ms"] = round(percentile(values, p) / 1000, 2)
+            summary["max_ms"] = round(max(values) / 1000, 2)
+        result[name] = summary
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://127.0.0.1:8080/stream", help="stream URL")
+    parser.add_argument("--duration", type=float, default=15.0, help="test length in seconds")
+    parser.add_argument("--max-p90-ms", type=float, help="fail if capture->receive p90 is higher")
+    parser.add_argument("--max-skipped", type=int, help="fail if more frames are skipped")
+    parser.add_argument("--json", action="store_true", help="print results as JSON")
+    args = parser.parse_args()
+
+    result = probe(args.url, args.duration)
+
+    failures = []
+    if result["error"]:
+        failures.append(result["error"])
+    if result["frames"] == 0:
+        failures.append("no frames received")
+    total = result["capture_receive"]
+    if args.max_p90_ms is not None and total and total["p90_ms"] > args.max_p90_ms:
+        failures.append(f"capture->receive p90 {total['p90_ms']} ms > {args.max_p90_ms}")
+    if args.max_skipped is not None and result["skipped"] > args.max_skipped:
+        failures.append(f"{result['skipped']} frames skipped > {args.max_skipped}")
+
+    if args.json:
+        print(json.dumps({"result": result, "failures": failures}, indent=2))
+    else:
+        print(f"{result['frames']} frames, {result['skipped']} skipped in {result['gaps']} gaps, "
+              f"{result['reordered']} out of order; clock sync within {result['sync_error_ms']} ms")
+        print(f"{'stage':>16} {'p50':>9} {'p90':>9} {'p99':>9} {'max':>9}")
+        for name, label in (("capture_send", "capture->send"), ("send_receive", "send->receive"),
+                            ("capture_receive", "capture->receive")):
+            summary = result[name]
+            if summary:
+                print(f"{label:>16} " + " ".join(f"{summary[key]:>7.1f}ms"
+                                                 for key in ("p50_ms", "p90_ms", "p99_ms", "max_ms")))
+        for failure in failures:
+            print(f"FAIL {failure}")
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+"""Minimal MQTT 3.1.1 broker for testing the device's MQTT traffic locally.
+
+Supports what the firmware uses: CONNECT, SUBSCRIBE (with + and #
+wildcards), QoS 0 PUBLISH, PINGREQ and DISCONNECT. Every publish is logged.
+--max-packet rejects larger packets by closing the connection, like a
+broker with a message size limit.
+
+    tools/mqtt_stub_broker.py --port 1883
+    WEBCAM_MQTT_PORT=1883 pio run -e native -t exec
+
+With --test-snapshot the broker checks the snapshot publisher end to end:
+once the device has subscribed to configure/<uuid> it sends a "snapshot"
+command, reassembles the reply (a single message or sequenced chunks),
+checks it against the info message and that it is a complete JPEG, and
+exits with status 0 on success or 1 on failure or timeout.
+
+    tools/mqtt_stub_broker.py --test-snapshot chunks --chunk-size 1024 \
+        --uuid native-webcam --max-packet 2048 --save /tmp/snapshot.jpg
+"""
+
+import argparse
+import asyncio
+import json
+import struct
+import sys
+
+CONNECT = 1
+CONNACK = 2
+PUBLISH = 3
+SUBSCRIBE = 8
+SUBACK = 9
+PINGREQ = 12
+PINGRESP = 13
+DISCONNECT = 14
+
+CHUNK_HEADER = struct.Struct(">IHHI")
+
+
+def topic_matches(pattern, topic):
+    pattern_levels = pattern.split("/")
+    topic_levels = topic.split("/")
+    for i, level in enumerate(pattern_levels):
+        if level == "#":
+            return True
+        if i >= len(topic_levels) or (level != "+" and level != topic_levels[i]):
+            return False
+    return len(pattern_levels) == len(topic_levels)
+
+
+def encode_length(length):
+    encoded = bytearray()
+    while True:
+        digit = length % 128
+        length //= 128
+        encoded.append(digit | (0x80 if length > 0 else 0))
+        if length == 0:
+            return bytes(encoded)
+
+
+def encode_string(text):
+    data = text.encode()
+    return struct.pack(">H", len(data)) + data
+
+
+def publish_packet(topic, payload):
+    body = encode_string(topic) + payload
+    return bytes([PUBLISH << 4]) + encode_length(len(body)) + body
+
+
+class SnapshotCheck:
+    """Sends a snapshot command and validates what comes back."""
+
+    def __init__(self, broker, uuid, mode, chunk_size, save):
+        self.broker = broker
+        self.uuid = uuid
+        self.mode = mode
+        self.chunk_size = chunk_size
+        self.save = save
+        self.info = None
+        self.chunks = {}
+        self.sent = False
+        self.result = asyncio.get_running_loop().create_future()
+
+    def on_subscribe(self, topic):
+        if not self.sent and topic == f"configure/{self.uuid}":
+            self.sent = True
+            command = {"action": "snapshot", "mode": self.mode, "chunk_size": self.chunk_size}
+            print(f"test: requesting snapshot {command}")
+            self.broker.route(topic, json.dumps(command).encode())
+
+    def on_publish(self, topic, payload):
+        if self.result.done():
+            return
+        base = f"snapshot/{self.uuid}"
+        if topic == base + "/info":
+            self.info = json.loads(payload)
+            self.chunks = {}
+        elif topic == base and self.info is not None:
+            self.finish(payload)
+        elif topic == base + "/chunk" and self.info is not None:
+            if len(payload) < CHUNK_HEADER.size:
+                self.fail(f"chunk of {len(payload)} bytes has no header")
+                return
+            sequence, index, count, size = CHUNK_HEADER.unpack_from(payload)
+            if sequence != self.info["frame_seq"] or count != self.info["chunks"] or size != self.info["size"]:
+                self.fail(f"chunk header {sequence}/{index}/{count}/{size} does not match info {self.info}")
+                return
+            self.chunks[index] = payload[CHUNK_HEADER.size:]
+            if len(self.chunks) == count:
+                self.finish(b"".join(self.chunks[i] for i in range(count)))
+
+    def finish(self, jpeg):
+        if self.info["mode"] != self.mode:
+            self.fail(f"asked for {self.mode}, got {self.info['mode']}")
+        elif len(jpeg) != self.info["size"]:
+            self.fail(f"received {len(jpeg)} bytes, info says {self.info['size']}")
+        elif not (jpeg.startswith(b"\xff\xd8") and jpeg.rstrip(b"\x00").endswith(b"\xff\xd9")):
+            self.fail("payload is not a complete JPEG")
+        else:
+            if self.save:
+                with open(self.save, "wb") as output:
+                    output.write(jpeg)
+            print(f"test: PASS frame {self.info['frame_seq']}, {len(jpeg)} bytes, "
+                  f"{self.info['width']}x{self.info['height']}, {self.info['chunks']} message(s)")
+            self.result.set_result(True)
+
+    def fail(self, reason):
+        print(f"test: FAIL {reason}")
+        if not self.result.done():
+            self.result.set_result(False)
+
+
+class Broker:
+    def __init__(self, max_packet, quiet):
+        self.max_packet = max_packet
+        self.quiet = quiet
+        self.sessions = {}
+        self.observer = None
+
+    def route(self, topic, payload):
+        if not self.quiet:
+            print(f"publish {topic} ({len(payload)} bytes)")
+        if self.observer is not None:
+            self.observer.on_publish(topic, payload)
+        packet = publish_packet(topic, payload)
+        for writer, subscriptions in list(self.sessions.items()):
+            if any(topic_matches(pattern, topic) for pattern in subscriptions):
+                writer.write(packet)
+
+    async def read_packet(self, reader):
+        header = await reader.readexactly(1)
+        length = 0
+        multiplier = 1
+        while True:
+            digit = (await reader.readexactly(1))[0]
+            length += (digit & 0x7F) * multiplier
+            multiplier *= 128
+            if not digit & 0x80:
+                break
+        if self.max_packet and length > self.max_packet:
+            raise ValueError(f"packet of {length} bytes exceeds --max-packet {self.max_packet}")
+        return header[0], await reader.readexactly(length)
+
+    async def handle(self, reader, writer):
+        peer = writer.get_extra_info("peername")
+        client_id = "?"
+        self.sessions[writer] = []
+        try:
+            while True:
+                header, body = await self.read_packet(reader)
+                kind = header >> 4
+                if kind == CONNECT:
+                    (name_length,) = struct.unpack_from(">H", body)
+                    offset = 2 + name_length + 4
+                    (id_length,) = struct.unpack_from(">H", body, offset)
+                    client_id = body[offset + 2:offset + 2 + id_length].decode()
+                    print(f"connect {client_id} from {peer[0]}:{peer[1]}")
+                    writer.write(bytes([CONNACK << 4, 2, 0, 0]))
+                elif kind == SUBSCRIBE:
+                    packet_id = body[:2]
+                    offset = 2
+                    granted = bytearray()
+                    while offset < len(body):
+                        (topic_length,) = struct.unpack_from(">H", body, offset)
+                        topic = body[offset + 2:offset + 2 + topic_length].decode()
+                        offset += 2 + topic_length + 1
+                        self.sessions[writer].append(topic)
+                        granted.append(0)
+                        print(f"subscribe {client_id} {topic}")
+                    writer.write(bytes([SUBACK << 4]) + encode_length(2 + len(granted)) + packet_id + granted)
+                    await writer.drain()
+                    if self.observer is not None:
+                        for topic in self.sessions[writer]:
+                            self.observer.on_subscribe(topic)
+                elif kind == PUBLISH:
+                    (topic_length,) = struct.unpack_from(">H", body)
+                    topic = body[2:2 + topic_length].decode()
+                    offset = 2 + topic_length + (2 if (header >> 1) & 3 else 0)
+                    self.route(topic, body[offset:])
+                elif kind == PINGREQ:
+                    writer.write(bytes([PINGRESP << 4, 0]))
+                elif kind == DISCONNECT:
+                    break
+                await writer.drain()
+        except (asyncio.IncompleteReadError, asyncio.CancelledError, ConnectionError):
+            pass
+        except ValueError as error:
+            print(f"closing {client_id}: {error}")
+        finally:
+            print(f"disconnect {client_id}")
+            del self.sessions[writer]
+            writer.close()
+
+
+async def run(args):
+    broker = Broker(args.max_packet, args.quiet)
+    server = await asyncio.start_server(broker.handle, args.host, args.port)
+    print(f"MQTT stub broker on {args.host}:{args.port}")
+    async with server:
+        if not args.test_snapshot:
+            await server.serve_forever()
+            return 0
+        check = SnapshotCheck(broker, args.uuid, args.test_snapshot, args.chunk_size, args.save)
+        broker.observer = check
+        try:
+            passed = await asyncio.wait_for(check.result, args.timeout)
+        except asyncio.TimeoutError:
+            print(f"test: FAIL no complete snapshot within {args.timeout:.0f}s")
+            passed = False
+        return 0 if passed else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1", help="address to listen on")
+    parser.add_argument("--port", type=int, default=1883, help="port to listen on")
+    parser.add_argument("--max-packet", type=int, default=0, help="largest packet body accepted (0: no limit)")
+    parser.add_argument("--quiet", action="store_true", help="do not log every publish")
+    parser.add_argument("--test-snapshot", choices=["stream", "chunks"], help="request and check a snapshot, then exit")
+    parser.add_argument("--uuid", default="native-webcam", help="device UUID for --test-snapshot")
+    parser.add_argument("--chunk-size", type=int, default=1024, help="chunk size for --test-snapshot chunks")
+    parser.add_argument("--timeout", type=float, default=30.0, help="seconds to wait for --test-snapshot")
+    parser.add_argument("--save", metavar="FILE", help="write the received JPEG to FILE")
+    args = parser.parse_args()
+    sys.exit(asyncio.run(run(args)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,507 @@
+#!/usr/bin/env python3
+"""Play the RTSP stream and check RTP/JPEG packetisation and frame reassembly.
+
+Works against a board or the native build (`pio run -e native -t exec`,
+which serves RTSP on port 8554). Each client runs DESCRIBE, SETUP and PLAY
+with the chosen transport, receives for --duration seconds and then checks
+every RTP packet against RFC 3550 and RFC 2435:
+
+  - version 2, payload type 26, the SSRC from SETUP and contiguous
+    sequence numbers (losses are counted, not tolerated beyond --max-loss)
+  - one timestamp per frame, increasing from frame to frame
+  - fragment offsets that join up from 0, the marker on the last packet,
+    and the quantisation tables in the first packet of each frame
+  - at least one RTCP sender report for the stream
+
+Every complete frame is rebuilt into a JPEG as RFC 2435 Appendix A
+describes, and the first --decode-frames of them are Huffman-decoded MCU
+by MCU to prove the scan is intact.
+
+    tools/rtsp_loopback_test.py --transport udp --duration 10 --min-fps 10
+    tools/rtsp_loopback_test.py --transport tcp
+    tools/rtsp_loopback_test.py --transport multicast --clients 3 --interface 127.0.0.1
+
+Multicast clients all join the group from SETUP; --interface picks the
+interface to join on (127.0.0.1 for the native build). With --save DIR the
+first client writes its rebuilt frames to DIR as numbered JPEGs.
+
+The exit status is 1 if any check fails.
+"""
+
+import argparse
+import os
+import select
+import socket
+import struct
+import sys
+import threading
+import time
+from urllib.parse import urlsplit
+
+# ITU T.81 Annex K tables, as RTP/JPEG assumes
+DC_LUMA_COUNTS = [0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0]
+DC_CHROMA_COUNTS = [0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0]
+DC_SYMBOLS = list(range(12))
+AC_LUMA_COUNTS = [0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d]
+AC_LUMA_SYMBOLS = bytes.fromhex(
+    "01020300041105122131410613516107227114328191a1082342b1c11552d1f02433627282090a161718191a25262728"
+    "292a3435363738393a434445464748494a535455565758595a636465666768696a737475767778797a838485868788"
+    "898a92939495969798999aa2a3a4a5a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9da"
+    "e1e2e3e4e5e6e7e8e9eaf1f2f3f4f5f6f7f8f9fa")
+AC_CHROMA_COUNTS = [0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77]
+AC_CHROMA_SYMBOLS = bytes.fromhex(
+    "000102031104052131061241510761711322328108144291a1b1c109233352f0156272d10a162434e125f11718191a"
+    "262728292a35363738393a434445464748494a535455565758595a636465666768696a737475767778797a82838485"
+    "868788898a92939495969798999aa2a3a4a5a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7"
+    "d8d9dae2e3e4e5e6e7e8e9eaf2f3f4f5f6f7f8f9fa")
+
+
+class RtspError(Exception):
+    pass
+
+
+class RtspConnection:
+    """Minimal RTSP/1.0 client; interleaved data is queued while waiting for a reply."""
+
+    def __init__(self, url, timeout):
+        parts = urlsplit(url)
+        self.url = url
+        self.sock = socket.create_connection((parts.hostname or "127.0.0.1", parts.port or 554), timeout=timeout)
+        self.buffer = b""
+        self.cseq = 0
+        self.session = None
+
+    def request(self, method, url=None, headers=None):
+        self.cseq += 1
+        lines = [f"{method} {url or self.url} RTSP/1.0", f"CSeq: {self.cseq}", "User-Agent: rtsp_loopback_test"]
+        if self.session:
+            lines.append(f"Session: {self.session}")
+        for name, value in (headers or {}).items():
+            lines.append(f"{name}: {value}")
+        self.sock.sendall(("\r\n".join(lines) + "\r\n\r\n").encode())
+
+        while True:
+            item = self.read_item()
+            if item[0] == "reply":
+                status, reply_headers, body = item[1:]
+                if int(reply_headers.get("cseq", "-1")) != self.cseq:
+                    raise RtspError(f"{method}: CSeq {reply_headers.get('cseq')} != {self.cseq}")
+                if status != 200:
+                    raise RtspError(f"{method}: status {status}")
+                if "session" in reply_headers:
+                    self.session = reply_headers["session"].split(";")[0]
+                return reply_headers, body
+
+    def read_item(self):
+        """Return ("data", channel, payload) or ("reply", status, headers, body)."""
+        while True:
+            if self.buffer[:1] == b"$" and len(self.buffer) >= 4:
+                length = struct.unpack(">H", self.buffer[2:4])[0]
+                if len(self.buffer) >= 4 + length:
+                    item = ("data", self.buffer[1], self.buffer[4:4 + length])
+                    self.buffer = self.buffer[4 + length:]
+                    return item
+            elif self.buffer[:1] not in (b"", b"$"):
+                end = self.buffer.find(b"\r\n\r\n")
+                if end >= 0:
+                    head = self.buffer[:end].decode(errors="replace").split("\r\n")
+                    headers = {}
+                    for line in head[1:]:
+                        name, _, value = line.partition(":")
+                        headers[name.strip().lower()] = value.strip()
+                    length = int(headers.get("content-length", "0"))
+                    if len(self.buffer) >= end + 4 + length:
+                        body = self.buffer[end + 4:end + 4 + length]
+                        self.buffer = self.buffer[end + 4 + length:]
+                        status = int(head[0].split()[1])
+                        return ("reply", status, headers, body)
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise RtspError("connection closed")
+            self.buffer += chunk
+
+    def close(self):
+        self.sock.close()
+
+
+class StreamChecker:
+    """Checks RTP packets of one stream and reassembles them into JPEGs."""
+
+    def __init__(self, ssrc=None):
+        self.ssrc = ssrc
+        self.errors = []
+        self.packets = 0
+        self.lost = 0
+        self.reports = 0
+        self.frames = []          # (timestamp, jpeg) of complete frames
+        self.first_time = None
+        self.last_time = None
+        self.last_sequence = None
+        self.last_timestamp = None
+        self.current = None       # Fragments of the frame being reassembled
+
+    def error(self, message):
+        if len(self.errors) < 10:
+            self.errors.append(message)
+
+    def rtcp(self, data):
+        # A compound packet starts with a sender report
+        if len(data) >= 28 and data[0] >> 6 == 2 and data[1] == 200:
+            if self.ssrc is not None and struct.unpack(">I", data[4:8])[0] != self.ssrc:
+                self.error("sender report for another SSRC")
+            self.reports += 1
+
+    def rtp(self, data):
+        if len(data) < 20:
+            self.error(f"{len(data)}-byte packet")
+            return
+        first, second, sequence, timestamp, ssrc = struct.unpack(">BBHII", data[:12])
+        self.packets += 1
+        if first >> 6 != 2 or first & 0x3f != 0:
+            self.error(f"RTP header byte 0x{first:02x}")
+        if second & 0x7f != 26:
+            self.error(f"payload type {second & 0x7f}")
+        if self.ssrc is None:
+            self.ssrc = ssrc
+        elif ssrc != self.ssrc:
+            self.error(f"SSRC {ssrc:08x} != {self.ssrc:08x}")
+        if self.last_sequence is not None:
+            gap = (sequence - self.last_sequence) & 0xffff
+            if gap == 0 or gap > 0x8000:
+                self.error(f"sequence {sequence} after {self.last_sequence}")
+                return
+            if gap > 1:
+                self.lost += gap - 1
+                self.current = None
+        self.last_sequence = sequence
+
+        offset = struct.unpack(">I", b"\0" + data[13:16])[0]
+        kind, q, width, height = data[16:20]
+        position = 20
+        restart_interval = 0
+        if kind >= 64:
+            restart_interval = struct.unpack(">H", data[position:position + 2])[0]
+            position += 4
+        if offset == 0:
+            if self.current is not None:
+                self.error(f"frame at {self.current['timestamp']} ended without a marker")
+            if self.last_timestamp is not None and ((timestamp - self.last_timestamp) & 0xffffffff) >= 0x80000000:
+                self.error(f"timestamp {timestamp} not after {self.last_timestamp}")
+            if q < 128:
+                self.error(f"Q {q}: tables not in the frame")
+                self.current = None
+                return
+            _, precision, length = struct.unpack(">BBH", data[position:position + 4])
+            position += 4
+            if precision != 0 or length != 128:
+                self.error(f"quantisation header precision {precision} length {length}")
+            self.current = {"timestamp": timestamp, "kind": kind, "width": width, "height": height,
+                            "restart": restart_interval, "tables": data[position:position + length],
+                            "scan": bytearray()}
+            position += length
+        elif self.current is None:
+            return  # Joined mid-frame or the start was lost
+        current = self.current
+        if timestamp != current["timestamp"]:
+            self.error(f"timestamp changed within a frame: {timestamp} != {current['timestamp']}")
+        if (kind, width, height) != (current["kind"], current["width"], current["height"]):
+            self.error("type or size changed within a frame")
+        if offset != len(current["scan"]):
+            self.error(f"fragment offset {offset}, expected {len(current['scan'])}")
+            self.current = None
+            return
+        current["scan"] += data[position:]
+
+        if second & 0x80:
+            self.last_timestamp = timestamp
+            self.current = None
+            jpeg = build_jpeg(current)
+            self.frames.append((timestamp, jpeg, current))
+            now = time.monotonic()
+            if self.first_time is None:
+                self.first_time = now
+            self.last_time = now
+
+
+def huffman_table(counts, symbols):
+    table = {}
+    code = 0
+    index = 0
+    for length in range(1, 17):
+        for _ in range(counts[length - 1]):
+            table[(length, code)] = symbols[index]
+            code += 1
+            index += 1
+        code <<= 1
+    return table
+
+
+def marker(code, payload):
+    return bytes([0xff, code]) + struct.pack(">H", len(payload) + 2) + payload
+
+
+def build_jpeg(frame):
+    """Rebuild the JPEG headers the way RFC 2435 Appendix A does."""
+    kind = frame["kind"] & 63
+    tables = frame["tables"]
+    luma_sampling = 0x21 if kind == 0 else 0x22
+    parts = [b"\xff\xd8",
+             marker(0xdb, b"\x00" + tables[:64] + b"\x01" + tables[64:128]),
+             marker(0xc0, struct.pack(">BHHB", 8, frame["height"] * 8, frame["width"] * 8, 3) +
+                    bytes([1, luma_sampling, 0, 2, 0x11, 1, 3, 0x11, 1]))]
+    for table_class, counts, symbols in ((0x00, DC_LUMA_COUNTS, DC_SYMBOLS), (0x10, AC_LUMA_COUNTS, AC_LUMA_SYMBOLS),
+                                         (0x01, DC_CHROMA_COUNTS, DC_SYMBOLS),
+                                         (0x11, AC_CHROMA_COUNTS, AC_CHROMA_SYMBOLS)):
+        parts.append(marker(0xc4, bytes([table_class] + counts) + bytes(symbols)))
+    if frame["restart"]:
+        parts.append(marker(0xdd, struct.pack(">H", frame["restart"])))
+    parts.append(marker(0xda, bytes([3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0])))
+    parts.append(bytes(frame["scan"]))
+    parts.append(b"\xff\xd9")
+    return b"".join(parts)
+
+
+def decode_scan(frame):
+    """Huffman-decode every MCU; returns an error message or None."""
+    dc_tables = [huffman_table(DC_LUMA_COUNTS, DC_SYMBOLS), huffman_table(DC_CHROMA_COUNTS, DC_SYMBOLS)]
+    ac_tables = [huffman_table(AC_LUMA_COUNTS, AC_LUMA_SYMBOLS), huffman_table(AC_CHROMA_COUNTS, AC_CHROMA_SYMBOLS)]
+    kind = frame["kind"] & 63
+    luma_blocks = 2 if kind == 0 else 4
+    mcu_width = 16
+    mcu_height = 8 if kind == 0 else 16
+    mcus = ((frame["width"] * 8 + mcu_width - 1) // mcu_width) * ((frame["height"] * 8 + mcu_height - 1) // mcu_height)
+
+    # Split at restart markers and remove stuffed zero bytes
+    segments = [bytearray()]
+    scan = frame["scan"]
+    i = 0
+    while i < len(scan):
+        byte = scan[i]
+        if byte == 0xff and i + 1 < len(scan):
+            following = scan[i + 1]
+            if following == 0x00:
+                segments[-1].append(0xff)
+                i += 2
+                continue
+            if 0xd0 <= following <= 0xd7:
+                segments.append(bytearray())
+                i += 2
+                continue
+            return f"marker ff{following:02x} inside the scan"
+        segments[-1].append(byte)
+        i += 1
+
+    restart = frame["restart"] or mcus
+    decoded = 0
+    for segment in segments:
+        bits = "".join(format(byte, "08b") for byte in segment)
+        position = 0
+
+        def symbol(table):
+            nonlocal position
+            code = 0
+            for length in range(1, 17):
+                if position >= len(bits):
+                    raise ValueError("scan ends mid-code")
+                code = code << 1 | (bits[position] == "1")
+                position += 1
+                if (length, code) in table:
+                    return table[(length, code)]
+            raise ValueError(f"invalid Huffman code at bit {position}")
+
+        try:
+            for _ in range(min(restart, mcus - decoded)):
+                for block in range(luma_blocks + 2):
+                    table = 0 if block < luma_blocks else 1
+                    size = symbol(dc_tables[table])
+                    position += size
+                    index = 1
+                    while index < 64:
+                        value = symbol(ac_tables[table])
+                        if value == 0x00:
+                            break
+                        index += (value >> 4) + 1
+                        position += value & 0x0f
+                    if index > 64:
+                        raise ValueError("coefficients run past the block")
+                decoded += 1
+        except ValueError as error:
+            return f"MCU {decoded} of {mcus}: {error}"
+        # Only the 1-bit padding to a byte boundary may be left
+        if len(bits) - position >= 8 or "0" in bits[position:]:
+            return f"{len(bits) - position} bits left after {decoded} MCUs"
+    if decoded != mcus:
+        return f"{decoded} of {mcus} MCUs"
+    return None
+
+
+def parse_transport(value):
+    fields = {}
+    for item in value.split(";"):
+        name, _, setting = item.partition("=")
+        fields[name.strip().lower()] = setting.strip()
+    return fields
+
+
+def run_client(index, args, results):
+    result = {"client": index, "error": None, "checker": None}
+    results[index] = result
+    connection = None
+    sockets = []
+    try:
+        connection = RtspConnection(args.url, args.timeout)
+        connection.request("OPTIONS")
+        _, sdp = connection.request("DESCRIBE", headers={"Accept": "application/sdp"})
+        sdp = sdp.decode()
+        if "RTP/AVP 26" not in sdp or "JPEG/90000" not in sdp:
+            raise RtspError("SDP does not offer RTP/JPEG")
+        control = next((line[10:] for line in sdp.splitlines() if line.startswith("a=control:track")), "track1")
+        track = args.url.rstrip("/") + "/" + control
+
+        if args.transport == "udp":
+            rtp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            rtp.bind(("0.0.0.0", 0))
+            port = rtp.getsockname()[1]
+            rtcp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            try:
+                rtcp.bind(("0.0.0.0", port + 1))
+            except OSError:
+                rtp.close()
+                rtp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+                rtp.bind(("0.0.0.0", port + 2))
+                rtcp.bind(("0.0.0.0", port + 3))
+                port += 2
+            rtp.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+            sockets = [rtp, rtcp]
+            transport = f"RTP/AVP;unicast;client_port={port}-{port + 1}"
+        elif args.transport == "tcp":
+            transport = "RTP/AVP/TCP;unicast;interleaved=0-1"
+        else:
+            transport = "RTP/AVP;multicast"
+        headers, _ = connection.request("SETUP", track, {"Transport": transport})
+        fields = parse_transport(headers.get("transport", ""))
+        ssrc = int(fields["ssrc"], 16) if "ssrc" in fields else None
+        checker = StreamChecker(ssrc)
+        result["checker"] = checker
+
+        if args.transport == "multicast":
+            group = fields.get("destination")
+            ports = [int(port) for port in fields.get("port", "").split("-") if port]
+            if not group or len(ports) != 2:
+                raise RtspError(f"no multicast group in {headers.get('transport')}")
+            for port in ports:
+                sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+                sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+                sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+                sock.bind(("", port))
+                membership = socket.inet_aton(group) + socket.inet_aton(args.interface)
+                sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+                sockets.append(sock)
+            result["group"] = f"{group}:{ports[0]}"
+
+        connection.request("PLAY")
+        deadline = time.monotonic() + args.duration
+        keepalive = time.monotonic() + 20
+        while time.monotonic() < deadline:
+            if args.transport == "tcp":
+                connection.sock.settimeout(max(deadline - time.monotonic(), 0.01))
+                try:
+                    item = connection.read_item()
+                except socket.timeout:
+                    break
+                if item[0] == "data":
+                    (checker.rtp if item[1] == 0 else checker.rtcp)(item[2])
+                continue
+            readable, _, _ = select.select(sockets, [], [], 0.2)
+            for sock in readable:
+                data = sock.recv(65536)
+                (checker.rtp if sock is sockets[0] else checker.rtcp)(data)
+            if time.monotonic() > keepalive:
+                connection.request("GET_PARAMETER")
+                keepalive = time.monotonic() + 20
+        # Over TCP, packets still in flight are skipped until the reply arrives
+        connection.sock.settimeout(args.timeout)
+        connection.request("TEARDOWN")
+    except (OSError, RtspError, ValueError, KeyError) as error:
+        result["error"] = str(error) or type(error).__name__
+    finally:
+        for sock in sockets:
+            sock.close()
+        if connection is not None:
+            connection.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="rtsp://127.0.0.1:8554/", help="RTSP URL")
+    parser.add_argument("--transport", choices=("udp", "tcp", "multicast"), default="udp")
+    parser.add_argument("--clients", type=int, default=1, help="concurrent clients")
+    parser.add_argument("--duration", type=float, default=8.0, help="seconds to receive for")
+    parser.add_argument("--interface", default="0.0.0.0", help="interface address to join multicast on")
+    parser.add_argument("--decode-frames", type=int, default=3, help="frames to Huffman-decode per client")
+    parser.add_argument("--max-loss", type=float, default=0.0, help="packet loss allowed, in percent")
+    parser.add_argument("--min-fps", type=float, help="fail if any client is slower")
+    parser.add_argument("--timeout", type=float, default=5.0, help="RTSP reply timeout in seconds")
+    parser.add_argument("--save", metavar="DIR", help="save client 0's frames to DIR")
+    args = parser.parse_args()
+
+    results = [None] * args.clients
+    threads = [threading.Thread(target=run_client, args=(i, args, results)) for i in range(args.clients)]
+    for thread in threads:
+        thread.start()
+        time.sleep(0.1)
+    for thread in threads:
+        thread.join()
+
+    failures = []
+    print(f"{'client':>6} {'frames':>7} {'fps':>7} {'packets':>8} {'lost':>6} {'reports':>8} {'decoded':>8}")
+    for result in results:
+        client = result["client"]
+        checker = result["checker"]
+        if result["error"]:
+            failures.append(f"client {client}: {result['error']}")
+        if checker is None:
+            continue
+        failures += [f"client {client}: {message}" for message in checker.errors]
+
+        decoded = 0
+        for _, jpeg, frame in checker.frames[:args.decode_frames]:
+            problem = decode_scan(frame)
+            if problem:
+                failures.append(f"client {client}: frame does not decode: {problem}")
+                break
+            decoded += 1
+        if args.save and client == 0:
+            os.makedirs(args.save, exist_ok=True)
+            for number, (_, jpeg, _) in enumerate(checker.frames):
+                with open(os.path.join(args.save, f"frame_{number:05d}.jpg"), "wb") as file:
+                    file.write(jpeg)
+
+        frames = len(checker.frames)
+        streaming = (checker.last_time - checker.first_time) if frames > 1 else 0
+        fps = (frames - 1) / streaming if streaming > 0 else 0.0
+        loss = 100.0 * checker.lost / (checker.packets + checker.lost) if checker.packets else 0.0
+        print(f"{client:>6} {frames:>7} {fps:>7.2f} {checker.packets:>8} {checker.lost:>6} "
+              f"{checker.reports:>8} {decoded:>8}")
+
+        if frames == 0:
+            failures.append(f"client {client}: no complete frames")
+        if loss > args.max_loss:
+            failures.append(f"client {client}: {loss:.2f}% packet loss > {args.max_loss}%")
+        if checker.reports == 0:
+            failures.append(f"client {client}: no RTCP sender report")
+        if args.min_fps is not None and fps < args.min_fps:
+            failures.append(f"client {client}: {fps:.2f} fps < {args.min_fps}")
+
+    if args.transport == "multicast":
+        ssrcs = {result["checker"].ssrc for result in results if result["checker"]}
+        if len(ssrcs) > 1:
+            failures.append(f"multicast clients saw {len(ssrcs)} different streams")
+
+    for failure in failures:
+        print(f"FAIL {failure}")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
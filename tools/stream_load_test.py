@@ -0,0 +1,339 @@
+#!/usr/bin/env python3
+"""Open N concurrent /stream viewers and report per-client frame statistics.
+
+Works against a board or the native build (`pio run -e native -t exec`,
+which serves on port 8080). For every client it reports frames received,
+frames per second, inter-frame jitter (standard deviation of the gap
+between frames) and time to first frame. Thresholds turn it into a CI
+check: the exit status is 1 if any client misses them.
+
+    tools/stream_load_test.py --url http://127.0.0.1:8080/stream --clients 4 \
+        --duration 20 --min-fps 10 --max-ttff-ms 1500
+
+A ws:// URL streams from /ws instead: each client acknowledges every frame,
+after --ack-delay-ms to imitate a slow viewer, and also reports lag - how
+far arrivals have fallen behind the camera's capture clock since the first
+frame. With acknowledgements it stays around the ack window rather than
+growing.
+
+    tools/stream_load_test.py --url ws://127.0.0.1:8080/ws --clients 1 --ack-delay-ms 200
+
+--sweep N repeats the test with 1, 2, ... N clients and checks that every
+viewer still gets the single-viewer frame rate, so the aggregate rises in
+step with the client count instead of the camera's output being divided
+between them. The exit status is 1 if the mean per-client FPS at any count
+falls more than --max-fps-drop percent below the one-client figure. Keep N
+within the stream slots (see /streams); priority=high may use all of them.
+
+    tools/stream_load_test.py --url 'http://127.0.0.1:8080/stream?priority=high' \
+        --sweep 4 --duration 10 --max-fps-drop 10
+
+With --record DIR the first client also writes every frame it receives to
+DIR as a numbered JPEG, which is how a frame corpus for the native build is
+captured from a real camera.
+"""
+
+import argparse
+import asyncio
+import base64
+import json
+import os
+import statistics
+import struct
+import sys
+import time
+from urllib.parse import urlsplit
+
+
+class ClientStats:
+    def __init__(self, index):
+        self.index = index
+        self.frames = 0
+        self.bytes = 0
+        self.connect_time = None
+        self.first_frame_time = None
+        self.last_frame_time = None
+        self.gaps = []
+        self.lag = None
+        self.error = None
+
+    def record_frame(self, length):
+        now = time.monotonic()
+        if self.first_frame_time is None:
+            self.first_frame_time = now
+        else:
+            self.gaps.append(now - self.last_frame_time)
+        self.last_frame_time = now
+        self.frames += 1
+        self.bytes += length
+
+    def summary(self, duration):
+        streaming = 0.0
+        if self.first_frame_time is not None and self.last_frame_time is not None:
+            streaming = self.last_frame_time - self.first_frame_time
+        fps = (self.frames - 1) / streaming if self.frames > 1 and streaming > 0 else 0.0
+        jitter = statistics.pstdev(self.gaps) * 1000 if len(self.gaps) > 1 else 0.0
+        ttff = None
+        if self.first_frame_time is not None:
+            ttff = (self.first_frame_time - self.connect_time) * 1000
+        return {
+            "client": self.index,
+            "frames": self.frames,
+            "fps": round(fps, 2),
+            "jitter_ms": round(jitter, 1),
+            "max_gap_ms": round(max(self.gaps) * 1000, 1) if self.gaps else 0.0,
+            "ttff_ms": round(ttff, 1) if ttff is not None else None,
+            "kbps": round(self.bytes * 8 / 1000 / duration, 1) if duration > 0 else 0.0,
+            "lag_ms": round(self.lag * 1000, 1) if self.lag is not None else None,
+            "error": self.error,
+        }
+
+
+async def read_headers(reader):
+    """Read header lines up to the blank line and return them lower-cased."""
+    headers = {}
+    while True:
+        line = await reader.readline()
+        if not line:
+            raise ConnectionError("connection closed")
+        line = line.decode("latin-1").strip()
+        if not line:
+            if headers:
+                return headers
+            continue  # blank line between parts
+        if ":" in line:
+            name, value = line.split(":", 1)
+            headers[name.strip().lower()] = value.strip()
+        else:
+            headers[line] = ""
+
+
+async def run_client(index, url, deadline, record_dir, stats):
+    parts = urlsplit(url)
+    host = parts.hostname or "127.0.0.1"
+    port = parts.port or 80
+    path = parts.path or "/stream"
+    if parts.query:
+        path += "?" + parts.query
+
+    stats.connect_time = time.monotonic()
+    writer = None
+    try:
+        reader, writer = await asyncio.open_connection(host, port)
+        writer.write(f"GET {path} HTTP/1.1\r\nHost: {host}\r\nConnection: close\r\n\r\n".encode())
+        await writer.drain()
+
+        status = await reader.readline()
+        if b" 200 " not in status:
+            raise ConnectionError(f"unexpected status: {status.decode(errors='replace').strip()}")
+        await read_headers(reader)
+
+        while time.monotonic() < deadline:
+            remaining = deadline - time.monotonic()
+            part = await asyncio.wait_for(read_headers(reader), timeout=max(remaining, 0.01))
+            length = int(part.get("content-length", "0"))
+            if length <= 0:
+                raise ConnectionError("part without Content-Length")
+            jpeg = await asyncio.wait_for(reader.readexactly(length), timeout=max(remaining, 0.01))
+            stats.record_frame(length)
+
+            if record_dir is not None:
+                with open(os.path.join(record_dir, f"frame_{stats.frames:05d}.jpg"), "wb") as file:
+                    file.write(jpeg)
+    except asyncio.TimeoutError:
+        pass
+    except (ConnectionError, OSError, asyncio.IncompleteReadError, ValueError) as error:
+        stats.error = str(error) or type(error).__name__
+    finally:
+        if writer is not None:
+            writer.close()
+
+
+async def read_ws_message(reader):
+    """Read one server-to-client WebSocket frame; returns (opcode, payload)."""
+    first, second = await reader.readexactly(2)
+    length = second & 0x7F
+    if length == 126:
+        length = struct.unpack(">H", await reader.readexactly(2))[0]
+    elif length == 127:
+        length = struct.unpack(">Q", await reader.readexactly(8))[0]
+    return first & 0x0F, await reader.readexactly(length)
+
+
+def ws_text_frame(text):
+    """Build a masked client-to-server text frame (payloads under 126 bytes)."""
+    payload = text.encode()
+    mask = os.urandom(4)
+    masked = bytes(byte ^ mask[i % 4] for i, byte in enumerate(payload))
+    return bytes([0x81, 0x80 | len(payload)]) + mask + masked
+
+
+async def run_ws_client(index, url, deadline, record_dir, ack_delay, stats):
+    parts = urlsplit(url)
+    host = parts.hostname or "127.0.0.1"
+    port = parts.port or 80
+    path = parts.path or "/ws"
+    if parts.query:
+        path += "?" + parts.query
+
+    stats.connect_time = time.monotonic()
+    writer = None
+    first_capture_us = None
+    try:
+        reader, writer = await asyncio.open_connection(host, port)
+        key = base64.b64encode(os.urandom(16)).decode()
+        writer.write((f"GET {path} HTTP/1.1\r\nHost: {host}\r\nUpgrade: websocket\r\n"
+                      f"Connection: Upgrade\r\nSec-WebSocket-Key: {key}\r\n"
+                      f"Sec-WebSocket-Version: 13\r\n\r\n").encode())
+        await writer.drain()
+
+        status = await reader.readline()
+        if b" 101 " not in status:
+            raise ConnectionError(f"unexpected status: {status.decode(errors='replace').strip()}")
+        await read_headers(reader)
+
+        while time.monotonic() < deadline:
+            remaining = deadline - time.monotonic()
+            opcode, payload = await asyncio.wait_for(read_ws_message(reader), timeout=max(remaining, 0.01))
+            if opcode == 0x8:
+                raise ConnectionError("closed by the server")
+            if opcode != 0x2 or len(payload) < 16:
+                continue
+            sequence, length, capture_us = struct.unpack("<IIQ", payload[:16])
+            stats.record_frame(length)
+
+            # Arrival time against capture time, relative to the first frame
+            if first_capture_us is None:
+                first_capture_us = capture_us
+            lag = (stats.last_frame_time - stats.first_frame_time) - (capture_us - first_capture_us) / 1e6
+            stats.lag = lag if stats.lag is None else max(stats.lag, lag)
+
+            if record_dir is not None:
+                with open(os.path.join(record_dir, f"frame_{stats.frames:05d}.jpg"), "wb") as file:
+                    file.write(payload[16:])
+
+            if ack_delay > 0:
+                await asyncio.sleep(ack_delay)
+            writer.write(ws_text_frame(str(sequence)))
+            await writer.drain()
+    except asyncio.TimeoutError:
+        pass
+    except (ConnectionError, OSError, asyncio.IncompleteReadError, ValueError) as error:
+        stats.error = str(error) or type(error).__name__
+    finally:
+        if writer is not None:
+            writer.close()
+
+
+async def run(args):
+    clients = [ClientStats(i) for i in range(args.clients)]
+    start = time.monotonic()
+    tasks = []
+    for i, stats in enumerate(clients):
+        # Stagger connections so time to first frame is measured per client
+        await asyncio.sleep(args.stagger_ms / 1000 if i else 0)
+        deadline = start + args.duration
+        record = args.record if i == 0 else None
+        if urlsplit(args.url).scheme == "ws":
+            client = run_ws_client(i, args.url, deadline, record, args.ack_delay_ms / 1000, stats)
+        else:
+            client = run_client(i, args.url, deadline, record, stats)
+        tasks.append(asyncio.create_task(client))
+    await asyncio.gather(*tasks)
+    return [stats.summary(args.duration) for stats in clients]
+
+
+def sweep(args):
+    """Run 1..args.sweep clients in turn; returns (rows, failures)."""
+    rows = []
+    failures = []
+    for count in range(1, args.sweep + 1):
+        args.clients = count
+        results = asyncio.run(run(args))
+        rates = [r["fps"] for r in results]
+        rows.append({
+            "clients": count,
+            "mean_fps": round(statistics.mean(rates), 2),
+            "min_fps": min(rates),
+            "aggregate_fps": round(sum(rates), 2),
+            "errors": [f"client {r['client']}: {r['error']}" for r in results if r["error"]],
+        })
+        failures.extend(f"{count} clients, {error}" for error in rows[-1]["errors"])
+        # Give the server time to close the last round's sessions
+        time.sleep(1)
+
+    baseline = rows[0]["mean_fps"]
+    if baseline <= 0:
+        failures.append("no frames with one client")
+    elif args.max_fps_drop is not None:
+        floor = baseline * (1 - args.max_fps_drop / 100)
+        for row in rows[1:]:
+            if row["mean_fps"] < floor:
+                failures.append(f"{row['clients']} clients: {row['mean_fps']} fps per client < {floor:.2f} "
+                                f"({args.max_fps_drop}% below {baseline})")
+    return rows, failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://127.0.0.1:8080/stream", help="stream URL (http:// or ws://)")
+    parser.add_argument("--ack-delay-ms", type=float, default=0.0, help="delay before acknowledging a /ws frame")
+    parser.add_argument("--clients", type=int, default=4, help="concurrent viewers")
+    parser.add_argument("--duration", type=float, default=15.0, help="test length in seconds")
+    parser.add_argument("--stagger-ms", type=float, default=100.0, help="delay between connections")
+    parser.add_argument("--min-fps", type=float, help="fail if any client is slower")
+    parser.add_argument("--max-jitter-ms", type=float, help="fail if any client's jitter is higher")
+    parser.add_argument("--max-ttff-ms", type=float, help="fail if any client's first frame is later")
+    parser.add_argument("--sweep", type=int, metavar="N", help="run 1..N clients and compare frame rates")
+    parser.add_argument("--max-fps-drop", type=float, help="with --sweep, fail if per-client FPS falls by more "
+                                                            "than this percentage of the one-client figure")
+    parser.add_argument("--record", metavar="DIR", help="save client 0's frames to DIR")
+    parser.add_argument("--json", action="store_true", help="print results as JSON")
+    args = parser.parse_args()
+
+    if args.record:
+        os.makedirs(args.record, exist_ok=True)
+
+    if args.sweep:
+        rows, failures = sweep(args)
+        if args.json:
+            print(json.dumps({"sweep": rows, "failures": failures}, indent=2))
+        else:
+            print(f"{'clients':>7} {'mean fps':>9} {'min fps':>9} {'aggregate':>10}")
+            for row in rows:
+                print(f"{row['clients']:>7} {row['mean_fps']:>9.2f} {row['min_fps']:>9.2f} {row['aggregate_fps']:>10.2f}")
+            for failure in failures:
+                print(f"FAIL {failure}")
+        return 1 if failures else 0
+
+    results = asyncio.run(run(args))
+
+    failures = []
+    for result in results:
+        client = result["client"]
+        if result["error"]:
+            failures.append(f"client {client}: {result['error']}")
+        if args.min_fps is not None and result["fps"] < args.min_fps:
+            failures.append(f"client {client}: {result['fps']} fps < {args.min_fps}")
+        if args.max_jitter_ms is not None and result["jitter_ms"] > args.max_jitter_ms:
+            failures.append(f"client {client}: jitter {result['jitter_ms']} ms > {args.max_jitter_ms}")
+        if args.max_ttff_ms is not None and (result["ttff_ms"] is None or result["ttff_ms"] > args.max_ttff_ms):
+            failures.append(f"client {client}: first frame {result['ttff_ms']} ms > {args.max_ttff_ms}")
+
+    if args.json:
+        print(json.dumps({"results": results, "failures": failures}, indent=2))
+    else:
+        print(f"{'client':>6} {'frames':>7} {'fps':>7} {'jitter':>9} {'max gap':>9} {'ttff':>9} {'kbps':>9} {'lag':>9}")
+        for r in results:
+            ttff = f"{r['ttff_ms']:.0f}ms" if r["ttff_ms"] is not None else "-"
+            lag = f"{r['lag_ms']:.0f}ms" if r["lag_ms"] is not None else "-"
+            print(f"{r['client']:>6} {r['frames']:>7} {r['fps']:>7.2f} {r['jitter_ms']:>7.1f}ms "
+                  f"{r['max_gap_ms']:>7.0f}ms {ttff:>9} {r['kbps']:>9.0f} {lag:>9}")
+        for failure in failures:
+            print(f"FAIL {failure}")
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())